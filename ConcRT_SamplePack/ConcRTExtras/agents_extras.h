@@ -138,12 +138,18 @@ namespace samples
     };
 
     /// <summary>
-    ///     Simple queue implementation that takes into account priority
-    ///     using the comparison operator <.
+    ///     Priority queue of messages ordered using the comparison operator < on
+    ///     the payload. Messages with equal priority are dequeued in the order they
+    ///     were enqueued.
     /// </summary>
     /// <typeparam name="_Type">
     ///     The payload type of messages stored in this queue.
     /// </typeparam>
+    /// <remarks>
+    ///     The queue is an array-backed 4-ary min-heap, so enqueue and dequeue are
+    ///     O(log n). Heap nodes live in a single buffer obtained from the ConcRT
+    ///     sub-allocator; no allocation is made per message.
+    /// </remarks>
     template <class _Type>
     class PriorityQueue
     {
@@ -151,18 +157,21 @@ namespace samples
         /// <summary>
         ///     Constructs an initially empty queue.
         /// </summary>
-        PriorityQueue() : _M_pHead(NULL), _M_count(0) {}
+        PriorityQueue() : _M_pHeap(NULL), _M_count(0), _M_capacity(0), _M_nextSequence(0), _M_fHeadPinned(false) {}
 
         /// <summary>
         ///     Removes and deletes any messages remaining in the queue.
         /// </summary>
         ~PriorityQueue() 
         {
-            message<_Type> * _Msg = dequeue();
-            while (_Msg != NULL)
+            for (size_t _I = 0; _I < _M_count; ++_I)
             {
-                delete _Msg;
-                _Msg = dequeue();
+                delete _M_pHeap[_I]._M_pMsg;
+            }
+
+            if (_M_pHeap != NULL)
+            {
+                Concurrency::Free(_M_pHeap);
             }
         }
 
@@ -173,53 +182,38 @@ namespace samples
         /// <param name="_Msg">
         ///     Message to add.
         /// </param>
-        /// <param name="fCanReplaceHead">
-        ///     True if this new message can be inserted at the head.
+        /// <param name="fInsertAtHead">
+        ///     True if this new message can be inserted at the head. If false, the
+        ///     current head stays at the head until it is dequeued or a message is
+        ///     enqueued with this parameter set to true.
         /// </param>
         void enqueue(message<_Type> *_Msg, const bool fInsertAtHead = true)
         {
-            MessageNode *_Element = new MessageNode();
-            _Element->_M_pMsg = _Msg;
-
-            // Find location to insert.
-            MessageNode *pCurrent = _M_pHead;
-            MessageNode *pPrev = NULL;
-            if(!fInsertAtHead && pCurrent != NULL)
+            if (fInsertAtHead)
             {
-                pPrev = pCurrent;
-                pCurrent = pCurrent->_M_pNext;
-            }
-            while(pCurrent != NULL)
-            {
-                if(_Element->_M_pMsg->payload < pCurrent->_M_pMsg->payload)
+                if (_M_fHeadPinned)
                 {
-                    break;
+                    // The head no longer needs to stay put; restore heap order
+                    // among the messages that were held behind it.
+                    _M_fHeadPinned = false;
+                    _Sift_down(0, _M_pHeap[0]);
                 }
-                pPrev = pCurrent;
-                pCurrent = pCurrent->_M_pNext;
             }
-
-            // Insert at head.
-            if(pPrev == NULL)
+            else if (_M_count != 0)
             {
-                _M_pHead = _Element;
-            }
-            else
-            {
-                pPrev->_M_pNext = _Element;
+                _M_fHeadPinned = true;
             }
 
-            // Last item in queue.
-            if(pCurrent == NULL)
+            if (_M_count == _M_capacity)
             {
-                _Element->_M_pNext = NULL;
-            }
-            else
-            {
-                _Element->_M_pNext = pCurrent;
+                _Grow();
             }
 
-            ++_M_count;
+            _HeapNode _Node;
+            _Node._M_pMsg = _Msg;
+            _Node._M_sequence = _M_nextSequence++;
+
+            _Sift_up(_M_count++, _Node);
         }
 
         /// <summary>
@@ -230,22 +224,19 @@ namespace samples
         /// </returns>
         message<_Type> * dequeue()
         {
-            if (_M_pHead == NULL) 
+            if (_M_count == 0) 
             {
                 return NULL;
             }
 
-            MessageNode *_OldHead = _M_pHead;
-            message<_Type> * _Result = _OldHead->_M_pMsg;
-
-            _M_pHead = _OldHead->_M_pNext;
+            message<_Type> * _Result = _M_pHeap[0]._M_pMsg;
+            _M_fHeadPinned = false;
 
-            delete _OldHead;
-
-            if(--_M_count == 0)
+            if (--_M_count != 0)
             {
-                _M_pHead = NULL;
+                _Sift_down(0, _M_pHeap[_M_count]);
             }
+
             return _Result;
         }
 
@@ -259,7 +250,7 @@ namespace samples
         {
             if(_M_count != 0)
             {
-                return _M_pHead->_M_pMsg;
+                return _M_pHeap[0]._M_pMsg;
             }
             return NULL;
         }
@@ -288,26 +279,130 @@ namespace samples
         {
             if(_M_count != 0)
             {
-                return _M_pHead->_M_pMsg->msg_id() == _MsgId;
+                return _M_pHeap[0]._M_pMsg->msg_id() == _MsgId;
             }
             return false;
         }
 
     private:
-        
-        // Used to store individual message nodes.
-        struct MessageNode
+
+        // Number of children of each heap node.
+        static const size_t _Arity = 4;
+
+        // Initial number of heap nodes allocated.
+        static const size_t _InitialCapacity = 16;
+
+        // A heap entry. The sequence number breaks ties between equal
+        // payloads in favor of the earlier message.
+        struct _HeapNode
         {
-            MessageNode() : _M_pMsg(NULL), _M_pNext(NULL) {}
             message<_Type> * _M_pMsg;
-            MessageNode * _M_pNext;
+            unsigned long long _M_sequence;
         };
 
-        // A pointer to the head of the queue.
-        MessageNode * _M_pHead;
+        // Returns true if _Left should be dequeued before _Right.
+        static bool _Precedes(const _HeapNode& _Left, const _HeapNode& _Right)
+        {
+            if (_Left._M_pMsg->payload < _Right._M_pMsg->payload)
+            {
+                return true;
+            }
+            if (_Right._M_pMsg->payload < _Left._M_pMsg->payload)
+            {
+                return false;
+            }
+            return _Left._M_sequence < _Right._M_sequence;
+        }
+
+        // Moves _Node up from the hole at _Index until its parent precedes it.
+        // A pinned head is never displaced.
+        void _Sift_up(size_t _Index, const _HeapNode& _Node)
+        {
+            while (_Index > 0)
+            {
+                size_t _Parent = (_Index - 1) / _Arity;
+
+                if ((_Parent == 0 && _M_fHeadPinned) || !_Precedes(_Node, _M_pHeap[_Parent]))
+                {
+                    break;
+                }
+
+                _M_pHeap[_Index] = _M_pHeap[_Parent];
+                _Index = _Parent;
+            }
+
+            _M_pHeap[_Index] = _Node;
+        }
+
+        // Moves _Node down from the hole at _Index until it precedes all of its
+        // children. _Node may be the entry at _Index itself.
+        void _Sift_down(size_t _Index, _HeapNode _Node)
+        {
+            for (;;)
+            {
+                size_t _First = _Index * _Arity + 1;
+                if (_First >= _M_count)
+                {
+                    break;
+                }
+
+                size_t _Last = (_M_count - _First > _Arity) ? _First + _Arity : _M_count;
+                size_t _Best = _First;
+
+                for (size_t _Child = _First + 1; _Child < _Last; ++_Child)
+                {
+                    if (_Precedes(_M_pHeap[_Child], _M_pHeap[_Best]))
+                    {
+                        _Best = _Child;
+                    }
+                }
+
+                if (!_Precedes(_M_pHeap[_Best], _Node))
+                {
+                    break;
+                }
+
+                _M_pHeap[_Index] = _M_pHeap[_Best];
+                _Index = _Best;
+            }
+
+            _M_pHeap[_Index] = _Node;
+        }
+
+        // Doubles the size of the heap buffer.
+        void _Grow()
+        {
+            size_t _NewCapacity = (_M_capacity == 0) ? _InitialCapacity : _M_capacity * 2;
+            _HeapNode * _PNewHeap = reinterpret_cast<_HeapNode *>(Concurrency::Alloc(_NewCapacity * sizeof(_HeapNode)));
+
+            for (size_t _I = 0; _I < _M_count; ++_I)
+            {
+                _PNewHeap[_I] = _M_pHeap[_I];
+            }
+
+            if (_M_pHeap != NULL)
+            {
+                Concurrency::Free(_M_pHeap);
+            }
+
+            _M_pHeap = _PNewHeap;
+            _M_capacity = _NewCapacity;
+        }
+
+        // The heap, stored in level order.
+        _HeapNode * _M_pHeap;
 
         // The number of elements presently stored in the queue.
         size_t _M_count;
+
+        // The number of heap nodes allocated.
+        size_t _M_capacity;
+
+        // Sequence number given to the next message enqueued.
+        unsigned long long _M_nextSequence;
+
+        // Set while the head has to stay in place (e.g. it is reserved).
+        bool _M_fHeadPinned;
     };
 
     /// <summary>
@@ -12,9 +12,86 @@
 
 #include <concurrent_queue.h>
 #include "..\concrtextras\semaphore.h"
+#include <climits>
+#include <cstddef>
+#include <iterator>
 #include <queue>
 
-// Bounded abortable blocking queue
+template<class T> class RingBufferQueue;
+
+// Give fixed-capacity queue types a chance to size their storage. 
+// Unbounded queues are left alone.
+template<class QueueType>
+inline void reserveQueueCapacity(QueueType&, size_t)
+{
+}
+
+template<class T>
+inline void reserveQueueCapacity(RingBufferQueue<T>& queue, size_t capacity)
+{
+    queue.reserve(capacity);
+}
+
+template<class T> class LockedQueue;
+
+// Push count items that the caller already holds free slots for, as one 
+// contiguous run where the queue type supports it.
+template<class QueueType, class InputIterator>
+inline InputIterator pushQueueRange(QueueType& queue, InputIterator first, size_t count)
+{
+    for (; count > 0; --count, ++first)
+    {
+        queue.push(*first);
+    }
+
+    return first;
+}
+
+template<class T, class InputIterator>
+inline InputIterator pushQueueRange(RingBufferQueue<T>& queue, InputIterator first, size_t count)
+{
+    return queue.push_bulk(first, count);
+}
+
+template<class T, class InputIterator>
+inline InputIterator pushQueueRange(LockedQueue<T>& queue, InputIterator first, size_t count)
+{
+    return queue.push_bulk(first, count);
+}
+
+// Pop count items that the caller already holds. The pushes that produced 
+// them may not have finished publishing yet, so retry until they show up.
+template<class QueueType, class T, class OutputIterator>
+inline OutputIterator popQueueRange(QueueType& queue, T& item, OutputIterator out, size_t count)
+{
+    for (; count > 0; --count, ++out)
+    {
+        while (!queue.try_pop(item))
+        {
+            Concurrency::Context::Yield();
+        }
+
+        *out = item;
+    }
+
+    return out;
+}
+
+template<class T, class OutputIterator>
+inline OutputIterator popQueueRange(RingBufferQueue<T>& queue, T&, OutputIterator out, size_t count)
+{
+    return queue.pop_bulk(out, count);
+}
+
+template<class T, class OutputIterator>
+inline OutputIterator popQueueRange(LockedQueue<T>& queue, T&, OutputIterator out, size_t count)
+{
+    return queue.pop_bulk(out, count);
+}
+
+// Bounded abortable blocking queue. The free and used slots are counted by 
+// lightweight semaphores, so enqueue and dequeue only block (and only take 
+// a lock) when the queue is full or empty respectively.
 template<class T, class QueueType = Concurrency::concurrent_queue<T>>
 class bounded_queue
 {
@@ -22,8 +99,9 @@ public:
 
     // maxItems indicate the maximum capacity of the queue
     bounded_queue(int maxItems)
-        : m_fullSemaphore(maxItems, maxItems), m_emptySemaphore((int)0, maxItems)
+        : m_fullSemaphore(maxItems), m_emptySemaphore(0)
     {
+        reserveQueueCapacity(m_queue, (size_t)maxItems);
     }
 
     // Enqueue the given item. Block, if the queue is full
@@ -45,7 +123,7 @@ public:
         else
         {
             T item;
-            m_queue.try_pop(item);
+            popItem(item);
             m_fullSemaphore.release();
 
             return item;
@@ -62,19 +140,76 @@ public:
         }
         else
         {
-            m_queue.try_pop(item);
+            popItem(item);
             m_fullSemaphore.release();
 
             return true;
         }        
     }
 
+    // Enqueue the items in [first, last). Slots are reserved in as large 
+    // batches as are free, with one semaphore adjustment per batch. Block 
+    // while the queue is full.
+    template<class ForwardIterator>
+    void enqueue_bulk(ForwardIterator first, ForwardIterator last)
+    {
+        size_t remaining = std::distance(first, last);
+
+        while (remaining > 0)
+        {
+            int batch = m_fullSemaphore.wait_many(clampCount(remaining));
+            first = pushQueueRange(m_queue, first, batch);
+            m_emptySemaphore.release(batch);
+
+            remaining -= batch;
+        }
+    }
+
+    // Dequeue up to maxItems items into out. Block (up to timeout) only if
+    // the queue is empty; otherwise take whatever is available without 
+    // waiting for more. Returns the number of items dequeued, 0 if the 
+    // wait timed out.
+    template<class OutputIterator>
+    size_t dequeue_bulk(OutputIterator out, size_t maxItems, unsigned int timeout = COOPERATIVE_TIMEOUT_INFINITE)
+    {
+        if (maxItems == 0)
+        {
+            return 0;
+        }
+
+        int batch = m_emptySemaphore.wait_many(clampCount(maxItems), timeout);
+        if (batch > 0)
+        {
+            T item;
+            popQueueRange(m_queue, item, out, batch);
+            m_fullSemaphore.release(batch);
+        }
+
+        return batch;
+    }
+
 
 private:
 
+    // Pop an item that the semaphore has already accounted for. The push 
+    // that produced it may not have finished publishing yet, so retry until
+    // it shows up.
+    void popItem(T& item)
+    {
+        while (!m_queue.try_pop(item))
+        {
+            Concurrency::Context::Yield();
+        }
+    }
+
+    static int clampCount(size_t count)
+    {
+        return (count < INT_MAX) ? (int)count : INT_MAX;
+    }
+
     QueueType m_queue;
-    Concurrency::samples::semaphore m_fullSemaphore;
-    Concurrency::samples::semaphore m_emptySemaphore;
+    Concurrency::samples::lightweight_semaphore m_fullSemaphore;
+    Concurrency::samples::lightweight_semaphore m_emptySemaphore;
 };
 
 // Wrapper on std::queue to allow concurrent access
@@ -105,9 +240,307 @@ public:
         return false;
     }
 
+    // Push count items under a single lock acquisition
+    template<class InputIterator>
+    InputIterator push_bulk(InputIterator first, size_t count)
+    {
+        Concurrency::critical_section::scoped_lock lock(m_cs);
+        for (; count > 0; --count, ++first)
+        {
+            m_queue.push(*first);
+        }
+
+        return first;
+    }
+
+    // Pop count items, taking the lock once per run of available items.
+    // Waits for items to show up if fewer than count are queued.
+    template<class OutputIterator>
+    OutputIterator pop_bulk(OutputIterator out, size_t count)
+    {
+        while (count > 0)
+        {
+            {
+                Concurrency::critical_section::scoped_lock lock(m_cs);
+                for (; (count > 0) && !m_queue.empty(); --count, ++out)
+                {
+                    *out = m_queue.front();
+                    m_queue.pop();
+                }
+            }
+
+            if (count > 0)
+            {
+                Concurrency::Context::Yield();
+            }
+        }
+
+        return out;
+    }
+
 private:
 
     std::queue<T> m_queue;
     Concurrency::critical_section m_cs;
 };
 
+
+// Fixed capacity lock-free multi-producer/multi-consumer queue. Every cell
+// carries a sequence number that tells producers and consumers whether the
+// cell is free or full for the lap they are on, so a push or a pop is a
+// single compare-and-swap on the enqueue or dequeue position. The two 
+// positions live on separate cache lines. The capacity is rounded up to a 
+// power of two.
+//
+// Use it as the QueueType of bounded_queue:
+//     bounded_queue<T, RingBufferQueue<T>> queue(maxItems);
+template<class T>
+class RingBufferQueue
+{
+public:
+    RingBufferQueue()
+        : m_buffer(NULL), m_mask(0), m_enqueuePos(0), m_dequeuePos(0)
+    {
+    }
+
+    explicit RingBufferQueue(size_t capacity)
+        : m_buffer(NULL), m_mask(0), m_enqueuePos(0), m_dequeuePos(0)
+    {
+        reserve(capacity);
+    }
+
+    ~RingBufferQueue()
+    {
+        delete [] m_buffer;
+    }
+
+    // Allocate the ring. Must be called once, before the queue is shared.
+    void reserve(size_t capacity)
+    {
+        _ASSERTE(m_buffer == NULL);
+        _ASSERTE(capacity > 0);
+
+        size_t size = 2;
+        while (size < capacity)
+        {
+            size <<= 1;
+        }
+
+        m_buffer = new Cell[size];
+        for (size_t i = 0; i < size; ++i)
+        {
+            m_buffer[i].m_sequence = i;
+        }
+
+        m_mask = size - 1;
+    }
+
+    size_t capacity() const
+    {
+        return m_mask + 1;
+    }
+
+    // Push the given item. Returns false if the queue is full.
+    bool try_push(const T& item)
+    {
+        Cell * pCell;
+        size_t pos = m_enqueuePos;
+
+        for (;;)
+        {
+            pCell = &m_buffer[pos & m_mask];
+            ptrdiff_t diff = (ptrdiff_t)(pCell->m_sequence - pos);
+
+            if (diff == 0)
+            {
+                // The cell is free on this lap; claim it
+                size_t prevPos = compareExchangePos(&m_enqueuePos, pos + 1, pos);
+                if (prevPos == pos)
+                {
+                    break;
+                }
+
+                pos = prevPos;
+            }
+            else if (diff < 0)
+            {
+                // The cell still holds an item from the previous lap
+                return false;
+            }
+            else
+            {
+                // Another producer got here first
+                pos = m_enqueuePos;
+            }
+        }
+
+        pCell->m_data = item;
+
+        // Publish the item to consumers
+        _ReadWriteBarrier();
+        pCell->m_sequence = pos + 1;
+        return true;
+    }
+
+    // Push count items as one contiguous run of cells: the run is claimed
+    // with a single interlocked add on the enqueue position and each cell
+    // is filled as soon as its consumer from the previous lap is done with
+    // it. Intended for callers that already hold count free slots 
+    // (bounded_queue); otherwise this waits for consumers to make room.
+    template<class InputIterator>
+    InputIterator push_bulk(InputIterator first, size_t count)
+    {
+        size_t pos = exchangeAddPos(&m_enqueuePos, count);
+
+        for (; count > 0; --count, ++first, ++pos)
+        {
+            Cell * pCell = &m_buffer[pos & m_mask];
+            while (pCell->m_sequence != pos)
+            {
+                Concurrency::Context::Yield();
+            }
+
+            pCell->m_data = *first;
+
+            _ReadWriteBarrier();
+            pCell->m_sequence = pos + 1;
+        }
+
+        return first;
+    }
+
+    // Pop count items as one contiguous run of cells claimed with a single
+    // interlocked add on the dequeue position. Intended for callers that 
+    // already hold count items (bounded_queue); otherwise this waits for 
+    // producers to fill the run.
+    template<class OutputIterator>
+    OutputIterator pop_bulk(OutputIterator out, size_t count)
+    {
+        size_t pos = exchangeAddPos(&m_dequeuePos, count);
+
+        for (; count > 0; --count, ++out, ++pos)
+        {
+            Cell * pCell = &m_buffer[pos & m_mask];
+            while (pCell->m_sequence != pos + 1)
+            {
+                Concurrency::Context::Yield();
+            }
+
+            _ReadWriteBarrier();
+            *out = pCell->m_data;
+
+            _ReadWriteBarrier();
+            pCell->m_sequence = pos + m_mask + 1;
+        }
+
+        return out;
+    }
+
+    // Push the given item, waiting for a slot if the queue is full. 
+    // bounded_queue only pushes when a slot is known to be free, so this
+    // only waits out consumers that are still copying out of the slot.
+    void push(const T& item)
+    {
+        while (!try_push(item))
+        {
+            Concurrency::Context::Yield();
+        }
+    }
+
+    // Pop an item. Returns false if the queue is empty.
+    bool try_pop(T& item)
+    {
+        Cell * pCell;
+        size_t pos = m_dequeuePos;
+
+        for (;;)
+        {
+            pCell = &m_buffer[pos & m_mask];
+            ptrdiff_t diff = (ptrdiff_t)(pCell->m_sequence - (pos + 1));
+
+            if (diff == 0)
+            {
+                // The cell is full on this lap; claim it
+                size_t prevPos = compareExchangePos(&m_dequeuePos, pos + 1, pos);
+                if (prevPos == pos)
+                {
+                    break;
+                }
+
+                pos = prevPos;
+            }
+            else if (diff < 0)
+            {
+                // No item has been published to this cell yet
+                return false;
+            }
+            else
+            {
+                // Another consumer got here first
+                pos = m_dequeuePos;
+            }
+        }
+
+        _ReadWriteBarrier();
+        item = pCell->m_data;
+
+        // Hand the cell back to producers for the next lap
+        _ReadWriteBarrier();
+        pCell->m_sequence = pos + m_mask + 1;
+        return true;
+    }
+
+    // Number of items in the queue. Only a snapshot if the queue is in use.
+    size_t unsafe_size() const
+    {
+        ptrdiff_t size = (ptrdiff_t)(m_enqueuePos - m_dequeuePos);
+        return (size < 0) ? 0 : (size_t)size;
+    }
+
+private:
+
+    enum
+    {
+        CacheLineSize = 64
+    };
+
+    struct Cell
+    {
+        volatile size_t m_sequence;
+        T m_data;
+    };
+
+    // Not copyable
+    RingBufferQueue(const RingBufferQueue&);
+    RingBufferQueue& operator=(const RingBufferQueue&);
+
+    // The positions and sequence numbers are pointer sized and wrap around 
+    // freely; they are only ever compared through their signed difference.
+    static size_t compareExchangePos(volatile size_t * target, size_t exchange, size_t comparand)
+    {
+#if defined(_M_IX86)
+        return (size_t)_InterlockedCompareExchange((volatile long *)target, (long)exchange, (long)comparand);
+#else
+        return (size_t)_InterlockedCompareExchange64((volatile __int64 *)target, (__int64)exchange, (__int64)comparand);
+#endif
+    }
+
+    static size_t exchangeAddPos(volatile size_t * target, size_t value)
+    {
+#if defined(_M_IX86)
+        return (size_t)_InterlockedExchangeAdd((volatile long *)target, (long)value);
+#else
+        return (size_t)_InterlockedExchangeAdd64((volatile __int64 *)target, (__int64)value);
+#endif
+    }
+
+    Cell * m_buffer;
+    size_t m_mask;
+    char m_pad0[CacheLineSize];
+
+    volatile size_t m_enqueuePos;
+    char m_pad1[CacheLineSize - sizeof(size_t)];
+
+    volatile size_t m_dequeuePos;
+    char m_pad2[CacheLineSize - sizeof(size_t)];
+};
@@ -0,0 +1,2071 @@
+/***
+* ==++==
+*
+* Copyright (c) Microsoft Corporation.  All rights reserved.
+*
+* ==--==
+* =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+*
+* concurrent_flat_map.h
+*
+* An open-addressing concurrent hash map. Slot arrays of element pointers are searched
+* through a parallel array of one-byte control words, probed sixteen at a time (with
+* SSE2 where available).
+*
+* =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+****/
+#pragma once
+
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "internal_concurrent_hash.h"
+
+#if !defined(CONCRTEXTRAS_FLAT_MAP_SSE2)
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CONCRTEXTRAS_FLAT_MAP_SSE2 1
+#else
+#define CONCRTEXTRAS_FLAT_MAP_SSE2 0
+#endif
+#endif
+
+#if CONCRTEXTRAS_FLAT_MAP_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#pragma pack(push,_CRT_PACKING)
+#endif
+
+namespace Concurrency
+{
+namespace samples
+{
+namespace details
+{
+// Control byte values. A slot whose control byte has the high bit clear holds a published
+// element, and the byte is the low seven bits of its hash. The others are:
+//   _Ctrl_empty   - never used; ends a probe sequence
+//   _Ctrl_frozen  - never used, and closed to insertion because the array is being migrated; ends a probe sequence
+//   _Ctrl_moved   - held an element that has been migrated to the next array
+//   _Ctrl_deleted - holds an erased element, which is destroyed when the array is freed
+//   _Ctrl_busy    - claimed by an insertion that has not published its element yet, or by a
+//                   migration that is moving the element out
+const unsigned char _Ctrl_empty = 0x80;
+const unsigned char _Ctrl_frozen = 0xFC;
+const unsigned char _Ctrl_moved = 0xFD;
+const unsigned char _Ctrl_deleted = 0xFE;
+const unsigned char _Ctrl_busy = 0xFF;
+
+// Slots are probed in aligned groups of this many control bytes
+const size_t _Flat_group_size = 16;
+
+// Slots are migrated to the next array in chunks of this many, each claimed by one thread
+const size_t _Flat_chunk_size = 1024;
+
+// Index of the lowest set bit of a non-zero mask
+inline unsigned int _Lowest_bit(unsigned int _Mask)
+{
+#if defined(_MSC_VER)
+    unsigned long _Index;
+    _BitScanForward(&_Index, _Mask);
+    return (unsigned int) _Index;
+#else
+    return (unsigned int) __builtin_ctz(_Mask);
+#endif
+}
+
+// Keeps the loads of a slot from moving ahead of the load of its control byte
+inline void _Flat_acquire_barrier()
+{
+#if defined(_MSC_VER)
+    _ReadWriteBarrier();
+#else
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+// Spreads the bits of a hash value, so hashers that return the key itself (std::hash on
+// integers) still fill both the group index and the control byte.
+inline size_t _Flat_mix_hash(size_t _Hash)
+{
+    unsigned long long _Mixed = _Hash;
+    _Mixed ^= _Mixed >> 33;
+    _Mixed *= 0xFF51AFD7ED558CCDULL;
+    _Mixed ^= _Mixed >> 33;
+    return (size_t) _Mixed;
+}
+
+// A snapshot of one group of control bytes, matched sixteen bytes at a time
+class _Flat_group
+{
+public:
+    explicit _Flat_group(const unsigned char * _Pctrl)
+    {
+#if CONCRTEXTRAS_FLAT_MAP_SSE2
+        _M_bytes = _mm_loadu_si128((const __m128i *) _Pctrl);
+#else
+        memcpy(_M_bytes, _Pctrl, _Flat_group_size);
+#endif
+        _Flat_acquire_barrier();
+    }
+
+    // Returns a mask with bit i set if control byte i equals _Value
+    unsigned int _Match(unsigned char _Value) const
+    {
+#if CONCRTEXTRAS_FLAT_MAP_SSE2
+        return (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(_M_bytes, _mm_set1_epi8((char) _Value)));
+#else
+        unsigned int _Mask = 0;
+        for (size_t _Index = 0; _Index < _Flat_group_size; _Index++)
+        {
+            if (_M_bytes[_Index] == _Value)
+            {
+                _Mask |= 1u << _Index;
+            }
+        }
+        return _Mask;
+#endif
+    }
+
+private:
+#if CONCRTEXTRAS_FLAT_MAP_SSE2
+    __m128i _M_bytes;
+#else
+    unsigned char _M_bytes[_Flat_group_size];
+#endif
+};
+
+// An element of a concurrent_flat_map. Elements are allocated one at a time and never move,
+// so only the pointers to them are migrated from one slot array to the next.
+template<typename _Value_type>
+struct _Flat_node
+{
+    _Value_type _M_value;
+    size_t      _M_hash;    // Mixed hash of the key, so migrations never call the hasher
+};
+
+// One slot array of a concurrent_flat_map, with its control bytes
+template<typename _Node_type>
+struct _Flat_table
+{
+    size_t          _M_capacity;      // Number of slots, a power of two and a multiple of the group size
+    size_t          _M_limit;         // Number of slots that may be claimed before the array is migrated
+    volatile size_t _M_claimed;       // Slots claimed or reserved so far
+    volatile long * _M_ctrl;          // Control bytes, stored as words so single bytes can be compare-and-swapped
+    _Node_type **   _M_slots;         // Element of each published, erased or moved slot
+    volatile long * _M_chunks;        // Migration state of each chunk: 0 pending, 1 being moved, 2 moved
+    volatile long   _M_chunks_left;   // Chunks not moved yet
+    _Flat_table *   _M_successor;     // The array this one is migrated to, set when the migration starts
+    _Flat_table *   _M_retired_next;  // Link in the map's list of arrays waiting to be freed
+
+    unsigned char * _Ctrl() const
+    {
+        return (unsigned char *) _M_ctrl;
+    }
+
+    size_t _Chunk_count() const
+    {
+        return (_M_capacity + _Flat_chunk_size - 1) / _Flat_chunk_size;
+    }
+
+    // Claim a slot regardless of the limit; migrations always have room in the new array
+    void _Claim()
+    {
+        for (;;)
+        {
+            size_t _Claimed = _M_claimed;
+            if (_Atomic_compare_exchange_size_t(&_M_claimed, _Claimed + 1, _Claimed) == _Claimed)
+            {
+                return;
+            }
+        }
+    }
+
+    // Reserve a slot, unless the table has reached its limit
+    bool _Reserve()
+    {
+        for (;;)
+        {
+            size_t _Claimed = _M_claimed;
+            if (_Claimed >= _M_limit)
+            {
+                return false;
+            }
+
+            if (_Atomic_compare_exchange_size_t(&_M_claimed, _Claimed + 1, _Claimed) == _Claimed)
+            {
+                return true;
+            }
+        }
+    }
+
+    // Return a reservation that was not used
+    void _Release()
+    {
+        for (;;)
+        {
+            size_t _Claimed = _M_claimed;
+            if (_Atomic_compare_exchange_size_t(&_M_claimed, _Claimed - 1, _Claimed) == _Claimed)
+            {
+                return;
+            }
+        }
+    }
+
+    // Change a control byte from _Expected to _Desired. Returns false if it held some other value.
+    bool _Set_ctrl(size_t _Index, unsigned char _Expected, unsigned char _Desired)
+    {
+        volatile long * _Pword = _M_ctrl + (_Index / sizeof(long));
+        size_t _Byte = _Index % sizeof(long);
+
+        for (;;)
+        {
+            long _Old_word = *_Pword;
+            if (((unsigned char *) &_Old_word)[_Byte] != _Expected)
+            {
+                return false;
+            }
+
+            long _New_word = _Old_word;
+            ((unsigned char *) &_New_word)[_Byte] = _Desired;
+
+            if (_Atomic_compare_exchange(_Pword, _New_word, _Old_word) == _Old_word)
+            {
+                return true;
+            }
+        }
+    }
+};
+
+template<class _Mymap>
+class _Flat_map_const_iterator
+{
+public:
+    typedef _Flat_map_const_iterator<_Mymap> _Myiter;
+    typedef std::forward_iterator_tag iterator_category;
+
+    typedef typename _Mymap::value_type value_type;
+    typedef typename _Mymap::difference_type difference_type;
+    typedef typename _Mymap::const_pointer pointer;
+    typedef typename _Mymap::const_reference reference;
+    typedef typename _Mymap::_Table_type _Table_type;
+    typedef typename _Mymap::_Node_type _Node_type;
+
+    _Flat_map_const_iterator() : _M_pmap(NULL), _M_table(NULL), _M_slot(0), _M_node(NULL)
+    {
+    }
+
+    _Flat_map_const_iterator(const _Mymap * _Pmap, _Table_type * _Table, size_t _Slot, _Node_type * _Node) :
+        _M_pmap(_Pmap), _M_table(_Table), _M_slot(_Slot), _M_node(_Node)
+    {
+    }
+
+    reference operator*() const
+    {
+        return _M_node->_M_value;
+    }
+
+    pointer operator->() const
+    {
+        return (&**this);
+    }
+
+    _Myiter& operator++()
+    {
+        _M_slot++;
+        _M_node = _M_pmap->_Seek(_M_table, _M_slot);
+        return (*this);
+    }
+
+    _Myiter operator++(int)
+    {
+        _Myiter _Tmp = *this;
+        ++*this;
+        return (_Tmp);
+    }
+
+    bool operator==(const _Myiter& _Right) const
+    {
+        return (_M_node == _Right._M_node);
+    }
+
+    bool operator!=(const _Myiter& _Right) const
+    {
+        return (!(*this == _Right));
+    }
+
+    _Table_type * _Table() const
+    {
+        return _M_table;
+    }
+
+    size_t _Slot() const
+    {
+        return _M_slot;
+    }
+
+    _Node_type * _Node() const
+    {
+        return _M_node;
+    }
+
+protected:
+    const _Mymap * _M_pmap;  // Owning map
+    _Table_type *  _M_table; // Slot array the traversal is in, or NULL for end()
+    size_t         _M_slot;  // Slot within the array
+    _Node_type *   _M_node;  // Element, which stays put when the array is migrated
+};
+
+template<class _Mymap>
+class _Flat_map_iterator : public _Flat_map_const_iterator<_Mymap>
+{
+public:
+    typedef _Flat_map_iterator<_Mymap> _Myiter;
+    typedef _Flat_map_const_iterator<_Mymap> _Mybase;
+    typedef std::forward_iterator_tag iterator_category;
+
+    typedef typename _Mymap::value_type value_type;
+    typedef typename _Mymap::difference_type difference_type;
+    typedef typename _Mymap::pointer pointer;
+    typedef typename _Mymap::reference reference;
+    typedef typename _Mymap::_Table_type _Table_type;
+    typedef typename _Mymap::_Node_type _Node_type;
+
+    _Flat_map_iterator()
+    {
+    }
+
+    _Flat_map_iterator(const _Mymap * _Pmap, _Table_type * _Table, size_t _Slot, _Node_type * _Node) : _Mybase(_Pmap, _Table, _Slot, _Node)
+    {
+    }
+
+    reference operator*() const
+    {
+        return ((reference)**(_Mybase *)this);
+    }
+
+    pointer operator->() const
+    {
+        return (&**this);
+    }
+
+    _Myiter& operator++()
+    {
+        ++(*(_Mybase *)this);
+        return (*this);
+    }
+
+    _Myiter operator++(int)
+    {
+        _Myiter _Tmp = *this;
+        ++*this;
+        return (_Tmp);
+    }
+};
+} // namespace details;
+
+/// <summary>
+///     The <c>concurrent_flat_map</c> class is a concurrency-safe, open-addressing hash map of elements of type
+///     std::pair<const _Key_type, _Element_type>. It offers the interface of <see cref="concurrent_unordered_map Class">
+///     concurrent_unordered_map</see> and enables concurrency-safe insertion, lookup, erasure, element access and
+///     iterator access.
+/// </summary>
+/// <typeparam name="_Key_type">
+///     The key type.
+/// </typeparam>
+/// <typeparam name="_Element_type">
+///     The mapped type.
+/// </typeparam>
+/// <typeparam name="_Hasher">
+///     The hash function object type. This argument is optional and the default value is
+///     hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
+/// </typeparam>
+/// <typeparam name="_Key_equality">
+///     The equality comparison function object type. This argument is optional and the default value is
+///     <c>equal_to&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
+/// </typeparam>
+/// <typeparam name="_Allocator_type">
+///     The type that represents the stored allocator object that encapsulates details about the allocation and
+///     deallocation of memory for the map. This argument is optional and the default value is
+///     <c>allocator&lt;</c><typeparamref name="_Key_type"/>, <typeparamref name="_Element_type"/><c>&gt;</c>.
+/// </typeparam>
+/// <remarks>
+///     Each element is allocated once and referenced from a slot array, next to an array of one-byte control words
+///     that hold seven bits of each element's hash. A lookup compares a group of sixteen control bytes at once and
+///     follows a slot's pointer only for candidate matches, so it usually costs two cache misses.
+///     <para>When a slot array reaches its maximum load factor, its slots are migrated to a new array twice its size,
+///     or of the same size when erased elements take up most of the full one. Every thread that uses the map during
+///     a migration helps move the slots, a chunk at a time, so at most two arrays are live at once. The old array is
+///     freed, and the elements erased from it destroyed, once no operation in progress can still be reading it.</para>
+///     <para>Elements themselves never move, so, as with <c>concurrent_unordered_map</c>, references and iterators
+///     stay valid across concurrent insertions until the map is cleared, rehashed or destroyed. A reference to an
+///     erased element stays valid until the slot array that held it is migrated. Advancing an iterator is
+///     concurrency-safe with lookups and erasures, but not with an insertion that migrates the slot array the
+///     iterator is traversing.</para>
+///     <para>The bucket interface of <c>concurrent_unordered_map</c> has no counterpart here; the bucket count
+///     reported is the total number of slots.</para>
+/// </remarks>
+/**/
+template <typename _Key_type, typename _Element_type, typename _Hasher = std::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<std::pair<const _Key_type, _Element_type> > >
+class concurrent_flat_map
+{
+public:
+    // Base type definitions
+    typedef concurrent_flat_map<_Key_type, _Element_type, _Hasher, _Key_equality, _Allocator_type> _Mytype;
+    typedef details::_Hash_compare<_Key_type, _Hasher, _Key_equality> _Mytraits;
+
+    // Type definitions
+    typedef _Key_type key_type;
+    typedef std::pair<const _Key_type, _Element_type> value_type;
+    typedef _Element_type mapped_type;
+    typedef _Hasher hasher;
+    typedef _Key_equality key_equal;
+    typedef _Mytraits key_compare;
+
+    typedef typename _Allocator_type::template rebind<value_type>::other allocator_type;
+    typedef typename allocator_type::pointer pointer;
+    typedef typename allocator_type::const_pointer const_pointer;
+    typedef typename allocator_type::reference reference;
+    typedef typename allocator_type::const_reference const_reference;
+
+    typedef typename allocator_type::size_type size_type;
+    typedef typename allocator_type::difference_type difference_type;
+
+    typedef details::_Flat_map_iterator<_Mytype> iterator;
+    typedef details::_Flat_map_const_iterator<_Mytype> const_iterator;
+    typedef std::pair<iterator, bool> _Pairib;
+    typedef std::pair<iterator, iterator> _Pairii;
+    typedef std::pair<const_iterator, const_iterator> _Paircc;
+
+    typedef details::_Flat_node<value_type> _Node_type;
+    typedef details::_Flat_table<_Node_type> _Table_type;
+
+    /// <summary>
+    ///     Constructs a concurrent flat map.
+    /// </summary>
+    /// <param name="_Number_of_buckets">
+    ///     The initial number of slots for this map.
+    /// </param>
+    /// <param name="_Hasharg">
+    ///     The hash function for this map.
+    /// </param>
+    /// <param name="_Keyeqarg">
+    ///     The equality comparison function for this map.
+    /// </param>
+    /// <param name="_Allocator">
+    ///     The allocator for this map.
+    /// </param>
+    /// <remarks>
+    ///     All constructors store an allocator object <paramref name="_Allocator"/> and initialize the map.
+    ///     <para>The first constructor specifies an empty initial map and explicitly specifies the number of slots,
+    ///     hash function, equality function and allocator type to be used. The number of slots is rounded up to a
+    ///     power of two, and to at least sixteen.</para>
+    ///     <para>The second constructor specifies an allocator for the map.<para>
+    ///     <para>The third constructor specifies values supplied by the iterator range [<paramref name="_Begin"/>, <paramref name="_End"/>).</para>
+    ///     <para>The fourth and fifth constructors specify a copy of the concurrent flat map <paramref name="_Umap"/>.</para>
+    ///     <para>The last constructor specifies a move of the concurrent flat map <paramref name="_Umap"/>.</para>
+    /// </remarks>
+    /**/
+    explicit concurrent_flat_map(size_type _Number_of_buckets = _Initial_capacity, const hasher& _Hasharg = hasher(), const key_equal& _Keyeqarg = key_equal(),
+        const allocator_type& _Allocator = allocator_type())
+        : _M_comparator(_Hasharg, _Keyeqarg), _M_allocator(_Allocator)
+    {
+        _Init(_Number_of_buckets);
+    }
+
+    /// <summary>
+    ///     Constructs a concurrent flat map.
+    /// </summary>
+    /// <param name="_Allocator">
+    ///     The allocator for this map.
+    /// </param>
+    /**/
+    concurrent_flat_map(const allocator_type& _Allocator) : _M_allocator(_Allocator)
+    {
+        _Init(_Initial_capacity);
+    }
+
+    /// <summary>
+    ///     Constructs a concurrent flat map.
+    /// </summary>
+    /// <typeparam name="_Iterator">
+    ///     The type of the input iterator.
+    /// </typeparam>
+    /// <param name="_Begin">
+    ///     Position of the first element in the range of elements to be copied.
+    /// </param>
+    /// <param name="_End">
+    ///     Position of the first element beyond the range of elements to be copied.
+    /// </param>
+    /// <param name="_Number_of_buckets">
+    ///     The initial number of slots for this map.
+    /// </param>
+    /// <param name="_Hasharg">
+    ///     The hash function for this map.
+    /// </param>
+    /// <param name="_Keyeqarg">
+    ///     The equality comparison function for this map.
+    /// </param>
+    /// <param name="_Allocator">
+    ///     The allocator for this map.
+    /// </param>
+    /**/
+    template <typename _Iterator>
+    concurrent_flat_map(_Iterator _Begin, _Iterator _End, size_type _Number_of_buckets = _Initial_capacity, const hasher& _Hasharg = hasher(),
+        const key_equal& _Keyeqarg = key_equal(), const allocator_type& _Allocator = allocator_type())
+        : _M_comparator(_Hasharg, _Keyeqarg), _M_allocator(_Allocator)
+    {
+        _Init(_Number_of_buckets);
+        insert(_Begin, _End);
+    }
+
+    /// <summary>
+    ///     Constructs a concurrent flat map.
+    /// </summary>
+    /// <param name="_Umap">
+    ///     The source <c>concurrent_flat_map</c> object to copy elements from.
+    /// </param>
+    /**/
+    concurrent_flat_map(const concurrent_flat_map& _Umap) : _M_comparator(_Umap._M_comparator), _M_allocator(_Umap._M_allocator)
+    {
+        _Init(_Initial_capacity);
+        _Copy(_Umap);
+    }
+
+    /// <summary>
+    ///     Constructs a concurrent flat map.
+    /// </summary>
+    /// <param name="_Umap">
+    ///     The source <c>concurrent_flat_map</c> object to copy elements from.
+    /// </param>
+    /// <param name="_Allocator">
+    ///     The allocator for this map.
+    /// </param>
+    /**/
+    concurrent_flat_map(const concurrent_flat_map& _Umap, const allocator_type& _Allocator) : _M_comparator(_Umap._M_comparator), _M_allocator(_Allocator)
+    {
+        _Init(_Initial_capacity);
+        _Copy(_Umap);
+    }
+
+    /// <summary>
+    ///     Constructs a concurrent flat map.
+    /// </summary>
+    /// <param name="_Umap">
+    ///     The source <c>concurrent_flat_map</c> object to move elements from.
+    /// </param>
+    /**/
+    concurrent_flat_map(concurrent_flat_map&& _Umap) : _M_comparator(_Umap._M_comparator), _M_allocator(_Umap._M_allocator)
+    {
+        _Init(_Initial_capacity);
+        swap(_Umap);
+    }
+
+    ~concurrent_flat_map()
+    {
+        _Destroy_tables();
+    }
+
+    /// <summary>
+    ///     Assigns the contents of another <c>concurrent_flat_map</c> object to this one. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Umap">
+    ///     The source <c>concurrent_flat_map</c> object.
+    /// </param>
+    /// <returns>
+    ///     A reference to this <c>concurrent_flat_map</c> object.
+    /// </returns>
+    /**/
+    concurrent_flat_map& operator=(const concurrent_flat_map& _Umap)
+    {
+        if (this != &_Umap)
+        {
+            _Copy(_Umap);
+        }
+
+        return (*this);
+    }
+
+    /// <summary>
+    ///     Assigns the contents of another <c>concurrent_flat_map</c> object to this one. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Umap">
+    ///     The source <c>concurrent_flat_map</c> object.
+    /// </param>
+    /// <returns>
+    ///     A reference to this <c>concurrent_flat_map</c> object.
+    /// </returns>
+    /**/
+    concurrent_flat_map& operator=(concurrent_flat_map&& _Umap)
+    {
+        if (this != &_Umap)
+        {
+            clear();
+            swap(_Umap);
+        }
+
+        return (*this);
+    }
+
+    /// <summary>
+    ///     Returns the allocator used for this concurrent container. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    allocator_type get_allocator() const
+    {
+        return _M_allocator;
+    }
+
+    /// <summary>
+    ///     Checks whether the map is empty. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    bool empty() const
+    {
+        return (_M_element_count == 0);
+    }
+
+    /// <summary>
+    ///     Returns the number of elements in the map. This method is concurrency-safe.
+    /// </summary>
+    /// <remarks>
+    ///     With concurrent inserts and erases, the number of elements may change immediately after calling this
+    ///     function, before the return value is even read.
+    /// </remarks>
+    /**/
+    size_type size() const
+    {
+        return (size_type) _M_element_count;
+    }
+
+    /// <summary>
+    ///     Returns the maximum size of the map, determined by the allocator. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    size_type max_size() const
+    {
+        return _M_allocator.max_size();
+    }
+
+    /// <summary>
+    ///     Returns an iterator pointing to the first element in the map. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    iterator begin()
+    {
+        _Table_type * _Ptable;
+        size_type _Slot;
+        _Node_type * _Pnode = _First_slot(_Ptable, _Slot);
+        return iterator(this, _Ptable, _Slot, _Pnode);
+    }
+
+    /// <summary>
+    ///     Returns a const_iterator pointing to the first element in the map. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    const_iterator begin() const
+    {
+        _Table_type * _Ptable;
+        size_type _Slot;
+        _Node_type * _Pnode = _First_slot(_Ptable, _Slot);
+        return const_iterator(this, _Ptable, _Slot, _Pnode);
+    }
+
+    /// <summary>
+    ///     Returns an iterator pointing to the location succeeding the last element in the map. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    iterator end()
+    {
+        return iterator(this, NULL, 0, NULL);
+    }
+
+    /// <summary>
+    ///     Returns a const_iterator pointing to the location succeeding the last element in the map. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    const_iterator end() const
+    {
+        return const_iterator(this, NULL, 0, NULL);
+    }
+
+    /// <summary>
+    ///     Returns a const_iterator pointing to the first element in the map. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    const_iterator cbegin() const
+    {
+        return ((const _Mytype *) this)->begin();
+    }
+
+    /// <summary>
+    ///     Returns a const_iterator pointing to the location succeeding the last element in the map. This method is concurrency-safe.
+    /// </summary>
+    /**/
+    const_iterator cend() const
+    {
+        return ((const _Mytype *) this)->end();
+    }
+
+    /// <summary>
+    ///     Inserts a value into the map. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Value">
+    ///     The value to insert.
+    /// </param>
+    /// <returns>
+    ///     A <see cref="pair Class">pair</see> where the first object is an iterator to the element with the key of
+    ///     <paramref name="_Value"/> and the second object is a bool indicating whether the value was inserted (true) or not (false).
+    /// </returns>
+    /**/
+    _Pairib insert(const value_type& _Value)
+    {
+        return _Insert(_Value);
+    }
+
+    /// <summary>
+    ///     Inserts a value into the map. This method is concurrency-safe.
+    /// </summary>
+    /// <typeparam name="_Valty">
+    ///     The type of the value inserted into the map.
+    /// </typeparm>
+    /// <param name="_Value">
+    ///     The value to insert.
+    /// </param>
+    /// <returns>
+    ///     A <see cref="pair Class">pair</see> where the first object is an iterator to the element with the key of
+    ///     <paramref name="_Value"/> and the second object is a bool indicating whether the value was inserted (true) or not (false).
+    /// </returns>
+    /**/
+    template<class _Valty>
+    _Pairib insert(_Valty&& _Value)
+    {
+        return _Insert(std::forward<_Valty>(_Value));
+    }
+
+    /// <summary>
+    ///     Inserts a value into the map. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Value">
+    ///     The value to insert.
+    /// </param>
+    /// <remarks>
+    ///     The <c>const_iterator</c> hint is ignored. It exists for similarity with <c>concurrent_unordered_map</c>.
+    /// </remarks>
+    /// <returns>
+    ///     An iterator to the element with the key of <paramref name="_Value"/>.
+    /// </returns>
+    /**/
+    iterator insert(const_iterator, const value_type& _Value)
+    {
+        // Ignore hint
+        return insert(_Value).first;
+    }
+
+    /// <summary>
+    ///     Inserts a value into the map. This method is concurrency-safe.
+    /// </summary>
+    /// <typeparam name="_Valty">
+    ///     The type of the value inserted into the map.
+    /// </typeparm>
+    /// <param name="_Value">
+    ///     The value to insert.
+    /// </param>
+    /// <remarks>
+    ///     The <c>const_iterator</c> hint is ignored. It exists for similarity with <c>concurrent_unordered_map</c>.
+    /// </remarks>
+    /// <returns>
+    ///     An iterator to the element with the key of <paramref name="_Value"/>.
+    /// </returns>
+    /**/
+    template<class _Valty>
+        typename std::enable_if<!std::is_same<const_iterator,
+            typename std::remove_reference<_Valty>::type>::value, iterator>::type
+    insert(const_iterator, _Valty&& _Value)
+    {
+        // Ignore hint
+        return insert(std::forward<_Valty>(_Value)).first;
+    }
+
+    /// <summary>
+    ///     Inserts a set of values into the map from an iterator range. This method is concurrency-safe.
+    /// </summary>
+    /// <typeparam name="_Iterator">
+    ///     The iterator type used for insertion.
+    /// </typeparm>
+    /// <param name="_First">
+    ///     The input iterator pointing to the beginning location.
+    /// </param>
+    /// <param name="_Last">
+    ///     The input iterator pointing to the end location.
+    /// </param>
+    /**/
+    template<class _Iterator>
+    void insert(_Iterator _First, _Iterator _Last)
+    {
+        for (_Iterator _I = _First; _I != _Last; _I++)
+        {
+            insert(*_I);
+        }
+    }
+
+    /// <summary>
+    ///     Erases the element matching a key from the map. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to erase.
+    /// </param>
+    /// <remarks>
+    ///     The element stops being visible to lookups immediately. It is destroyed, and its slot reused, when the
+    ///     slot array holding it is next migrated, cleared or rehashed, so references to it stay valid until then.
+    /// </remarks>
+    /// <returns>
+    ///     The count of elements erased from this <c>concurrent_flat_map</c> object.
+    /// </returns>
+    /**/
+    size_type erase(const key_type& _Keyval)
+    {
+        size_t _Hash = _Hash_key(_Keyval);
+        bool _Erased;
+
+        {
+            _Epoch_guard _Guard(_M_epochs);
+
+            for (;;)
+            {
+                _Table_type * _Ptable;
+                size_type _Slot;
+                if (!_Find_slot(_Keyval, _Hash, _Ptable, _Slot))
+                {
+                    _Erased = false;
+                    break;
+                }
+
+                if (_Ptable->_Set_ctrl(_Slot, _Hash_h2(_Hash), details::_Ctrl_deleted))
+                {
+                    details::_Atomic_decrement(&_M_element_count);
+                    _Erased = true;
+                    break;
+                }
+
+                // Another thread erased it first, or a migration is moving it; look again
+            }
+        }
+
+        _Reclaim_retired();
+        return _Erased ? 1 : 0;
+    }
+
+    /// <summary>
+    ///     Erases an element from the map given an iterator position. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Where">
+    ///     The iterator position to erase from.
+    /// </param>
+    /// <returns>
+    ///     An iterator to the element following the erased one.
+    /// </returns>
+    /**/
+    iterator unsafe_erase(const_iterator _Where)
+    {
+        _Table_type * _Ptable = _Where._Table();
+        size_type _Slot = _Where._Slot();
+        unsigned char _Ctrl = _Ptable->_Ctrl()[_Slot];
+
+        if ((_Ctrl & 0x80) == 0 && _Ptable->_Set_ctrl(_Slot, _Ctrl, details::_Ctrl_deleted))
+        {
+            _M_element_count--;
+        }
+
+        _Slot++;
+        _Node_type * _Pnode = _Seek(_Ptable, _Slot);
+        return iterator(this, _Ptable, _Slot, _Pnode);
+    }
+
+    /// <summary>
+    ///     Erases the element matching a key from the map. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to erase.
+    /// </param>
+    /// <returns>
+    ///     The count of elements erased from this <c>concurrent_flat_map</c> object.
+    /// </returns>
+    /**/
+    size_type unsafe_erase(const key_type& _Keyval)
+    {
+        return erase(_Keyval);
+    }
+
+    /// <summary>
+    ///     Erases elements from the map given an iterator range. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_First">
+    ///     Position of the first element in the range of elements to be erased.
+    /// </param>
+    /// <param name="_Last">
+    ///     Position of the first element beyond the range of elements to be erased.
+    /// </param>
+    /// <returns>
+    ///     The iterator for this <c>concurrent_flat_map</c> object.
+    /// </returns>
+    /**/
+    iterator unsafe_erase(const_iterator _First, const_iterator _Last)
+    {
+        while (_First != _Last)
+        {
+            unsafe_erase(_First++);
+        }
+
+        return iterator(this, _Last._Table(), _Last._Slot(), _Last._Node());
+    }
+
+    /// <summary>
+    ///     Swaps the contents of two <c>concurrent_flat_map</c> objects. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Umap">
+    ///     The <c>concurrent_flat_map</c> object to swap with.
+    /// </param>
+    /// <remarks>
+    ///     Throws an <see cref="invalid_argument Class">invalid_argument</see> exception if the swap is being
+    ///     performed on unequal allocators.
+    /// </remarks>
+    /**/
+    void swap(concurrent_flat_map& _Umap)
+    {
+        if (this != &_Umap)
+        {
+            if (!(_M_allocator == _Umap._M_allocator))
+            {
+                throw std::invalid_argument("swap is invalid on non-equal allocators");
+            }
+
+            // Leave each map with a single array and nothing waiting to be freed
+            _Finish_migration();
+            _Umap._Finish_migration();
+
+            using std::swap;
+            swap(_M_comparator, _Umap._M_comparator);
+
+            _Table_type * _Ptable = _M_table;
+            _M_table = _Umap._M_table;
+            _Umap._M_table = _Ptable;
+
+            long _Count = _M_element_count;
+            _M_element_count = _Umap._M_element_count;
+            _Umap._M_element_count = _Count;
+
+            std::swap(_M_initial_capacity, _Umap._M_initial_capacity);
+            std::swap(_M_maximum_load, _Umap._M_maximum_load);
+        }
+    }
+
+    /// <summary>
+    ///     Erases all the elements in the map. This method is not concurrency-safe.
+    /// </summary>
+    /**/
+    void clear()
+    {
+        _Destroy_tables();
+        _M_element_count = 0;
+    }
+
+    /// <summary>
+    ///     Searches the map for a specific key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to search for.
+    /// </param>
+    /// <returns>
+    ///     An iterator pointing to the element with the key, or end() if there is none.
+    /// </returns>
+    /**/
+    iterator find(const key_type& _Keyval)
+    {
+        _Table_type * _Ptable;
+        size_type _Slot;
+        _Node_type * _Pnode = _Find(_Keyval, _Ptable, _Slot);
+        if (_Pnode != NULL)
+        {
+            return iterator(this, _Ptable, _Slot, _Pnode);
+        }
+
+        return end();
+    }
+
+    /// <summary>
+    ///     Searches the map for a specific key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to search for.
+    /// </param>
+    /// <returns>
+    ///     A const_iterator pointing to the element with the key, or end() if there is none.
+    /// </returns>
+    /**/
+    const_iterator find(const key_type& _Keyval) const
+    {
+        _Table_type * _Ptable;
+        size_type _Slot;
+        _Node_type * _Pnode = _Find(_Keyval, _Ptable, _Slot);
+        if (_Pnode != NULL)
+        {
+            return const_iterator(this, _Ptable, _Slot, _Pnode);
+        }
+
+        return end();
+    }
+
+    /// <summary>
+    ///     Counts the number of elements matching a key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to count.
+    /// </param>
+    /// <returns>
+    ///     1 if the map contains the key, 0 otherwise.
+    /// </returns>
+    /**/
+    size_type count(const key_type& _Keyval) const
+    {
+        return (find(_Keyval) != end()) ? 1 : 0;
+    }
+
+    /// <summary>
+    ///     Finds the range of elements matching a key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to search for.
+    /// </param>
+    /// <returns>
+    ///     A <see cref="pair Class">pair</see> of iterators delimiting the element with the key, or two end() iterators.
+    /// </returns>
+    /**/
+    _Pairii equal_range(const key_type& _Keyval)
+    {
+        iterator _Where = find(_Keyval);
+        iterator _Next = _Where;
+
+        if (_Next != end())
+        {
+            ++_Next;
+        }
+
+        return _Pairii(_Where, _Next);
+    }
+
+    /// <summary>
+    ///     Finds the range of elements matching a key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to search for.
+    /// </param>
+    /// <returns>
+    ///     A <see cref="pair Class">pair</see> of const_iterators delimiting the element with the key, or two end() iterators.
+    /// </returns>
+    /**/
+    _Paircc equal_range(const key_type& _Keyval) const
+    {
+        const_iterator _Where = find(_Keyval);
+        const_iterator _Next = _Where;
+
+        if (_Next != end())
+        {
+            ++_Next;
+        }
+
+        return _Paircc(_Where, _Next);
+    }
+
+    /// <summary>
+    ///     Provides access to the element at the given key, inserting a default-constructed one if there is none.
+    ///     This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key of the element to be retrieved.
+    /// </param>
+    /// <returns>
+    ///     A element mapped to by the key.
+    /// </returns>
+    /**/
+    mapped_type& operator[](const key_type& _Keyval)
+    {
+        iterator _Where = find(_Keyval);
+
+        if (_Where == end())
+        {
+            _Where = insert(value_type(_Keyval, mapped_type())).first;
+        }
+
+        return ((*_Where).second);
+    }
+
+    /// <summary>
+    ///     Provides access to the element at the given key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key of the element to be retrieved.
+    /// </param>
+    /// <returns>
+    ///     A element mapped to by the key.
+    /// </returns>
+    /**/
+    mapped_type& at(const key_type& _Keyval)
+    {
+        iterator _Where = find(_Keyval);
+
+        if (_Where == end())
+        {
+            throw std::out_of_range("invalid concurrent_flat_map<K, T> key");
+        }
+
+        return ((*_Where).second);
+    }
+
+    /// <summary>
+    ///     Provides read access to the element at the given key. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key of the element to be retrieved.
+    /// </param>
+    /// <returns>
+    ///     A element mapped to by the key.
+    /// </returns>
+    /**/
+    const mapped_type& at(const key_type& _Keyval) const
+    {
+        const_iterator _Where = find(_Keyval);
+
+        if (_Where == end())
+        {
+            throw std::out_of_range("invalid concurrent_flat_map<K, T> key");
+        }
+
+        return ((*_Where).second);
+    }
+
+    /// <summary>
+    ///     Returns the number of slots in the current slot array of this map.
+    /// </summary>
+    /**/
+    size_type unsafe_bucket_count() const
+    {
+        _Table_type * _Ptable = _M_table;
+        return (_Ptable == NULL) ? 0 : _Ptable->_M_capacity;
+    }
+
+    /// <summary>
+    ///     Returns the maximum number of slots in this map.
+    /// </summary>
+    /**/
+    size_type unsafe_max_bucket_count() const
+    {
+        return max_size();
+    }
+
+    /// <summary>
+    ///     Computes and returns the current load factor of the map, the number of elements divided by the number of slots.
+    /// </summary>
+    /**/
+    float load_factor() const
+    {
+        size_type _Buckets = unsafe_bucket_count();
+        return (_Buckets == 0) ? 0.0f : (float) size() / (float) _Buckets;
+    }
+
+    /// <summary>
+    ///     Returns the maximum load factor of the map: the fraction of a slot array that can be filled before
+    ///     its elements are migrated to a new one.
+    /// </summary>
+    /**/
+    float max_load_factor() const
+    {
+        return _M_maximum_load;
+    }
+
+    /// <summary>
+    ///     Sets the maximum load factor of the map. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Newmax">
+    ///     The desired load factor, greater than 0 and at most 1. It applies to slot arrays created afterwards.
+    /// </param>
+    /// <remarks>
+    ///     Throws an <see cref="out_of_range Class">out_of_range</see> exception if the load factor is invalid.
+    /// </remarks>
+    /**/
+    void max_load_factor(float _Newmax)
+    {
+        // The _Newmax != _Newmax is a check for NaN, because NaN is != to itself
+        if (_Newmax != _Newmax || _Newmax <= 0 || _Newmax > 1)
+        {
+            throw std::out_of_range("invalid hash load factor");
+        }
+
+        _M_maximum_load = _Newmax;
+    }
+
+    /// <summary>
+    ///     Rebuilds the map in a single slot array of at least the given number of slots. This method is not concurrency-safe.
+    /// </summary>
+    /// <param name="_Buckets">
+    ///     The desired number of slots.
+    /// </param>
+    /// <remarks>
+    ///     The array is sized to hold the current elements within the maximum load factor, and rounded up to a power
+    ///     of two. Erased elements are destroyed, and all iterators are invalidated.
+    ///     <para>Throws an <see cref="out_of_range Class">out_of_range</see> exception if the number of slots is
+    ///     invalid (greater than the maximum number of slots)</para>
+    /// </remarks>
+    /**/
+    void rehash(size_type _Buckets)
+    {
+        if (_Buckets > unsafe_max_bucket_count())
+        {
+            throw std::out_of_range("invalid number of buckets");
+        }
+
+        _Finish_migration();
+
+        size_type _Needed = (size_type) ((float) size() / _M_maximum_load) + 1;
+        size_type _Capacity = _Round_capacity(_Buckets > _Needed ? _Buckets : _Needed);
+
+        // The new array must hold every element with one slot per group left free
+        while (_Capacity - _Capacity / details::_Flat_group_size < size())
+        {
+            _Capacity *= 2;
+        }
+
+        _Table_type * _Ptable = _M_table;
+
+        if (_Ptable == NULL)
+        {
+            _M_table = _Create_table(_Capacity);
+            return;
+        }
+
+        // Nothing to do if the array already has that size and no erased elements
+        if (_Ptable->_M_capacity >= _Capacity && _Ptable->_M_claimed == size())
+        {
+            return;
+        }
+
+        _Start_migration(_Ptable, _Create_table(_Capacity));
+        _Finish_migration();
+    }
+
+    /// <summary>
+    ///     The hash function object.
+    /// </summary>
+    /**/
+    hasher hash_function() const
+    {
+        return _M_comparator._M_hash_object;
+    }
+
+    /// <summary>
+    ///     The equality comparison function object.
+    /// </summary>
+    /**/
+    key_equal key_eq() const
+    {
+        return _M_comparator._M_key_compare_object;
+    }
+
+    // Moves _Slot forward to the first published element at or after it in the array and returns
+    // the element, or moves (_Ptable, _Slot) to end() and returns NULL; used by the iterators
+    _Node_type * _Seek(_Table_type *& _Ptable, size_type& _Slot) const
+    {
+        if (_Ptable != NULL)
+        {
+            const unsigned char * _Pctrl = _Ptable->_Ctrl();
+
+            for (; _Slot < _Ptable->_M_capacity; _Slot++)
+            {
+                if ((_Pctrl[_Slot] & 0x80) == 0)
+                {
+                    details::_Flat_acquire_barrier();
+                    return _Ptable->_M_slots[_Slot];
+                }
+            }
+        }
+
+        _Ptable = NULL;
+        _Slot = 0;
+        return NULL;
+    }
+
+private:
+
+    typedef details::_Epoch_domain::_Guard _Epoch_guard;
+
+    static const size_type _Initial_capacity = 16;                      // Initial number of slots
+    static const size_t _Epoch_count = details::_Epoch_domain::_Epoch_count;
+
+    // Result of an insertion attempt in one slot array
+    enum _Insert_status
+    {
+        _Inserted,
+        _Found,
+        _Full,      // The array reached its limit and must be migrated first
+        _Retry      // The array is being migrated; the key may already be in the new one
+    };
+
+    void _Init(size_type _Number_of_buckets)
+    {
+        for (size_t _Index = 0; _Index < _Epoch_count; _Index++)
+        {
+            _M_retired[_Index] = NULL;
+        }
+
+        _M_table = NULL;
+        _M_old = NULL;
+        _M_retired_count = 0;
+        _M_creating = 0;
+        _M_element_count = 0;
+        _M_maximum_load = 0.875f;
+        _M_initial_capacity = _Round_capacity(_Number_of_buckets);
+    }
+
+    void _Copy(const _Mytype& _Umap)
+    {
+        clear();
+
+        _M_maximum_load = _Umap._M_maximum_load;
+        _M_comparator = _Umap._M_comparator;
+        _M_initial_capacity = _Round_capacity((size_type) ((float) _Umap.size() / _M_maximum_load) + 1);
+
+        insert(_Umap.begin(), _Umap.end());
+    }
+
+    static size_type _Round_capacity(size_type _Count)
+    {
+        if (_Count <= details::_Flat_group_size)
+        {
+            return details::_Flat_group_size;
+        }
+
+        return ((size_type) 1) << (details::_Get_msb(_Count - 1) + 1);
+    }
+
+    // Slots that can be claimed in an array before it is migrated. At least one per group
+    // stays free, so every probe sequence ends.
+    size_type _Table_limit(size_type _Capacity) const
+    {
+        size_type _Limit = (size_type) ((float) _Capacity * _M_maximum_load);
+        size_type _Maximum = _Capacity - _Capacity / details::_Flat_group_size;
+        return (_Limit < _Maximum) ? _Limit : _Maximum;
+    }
+
+    size_t _Hash_key(const key_type& _Keyval) const
+    {
+        return details::_Flat_mix_hash(_M_comparator(_Keyval));
+    }
+
+    // The seven hash bits kept in a control byte
+    static unsigned char _Hash_h2(size_t _Hash)
+    {
+        return (unsigned char) (_Hash & 0x7F);
+    }
+
+    // The hash bits that select the first group to probe
+    static size_t _Hash_h1(size_t _Hash)
+    {
+        return _Hash >> 7;
+    }
+
+    _Table_type * _Create_table(size_type _Capacity)
+    {
+        typename allocator_type::template rebind<_Table_type>::other _Table_allocator(_M_allocator);
+        typename allocator_type::template rebind<_Node_type *>::other _Slot_allocator(_M_allocator);
+        typename allocator_type::template rebind<long>::other _Ctrl_allocator(_M_allocator);
+
+        _Table_type * _Ptable = _Table_allocator.allocate(1);
+        _Ptable->_M_capacity = _Capacity;
+        _Ptable->_M_limit = _Table_limit(_Capacity);
+        _Ptable->_M_claimed = 0;
+        _Ptable->_M_ctrl = NULL;
+        _Ptable->_M_slots = NULL;
+        _Ptable->_M_chunks = NULL;
+        _Ptable->_M_chunks_left = (long) _Ptable->_Chunk_count();
+        _Ptable->_M_successor = NULL;
+        _Ptable->_M_retired_next = NULL;
+
+        try
+        {
+            _Ptable->_M_ctrl = _Ctrl_allocator.allocate(_Capacity / sizeof(long));
+            _Ptable->_M_slots = _Slot_allocator.allocate(_Capacity);
+            _Ptable->_M_chunks = _Ctrl_allocator.allocate(_Ptable->_Chunk_count());
+        }
+        catch(...)
+        {
+            _Free_table(_Ptable);
+            throw;
+        }
+
+        memset((void *) _Ptable->_M_ctrl, details::_Ctrl_empty, _Capacity);
+        memset((void *) _Ptable->_M_chunks, 0, _Ptable->_Chunk_count() * sizeof(long));
+        return _Ptable;
+    }
+
+    // Destroy the elements a slot array still owns, the published and the erased ones, and free
+    // it. Moved elements belong to the successor array.
+    void _Free_table(_Table_type * _Ptable)
+    {
+        typename allocator_type::template rebind<_Table_type>::other _Table_allocator(_M_allocator);
+        typename allocator_type::template rebind<_Node_type *>::other _Slot_allocator(_M_allocator);
+        typename allocator_type::template rebind<long>::other _Ctrl_allocator(_M_allocator);
+
+        if (_Ptable->_M_ctrl != NULL)
+        {
+            if (_Ptable->_M_slots != NULL)
+            {
+                const unsigned char * _Pctrl = _Ptable->_Ctrl();
+                for (size_type _Slot = 0; _Slot < _Ptable->_M_capacity; _Slot++)
+                {
+                    if ((_Pctrl[_Slot] & 0x80) == 0 || _Pctrl[_Slot] == details::_Ctrl_deleted)
+                    {
+                        _Destroy_node(_Ptable->_M_slots[_Slot]);
+                    }
+                }
+
+                _Slot_allocator.deallocate(_Ptable->_M_slots, _Ptable->_M_capacity);
+            }
+
+            _Ctrl_allocator.deallocate((long *) _Ptable->_M_ctrl, _Ptable->_M_capacity / sizeof(long));
+        }
+
+        if (_Ptable->_M_chunks != NULL)
+        {
+            _Ctrl_allocator.deallocate((long *) _Ptable->_M_chunks, _Ptable->_Chunk_count());
+        }
+
+        _Table_allocator.deallocate(_Ptable, 1);
+    }
+
+    // Allocate an element and construct its value
+    template<typename _ValTy>
+    _Node_type * _Buynode(_ValTy&& _Value, size_t _Hash)
+    {
+        typename allocator_type::template rebind<_Node_type>::other _Node_allocator(_M_allocator);
+        _Node_type * _Pnode = _Node_allocator.allocate(1);
+
+        try
+        {
+            _M_allocator.construct(&_Pnode->_M_value, std::forward<_ValTy>(_Value));
+        }
+        catch(...)
+        {
+            _Node_allocator.deallocate(_Pnode, 1);
+            throw;
+        }
+
+        _Pnode->_M_hash = _Hash;
+        return _Pnode;
+    }
+
+    void _Destroy_node(_Node_type * _Pnode)
+    {
+        typename allocator_type::template rebind<_Node_type>::other _Node_allocator(_M_allocator);
+
+        _M_allocator.destroy(&_Pnode->_M_value);
+        _Node_allocator.deallocate(_Pnode, 1);
+    }
+
+    // Free every array. Only safe when no operation is in progress on the map.
+    void _Destroy_tables()
+    {
+        _Reclaim_all();
+
+        if (_M_old != NULL)
+        {
+            _Free_table(_M_old);
+            _M_old = NULL;
+        }
+
+        if (_M_table != NULL)
+        {
+            _Free_table(_M_table);
+            _M_table = NULL;
+        }
+    }
+
+    // Returns the array operations work on, after helping any migration in progress to
+    // finish; NULL until the first insertion. Must be called inside an epoch guard.
+    _Table_type * _Current_table() const
+    {
+        for (;;)
+        {
+            _Table_type * _Ptable = _M_table;
+            _Table_type * _Pold = _M_old;
+
+            // _M_old is published before _M_table, so when they are equal the new array is not
+            // published yet. Nothing has been moved, and operations on the old array restart
+            // once they run into the migration.
+            if (_Pold == NULL || _Pold == _Ptable)
+            {
+                return _Ptable;
+            }
+
+            // Helping the migration along does not change the contents of the map
+            const_cast<_Mytype *>(this)->_Help_migrate(_Pold);
+        }
+    }
+
+    // Allocate the first array, unless another thread already did
+    void _Create_first_table()
+    {
+        if (details::_Atomic_compare_exchange(&_M_creating, 1, 0) != 0)
+        {
+            // Another thread is allocating an array; wait for it
+            details::_Atomic_yield();
+            return;
+        }
+
+        try
+        {
+            if (_M_table == NULL)
+            {
+                details::_Atomic_compare_exchange_pointer((void * volatile *) &_M_table, _Create_table(_M_initial_capacity), NULL);
+            }
+        }
+        catch(...)
+        {
+            details::_Atomic_exchange(&_M_creating, 0);
+            throw;
+        }
+
+        details::_Atomic_exchange(&_M_creating, 0);
+    }
+
+    // Start migrating a full array, unless another thread already did. The new array doubles
+    // the old one when the elements would fill more than half of an array of the same size;
+    // otherwise it is the same size, and the migration only purges the erased elements.
+    void _Grow(_Table_type * _Ptable)
+    {
+        if (details::_Atomic_compare_exchange(&_M_creating, 1, 0) != 0)
+        {
+            details::_Atomic_yield();
+            return;
+        }
+
+        try
+        {
+            if (_M_table == _Ptable && _M_old == NULL)
+            {
+                long _Count = _M_element_count;
+                size_type _Live = (_Count > 0) ? (size_type) _Count : 0;
+                size_type _Capacity = _Ptable->_M_capacity;
+
+                while (_Table_limit(_Capacity) < 2 * _Live)
+                {
+                    if (_Capacity > max_size() / 2)
+                    {
+                        throw std::length_error("concurrent_flat_map too large");
+                    }
+
+                    _Capacity *= 2;
+                }
+
+                _Start_migration(_Ptable, _Create_table(_Capacity));
+            }
+        }
+        catch(...)
+        {
+            details::_Atomic_exchange(&_M_creating, 0);
+            throw;
+        }
+
+        details::_Atomic_exchange(&_M_creating, 0);
+    }
+
+    // Publish a migration from _Pold to _Pnew. _M_old is set first, so no thread inserts into
+    // the new array while elements of the old one may still be missing from it.
+    void _Start_migration(_Table_type * _Pold, _Table_type * _Pnew)
+    {
+        _Pold->_M_successor = _Pnew;
+        details::_Atomic_compare_exchange_pointer((void * volatile *) &_M_old, _Pold, NULL);
+        details::_Atomic_compare_exchange_pointer((void * volatile *) &_M_table, _Pnew, _Pold);
+    }
+
+    // Move chunks of _Pold to its successor until none is left to claim, and wait for the
+    // threads moving the others. Whoever moves the last chunk ends the migration.
+    void _Help_migrate(_Table_type * _Pold)
+    {
+        size_type _Chunks = _Pold->_Chunk_count();
+
+        while (_M_old == _Pold)
+        {
+            bool _Claimed = false;
+
+            for (size_type _Chunk = 0; _Chunk < _Chunks; _Chunk++)
+            {
+                volatile long * _Pstate = &_Pold->_M_chunks[_Chunk];
+                if (*_Pstate != 0 || details::_Atomic_compare_exchange(_Pstate, 1, 0) != 0)
+                {
+                    continue;
+                }
+
+                _Claimed = true;
+                _Migrate_chunk(_Pold, _Chunk);
+                details::_Atomic_exchange(_Pstate, 2);
+
+                if (details::_Atomic_decrement(&_Pold->_M_chunks_left) == 0)
+                {
+                    details::_Atomic_compare_exchange_pointer((void * volatile *) &_M_old, NULL, _Pold);
+                    _Retire(_Pold);
+                    return;
+                }
+            }
+
+            if (!_Claimed)
+            {
+                details::_Atomic_yield();
+            }
+        }
+    }
+
+    void _Migrate_chunk(_Table_type * _Pold, size_type _Chunk)
+    {
+        size_type _First = _Chunk * details::_Flat_chunk_size;
+        size_type _Last = _First + details::_Flat_chunk_size;
+
+        if (_Last > _Pold->_M_capacity)
+        {
+            _Last = _Pold->_M_capacity;
+        }
+
+        for (size_type _Slot = _First; _Slot < _Last; _Slot++)
+        {
+            _Migrate_slot(_Pold, _Slot);
+        }
+    }
+
+    // Freeze an unused slot so nothing is inserted in it any more, or move its element to the
+    // successor array. Only the pointer moves, so a migration never calls user code or throws.
+    void _Migrate_slot(_Table_type * _Pold, size_type _Slot)
+    {
+        for (;;)
+        {
+            unsigned char _Ctrl = ((volatile unsigned char *) _Pold->_M_ctrl)[_Slot];
+
+            if (_Ctrl == details::_Ctrl_empty)
+            {
+                if (_Pold->_Set_ctrl(_Slot, details::_Ctrl_empty, details::_Ctrl_frozen))
+                {
+                    return;
+                }
+            }
+            else if (_Ctrl == details::_Ctrl_busy)
+            {
+                // An insertion is publishing its element; wait for it
+                details::_Atomic_yield();
+            }
+            else if ((_Ctrl & 0x80) != 0)
+            {
+                // Erased
+                return;
+            }
+            else if (_Pold->_Set_ctrl(_Slot, _Ctrl, details::_Ctrl_busy))
+            {
+                // Busy keeps erase from marking the slot while the element is on its way
+                _Insert_moved(_Pold->_M_successor, _Pold->_M_slots[_Slot]);
+                _Pold->_Set_ctrl(_Slot, details::_Ctrl_busy, details::_Ctrl_moved);
+                return;
+            }
+        }
+    }
+
+    // Move an element into an array that only migrations write to. The key cannot be there
+    // yet, so any unused slot on its probe sequence will do.
+    void _Insert_moved(_Table_type * _Ptable, _Node_type * _Pnode)
+    {
+        size_t _Hash = _Pnode->_M_hash;
+        size_type _Group_mask = _Ptable->_M_capacity / details::_Flat_group_size - 1;
+        size_type _Group = _Hash_h1(_Hash) & _Group_mask;
+
+        for (size_type _Probe = 0; ; )
+        {
+            details::_Flat_group _Bytes(_Ptable->_Ctrl() + _Group * details::_Flat_group_size);
+            unsigned int _Empty = _Bytes._Match(details::_Ctrl_empty);
+
+            if (_Empty == 0)
+            {
+                _Probe++;
+                _Group = (_Group + _Probe) & _Group_mask;
+                continue;
+            }
+
+            size_type _Index = _Group * details::_Flat_group_size + details::_Lowest_bit(_Empty);
+
+            if (_Ptable->_Set_ctrl(_Index, details::_Ctrl_empty, details::_Ctrl_busy))
+            {
+                _Ptable->_M_slots[_Index] = _Pnode;
+                _Ptable->_Claim();
+                _Ptable->_Set_ctrl(_Index, details::_Ctrl_busy, _Hash_h2(_Hash));
+                return;
+            }
+
+            // Another migration took the slot first; look at the group again
+        }
+    }
+
+    // Queue an array that has been migrated to be freed once no operation can still be reading it
+    void _Retire(_Table_type * _Ptable)
+    {
+        _Table_type * volatile * _Plist = &_M_retired[_M_epochs._Current() % _Epoch_count];
+
+        for (;;)
+        {
+            _Table_type * _Old_head = *_Plist;
+            _Ptable->_M_retired_next = _Old_head;
+
+            if (details::_Atomic_compare_exchange_pointer((void * volatile *) _Plist, _Ptable, _Old_head) == _Old_head)
+            {
+                break;
+            }
+        }
+
+        details::_Atomic_increment(&_M_retired_count);
+    }
+
+    // Free the retired arrays that no operation can be reading any more. Called after an
+    // operation's epoch guard is gone, so the epoch can move past the operation itself.
+    void _Reclaim_retired() const
+    {
+        if (_M_retired_count != 0)
+        {
+            // Freeing retired arrays does not change the contents of the map
+            const_cast<_Mytype *>(this)->_Try_reclaim();
+        }
+    }
+
+    // Advance the epoch as far as the operations in progress allow, freeing the arrays retired
+    // in the epochs left behind
+    void _Try_reclaim()
+    {
+        for (size_t _Index = 0; _Index < _Epoch_count; _Index++)
+        {
+            size_t _Oldest;
+            if (!_M_epochs._Begin_advance(_Oldest))
+            {
+                return;
+            }
+
+            // Detach the oldest list before publishing the new epoch; nothing is retired
+            // into it until the epoch has advanced.
+            _Table_type * volatile * _Plist = &_M_retired[_Oldest];
+            _Table_type * _Reclaimable;
+            for (;;)
+            {
+                _Reclaimable = *_Plist;
+                if (details::_Atomic_compare_exchange_pointer((void * volatile *) _Plist, NULL, _Reclaimable) == _Reclaimable)
+                {
+                    break;
+                }
+            }
+
+            _M_epochs._End_advance();
+            _Free_retired(_Reclaimable);
+        }
+    }
+
+    void _Free_retired(_Table_type * _Ptable)
+    {
+        while (_Ptable != NULL)
+        {
+            _Table_type * _Pnext = _Ptable->_M_retired_next;
+            _Free_table(_Ptable);
+            details::_Atomic_decrement(&_M_retired_count);
+            _Ptable = _Pnext;
+        }
+    }
+
+    // Free every retired array. Only safe when no operation is in progress on the map.
+    void _Reclaim_all()
+    {
+        for (size_t _Index = 0; _Index < _Epoch_count; _Index++)
+        {
+            _Free_retired(_M_retired[_Index]);
+            _M_retired[_Index] = NULL;
+        }
+    }
+
+    // Run the migration started by rehash to completion, and free the retired arrays. Only safe
+    // when no operation is in progress on the map.
+    void _Finish_migration()
+    {
+        if (_M_old != NULL)
+        {
+            _Help_migrate(_M_old);
+        }
+
+        _Reclaim_all();
+    }
+
+    // Returns the first published element, and its array and slot, for begin()
+    _Node_type * _First_slot(_Table_type *& _Ptable, size_type& _Slot) const
+    {
+        _Node_type * _Pnode;
+
+        {
+            _Epoch_guard _Guard(_M_epochs);
+            _Ptable = _Current_table();
+            _Slot = 0;
+            _Pnode = _Seek(_Ptable, _Slot);
+        }
+
+        _Reclaim_retired();
+        return _Pnode;
+    }
+
+    // Insert an element in the map given its value
+    template<typename _ValTy>
+    _Pairib _Insert(_ValTy&& _Value)
+    {
+        const key_type& _Keyval = _Value.first;
+        size_t _Hash = _Hash_key(_Keyval);
+        _Table_type * _Ptable;
+        size_type _Slot;
+        _Node_type * _Pnode;
+        _Insert_status _Status;
+
+        {
+            _Epoch_guard _Guard(_M_epochs);
+
+            for (;;)
+            {
+                _Ptable = _Current_table();
+                if (_Ptable == NULL)
+                {
+                    _Create_first_table();
+                    continue;
+                }
+
+                _Status = _Insert_in(_Ptable, _Keyval, _Hash, std::forward<_ValTy>(_Value), _Slot);
+
+                if (_Status == _Full)
+                {
+                    _Grow(_Ptable);
+                }
+                else if (_Status != _Retry)
+                {
+                    break;
+                }
+            }
+
+            // The array may be retired as soon as the guard is gone; the element stays
+            _Pnode = _Ptable->_M_slots[_Slot];
+        }
+
+        if (_Status == _Inserted)
+        {
+            details::_Atomic_increment(&_M_element_count);
+        }
+
+        _Reclaim_retired();
+        return _Pairib(iterator(this, _Ptable, _Slot, _Pnode), _Status == _Inserted);
+    }
+
+    // Insert an element in one slot array. Every insertion of a key stops at the first unused slot
+    // in its probe sequence and claims it, so all concurrent insertions of the key agree on where
+    // it lives. A migration freezes the unused slots before it moves anything past them.
+    template<typename _ValTy>
+    _Insert_status _Insert_in(_Table_type * _Ptable, const key_type& _Keyval, size_t _Hash, _ValTy&& _Value, size_type& _Slot)
+    {
+        unsigned char _H2 = _Hash_h2(_Hash);
+        size_type _Group_mask = _Ptable->_M_capacity / details::_Flat_group_size - 1;
+        size_type _Group = _Hash_h1(_Hash) & _Group_mask;
+        bool _Reserved = false;
+
+        for (size_type _Probe = 0; _Probe <= _Group_mask; )
+        {
+            const unsigned char * _Pctrl = _Ptable->_Ctrl() + _Group * details::_Flat_group_size;
+            details::_Flat_group _Bytes(_Pctrl);
+
+            unsigned int _Unused = _Bytes._Match(details::_Ctrl_empty) | _Bytes._Match(details::_Ctrl_frozen);
+            unsigned int _First_unused = (_Unused != 0) ? details::_Lowest_bit(_Unused) : details::_Flat_group_size;
+            unsigned int _Before = (1u << _First_unused) - 1;
+
+            // Look for the key among the published elements ahead of the first unused slot
+            for (unsigned int _Match = _Bytes._Match(_H2) & _Before; _Match != 0; _Match &= _Match - 1)
+            {
+                size_type _Index = _Group * details::_Flat_group_size + details::_Lowest_bit(_Match);
+                const _Node_type * _Pnode = _Ptable->_M_slots[_Index];
+                if (_Pnode->_M_hash == _Hash && !_M_comparator(_Pnode->_M_value.first, _Keyval))
+                {
+                    if (_Reserved)
+                    {
+                        _Ptable->_Release();
+                    }
+
+                    _Slot = _Index;
+                    return _Found;
+                }
+            }
+
+            unsigned int _Migrated = _Bytes._Match(details::_Ctrl_moved) | _Bytes._Match(details::_Ctrl_frozen);
+            if ((_Migrated & (_Before | (1u << _First_unused))) != 0)
+            {
+                if (_Reserved)
+                {
+                    _Ptable->_Release();
+                }
+
+                return _Retry;
+            }
+
+            if ((_Bytes._Match(details::_Ctrl_busy) & _Before) != 0)
+            {
+                // Another thread is publishing or moving an element ahead of the unused slot, and
+                // it may have the same key; wait for it and look again
+                details::_Atomic_yield();
+                continue;
+            }
+
+            if (_Unused == 0)
+            {
+                // Move on to the next group (triangular probing visits every group once)
+                _Probe++;
+                _Group = (_Group + _Probe) & _Group_mask;
+                continue;
+            }
+
+            if (!_Reserved && !(_Reserved = _Ptable->_Reserve()))
+            {
+                return _Full;
+            }
+
+            size_type _Index = _Group * details::_Flat_group_size + _First_unused;
+
+            if (_Ptable->_Set_ctrl(_Index, details::_Ctrl_empty, details::_Ctrl_busy))
+            {
+                try
+                {
+                    _Ptable->_M_slots[_Index] = _Buynode(std::forward<_ValTy>(_Value), _Hash);
+                }
+                catch(...)
+                {
+                    _Ptable->_Set_ctrl(_Index, details::_Ctrl_busy, details::_Ctrl_empty);
+                    _Ptable->_Release();
+                    throw;
+                }
+
+                _Ptable->_Set_ctrl(_Index, details::_Ctrl_busy, _H2);
+                _Slot = _Index;
+                return _Inserted;
+            }
+
+            // Another thread took the slot first, or a migration froze it; look at the group again
+        }
+
+        if (_Reserved)
+        {
+            _Ptable->_Release();
+        }
+
+        return _Full;
+    }
+
+    // Find the published element with the given key, and its array and slot. Returns NULL if there is none.
+    _Node_type * _Find(const key_type& _Keyval, _Table_type *& _Ptable, size_type& _Slot) const
+    {
+        size_t _Hash = _Hash_key(_Keyval);
+        _Node_type * _Pnode = NULL;
+
+        {
+            _Epoch_guard _Guard(_M_epochs);
+            if (_Find_slot(_Keyval, _Hash, _Ptable, _Slot))
+            {
+                _Pnode = _Ptable->_M_slots[_Slot];
+            }
+        }
+
+        _Reclaim_retired();
+        return _Pnode;
+    }
+
+    // Find the slot holding a published element with the given key in the current array.
+    // Must be called inside an epoch guard.
+    bool _Find_slot(const key_type& _Keyval, size_t _Hash, _Table_type *& _Ptable, size_type& _Slot) const
+    {
+        for (;;)
+        {
+            _Ptable = _Current_table();
+            if (_Ptable == NULL)
+            {
+                return false;
+            }
+
+            if (_Probe_slot(_Ptable, _Keyval, _Hash, _Slot))
+            {
+                return true;
+            }
+
+            // An element moved out of the array ahead of the probe is in the new one, which is
+            // published before anything moves
+            if (_M_table == _Ptable)
+            {
+                return false;
+            }
+        }
+    }
+
+    bool _Probe_slot(const _Table_type * _Ptable, const key_type& _Keyval, size_t _Hash, size_type& _Slot) const
+    {
+        unsigned char _H2 = _Hash_h2(_Hash);
+        size_type _Group_mask = _Ptable->_M_capacity / details::_Flat_group_size - 1;
+        size_type _Group = _Hash_h1(_Hash) & _Group_mask;
+
+        for (size_type _Probe = 0; _Probe <= _Group_mask; )
+        {
+            details::_Flat_group _Bytes(_Ptable->_Ctrl() + _Group * details::_Flat_group_size);
+
+            unsigned int _Unused = _Bytes._Match(details::_Ctrl_empty) | _Bytes._Match(details::_Ctrl_frozen);
+            unsigned int _Before = (_Unused != 0) ? (1u << details::_Lowest_bit(_Unused)) - 1 : 0xFFFF;
+
+            for (unsigned int _Match = _Bytes._Match(_H2) & _Before; _Match != 0; _Match &= _Match - 1)
+            {
+                size_type _Candidate = _Group * details::_Flat_group_size + details::_Lowest_bit(_Match);
+                const _Node_type * _Pnode = _Ptable->_M_slots[_Candidate];
+                if (_Pnode->_M_hash == _Hash && !_M_comparator(_Pnode->_M_value.first, _Keyval))
+                {
+                    _Slot = _Candidate;
+                    return true;
+                }
+            }
+
+            if (_Unused != 0)
+            {
+                // The probe sequence ends here
+                break;
+            }
+
+            _Probe++;
+            _Group = (_Group + _Probe) & _Group_mask;
+        }
+
+        return false;
+    }
+
+    _Table_type * volatile          _M_table;                  // Array operations work on, NULL until the first insertion
+    _Table_type * volatile          _M_old;                    // Array being migrated to _M_table, or NULL
+    _Mytraits                       _M_comparator;             // Hash and equality function objects
+    allocator_type                  _M_allocator;              // Allocator object for elements
+    details::_Epoch_domain          _M_epochs;                 // Keeps migrated arrays allocated while operations may read them
+    _Table_type * volatile          _M_retired[_Epoch_count];  // Migrated arrays by the epoch they were retired in
+    volatile long                   _M_retired_count;          // Migrated arrays not freed yet
+    volatile long                   _M_creating;               // Set while a thread allocates an array
+    volatile long                   _M_element_count;          // Number of elements not erased
+    float                           _M_maximum_load;           // Fraction of an array filled before it is migrated
+    size_type                       _M_initial_capacity;       // Number of slots in the first array
+};
+} // namespace samples
+} // namespace Concurrency
+
+#if defined(_MSC_VER)
+#pragma pack(pop)
+#endif
@@ -12,10 +12,11 @@
 ****/
 #pragma once
 
+#include <functional>
 #include <utility>
 #include "internal_concurrent_hash.h"
 
-#if !(defined(_M_AMD64) || defined(_M_IX86))
+#if defined(_MSC_VER) && !(defined(_M_AMD64) || defined(_M_IX86))
     #error ERROR: Concurrency Runtime is supported only on X64 and X86 architectures.
 #endif
 
@@ -23,7 +24,9 @@
     #error ERROR: Concurrency Runtime is not supported when compiling /clr.
 #endif
 
+#if defined(_MSC_VER)
 #pragma pack(push,_CRT_PACKING)
+#endif
 
 namespace Concurrency
 {
@@ -33,7 +36,7 @@ namespace details
 {
 // Template class for hash map traits
 template<typename _Key_type, typename _Element_type, typename _Key_comparator, typename _Allocator_type, bool _Allow_multimapping>
-class _Concurrent_unordered_map_traits : public std::_Container_base
+class _Concurrent_unordered_map_traits
 {
 public:
     typedef std::pair<_Key_type, _Element_type> _Value_type;
@@ -56,11 +59,15 @@ public:
     {
     }
 
-    class value_compare : public std::binary_function<value_type, value_type, bool>
+    class value_compare
     {
         friend class _Concurrent_unordered_map_traits<_Key_type, _Element_type, _Key_comparator, _Allocator_type, _Allow_multimapping>;
 
     public:
+        typedef value_type first_argument_type;
+        typedef value_type second_argument_type;
+        typedef bool result_type;
+
         bool operator()(const value_type& _Left, const value_type& _Right) const
         {
             return (_M_comparator(_Left.first, _Right.first));
@@ -96,7 +103,7 @@ public:
 /// </typeparam>
 /// <typeparam name="_Hasher">
 ///     The hash function object type. This argument is optional and the default value is
-///     tr1::hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
+///     hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
 /// </typeparam>
 /// <typeparam name="_Key_equality">
 ///     The equality comparison function object type. This argument is optional and the default value is
@@ -112,7 +119,7 @@ public:
 /// </remarks>
 /// <seealso cref="Parallel Containers and Objects"/>
 /**/
-template <typename _Key_type, typename _Element_type, typename _Hasher = std::tr1::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<std::pair<const _Key_type, _Element_type> > >
+template <typename _Key_type, typename _Element_type, typename _Hasher = std::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<std::pair<const _Key_type, _Element_type> > >
 class concurrent_unordered_map : public details::_Concurrent_hash< details::_Concurrent_unordered_map_traits<_Key_type, _Element_type, details::_Hash_compare<_Key_type, _Hasher, _Key_equality>, _Allocator_type, false> >
 {
 public:
@@ -149,10 +156,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered map.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered map.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered map.
     /// </param>
     /// <param name="_Allocator">
@@ -168,9 +175,9 @@ public:
     ///     <para>The last constructor specifies a move of the concurrent unordered map <paramref name="_Umap"/>.</para>
     /// </remarks>
     /**/
-    explicit concurrent_unordered_map(size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(), const key_equal& _Key_equality = key_equal(),
+    explicit concurrent_unordered_map(size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(), const key_equal& _Keyeqarg = key_equal(),
         const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(_Hasher, _Key_equality), _Allocator)
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
     }
@@ -210,10 +217,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered map.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered map.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered map.
     /// </param>
     /// <param name="_Allocator">
@@ -230,15 +237,12 @@ public:
     /// </remarks>
     /**/
     template <typename _Iterator>
-    concurrent_unordered_map(_Iterator _Begin, _Iterator _End, size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(),
-        const key_equal& _Key_equality = key_equal(), const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(), allocator_type())
+    concurrent_unordered_map(_Iterator _Begin, _Iterator _End, size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(),
+        const key_equal& _Keyeqarg = key_equal(), const allocator_type& _Allocator = allocator_type())
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
-        for (; _Begin != _End; ++_Begin)
-        {
-            _Mybase::insert(*_Begin);
-        }
+        this->unsafe_insert(_Begin, _End);
     }
 
     /// <summary>
@@ -407,6 +411,26 @@ public:
         return _Mybase::unsafe_erase(_Begin, _End);
     }
 
+    /// <summary>
+    ///     Erases the elements matching a key from the <c>concurrent_unordered_map</c>. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to erase.
+    /// </param>
+    /// <remarks>
+    ///     This method may be called concurrently with insertion, lookup and other calls to <c>erase</c>. The memory
+    ///     of erased elements is reclaimed once no concurrent operation can still be reading it. An iterator to an
+    ///     element is invalidated when that element is erased.
+    /// </remarks>
+    /// <returns>
+    ///     The count of elements erased from this <c>concurrent_unordered_map</c> object.
+    /// </returns>
+    /**/
+    size_type erase(const key_type& _Keyval)
+    {
+        return _Mybase::erase(_Keyval);
+    }
+
     /// <summary>
     ///     Swaps the contents of two <c>concurrent_unordered_map</c> objects. 
     ///     This method is not concurrency-safe.
@@ -427,7 +451,7 @@ public:
     /**/
     hasher hash_function() const
     {
-        return _M_comparator._M_hash_object;
+        return this->_M_comparator._M_hash_object;
     }
 
     /// <summary>
@@ -436,7 +460,7 @@ public:
     /**/
     key_equal key_eq() const
     {
-        return _M_comparator._M_key_compare_object;
+        return this->_M_comparator._M_key_compare_object;
     }
 
     /// <summary>
@@ -451,11 +475,11 @@ public:
     /**/
     mapped_type& operator[](const key_type& _Keyval)
     {
-        iterator _Where = find(_Keyval);
+        iterator _Where = this->find(_Keyval);
 
-        if (_Where == end())
+        if (_Where == this->end())
         {
-            _Where = insert(std::pair<key_type, mapped_type>(std::move(_Keyval), mapped_type())).first;
+            _Where = this->insert(std::pair<key_type, mapped_type>(std::move(_Keyval), mapped_type())).first;
         }
 
         return ((*_Where).second);
@@ -473,9 +497,9 @@ public:
     /**/
     mapped_type& at(const key_type& _Keyval)
     {
-        iterator _Where = find(_Keyval);
+        iterator _Where = this->find(_Keyval);
 
-        if (_Where == end())
+        if (_Where == this->end())
         {
             throw std::out_of_range("invalid concurrent_unordered_map<K, T> key");
         }
@@ -495,9 +519,9 @@ public:
     /**/
     const mapped_type& at(const key_type& _Keyval) const
     {
-        const_iterator _Where = find(_Keyval);
+        const_iterator _Where = this->find(_Keyval);
 
-        if (_Where == end())
+        if (_Where == this->end())
         {
             throw std::out_of_range("invalid concurrent_unordered_map<K, T> key");
         }
@@ -519,7 +543,7 @@ public:
 /// </typeparam>
 /// <typeparam name="_Hasher">
 ///     The hash function object type. This argument is optional and the default value is
-///     tr1::hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
+///     hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
 /// </typeparam>
 /// <typeparam name="_Key_equality">
 ///     The equality comparison function object type. This argument is optional and the default value is
@@ -535,7 +559,7 @@ public:
 /// </remarks>
 /// <seealso cref="Parallel Containers and Objects"/>
 /**/
-template <typename _Key_type, typename _Element_type, typename _Hasher = std::tr1::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<std::pair<const _Key_type, _Element_type> > >
+template <typename _Key_type, typename _Element_type, typename _Hasher = std::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<std::pair<const _Key_type, _Element_type> > >
 class concurrent_unordered_multimap : public details::_Concurrent_hash< details::_Concurrent_unordered_map_traits<_Key_type, _Element_type, details::_Hash_compare<_Key_type, _Hasher, _Key_equality>, _Allocator_type, true> >
 {
 public:
@@ -572,10 +596,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered multimap.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered multimap.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered multimap.
     /// </param>
     /// <param name="_Allocator">
@@ -591,9 +615,9 @@ public:
     ///     <para>The last constructor specifies a move of the concurrent unordered multimap <paramref name="_Umap"/>.</para>
     /// </remarks>
     /**/
-    explicit concurrent_unordered_multimap(size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(), const key_equal& _Key_equality = key_equal(),
+    explicit concurrent_unordered_multimap(size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(), const key_equal& _Keyeqarg = key_equal(),
         const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(_Hasher, _Key_equality), _Allocator)
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
     }
@@ -633,10 +657,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered multimap.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered multimap.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered multimap.
     /// </param>
     /// <param name="_Allocator">
@@ -653,15 +677,12 @@ public:
     /// </remarks>
     /**/
     template <typename _Iterator>
-    concurrent_unordered_multimap(_Iterator _Begin, _Iterator _End, size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(),
-        const key_equal& _Key_equality = key_equal(), const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(), allocator_type())
+    concurrent_unordered_multimap(_Iterator _Begin, _Iterator _End, size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(),
+        const key_equal& _Keyeqarg = key_equal(), const allocator_type& _Allocator = allocator_type())
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
-        for (; _Begin != _End; ++_Begin)
-        {
-            _Mybase::insert(*_Begin);
-        }
+        this->unsafe_insert(_Begin, _End);
     }
 
     /// <summary>
@@ -898,8 +919,8 @@ public:
     ///     The iterator for the <c>concurrent_unordered_multimap</c> object.
     /// </returns>
     template<class _Valty>
-        typename std::tr1::enable_if<!std::tr1::is_same<const_iterator, 
-            typename std::tr1::remove_reference<_Valty>::type>::value, iterator>::type
+        typename std::enable_if<!std::is_same<const_iterator, 
+            typename std::remove_reference<_Valty>::type>::value, iterator>::type
     insert(const_iterator _Where, _Valty&& _Value)
     {
         return _Mybase::insert(_Where, std::forward<_Valty>(_Value));
@@ -968,6 +989,26 @@ public:
         return _Mybase::unsafe_erase(_First, _Last);
     }
 
+    /// <summary>
+    ///     Erases the elements matching a key from the <c>concurrent_unordered_multimap</c>. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to erase.
+    /// </param>
+    /// <remarks>
+    ///     This method may be called concurrently with insertion, lookup and other calls to <c>erase</c>. The memory
+    ///     of erased elements is reclaimed once no concurrent operation can still be reading it. An iterator to an
+    ///     element is invalidated when that element is erased.
+    /// </remarks>
+    /// <returns>
+    ///     The count of elements erased from this <c>concurrent_unordered_multimap</c> object.
+    /// </returns>
+    /**/
+    size_type erase(const key_type& _Keyval)
+    {
+        return _Mybase::erase(_Keyval);
+    }
+
     /// <summary>
     ///     Swaps the contents of two <c>concurrent_unordered_multimap</c> objects. 
     ///     This method is not concurrency-safe.
@@ -988,7 +1029,7 @@ public:
     /**/
     hasher hash_function() const
     {
-        return _M_comparator._M_hash_object;
+        return this->_M_comparator._M_hash_object;
     }
 
     /// <summary>
@@ -997,10 +1038,12 @@ public:
     /**/
     key_equal key_eq() const
     {
-        return _M_comparator._M_key_compare_object;
+        return this->_M_comparator._M_key_compare_object;
     }
 };
 } // namespace samples
 } // namespace Concurrency
 
+#if defined(_MSC_VER)
 #pragma pack(pop)
+#endif
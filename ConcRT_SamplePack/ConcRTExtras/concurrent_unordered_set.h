@@ -12,10 +12,11 @@
 ****/
 #pragma once
 
+#include <functional>
 #include <utility>
 #include "internal_concurrent_hash.h"
 
-#if !(defined(_M_AMD64) || defined(_M_IX86))
+#if defined(_MSC_VER) && !(defined(_M_AMD64) || defined(_M_IX86))
     #error ERROR: Concurrency Runtime is supported only on X64 and X86 architectures.
 #endif
 
@@ -23,7 +24,9 @@
     #error ERROR: Concurrency Runtime is not supported when compiling /clr.
 #endif
 
+#if defined(_MSC_VER)
 #pragma pack(push,_CRT_PACKING)
+#endif
 
 namespace Concurrency
 {
@@ -33,7 +36,7 @@ namespace details
 {
 // Template class for hash set traits
 template<typename _Key_type, typename _Key_comparator, typename _Allocator_type, bool _Allow_multimapping>
-class _Concurrent_unordered_set_traits : public std::_Container_base
+class _Concurrent_unordered_set_traits
 {
 public:
     typedef _Key_type _Value_type;
@@ -77,7 +80,7 @@ public:
 /// </typeparam>
 /// <typeparam name="_Hasher">
 ///     The hash function object type. This argument is optional and the default value is
-///     tr1::hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
+///     hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
 /// </typeparam>
 /// <typeparam name="_Key_equality">
 ///     The equality comparison function object type. This argument is optional and the default value is
@@ -93,7 +96,7 @@ public:
 /// </remarks>
 /// <seealso cref="Parallel Containers and Objects"/>
 /**/
-template <typename _Key_type, typename _Hasher = std::tr1::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<_Key_type> >
+template <typename _Key_type, typename _Hasher = std::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<_Key_type> >
 class concurrent_unordered_set : public details::_Concurrent_hash< details::_Concurrent_unordered_set_traits<_Key_type, details::_Hash_compare<_Key_type, _Hasher, _Key_equality>, _Allocator_type, false> >
 {
 public:
@@ -130,10 +133,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered set.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered set.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered set.
     /// </param>
     /// <param name="_Allocator">
@@ -149,9 +152,9 @@ public:
     ///     <para>The last constructor specifies a move of the concurrent unordered set <paramref name="_Uset"/>.</para>
     /// </remarks>
     /**/
-    explicit concurrent_unordered_set(size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(), const key_equal& _Key_equality = key_equal(),
+    explicit concurrent_unordered_set(size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(), const key_equal& _Keyeqarg = key_equal(),
         const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(_Hasher, _Key_equality), _Allocator)
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
     }
@@ -191,10 +194,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered set.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered set.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered set.
     /// </param>
     /// <param name="_Allocator">
@@ -211,15 +214,12 @@ public:
     /// </remarks>
     /**/
     template <typename _Iterator>
-    concurrent_unordered_set(_Iterator _First, _Iterator _Last, size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(),
-        const key_equal& _Key_equality = key_equal(), const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(), allocator_type())
+    concurrent_unordered_set(_Iterator _First, _Iterator _Last, size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(),
+        const key_equal& _Keyeqarg = key_equal(), const allocator_type& _Allocator = allocator_type())
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
-        for (; _First != _Last; ++_First)
-        {
-            _Mybase::insert(*_First);
-        }
+        this->unsafe_insert(_First, _Last);
     }
 
     /// <summary>
@@ -388,6 +388,27 @@ public:
         return _Mybase::unsafe_erase(_First, _Last);
     }
 
+    /// <summary>
+    ///     Erases the elements matching a key from the <c>concurrent_unordered_set</c>. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to erase.
+    /// </param>
+    /// <remarks>
+    ///     This method may be called concurrently with insertion, lookup and other calls to <c>erase</c>. The memory
+    ///     of erased elements is reclaimed once no concurrent operation can still be reading it; call
+    ///     <c>reclaim_erased</c> at a quiescent point to release the last erased elements without waiting for further
+    ///     erasures. An iterator to an element is invalidated when that element is erased.
+    /// </remarks>
+    /// <returns>
+    ///     The count of elements erased from this <c>concurrent_unordered_set</c> object.
+    /// </returns>
+    /**/
+    size_type erase(const key_type& _Keyval)
+    {
+        return _Mybase::erase(_Keyval);
+    }
+
     /// <summary>
     ///     Swaps the contents of two <c>concurrent_unordered_set</c> objects. 
     ///     This method is not concurrency-safe.
@@ -408,7 +429,7 @@ public:
     /**/
     hasher hash_function() const
     {
-        return _M_comparator._M_hash_object;
+        return this->_M_comparator._M_hash_object;
     }
 
     /// <summary>
@@ -417,7 +438,7 @@ public:
     /**/
     key_equal key_eq() const
     {
-        return _M_comparator._M_key_compare_object;
+        return this->_M_comparator._M_key_compare_object;
     }
 };
 
@@ -431,7 +452,7 @@ public:
 /// </typeparam>
 /// <typeparam name="_Hasher">
 ///     The hash function object type. This argument is optional and the default value is
-///     tr1::hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
+///     hash&lt;</c><typeparamref name="_Key_type"/><c>&gt;</c>.
 /// </typeparam>
 /// <typeparam name="_Key_equality">
 ///     The equality comparison function object type. This argument is optional and the default value is
@@ -447,7 +468,7 @@ public:
 /// </remarks>
 /// <seealso cref="Parallel Containers and Objects"/>
 /**/
-template <typename _Key_type, typename _Hasher = std::tr1::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<_Key_type> >
+template <typename _Key_type, typename _Hasher = std::hash<_Key_type>, typename _Key_equality = std::equal_to<_Key_type>, typename _Allocator_type = std::allocator<_Key_type> >
 class concurrent_unordered_multiset : public details::_Concurrent_hash< details::_Concurrent_unordered_set_traits<_Key_type, details::_Hash_compare<_Key_type, _Hasher, _Key_equality>, _Allocator_type, true> >
 {
 public:
@@ -484,10 +505,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered multiset.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered multiset.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered multiset.
     /// </param>
     /// <param name="_Allocator">
@@ -503,9 +524,9 @@ public:
     ///     <para>The last constructor specifies a move of the concurrent unordered multiset <paramref name="_Uset"/>.</para>
     /// </remarks>
     /**/
-    explicit concurrent_unordered_multiset(size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(), const key_equal& _Key_equality = key_equal(),
+    explicit concurrent_unordered_multiset(size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(), const key_equal& _Keyeqarg = key_equal(),
         const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(_Hasher, _Key_equality), _Allocator)
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
     }
@@ -545,10 +566,10 @@ public:
     /// <param name="_Number_of_buckets">
     ///     The initial number of buckets for this unordered multiset.
     /// </param>
-    /// <param name="_Hasher">
+    /// <param name="_Hasharg">
     ///     The hash function for this unordered multiset.
     /// </param>
-    /// <param name="_Key_equality">
+    /// <param name="_Keyeqarg">
     ///     The equality comparison function for this unordered multiset.
     /// </param>
     /// <param name="_Allocator">
@@ -565,15 +586,12 @@ public:
     /// </remarks>
     /**/
     template <typename _Iterator>
-    concurrent_unordered_multiset(_Iterator _First, _Iterator _Last, size_type _Number_of_buckets = 8, const hasher& _Hasher = hasher(),
-        const key_equal& _Key_equality = key_equal(), const allocator_type& _Allocator = allocator_type())
-        : _Mybase(_Number_of_buckets, key_compare(), allocator_type())
+    concurrent_unordered_multiset(_Iterator _First, _Iterator _Last, size_type _Number_of_buckets = 8, const hasher& _Hasharg = hasher(),
+        const key_equal& _Keyeqarg = key_equal(), const allocator_type& _Allocator = allocator_type())
+        : _Mybase(_Number_of_buckets, key_compare(_Hasharg, _Keyeqarg), _Allocator)
     {
         this->rehash(_Number_of_buckets);
-        for (; _First != _Last; ++_First)
-        {
-            _Mybase::insert(*_First);
-        }
+        this->unsafe_insert(_First, _Last);
     }
 
     /// <summary>
@@ -810,8 +828,8 @@ public:
     ///     The iterator for the <c>concurrent_unordered_multiset</c> object.
     /// </returns>
     template<class _Valty>
-        typename std::tr1::enable_if<!std::tr1::is_same<const_iterator, 
-            typename std::tr1::remove_reference<_Valty>::type>::value, iterator>::type
+        typename std::enable_if<!std::is_same<const_iterator, 
+            typename std::remove_reference<_Valty>::type>::value, iterator>::type
     insert(const_iterator _Where, _Valty&& _Value)
     {
         return _Mybase::insert(_Where, std::forward<_Valty>(_Value));
@@ -880,6 +898,27 @@ public:
         return _Mybase::unsafe_erase(_First, _Last);
     }
 
+    /// <summary>
+    ///     Erases the elements matching a key from the <c>concurrent_unordered_multiset</c>. This method is concurrency-safe.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key to erase.
+    /// </param>
+    /// <remarks>
+    ///     This method may be called concurrently with insertion, lookup and other calls to <c>erase</c>. The memory
+    ///     of erased elements is reclaimed once no concurrent operation can still be reading it; call
+    ///     <c>reclaim_erased</c> at a quiescent point to release the last erased elements without waiting for further
+    ///     erasures. An iterator to an element is invalidated when that element is erased.
+    /// </remarks>
+    /// <returns>
+    ///     The count of elements erased from this <c>concurrent_unordered_multiset</c> object.
+    /// </returns>
+    /**/
+    size_type erase(const key_type& _Keyval)
+    {
+        return _Mybase::erase(_Keyval);
+    }
+
     /// <summary>
     ///     Swaps the contents of two <c>concurrent_unordered_multiset</c> objects. 
     ///     This method is not concurrency-safe.
@@ -900,7 +939,7 @@ public:
     /**/
     hasher hash_function() const
     {
-        return _M_comparator._M_hash_object;
+        return this->_M_comparator._M_hash_object;
     }
 
     /// <summary>
@@ -909,10 +948,12 @@ public:
     /**/
     key_equal key_eq() const
     {
-        return _M_comparator._M_key_compare_object;
+        return this->_M_comparator._M_key_compare_object;
     }
 };
 } // namespace samples
 } // namespace Concurrency
 
+#if defined(_MSC_VER)
 #pragma pack(pop)
+#endif
@@ -0,0 +1,169 @@
+/***
+* ==++==
+*
+* Copyright (c) Microsoft Corporation.  All rights reserved.
+*
+* ==--==
+* =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+*
+* internal_atomics.h
+*
+* =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+****/
+#pragma once
+
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <concrt.h>
+#else
+#include <thread>
+#endif
+
+namespace Concurrency
+{
+namespace samples
+{
+namespace details
+{
+// Atomic primitives used by the split-ordered list, the hash tables built on it and the
+// parallel algorithms. They map to the interlocked intrinsics under Visual C++ and to the
+// __sync builtins elsewhere; all of them except _Atomic_load_acquire and
+// _Atomic_store_release are full barriers.
+#if defined(_MSC_VER)
+
+inline long _Atomic_increment(volatile long * _Target)
+{
+    return _InterlockedIncrement(_Target);
+}
+
+inline long _Atomic_decrement(volatile long * _Target)
+{
+    return _InterlockedDecrement(_Target);
+}
+
+inline long _Atomic_add(volatile long * _Target, long _Value)
+{
+    return _InterlockedExchangeAdd(_Target, _Value) + _Value;
+}
+
+inline long _Atomic_exchange(volatile long * _Target, long _Value)
+{
+    return _InterlockedExchange(_Target, _Value);
+}
+
+inline long _Atomic_compare_exchange(volatile long * _Target, long _Exchange, long _Comparand)
+{
+    return _InterlockedCompareExchange(_Target, _Exchange, _Comparand);
+}
+
+inline void * _Atomic_compare_exchange_pointer(void * volatile * _Target, void * _Exchange, void * _Comparand)
+{
+    return _InterlockedCompareExchangePointer(_Target, _Exchange, _Comparand);
+}
+
+inline size_t _Atomic_compare_exchange_size_t(volatile size_t * _Target, size_t _Exchange, size_t _Comparand)
+{
+#if defined(_M_IX86)
+    return (size_t) _InterlockedCompareExchange((volatile long *) _Target, (long) _Exchange, (long) _Comparand);
+#else
+    return (size_t) _InterlockedCompareExchange64((volatile __int64 *) _Target, (__int64) _Exchange, (__int64) _Comparand);
+#endif
+}
+
+// Loads of the value are ordered before any later loads
+inline long _Atomic_load_acquire(volatile long * _Target)
+{
+    long _Value = *_Target;
+    _ReadWriteBarrier();
+    return _Value;
+}
+
+// Earlier loads and stores are ordered before the store
+inline void _Atomic_store_release(volatile long * _Target, long _Value)
+{
+    _ReadWriteBarrier();
+    *_Target = _Value;
+}
+
+// The store is ordered before any later loads
+inline void _Atomic_store_fence(volatile long * _Target, long _Value)
+{
+    *_Target = _Value;
+    _mm_mfence();
+}
+
+inline void _Atomic_yield()
+{
+    Concurrency::Context::Yield();
+}
+
+#else /* _MSC_VER */
+
+inline long _Atomic_increment(volatile long * _Target)
+{
+    return __sync_add_and_fetch(_Target, 1);
+}
+
+inline long _Atomic_decrement(volatile long * _Target)
+{
+    return __sync_sub_and_fetch(_Target, 1);
+}
+
+inline long _Atomic_add(volatile long * _Target, long _Value)
+{
+    return __sync_add_and_fetch(_Target, _Value);
+}
+
+inline long _Atomic_exchange(volatile long * _Target, long _Value)
+{
+    // __sync_lock_test_and_set is only an acquire barrier
+    __sync_synchronize();
+    return __sync_lock_test_and_set(_Target, _Value);
+}
+
+inline long _Atomic_compare_exchange(volatile long * _Target, long _Exchange, long _Comparand)
+{
+    return __sync_val_compare_and_swap(_Target, _Comparand, _Exchange);
+}
+
+inline void * _Atomic_compare_exchange_pointer(void * volatile * _Target, void * _Exchange, void * _Comparand)
+{
+    return __sync_val_compare_and_swap(_Target, _Comparand, _Exchange);
+}
+
+inline size_t _Atomic_compare_exchange_size_t(volatile size_t * _Target, size_t _Exchange, size_t _Comparand)
+{
+    return __sync_val_compare_and_swap(_Target, _Comparand, _Exchange);
+}
+
+// Loads of the value are ordered before any later loads
+inline long _Atomic_load_acquire(volatile long * _Target)
+{
+    return __atomic_load_n(_Target, __ATOMIC_ACQUIRE);
+}
+
+// Earlier loads and stores are ordered before the store
+inline void _Atomic_store_release(volatile long * _Target, long _Value)
+{
+    __atomic_store_n(_Target, _Value, __ATOMIC_RELEASE);
+}
+
+// The store is ordered before any later loads
+inline void _Atomic_store_fence(volatile long * _Target, long _Value)
+{
+    __atomic_store_n(_Target, _Value, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+inline void _Atomic_yield()
+{
+    std::this_thread::yield();
+}
+
+#endif /* _MSC_VER */
+
+} // namespace details
+} // namespace samples
+} // namespace Concurrency
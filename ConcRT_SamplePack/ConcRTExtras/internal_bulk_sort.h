@@ -0,0 +1,139 @@
+/***
+* ==++==
+*
+* Copyright (c) Microsoft Corporation.  All rights reserved.
+*
+* ==--==
+* =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
+*
+* internal_bulk_sort.h
+*
+* =-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-
+****/
+#pragma once
+
+// The scheduler is selected as in ppl_extras.h
+#if !defined(_MSC_VER) && !defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+#define CONCRTEXTRAS_STD_THREAD_BACKEND
+#endif
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+#include "work_stealing_scheduler.h"
+#else
+#include <ppl.h>
+#endif
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace Concurrency
+{
+namespace samples
+{
+namespace details
+{
+// Smallest number of items that _Bulk_sort gives to one worker; smaller inputs are sorted serially
+static const size_t _Bulk_sort_min_chunk = 16384;
+
+// Compares two items by the key that _Bulk_sort orders them by
+template<typename _Key_function>
+struct _Bulk_sort_less
+{
+    explicit _Bulk_sort_less(const _Key_function& _Key) : _M_key(_Key)
+    {
+    }
+
+    template<typename _Ty>
+    bool operator()(const _Ty& _Left, const _Ty& _Right) const
+    {
+        return _M_key(_Left) < _M_key(_Right);
+    }
+
+    const _Key_function& _M_key;
+
+private:
+    _Bulk_sort_less& operator=(const _Bulk_sort_less&);
+};
+
+// Stable sort of _Items by the size_t key that _Key returns, for the containers' bulk
+// insertion. It is a least significant digit radix sort, one byte per pass: every chunk of
+// the input counts its digits in parallel, the counts are summed in digit-major, chunk-minor
+// order and every chunk then scatters its items into the other buffer in parallel. There is
+// no pass for a digit that all the keys share.
+template<typename _Ty, typename _Key_function>
+void _Bulk_sort(std::vector<_Ty>& _Items, const _Key_function& _Key)
+{
+    const size_t _Size = _Items.size();
+    if (_Size < _Bulk_sort_min_chunk)
+    {
+        std::stable_sort(_Items.begin(), _Items.end(), _Bulk_sort_less<_Key_function>(_Key));
+        return;
+    }
+
+    const size_t _Chunks = (std::min)(static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), _Size / _Bulk_sort_min_chunk);
+
+    std::vector<_Ty> _Buffer(_Size);
+    std::vector<size_t> _Counts(_Chunks * 256);
+
+    // Find the key bits that are not the same in every item; only their digits need a pass
+    const size_t _First_key = _Key(_Items[0]);
+    parallel_for(size_t(0), _Chunks, [&](size_t _Chunk) {
+        size_t _Chunk_varying = 0;
+        for (size_t _Index = _Chunk * _Size / _Chunks; _Index < (_Chunk + 1) * _Size / _Chunks; _Index++)
+        {
+            _Chunk_varying |= _Key(_Items[_Index]) ^ _First_key;
+        }
+
+        _Counts[_Chunk] = _Chunk_varying;
+    });
+
+    size_t _Varying = 0;
+    for (size_t _Chunk = 0; _Chunk < _Chunks; _Chunk++)
+    {
+        _Varying |= _Counts[_Chunk];
+    }
+
+    for (size_t _Shift = 0; _Shift < sizeof(size_t) * 8; _Shift += 8)
+    {
+        if (((_Varying >> _Shift) & 0xFF) == 0)
+        {
+            continue;
+        }
+
+        parallel_for(size_t(0), _Chunks, [&](size_t _Chunk) {
+            size_t * _Chunk_counts = &_Counts[_Chunk * 256];
+            std::fill(_Chunk_counts, _Chunk_counts + 256, size_t(0));
+
+            for (size_t _Index = _Chunk * _Size / _Chunks; _Index < (_Chunk + 1) * _Size / _Chunks; _Index++)
+            {
+                _Chunk_counts[(_Key(_Items[_Index]) >> _Shift) & 0xFF]++;
+            }
+        });
+
+        // Turn the counts into the position of each chunk's first item with each digit
+        size_t _Position = 0;
+        for (size_t _Digit = 0; _Digit < 256; _Digit++)
+        {
+            for (size_t _Chunk = 0; _Chunk < _Chunks; _Chunk++)
+            {
+                size_t _Count = _Counts[_Chunk * 256 + _Digit];
+                _Counts[_Chunk * 256 + _Digit] = _Position;
+                _Position += _Count;
+            }
+        }
+
+        parallel_for(size_t(0), _Chunks, [&](size_t _Chunk) {
+            size_t * _Chunk_positions = &_Counts[_Chunk * 256];
+
+            for (size_t _Index = _Chunk * _Size / _Chunks; _Index < (_Chunk + 1) * _Size / _Chunks; _Index++)
+            {
+                _Buffer[_Chunk_positions[(_Key(_Items[_Index]) >> _Shift) & 0xFF]++] = _Items[_Index];
+            }
+        });
+
+        _Items.swap(_Buffer);
+    }
+}
+
+} // namespace details
+} // namespace samples
+} // namespace Concurrency
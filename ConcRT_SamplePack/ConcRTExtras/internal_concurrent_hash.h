@@ -12,9 +12,13 @@
 ****/
 #pragma once
 
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
 #include <utility>
+#include <vector>
+#include "internal_bulk_sort.h"
 #include "internal_split_ordered_list.h"
-#include <concrt.h>
 
 namespace Concurrency
 {
@@ -92,15 +96,19 @@ inline unsigned char _Get_msb(size_t _Mask)
 
 #if defined(_M_IX86)
     _BitScanReverse(&_Index, _Mask);
-#else
+#elif defined(_MSC_VER)
     _BitScanReverse64(&_Index, _Mask);
+#else
+    _Index = (unsigned long) (sizeof(unsigned long long) * 8 - 1 - __builtin_clzll((unsigned long long) _Mask));
 #endif
 
     return (unsigned char) _Index;
 }
 
+#if defined(_MSC_VER)
 #pragma warning(push)
 #pragma warning(disable: 4127) // warning 4127 -- while (true) has a constant expression in it
+#endif
 
 template <typename _Traits>
 class _Concurrent_hash : public _Traits
@@ -123,10 +131,11 @@ public:
     typedef typename allocator_type::size_type size_type;
     typedef typename allocator_type::difference_type difference_type;
 
-    typedef typename _Split_ordered_list<typename _Traits::value_type, typename _Traits::allocator_type> _Mylist;
+    typedef _Split_ordered_list<typename _Traits::value_type, typename _Traits::allocator_type> _Mylist;
     typedef typename _Mylist::_Nodeptr _Nodeptr;
+    typedef typename _Mylist::_Epoch_guard _Epoch_guard;
 
-    typedef typename std::tr1::conditional<std::tr1::is_same<key_type, value_type>::value, typename _Mylist::const_iterator, typename _Mylist::iterator>::type iterator;
+    typedef typename std::conditional<std::is_same<key_type, value_type>::value, typename _Mylist::const_iterator, typename _Mylist::iterator>::type iterator;
     typedef typename _Mylist::const_iterator const_iterator;
     typedef iterator local_iterator;
     typedef const_iterator const_local_iterator;
@@ -134,17 +143,124 @@ public:
     typedef std::pair<iterator, iterator> _Pairii;
     typedef std::pair<const_iterator, const_iterator> _Paircc;
 
-    // Iterators that walk the entire split-order list, including dummy nodes
-    typedef typename _Mylist::_Full_iterator _Full_iterator;
-    typedef typename _Mylist::_Full_const_iterator _Full_const_iterator;
+    using _Traits::_M_comparator;
+    using _Traits::_Key_function;
 
     static const size_type _Initial_bucket_number = 8;                               // Initial number of buckets
     static const size_type _Initial_bucket_load = 4;                                 // Initial maximum number of elements per bucket
     static size_type const _Pointers_per_table = sizeof(size_type) * 8;              // One bucket segment per bit
+    static const size_type _Default_range_grainsize = 256;                          // Default number of buckets per subrange
+
+    // A range of the container that can be split for parallel traversal. Ranges split at the
+    // dummy nodes of the bucket table: the midpoint of a range is the initialized bucket whose
+    // dummy node is ordered closest below the middle of the range's split-order keys.
+    template<bool _Is_const>
+    class _Hash_range
+    {
+    public:
+        typedef _Solist_range_iterator<_Mylist, _Is_const> iterator;
+        typedef _Solist_range_iterator<_Mylist, true> const_iterator;
+        typedef typename _Concurrent_hash::size_type size_type;
+        typedef typename _Concurrent_hash::value_type value_type;
+        typedef typename iterator::reference reference;
+        typedef typename _Concurrent_hash::difference_type difference_type;
+
+        // The whole container
+        _Hash_range(const _Concurrent_hash& _Table, size_type _Grainsize) :
+            _M_table(&_Table), _M_begin_node(_Table._M_split_ordered_list._Begin()), _M_end_node(NULL),
+            _M_grainsize(_Grainsize == 0 ? 1 : _Grainsize)
+        {
+            _Set_midpoint();
+        }
+
+        bool empty() const
+        {
+            return (begin() == end());
+        }
+
+        bool is_divisible() const
+        {
+            return (_M_midpoint_node != _M_end_node);
+        }
+
+        // Moves the upper part of this range into a new range and returns it
+        _Hash_range split()
+        {
+            _ASSERT_EXPR(is_divisible(), L"The range cannot be split");
+
+            _Hash_range _Upper(*this);
+            _Upper._M_begin_node = _M_midpoint_node;
+            _Upper._Set_midpoint();
+
+            _M_end_node = _M_midpoint_node;
+            _Set_midpoint();
+
+            return _Upper;
+        }
+
+        iterator begin() const
+        {
+            return iterator(_M_begin_node, _M_end_node);
+        }
+
+        iterator end() const
+        {
+            return iterator(_M_end_node, _M_end_node);
+        }
+
+        size_type grainsize() const
+        {
+            return _M_grainsize;
+        }
+
+    private:
+        void _Set_midpoint()
+        {
+            _M_midpoint_node = _M_end_node;
+
+            size_type _Buckets = _M_table->_M_number_of_buckets;
+            unsigned char _Bucket_bits = _Get_msb(_Buckets);
+            if (_Bucket_bits == 0)
+            {
+                return;
+            }
+
+            // Both ends of a range are dummy nodes, or the end of the list
+            _Split_order_key _Begin_key = _Mylist::_Get_key(_M_begin_node);
+            _Split_order_key _End_key = (_M_end_node != NULL) ? _Mylist::_Get_key(_M_end_node) : ~_Split_order_key(0);
+
+            // Number of bucket slots the range spans in split order
+            size_type _Span = (_End_key - _Begin_key) >> (sizeof(_Split_order_key) * 8 - _Bucket_bits);
+            if (_Span < 2 * _M_grainsize)
+            {
+                return;
+            }
+
+            size_type _Mid_bucket = _M_table->_Reverse(_Begin_key + (_End_key - _Begin_key) / 2) % _Buckets;
+            while (!_M_table->_Is_initialized(_Mid_bucket))
+            {
+                _Mid_bucket = _M_table->_Get_parent(_Mid_bucket);
+            }
+
+            if (_M_table->_Split_order_dummy_key(_Mid_bucket) > _Begin_key)
+            {
+                _M_midpoint_node = _M_table->_Get_bucket(_Mid_bucket);
+            }
+        }
+
+        const _Concurrent_hash * _M_table;
+        _Nodeptr                 _M_begin_node;    // Dummy node at the start of the range
+        _Nodeptr                 _M_end_node;      // Dummy node past the end of the range, or NULL
+        _Nodeptr                 _M_midpoint_node; // Where split() divides the range; _M_end_node if it cannot
+        size_type                _M_grainsize;
+    };
+
+    typedef _Hash_range<std::is_same<key_type, value_type>::value> range_type;
+    typedef _Hash_range<true> const_range_type;
 
     // Constructors/Destructors
     _Concurrent_hash(size_type _Number_of_buckets = _Initial_bucket_number, const key_compare& _Parg = key_compare(), const allocator_type& _Allocator = allocator_type())
-        : _Traits(_Parg), _M_number_of_buckets(_Number_of_buckets), _M_split_ordered_list(_Allocator), _M_allocator(_Allocator), _M_maximum_bucket_size((float) _Initial_bucket_load)
+        : _Traits(_Parg), _M_split_ordered_list(_Allocator), _M_allocator(_Allocator), _M_number_of_buckets(_Number_of_buckets), _M_maximum_bucket_size((float) _Initial_bucket_load)
     {
         _Init();
     }
@@ -205,7 +321,7 @@ public:
         }
     }
 
-    static size_type __cdecl _Segment_index_of( size_type _Index )
+    static size_type _Segment_index_of( size_type _Index )
     {
         return size_type( _Get_msb( _Index|1 ) );
     }
@@ -260,6 +376,7 @@ public:
     ///     This function is concurrency safe.
     ///     <para>With concurrent inserts, the number of elements in the concurrent container may change 
     ///     immediately after calling this function, before the return value is even read.</para>
+    ///     <para>The count is kept in stripes, one per inserting thread up to a fixed number, which this function sums.</para>
     /// </remarks>
     /// <returns>
     ///     The number of items in the container.
@@ -377,6 +494,50 @@ public:
         return _M_split_ordered_list.cend();
     }
 
+    /// <summary>
+    ///     Returns a range over the whole container that can be split for parallel traversal.
+    /// </summary>
+    /// <param name="_Grainsize">
+    ///     The smallest number of buckets a subrange is split into.
+    /// </param>
+    /// <remarks>
+    ///     This function is concurrency safe.
+    ///     <para>The range is split along the bucket table, so each subrange covers a contiguous set of buckets
+    ///     and the subranges can be traversed independently, for example with <c>parallel_for_each_range</c> or
+    ///     <c>parallel_reduce_range</c>. Elements inserted concurrently with the traversal may or may not be
+    ///     visited; as with iterators, a range must not be traversed across a concurrent erase.</para>
+    /// </remarks>
+    /// <returns>
+    ///     A splittable range over the elements of the concurrent container.
+    /// </returns>
+    /**/
+    range_type range(size_type _Grainsize = _Default_range_grainsize)
+    {
+        return range_type(*this, _Grainsize);
+    }
+
+    /// <summary>
+    ///     Returns a range over the whole container that can be split for parallel traversal.
+    /// </summary>
+    /// <param name="_Grainsize">
+    ///     The smallest number of buckets a subrange is split into.
+    /// </param>
+    /// <remarks>
+    ///     This function is concurrency safe.
+    ///     <para>The range is split along the bucket table, so each subrange covers a contiguous set of buckets
+    ///     and the subranges can be traversed independently, for example with <c>parallel_for_each_range</c> or
+    ///     <c>parallel_reduce_range</c>. Elements inserted concurrently with the traversal may or may not be
+    ///     visited; as with iterators, a range must not be traversed across a concurrent erase.</para>
+    /// </remarks>
+    /// <returns>
+    ///     A splittable range over the elements of the concurrent container.
+    /// </returns>
+    /**/
+    const_range_type range(size_type _Grainsize = _Default_range_grainsize) const
+    {
+        return const_range_type(*this, _Grainsize);
+    }
+
     // Modifiers
     /// <summary>
     ///     Inserts a value into the concurrent container.
@@ -466,8 +627,8 @@ public:
     /// </returns>
     /**/
     template<class _Valty>
-        typename std::tr1::enable_if<!std::tr1::is_same<const_iterator, 
-            typename std::tr1::remove_reference<_Valty>::type>::value, iterator>::type
+        typename std::enable_if<!std::is_same<const_iterator, 
+            typename std::remove_reference<_Valty>::type>::value, iterator>::type
     insert(const_iterator, _Valty&& _Value)
     {
         // Ignore hint
@@ -499,6 +660,34 @@ public:
         }
     }
 
+    /// <summary>
+    ///     Inserts a set of values into the concurrent container from an iterator, building the container in bulk.
+    /// </summary>
+    /// <typeparam name="_Iterator">
+    ///     The iterator type used for insertion.
+    /// </typeparm>
+    /// <param name="_First">
+    ///     The input iterator pointing to the beginning location.
+    /// </param>
+    /// <param name="_Last">
+    ///     The input iterator pointing to the end location.
+    /// </param>
+    /// <remarks>
+    ///     This function is not concurrency safe.
+    ///     <para>Rather than inserting the values one at a time, this function sizes the bucket table for the final
+    ///     number of elements, creates the new elements (in parallel for random access iterators), sorts them into
+    ///     split order with a parallel radix sort and links them into the container in a single pass. For large
+    ///     ranges it is much faster than <c>insert</c>.</para>
+    ///     <para>As with <c>insert</c>, a value whose key is already present is not inserted unless the container
+    ///     allows multiple keys; of several equal keys in the range, the first one is kept.</para>
+    /// </remarks>
+    /**/
+    template<class _Iterator>
+    void unsafe_insert(_Iterator _First, _Iterator _Last)
+    {
+        _Unsafe_bulk_insert(_First, _Last, typename std::iterator_traits<_Iterator>::iterator_category());
+    }
+
     /// <summary>
     ///     Erases an element from the concurrent container.
     /// </summary>
@@ -564,6 +753,56 @@ public:
         return _Count;
     }
 
+    /// <summary>
+    ///     Erases the elements with a specific key from the concurrent container.
+    /// </summary>
+    /// <param name="_Keyval">
+    ///     The key of the elements to erase from the concurrent container.
+    /// </param>
+    /// <remarks>
+    ///     This function is concurrency safe with respect to insert, find, count, equal_range and erase.
+    ///     <para>Erased elements stop being visible immediately, but their memory is reclaimed only once no
+    ///     concurrent operation can still be reading it. An iterator to an element remains valid only until
+    ///     that element is erased, so iterators must not be held across a concurrent erase of the same key.</para>
+    /// </remarks>
+    /// <returns>
+    ///     A count of the number of elements removed from the concurrent container.
+    /// </returns>
+    /**/
+    size_type erase(const key_type& _Keyval)
+    {
+        size_type _Count = 0;
+
+        while (_Erase_one(_Keyval))
+        {
+            _Count++;
+
+            if (!_Traits::_M_allow_multimapping)
+            {
+                break;
+            }
+        }
+
+        return _Count;
+    }
+
+    /// <summary>
+    ///     Frees the memory of erased elements that no concurrent operation can still be reading.
+    /// </summary>
+    /// <remarks>
+    ///     This function is concurrency safe.
+    ///     <para><c>erase</c> retires elements into the current reclamation epoch and frees them in batches, as later
+    ///     erasures find that every operation in progress has moved past the epoch they were retired in. When erasures
+    ///     stop, the last batches stay allocated until the next one. Calling this function at a quiescent point, such
+    ///     as the end of an eviction pass or an idle period of the scheduler, frees them; elements that an operation
+    ///     still in progress may be reading are kept until a later call.</para>
+    /// </remarks>
+    /**/
+    void reclaim_erased()
+    {
+        _M_split_ordered_list._Try_reclaim();
+    }
+
     /// <summary>
     ///     Swaps the contents of two concurrent containers.
     /// </summary>
@@ -582,7 +821,8 @@ public:
     {
         if (this != &_Right)
         {
-            std::_Swap_adl(_M_comparator, _Right._M_comparator);
+            using std::swap;
+            swap(_M_comparator, _Right._M_comparator);
             _M_split_ordered_list.swap(_Right._M_split_ordered_list);
             _Swap_buckets(_Right);
             std::swap(_M_number_of_buckets, _Right._M_number_of_buckets);
@@ -673,6 +913,7 @@ public:
     /**/
     size_type count(const key_type& _Keyval) const
     {
+        _Epoch_guard _Guard(_M_split_ordered_list);
         size_type _Count = 0;
         const_iterator _It = _Find(_Keyval);
         for (;_It != end() && !_M_comparator(_Key_function(*_It), _Keyval); _It++)
@@ -768,12 +1009,14 @@ public:
             return _Count;
         }
 
-        _Full_iterator _Iterator = _Get_bucket(_Bucket);
-        _Iterator++;
+        _Nodeptr _Pnode = _Mylist::_Get_next(_Get_bucket(_Bucket));
 
-        for (; _Iterator != _M_split_ordered_list._End() && !_Iterator._Mynode()->_Is_dummy(); _Iterator++)
+        for (; _Pnode != NULL && !_Pnode->_Is_dummy(); _Pnode = _Mylist::_Get_next(_Pnode))
         {
-            _Count++;
+            if (!_Mylist::_Is_erased(_Pnode))
+            {
+                _Count++;
+            }
         }
 
         return _Count;
@@ -816,8 +1059,7 @@ public:
             _Initialize_bucket(_Bucket);
         }
 
-        _Full_iterator _Iterator = _Get_bucket(_Bucket);
-        return _M_split_ordered_list._Get_first_real_iterator(_Iterator);
+        return _M_split_ordered_list._Get_first_real_iterator(_Get_bucket(_Bucket));
     }
 
     // If the bucket is initialized, return a first non-dummy element in it
@@ -840,9 +1082,7 @@ public:
             _Initialize_bucket(_Bucket);
         }
 
-
-        _Full_const_iterator _Iterator = _Get_bucket(_Bucket);
-        return _M_split_ordered_list._Get_first_real_iterator(_Iterator);
+        return _M_split_ordered_list._Get_first_real_iterator(_Get_bucket(_Bucket));
     }
 
     // Returns the iterator after the last non-dummy element in the bucket
@@ -871,17 +1111,17 @@ public:
             }
         }
 
-        _Full_iterator _Iterator = _Get_bucket(_Bucket);
+        _Nodeptr _Pnode = _Get_bucket(_Bucket);
     
         // Find the end of the bucket, denoted by the dummy element
         do
         {
-            _Iterator++;
+            _Pnode = _Mylist::_Get_next(_Pnode);
         }
-        while(_Iterator != _M_split_ordered_list._End() && !_Iterator._Mynode()->_Is_dummy());
+        while(_Pnode != NULL && !_Pnode->_Is_dummy());
 
         // Return the first real element past the end of the bucket
-        return _M_split_ordered_list._Get_first_real_iterator(_Iterator);
+        return _M_split_ordered_list._Get_first_real_iterator(_Pnode);
     }
 
     // Returns the iterator after the last non-dummy element in the bucket
@@ -910,17 +1150,17 @@ public:
             }
         }
 
-        _Full_const_iterator _Iterator = _Get_bucket(_Bucket);
+        _Nodeptr _Pnode = _Get_bucket(_Bucket);
     
         // Find the end of the bucket, denoted by the dummy element
         do
         {
-            _Iterator++;
+            _Pnode = _Mylist::_Get_next(_Pnode);
         }
-        while(_Iterator != _M_split_ordered_list._End() && !_Iterator._Mynode()->_Is_dummy());
+        while(_Pnode != NULL && !_Pnode->_Is_dummy());
 
         // Return the first real element past the end of the bucket
-        return _M_split_ordered_list._Get_first_real_iterator(_Iterator);
+        return _M_split_ordered_list._Get_first_real_iterator(_Pnode);
     }
 
     /// <summary>
@@ -1044,7 +1284,7 @@ private:
         memset(_M_buckets, 0, _Pointers_per_table * sizeof(void *));
 
         // Insert the first element in the split-ordered list
-        _Full_iterator _Dummy_node = _M_split_ordered_list._Begin();
+        _Nodeptr _Dummy_node = _M_split_ordered_list._Begin();
         _Set_bucket(0, _Dummy_node);
     }
 
@@ -1057,7 +1297,7 @@ private:
 
         try
         {
-            insert(_Right.begin(), _Right.end());
+            unsafe_insert(_Right.begin(), _Right.end());
             _M_comparator = _Right._M_comparator;
         }
         catch(...)
@@ -1074,9 +1314,9 @@ private:
             // Swap all node segments
             for (size_type _Index = 0; _Index < _Pointers_per_table; _Index++)
             {
-                _Full_iterator * _Iterator_pointer = _M_buckets[_Index];
+                _Nodeptr * _Segment_pointer = _M_buckets[_Index];
                 _M_buckets[_Index] = _Right._M_buckets[_Index];
-                _Right._M_buckets[_Index] = _Iterator_pointer;
+                _Right._M_buckets[_Index] = _Segment_pointer;
             }
         }
         else
@@ -1102,6 +1342,8 @@ private:
     template<typename _ValTy>
     _Pairib _Insert(_ValTy&& _Value)
     {
+        _Epoch_guard _Guard(_M_split_ordered_list);
+
         _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Key_function(_Value));
         size_type _Bucket = _Order_key % _M_number_of_buckets;
 
@@ -1111,99 +1353,107 @@ private:
             _Initialize_bucket(_Bucket);
         }
 
-        long _New_count;
+        size_type _New_count;
         _Order_key = _Split_order_regular_key(_Order_key);
-        _Full_iterator _Iterator = _Get_bucket(_Bucket);
-        _Full_iterator _Last = _M_split_ordered_list._End();
-        _Full_iterator _Where = _Iterator;
+        _Nodeptr _Head = _Get_bucket(_Bucket);
         _Nodeptr _New_node = _M_split_ordered_list._Buynode(_Order_key, std::forward<_ValTy>(_Value));
 
-        _ASSERT_EXPR(_Where != _Last, L"Invalid head node");
-
-        // First node is a dummy node
-        _Where++;
-
         for (;;)
         {
-            if (_Where == _Last || _Mylist::_Get_key(_Where) > _Order_key)
+            _Nodeptr _Previous;
+            _Nodeptr _Where = _M_split_ordered_list._Search(_Head, _Order_key, _Previous);
+
+            // Walk the nodes that share the order key, looking for a duplicate. The new node
+            // goes after all of them.
+            bool _Retry = false;
+            for (; _Where != NULL && _Mylist::_Get_key(_Where) == _Order_key; _Where = _Mylist::_Get_next(_Where))
             {
-                // Try to insert it in the right place
-                _Pairib _Result = _M_split_ordered_list._Insert(_Iterator, _Where, _New_node, &_New_count);
-                
-                if (_Result.second)
+                if (_Mylist::_Is_erased(_Where))
                 {
-                    // Insertion succeeded, adjust the table size, if needed
-                    _Adjust_table_size(_New_count, _M_number_of_buckets);
-                    return _Result;
+                    // The new node cannot be linked behind an erased one; unlink every erased
+                    // node with this order key and start over.
+                    _M_split_ordered_list._Search(_Head, _Order_key, _Previous, true);
+                    _Retry = true;
+                    break;
                 }
-                else
+
+                if (!_Traits::_M_allow_multimapping &&
+                    _M_comparator(_Key_function(_Mylist::_Myval(_Where)), _Key_function(_New_node->_M_element)) == 0)
                 {
-                    // Insertion failed: either the same node was inserted by another thread, or
-                    // another element was inserted at exactly the same place as this node.
-                    // Proceed with the search from the previous location where order key was
-                    // known to be larger (note: this is legal only because there is no safe
-                    // concurrent erase operation supported).
-                    _Where = _Iterator;
-                    _Where++;
-                    continue;
+                    // If the insert failed (element already there), then delete the new one
+                    _M_split_ordered_list._Erase(_New_node);
+
+                    // Element already in the list, return it
+                    return _Pairib(_M_split_ordered_list._Get_iterator(_Where), false);
                 }
+
+                _Previous = _Where;
             }
-            else if (!_M_allow_multimapping && _Mylist::_Get_key(_Where) == _Order_key && 
-                _M_comparator(_Key_function(*_Where), _Key_function(_New_node->_M_element)) == 0)
-            {
-                // If the insert failed (element already there), then delete the new one
-                _M_split_ordered_list._Erase(_New_node);
 
-                // Element already in the list, return it
-                return _Pairib(_M_split_ordered_list._Get_iterator(_Where), false);
+            // Try to insert it in the right place
+            if (!_Retry && _M_split_ordered_list._Insert(_Previous, _New_node, _Where, &_New_count))
+            {
+                // Insertion succeeded, adjust the table size, if needed
+                _Adjust_table_size(_New_count, _M_number_of_buckets);
+                return _Pairib(_M_split_ordered_list._Get_iterator(_New_node), true);
             }
 
-            // Move the iterator forward
-            _Iterator = _Where;
-            _Where++;
+            // Insertion failed: either the same node was inserted by another thread, another
+            // element was inserted at exactly the same place, or the predecessor was erased.
+            // Search again from the bucket's dummy node, which is never erased.
         }
     }
-    // Find the element in the split-ordered list
-    iterator _Find(const key_type& _Keyval)
-    {
-        _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Keyval);
-        size_type _Bucket = _Order_key % _M_number_of_buckets;
 
-        // If _Bucket is empty, initialize it first
-        if (!_Is_initialized(_Bucket))
-        {
-            _Initialize_bucket(_Bucket);
-        }
-
-        _Order_key = _Split_order_regular_key(_Order_key);
-        _Full_iterator _Last = _M_split_ordered_list._End();
-
-        for (_Full_iterator _Iterator = _Get_bucket(_Bucket); _Iterator != _Last; _Iterator++)
+    // Find the first live node with the given key, starting at the dummy node _Head. This
+    // only reads the list, so it never retries because of concurrent updates.
+    _Nodeptr _Find_node(_Nodeptr _Head, const key_type& _Keyval, _Split_order_key _Order_key) const
+    {
+        for (_Nodeptr _Pnode = _Head; _Pnode != NULL; _Pnode = _Mylist::_Get_next(_Pnode))
         {
-            if (_Mylist::_Get_key(_Iterator) > _Order_key)
+            if (_Mylist::_Get_key(_Pnode) > _Order_key)
             {
                 // If the order key is smaller than the current order key, the element
                 // is not in the hash.
-                return end();
+                return NULL;
             }
-            else if (_Mylist::_Get_key(_Iterator) == _Order_key)
+            else if (_Mylist::_Get_key(_Pnode) == _Order_key && !_Mylist::_Is_erased(_Pnode))
             {
                 // The fact that order keys match does not mean that the element is found.
                 // Key function comparison has to be performed to check whether this is the
                 // right element. If not, keep searching while order key is the same.
-                if (!_M_comparator(_Key_function(*_Iterator), _Keyval))
+                if (!_M_comparator(_Key_function(_Mylist::_Myval(_Pnode)), _Keyval))
                 {
-                    return _M_split_ordered_list._Get_iterator(_Iterator);
+                    return _Pnode;
                 }
             }
         }
 
-        return end();
+        return NULL;
+    }
+
+    // Find the element in the split-ordered list
+    iterator _Find(const key_type& _Keyval)
+    {
+        _Epoch_guard _Guard(_M_split_ordered_list);
+
+        _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Keyval);
+        size_type _Bucket = _Order_key % _M_number_of_buckets;
+
+        // If _Bucket is empty, initialize it first
+        if (!_Is_initialized(_Bucket))
+        {
+            _Initialize_bucket(_Bucket);
+        }
+
+        _Nodeptr _Pnode = _Find_node(_Get_bucket(_Bucket), _Keyval, _Split_order_regular_key(_Order_key));
+        return (_Pnode != NULL) ? _M_split_ordered_list._Get_iterator(_Pnode) : end();
     }
 
     // Find the element in the split-ordered list
     const_iterator _Find(const key_type& _Keyval) const
     {
+        _Epoch_guard _Guard(_M_split_ordered_list);
+
         _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Keyval);
         size_type _Bucket = _Order_key % _M_number_of_buckets;
 
@@ -1214,30 +1464,54 @@ private:
             _Bucket = _Get_parent(_Bucket);
         }
 
+        _Nodeptr _Pnode = _Find_node(_Get_bucket(_Bucket), _Keyval, _Split_order_regular_key(_Order_key));
+        return (_Pnode != NULL) ? _M_split_ordered_list._Get_iterator(_Pnode) : end();
+    }
+
+    // Erase one element with the given key. This is a concurrency safe function.
+    bool _Erase_one(const key_type& _Keyval)
+    {
+        _Epoch_guard _Guard(_M_split_ordered_list);
+
+        _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Keyval);
+        size_type _Bucket = _Order_key % _M_number_of_buckets;
+
+        // If bucket is empty, initialize it first
+        if (!_Is_initialized(_Bucket))
+        {
+            _Initialize_bucket(_Bucket);
+        }
+
         _Order_key = _Split_order_regular_key(_Order_key);
-        _Full_const_iterator _Last = _M_split_ordered_list._End();
+        _Nodeptr _Head = _Get_bucket(_Bucket);
 
-        for (_Full_const_iterator _Iterator = _Get_bucket(_Bucket); _Iterator != _Last; _Iterator++)
+        for (;;)
         {
-            if (_Mylist::_Get_key(_Iterator) > _Order_key)
-            {
-                // If the order key is smaller than the current order key, the element
-                // is not in the hash.
-                return end();
-            }
-            else if (_Mylist::_Get_key(_Iterator) == _Order_key)
+            _Nodeptr _Previous;
+            _Nodeptr _Where = _M_split_ordered_list._Search(_Head, _Order_key, _Previous);
+
+            for (; _Where != NULL && _Mylist::_Get_key(_Where) == _Order_key; _Where = _Mylist::_Get_next(_Where))
             {
-                // The fact that order keys match does not mean that the element is found.
-                // Key function comparison has to be performed to check whether this is the
-                // right element. If not, keep searching while order key is the same.
-                if (!_M_comparator(_Key_function(*_Iterator), _Keyval))
+                if (!_Mylist::_Is_erased(_Where) && !_M_comparator(_Key_function(_Mylist::_Myval(_Where)), _Keyval))
                 {
-                    return _M_split_ordered_list._Get_iterator(_Iterator);
+                    break;
                 }
+
+                _Previous = _Where;
+            }
+
+            if (_Where == NULL || _Mylist::_Get_key(_Where) != _Order_key)
+            {
+                return false;
             }
-        }
 
-        return end();
+            if (_M_split_ordered_list._Erase(_Head, _Previous, _Where))
+            {
+                return true;
+            }
+
+            // Another thread erased this element first; look for another one with the same key
+        }
     }
 
     // Erase an element from the list. This is not a concurrency safe function.
@@ -1253,31 +1527,26 @@ private:
             _Initialize_bucket(_Bucket);
         }
 
-        _Order_key = _Split_order_regular_key(_Order_key);
-
-        _Full_iterator _Previous = _Get_bucket(_Bucket);
-        _Full_iterator _Last = _M_split_ordered_list._End();
-        _Full_iterator _Where = _Previous;
-
-        _ASSERT_EXPR(_Where != _Last, L"Invalid head node");
+        _Nodeptr _Previous = _Get_bucket(_Bucket);
+        _Nodeptr _Where = _Mylist::_Get_next(_Previous);
 
-        // First node is a dummy node
-        _Where++;
+        _ASSERT_EXPR(_Previous != NULL, L"Invalid head node");
 
         for (;;)
         {
-            if (_Where == _Last)
+            if (_Where == NULL)
             {
                 return end();
             }
-            else if (_M_split_ordered_list._Get_iterator(_Where) == _Iterator)
+            else if (_Where == _Iterator._Mynode())
             {
-                return _M_split_ordered_list._Erase(_Previous, _Iterator);
+                _Nodeptr _Pnext = _M_split_ordered_list._Unsafe_erase(_Previous, _Where);
+                return _M_split_ordered_list._Get_first_real_iterator(_Pnext);
             }
 
             // Move the iterator forward
             _Previous = _Where;
-            _Where++;
+            _Where = _Mylist::_Get_next(_Where);
         }
     }
 
@@ -1285,6 +1554,8 @@ private:
     // This operation makes sense only if mapping is many-to-one.
     _Pairii _Equal_range(const key_type& _Keyval)
     {
+        _Epoch_guard _Guard(_M_split_ordered_list);
+
         _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Keyval);
         size_type _Bucket = _Order_key % _M_number_of_buckets;
 
@@ -1294,36 +1565,30 @@ private:
             _Initialize_bucket(_Bucket);
         }
 
-        _Order_key = _Split_order_regular_key(_Order_key);
-        _Full_iterator _Last = _M_split_ordered_list._End();
+        _Nodeptr _Pnode = _Find_node(_Get_bucket(_Bucket), _Keyval, _Split_order_regular_key(_Order_key));
 
-        for (_Full_iterator _Iterator = _Get_bucket(_Bucket); _Iterator != _Last; _Iterator++)
+        if (_Pnode == NULL)
         {
-            if (_Mylist::_Get_key(_Iterator) > _Order_key)
-            {
-                // There is no element with the given key
-                return _Pairii(end(), end());
-            }
-            else if (_Mylist::_Get_key(_Iterator) == _Order_key && !_M_comparator(_Key_function(*_Iterator), _Keyval))
-            {
-                iterator _Begin = _M_split_ordered_list._Get_iterator(_Iterator);
-                iterator _End= _Begin;
+            // There is no element with the given key
+            return _Pairii(end(), end());
+        }
 
-                for (;_End != end() && !_M_comparator(_Key_function(*_End), _Keyval); _End++)
-                {
-                }
+        iterator _Begin = _M_split_ordered_list._Get_iterator(_Pnode);
+        iterator _End = _Begin;
 
-                return _Pairii(_Begin, _End);
-            }
+        for (;_End != end() && !_M_comparator(_Key_function(*_End), _Keyval); _End++)
+        {
         }
 
-        return _Pairii(end(), end());
+        return _Pairii(_Begin, _End);
     }
 
     // Return the [begin, end) pair of const iterators with the same key values.
     // This operation makes sense only if mapping is many-to-one.
     _Paircc _Equal_range(const key_type& _Keyval) const
     {
+        _Epoch_guard _Guard(_M_split_ordered_list);
+
         _Split_order_key _Order_key = (_Split_order_key) _M_comparator(_Keyval);
         size_type _Bucket = _Order_key % _M_number_of_buckets;
 
@@ -1334,30 +1599,22 @@ private:
             _Bucket = _Get_parent(_Bucket);
         }
 
-        _Order_key = _Split_order_regular_key(_Order_key);
-        _Full_const_iterator _Last = _M_split_ordered_list._End();
+        _Nodeptr _Pnode = _Find_node(_Get_bucket(_Bucket), _Keyval, _Split_order_regular_key(_Order_key));
 
-        for (_Full_const_iterator _Iterator = _Get_bucket(_Bucket); _Iterator != _Last; _Iterator++)
+        if (_Pnode == NULL)
         {
-            if (_Mylist::_Get_key(_Iterator) > _Order_key)
-            {
-                // There is no element with the given key
-                return _Paircc(end(), end());
-            }
-            else if (_Mylist::_Get_key(_Iterator) == _Order_key && !_M_comparator(_Key_function(*_Iterator), _Keyval))
-            {
-                const_iterator _Begin = _M_split_ordered_list._Get_iterator(_Iterator);
-                const_iterator _End = _Begin;
+            // There is no element with the given key
+            return _Paircc(end(), end());
+        }
 
-                for (; _End != end() && !_M_comparator(_Key_function(*_End), _Keyval); _End++)
-                {
-                }
+        const_iterator _Begin = _M_split_ordered_list._Get_iterator(_Pnode);
+        const_iterator _End = _Begin;
 
-                return _Paircc(_Begin, _End);
-            }
+        for (; _End != end() && !_M_comparator(_Key_function(*_End), _Keyval); _End++)
+        {
         }
 
-        return _Paircc(end(), end());
+        return _Paircc(_Begin, _End);
     }
 
     // Bucket APIs
@@ -1378,20 +1635,200 @@ private:
             _Initialize_bucket(_Parent_bucket);
         }
 
-        _Full_iterator _Parent = _Get_bucket(_Parent_bucket);
+        _Nodeptr _Parent = _Get_bucket(_Parent_bucket);
 
         // Create a dummy first node in this bucket
-        _Full_iterator _Dummy_node = _M_split_ordered_list._Insert_dummy(_Parent, _Split_order_dummy_key(_Bucket));
+        _Nodeptr _Dummy_node = _M_split_ordered_list._Insert_dummy(_Parent, _Split_order_dummy_key(_Bucket));
         _Set_bucket(_Bucket, _Dummy_node);
     }
 
+    // A new node waiting to be linked by _Unsafe_bulk_insert, with the key it is sorted by
+    struct _Bulk_entry
+    {
+        _Split_order_key _M_order_key;
+        _Nodeptr         _M_node;
+    };
+
+    struct _Bulk_entry_key
+    {
+        size_t operator()(const _Bulk_entry& _Entry) const
+        {
+            return _Entry._M_order_key;
+        }
+    };
+
+    template<class _Iterator>
+    void _Unsafe_bulk_insert(_Iterator _First, _Iterator _Last, std::input_iterator_tag)
+    {
+        std::vector<_Bulk_entry> _Entries;
+
+        try
+        {
+            for (; _First != _Last; ++_First)
+            {
+                _Bulk_entry _Entry;
+                _Entry._M_order_key = _Split_order_regular_key((_Split_order_key) _M_comparator(_Key_function(*_First)));
+                _Entry._M_node = NULL;
+                _Entries.push_back(_Entry);
+                _Entries.back()._M_node = _M_split_ordered_list._Buynode(_Entries.back()._M_order_key, *_First);
+            }
+        }
+        catch(...)
+        {
+            _Free_bulk_entries(_Entries);
+            throw;
+        }
+
+        _Bulk_link(_Entries, _Entries.size());
+    }
+
+    template<class _Iterator>
+    void _Unsafe_bulk_insert(_Iterator _First, _Iterator _Last, std::random_access_iterator_tag)
+    {
+        size_type _Count = (size_type) (_Last - _First);
+        std::vector<_Bulk_entry> _Entries(_Count);
+
+        try
+        {
+            // Hashing and constructing the elements dominates for large ranges, so do it in parallel
+            parallel_for(size_type(0), _Count, [&](size_type _Index) {
+                _Bulk_entry& _Entry = _Entries[_Index];
+                _Entry._M_order_key = _Split_order_regular_key((_Split_order_key) _M_comparator(_Key_function(_First[_Index])));
+                _Entry._M_node = _M_split_ordered_list._Buynode(_Entry._M_order_key, _First[_Index]);
+            });
+        }
+        catch(...)
+        {
+            _Free_bulk_entries(_Entries);
+            throw;
+        }
+
+        _Bulk_link(_Entries, _Count);
+    }
+
+    // Size the table for _Count more elements, add the dummy nodes for the buckets that do not
+    // exist yet, sort everything into split order and merge it into the list in one pass.
+    // Takes ownership of the nodes in _Entries.
+    void _Bulk_link(std::vector<_Bulk_entry>& _Entries, size_type _Count)
+    {
+        if (_Count == 0)
+        {
+            return;
+        }
+
+        size_type _Total_elements = size() + _Count;
+        size_type _Buckets = _M_number_of_buckets;
+        while (_Buckets < unsafe_max_bucket_count() && ((float) _Total_elements / (float) _Buckets) > _M_maximum_bucket_size)
+        {
+            _Buckets *= 2;
+        }
+
+        try
+        {
+            // Entries for the buckets that already have a dummy node are left empty
+            _Entries.resize(_Count + _Buckets);
+            parallel_for(size_type(0), _Buckets, [&](size_type _Bucket) {
+                _Bulk_entry& _Entry = _Entries[_Count + _Bucket];
+                _Entry._M_order_key = _Split_order_dummy_key(_Bucket);
+                _Entry._M_node = _Is_initialized(_Bucket) ? NULL : _M_split_ordered_list._Buynode(_Entry._M_order_key);
+            });
+
+            _Bulk_sort(_Entries, _Bulk_entry_key());
+        }
+        catch(...)
+        {
+            _Free_bulk_entries(_Entries);
+            throw;
+        }
+
+        _M_number_of_buckets = _Buckets;
+
+        // Merge the sorted entries into the list. _Run_start is the last node ordered before the
+        // current order key; a new node goes after every node that shares its order key.
+        _Nodeptr _Previous = _M_split_ordered_list._Begin();
+        _Nodeptr _Run_start = _Previous;
+        size_type _Linked = 0;
+
+        for (size_type _Index = 0; _Index < _Entries.size(); _Index++)
+        {
+            _Split_order_key _Order_key = _Entries[_Index]._M_order_key;
+            _Nodeptr _New_node = _Entries[_Index]._M_node;
+            _Nodeptr _Next;
+
+            if (_New_node == NULL)
+            {
+                continue;
+            }
+
+            if (_Order_key != _Mylist::_Get_key(_Previous))
+            {
+                while ((_Next = _M_split_ordered_list._Unsafe_next_live(_Previous)) != NULL && _Mylist::_Get_key(_Next) < _Order_key)
+                {
+                    _Previous = _Next;
+                }
+
+                _Run_start = _Previous;
+            }
+            else
+            {
+                _Previous = _Run_start;
+            }
+
+            bool _Duplicate = false;
+            while ((_Next = _M_split_ordered_list._Unsafe_next_live(_Previous)) != NULL && _Mylist::_Get_key(_Next) == _Order_key)
+            {
+                if (!_Traits::_M_allow_multimapping && !_New_node->_Is_dummy() &&
+                    _M_comparator(_Key_function(_Mylist::_Myval(_Next)), _Key_function(_New_node->_M_element)) == 0)
+                {
+                    _Duplicate = true;
+                    break;
+                }
+
+                _Previous = _Next;
+            }
+
+            if (_Duplicate)
+            {
+                _M_split_ordered_list._Erase(_New_node);
+                continue;
+            }
+
+            _M_split_ordered_list._Unsafe_link(_Previous, _New_node);
+            _Previous = _New_node;
+
+            if (_New_node->_Is_dummy())
+            {
+                _Set_bucket(_Reverse(_Order_key), _New_node);
+            }
+            else
+            {
+                _Linked++;
+            }
+        }
+
+        _M_split_ordered_list._Unsafe_add_count(_Linked);
+    }
+
+    void _Free_bulk_entries(std::vector<_Bulk_entry>& _Entries)
+    {
+        for (size_type _Index = 0; _Index < _Entries.size(); _Index++)
+        {
+            if (_Entries[_Index]._M_node != NULL)
+            {
+                _M_split_ordered_list._Erase(_Entries[_Index]._M_node);
+            }
+        }
+    }
+
+    // _Total_elements is the approximate count returned by the list's insert, which is close
+    // enough to decide on growth without summing the count stripes.
     void _Adjust_table_size(size_type _Total_elements, size_type _Current_size)
     {
         // Grow the table by a factor of 2 if possible and needed
         if (((float) _Total_elements / (float) _Current_size) > _M_maximum_bucket_size)
         {
              // Double the size of the hash only if size has not changed inbetween loads
-            _InterlockedCompareExchangeSizeT(&_M_number_of_buckets, 2 * _Current_size, _Current_size);
+            _Atomic_compare_exchange_size_t(&_M_number_of_buckets, 2 * _Current_size, _Current_size);
         }
     }
 
@@ -1399,20 +1836,20 @@ private:
     {
         // Unsets bucket's most significant turned-on bit
         unsigned char _Msb = _Get_msb(_Bucket);
-        return _Bucket & ~(1 << _Msb);
+        return _Bucket & ~(size_type(1) << _Msb);
     }
 
 
     // Dynamic sized array (segments)
 
-    _Full_iterator _Get_bucket(size_type _Bucket) const
+    _Nodeptr _Get_bucket(size_type _Bucket) const
     {
         size_type _Segment = _Segment_index_of(_Bucket);
         _Bucket -= _Segment_base(_Segment);
         return _M_buckets[_Segment][_Bucket];
     }
 
-    void _Set_bucket(size_type _Bucket, _Full_iterator _Dummy_head)
+    void _Set_bucket(size_type _Bucket, _Nodeptr _Dummy_head)
     {
         size_type _Segment = _Segment_index_of(_Bucket);
         _Bucket -= _Segment_base(_Segment);
@@ -1420,9 +1857,12 @@ private:
         if (_M_buckets[_Segment] == NULL)
         {
             size_type _Seg_size = _Segment_size(_Segment);
-            _Full_iterator * _New_segment = _M_allocator.allocate(_Seg_size);
-            _Uninitialized_default_fill_n(_New_segment, _Seg_size, (_Full_iterator *) 0, _M_allocator);
-            if (_InterlockedCompareExchangePointer((void * volatile *) &_M_buckets[_Segment], _New_segment, NULL) != NULL)
+            _Nodeptr * _New_segment = _M_allocator.allocate(_Seg_size);
+            for (size_type _Index = 0; _Index < _Seg_size; _Index++)
+            {
+                _M_allocator.construct(&_New_segment[_Index], (_Nodeptr) NULL);
+            }
+            if (_Atomic_compare_exchange_pointer((void * volatile *) &_M_buckets[_Segment], _New_segment, NULL) != NULL)
             {
                 _M_allocator.deallocate(_New_segment, _Seg_size);
             }
@@ -1440,8 +1880,7 @@ private:
             return false;
         }
 
-        _Full_iterator _Iterator = _M_buckets[_Segment][_Bucket];
-        return (_Iterator._Mynode() != NULL);
+        return (_M_buckets[_Segment][_Bucket] != NULL);
     }
 
     // Utilities for keys
@@ -1475,14 +1914,16 @@ private:
     }
 
     // Shared variables
-    _Full_iterator *                                                _M_buckets[_Pointers_per_table]; // The segment table
-    _Mylist                                                         _M_split_ordered_list;           // List where all the elements are kept
-    typename allocator_type::template rebind<_Full_iterator>::other _M_allocator;                    // Allocator object for segments
-    size_type                                                       _M_number_of_buckets;            // Current table size
-    float                                                           _M_maximum_bucket_size;          // Maximum size of the bucket
+    _Nodeptr *                                                _M_buckets[_Pointers_per_table]; // The segment table
+    _Mylist                                                   _M_split_ordered_list;           // List where all the elements are kept
+    typename allocator_type::template rebind<_Nodeptr>::other _M_allocator;                    // Allocator object for segments
+    size_type                                                 _M_number_of_buckets;            // Current table size
+    float                                                     _M_maximum_bucket_size;          // Maximum size of the bucket
 };
 
+#if defined(_MSC_VER)
 #pragma warning(pop) // warning 4127 -- while (true) has a constant expression in it
+#endif
 
 } // namespace details;
 } // namespace samples;
@@ -2,7 +2,7 @@
 * ==++==
 *
 * Copyright (c) Microsoft Corporation.  All rights reserved.
-* 
+*
 * ==--==
 * =+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+=+
 *
@@ -12,9 +12,24 @@
 ****/
 #pragma once
 
-// Needed for forward iterators
-#include <forward_list>
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include "internal_atomics.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
 #include <concrt.h>
+#else
+#include <thread>
+#endif
+
+#if !defined(_ASSERT_EXPR)
+#define _ASSERT_EXPR(_Expr, _Msg) assert(_Expr)
+#endif
 
 namespace Concurrency
 {
@@ -22,13 +37,12 @@ namespace samples
 {
 namespace details
 {
-// Split-order list iterators, needed to skip dummy elements
+// Split-order list iterators, needed to skip dummy and erased elements
 template<class _Mylist>
-class _Solist_const_iterator : public std::_Flist_const_iterator<_Mylist>
+class _Solist_const_iterator
 {
 public:
     typedef _Solist_const_iterator<_Mylist> _Myiter;
-    typedef std::_Flist_const_iterator<_Mylist> _Mybase;
     typedef std::forward_iterator_tag iterator_category;
 
     typedef typename _Mylist::_Nodeptr _Nodeptr;
@@ -37,30 +51,17 @@ public:
     typedef typename _Mylist::const_pointer pointer;
     typedef typename _Mylist::const_reference reference;
 
-    _Solist_const_iterator()
+    _Solist_const_iterator() : _M_ptr(NULL), _M_plist(NULL)
     {
     }
 
-    _Solist_const_iterator(_Nodeptr _Pnode, const _Mylist * _Plist) : _Mybase(_Pnode, _Plist)
+    _Solist_const_iterator(_Nodeptr _Pnode, const _Mylist * _Plist) : _M_ptr(_Pnode), _M_plist(_Plist)
     {
     }
 
-    typedef _Solist_const_iterator<_Mylist> _Unchecked_type;
-
-    _Myiter& _Rechecked(_Unchecked_type _Right)
-    {
-        _Ptr = _Right._Ptr;
-        return (*this);
-    }
-
-    _Unchecked_type _Unchecked() const
-    {
-        return (_Unchecked_type(_Ptr, (_Mylist *)_Getcont()));
-    }
-
     reference operator*() const
     {
-        return ((reference)**(_Mybase *)this);
+        return ((reference)_Mylist::_Myval(_M_ptr));
     }
 
     pointer operator->() const
@@ -72,9 +73,9 @@ public:
     {
         do
         {
-            ++(*(_Mybase *)this);
+            _M_ptr = _Mylist::_Get_next(_M_ptr);
         }
-        while (_Mynode() != NULL && _Mynode()->_Is_dummy());
+        while (_M_ptr != NULL && (_M_ptr->_Is_dummy() || _Mylist::_Is_erased(_M_ptr)));
 
         return (*this);
     }
@@ -82,28 +83,29 @@ public:
     _Myiter operator++(int)
     {
         _Myiter _Tmp = *this;
-        do
-        {
-            ++*this;
-        }
-        while (_Mynode() != NULL && _Mynode()->_Is_dummy());
-
+        ++*this;
         return (_Tmp);
     }
-};
 
-template<class _Mylist> inline
-typename _Solist_const_iterator<_Mylist>::_Unchecked_type _Unchecked(_Solist_const_iterator<_Mylist> _Iterator)
-{
-    return (_Iterator._Unchecked());
-}
+    bool operator==(const _Myiter& _Right) const
+    {
+        return (_M_ptr == _Right._M_ptr);
+    }
 
-template<class _Mylist> inline
-_Solist_const_iterator<_Mylist>& _Rechecked(_Solist_const_iterator<_Mylist>& _Iterator,
-    typename _Solist_const_iterator<_Mylist>::_Unchecked_type _Right)
-{
-    return (_Iterator._Rechecked(_Right));
-}
+    bool operator!=(const _Myiter& _Right) const
+    {
+        return (!(*this == _Right));
+    }
+
+    _Nodeptr _Mynode() const
+    {
+        return (_M_ptr);
+    }
+
+protected:
+    _Nodeptr        _M_ptr;   // Current node
+    const _Mylist * _M_plist; // Owning list
+};
 
 template<class _Mylist>
 class _Solist_iterator : public _Solist_const_iterator<_Mylist>
@@ -127,22 +129,59 @@ public:
     {
     }
 
-    typedef _Solist_iterator<_Mylist> _Unchecked_type;
+    reference operator*() const
+    {
+        return ((reference)**(_Mybase *)this);
+    }
 
-    _Myiter& _Rechecked(_Unchecked_type _Right)
+    pointer operator->() const
     {
-        _Ptr = _Right._Ptr;
+        return (&**this);
+    }
+
+    _Myiter& operator++()
+    {
+        ++(*(_Mybase *)this);
         return (*this);
     }
 
-    _Unchecked_type _Unchecked() const
+    _Myiter operator++(int)
+    {
+        _Myiter _Tmp = *this;
+        ++*this;
+        return (_Tmp);
+    }
+};
+
+// Iterator over the part of a split-order list that ends at a limit node, used by the ranges that
+// split a hash table for parallel traversal. The limit is a dummy node, which the list iterators
+// would step over; this iterator stops at it instead.
+template<class _Mylist, bool _Is_const>
+class _Solist_range_iterator
+{
+public:
+    typedef _Solist_range_iterator<_Mylist, _Is_const> _Myiter;
+    typedef std::forward_iterator_tag iterator_category;
+
+    typedef typename _Mylist::_Nodeptr _Nodeptr;
+    typedef typename _Mylist::value_type value_type;
+    typedef typename _Mylist::difference_type difference_type;
+    typedef typename std::conditional<_Is_const, typename _Mylist::const_pointer, typename _Mylist::pointer>::type pointer;
+    typedef typename std::conditional<_Is_const, typename _Mylist::const_reference, typename _Mylist::reference>::type reference;
+
+    _Solist_range_iterator() : _M_ptr(NULL), _M_limit(NULL)
     {
-        return (_Unchecked_type(_Ptr, (_Mylist *)_Getcont()));
+    }
+
+    // Positions the iterator at the first live, non-dummy node at or after _Pnode, or at _Limit
+    _Solist_range_iterator(_Nodeptr _Pnode, _Nodeptr _Limit) : _M_ptr(_Pnode), _M_limit(_Limit)
+    {
+        _Skip();
     }
 
     reference operator*() const
     {
-        return ((reference)**(_Mybase *)this);
+        return ((reference)_Mylist::_Myval(_M_ptr));
     }
 
     pointer operator->() const
@@ -152,58 +191,59 @@ public:
 
     _Myiter& operator++()
     {
-        do
-        {
-            ++(*(_Mybase *)this);
-        }
-        while (_Mynode() != NULL && _Mynode()->_Is_dummy());
-
+        _M_ptr = _Mylist::_Get_next(_M_ptr);
+        _Skip();
         return (*this);
     }
 
     _Myiter operator++(int)
     {
         _Myiter _Tmp = *this;
-        do
-        {
-            ++*this;
-        }
-        while (_Mynode() != NULL && _Mynode()->_Is_dummy());
-
+        ++*this;
         return (_Tmp);
     }
-};
 
-template<class _Mylist> inline
-typename _Solist_iterator<_Mylist>::_Unchecked_type _Unchecked(_Solist_iterator<_Mylist> _Iterator)
-{
-    return (_Iterator._Unchecked());
-}
+    bool operator==(const _Myiter& _Right) const
+    {
+        return (_M_ptr == _Right._M_ptr);
+    }
 
-template<class _Mylist> inline
-_Solist_iterator<_Mylist>& _Rechecked(_Solist_iterator<_Mylist>& _Iterator,
-    typename _Solist_iterator<_Mylist>::_Unchecked_type _Right)
-{
-    return (_Iterator._Rechecked(_Right));
-}
+    bool operator!=(const _Myiter& _Right) const
+    {
+        return (!(*this == _Right));
+    }
+
+private:
+    void _Skip()
+    {
+        while (_M_ptr != _M_limit && _M_ptr != NULL && (_M_ptr->_Is_dummy() || _Mylist::_Is_erased(_M_ptr)))
+        {
+            _M_ptr = _Mylist::_Get_next(_M_ptr);
+        }
+    }
+
+    _Nodeptr _M_ptr;   // Current node
+    _Nodeptr _M_limit; // First node past the end of the range
+};
 
 // Forward type and class definitions
 typedef size_t _Map_key;
 typedef _Map_key _Split_order_key;
 
-template<typename _Element_type, typename _Allocator_type>
-class _Split_order_list_node : public std::_Container_base
+template<typename _Element_type, typename _Element_allocator_type>
+class _Split_order_list_node
 {
 public:
-    typedef typename _Allocator_type::template rebind<_Element_type>::other _Allocator_type;
+    typedef typename _Element_allocator_type::template rebind<_Element_type>::other _Allocator_type;
     typedef typename _Allocator_type::size_type size_type;
-    typedef typename _Element_type value_type;
+    typedef _Element_type value_type;
 
     struct _Node;
     typedef _Node * _Nodeptr;
     typedef _Nodeptr& _Nodepref;
 
-    // Node that holds the element in a split-ordered list
+    // Node that holds the element in a split-ordered list. The low bit of the next
+    // pointer marks the node itself as logically erased.
     struct _Node
     {
         // Initialize the node with the given order key
@@ -211,6 +251,7 @@ public:
         {
             _M_order_key = _Order_key;
             _M_next = NULL;
+            _M_retired_next = NULL;
         }
 
         // Return the order key (needed for hashing)
@@ -219,22 +260,11 @@ public:
             return _M_order_key;
         }
 
-        // Inserts the new element in the list in an atomic fashion
+        // Change the next pointer, only if it still points to _Current_node. Returns the
+        // value the next pointer held, i.e. _Current_node on success.
         _Nodeptr _Atomic_set_next(_Nodeptr _New_node, _Nodeptr _Current_node)
         {
-            // Try to change the next pointer on the current element to a new element, only if it still points to the cached next
-            _Nodeptr _Exchange_node = (_Nodeptr) _InterlockedCompareExchangePointer((void * volatile *) &_M_next, _New_node, _Current_node);
-
-            if (_Exchange_node == _Current_node)
-            {
-                // Operation succeeded, return the new node
-                return _New_node;
-            }
-            else
-            {
-                // Operation failed, return the "interfering" node
-                return _Exchange_node;
-            }
+            return (_Nodeptr) _Atomic_compare_exchange_pointer((void * volatile *) &_M_next, _New_node, _Current_node);
         }
 
         // Checks if this element in the list is a dummy, order enforcing node. Dummy nodes are used by buckets
@@ -244,47 +274,29 @@ public:
             return (_M_order_key & 0x1) == 0;
         }
 
-        _Nodeptr         _M_next;      // Next element in the list
-        value_type       _M_element;   // Element storage
-        _Split_order_key _M_order_key; // Order key for this element
+        _Nodeptr volatile _M_next;         // Next element in the list, low bit set once this node is erased
+        value_type        _M_element;      // Element storage
+        _Split_order_key  _M_order_key;    // Order key for this element
+        _Nodeptr          _M_retired_next; // Next node waiting to be reclaimed, once unlinked
     };
 
-#if _ITERATOR_DEBUG_LEVEL == 0 /*IFSTRIP=IGN*/ 
-    _Split_order_list_node(_Allocator_type _Allocator) : _M_node_allocator(_Allocator), _M_value_allocator(_Allocator)
-    {
-    }
-#else /* _ITERATOR_DEBUG_LEVEL == 0 */
     _Split_order_list_node(_Allocator_type _Allocator) : _M_node_allocator(_Allocator), _M_value_allocator(_Allocator)
     {
-        typename _Allocator_type::template rebind<std::_Container_proxy>::other _Alproxy(_M_node_allocator);
-        _Myproxy = _Alproxy.allocate(1);
-        _Cons_val(_Alproxy, _Myproxy, std::_Container_proxy());
-        _Myproxy->_Mycont = this;
-    }
-
-    ~_Split_order_list_node()
-    {
-        typename _Allocator_type::template rebind<std::_Container_proxy>::other _Alproxy(_M_node_allocator);
-        _Orphan_all();
-        _Dest_val(_Alproxy, _Myproxy);
-        _Alproxy.deallocate(_Myproxy, 1);
-        _Myproxy = 0;
     }
-#endif /* _ITERATOR_DEBUG_LEVEL == 0 */
 
     _Nodeptr                                                _Myhead;            // pointer to head node
     typename _Allocator_type::template rebind<_Node>::other _M_node_allocator;  // allocator object for nodes
     _Allocator_type                                         _M_value_allocator; // allocator object for element values
 };
 
-template<typename _Element_type, typename _Allocator_type>
-class _Split_order_list_value : public _Split_order_list_node<_Element_type, _Allocator_type>
+template<typename _Element_type, typename _Element_allocator_type>
+class _Split_order_list_value : public _Split_order_list_node<_Element_type, _Element_allocator_type>
 {
 public:
-    typedef _Split_order_list_node<_Element_type, _Allocator_type> _Mybase;
+    typedef _Split_order_list_node<_Element_type, _Element_allocator_type> _Mybase;
     typedef typename _Mybase::_Nodeptr _Nodeptr;
     typedef typename _Mybase::_Nodepref _Nodepref;
-    typedef typename _Allocator_type::template rebind<_Element_type>::other _Allocator_type;
+    typedef typename _Mybase::_Allocator_type _Allocator_type;
 
     typedef typename _Allocator_type::size_type size_type;
     typedef typename _Allocator_type::difference_type difference_type;
@@ -294,6 +306,10 @@ public:
     typedef typename _Allocator_type::const_reference const_reference;
     typedef typename _Allocator_type::value_type value_type;
 
+    using _Mybase::_Myhead;
+    using _Mybase::_M_node_allocator;
+    using _Mybase::_M_value_allocator;
+
     _Split_order_list_value(_Allocator_type _Allocator = _Allocator_type()) : _Mybase(_Allocator)
     {
         // Immediately allocate a dummy node with order key of 0. This node
@@ -334,10 +350,22 @@ public:
         return (_Pnode);
     }
 
-    // Get the next node
-    static _Nodepref _Nextnode(_Nodeptr _Pnode)
+    // Checks whether the node has been logically erased
+    static bool _Is_erased(_Nodeptr _Pnode)
+    {
+        return (((size_t) _Pnode->_M_next) & 0x1) != 0;
+    }
+
+    // Get the next node, whether or not this node has been erased
+    static _Nodeptr _Get_next(_Nodeptr _Pnode)
     {
-        return ((_Nodepref)(*_Pnode)._M_next);
+        return ((_Nodeptr)(((size_t) _Pnode->_M_next) & ~(size_t) 0x1));
+    }
+
+    // Get the order key of a node
+    static _Split_order_key _Get_key(_Nodeptr _Pnode)
+    {
+        return _Pnode->_Get_order_key();
     }
 
     // Get the stored value
@@ -347,7 +375,432 @@ public:
     }
 };
 
-// Forward list in which elements are sorted in a split-order
+// Identifies a thread to the epoch records it has claimed. Every record owned by the
+// thread holds a reference, so the token outlives the thread as long as some domain still
+// has a record claimed by it; _M_alive is cleared when the thread exits, which frees
+// those records for other threads.
+struct _Epoch_thread_token
+{
+    volatile long _M_references;
+    volatile long _M_alive;
+};
+
+// A thread's epoch record in one epoch domain, padded to a cache line. Only the
+// owner writes the state: 0 while it is outside the domain, otherwise the epoch its
+// outermost operation started in, shifted left, with the low bit set.
+struct _Epoch_record
+{
+    volatile long                  _M_state;
+    long                           _M_depth;    // Nesting of the owner's operations
+    _Epoch_thread_token * volatile _M_owner;
+    _Epoch_record *                _M_next;
+    char                           _M_pad[64 - 2 * sizeof(long) - 2 * sizeof(void *)];
+};
+
+inline void _Release_epoch_thread_token(_Epoch_thread_token * _Token)
+{
+    if (_Atomic_decrement(&_Token->_M_references) == 0)
+    {
+        delete _Token;
+    }
+}
+
+// Returns a new identifier for an epoch domain, never 0 and never reused
+inline size_t _Next_epoch_domain_id()
+{
+    static volatile size_t _S_last_id = 0;
+
+    for (;;)
+    {
+        size_t _Id = _S_last_id;
+        if (_Atomic_compare_exchange_size_t(&_S_last_id, _Id + 1, _Id) == _Id)
+        {
+            return _Id + 1;
+        }
+    }
+}
+
+// Returns a new index for a thread, assigned in order of first use
+inline size_t _Next_epoch_thread_index()
+{
+    static volatile long _S_last_index = 0;
+    return (size_t) (unsigned long) _Atomic_increment(&_S_last_index);
+}
+
+// The calling thread's token and a small direct-mapped cache of the records it owns,
+// indexed by domain identifier. An entry that gets evicted only costs a search of that
+// domain's records on the next operation; the record stays owned.
+class _Epoch_thread
+{
+public:
+    static const size_t _Cache_size = 8;
+
+    struct _Cache_entry
+    {
+        size_t          _M_domain_id;
+        _Epoch_record * _M_record;
+    };
+
+    _Epoch_thread() : _M_index(_Next_epoch_thread_index())
+    {
+        _M_token = new _Epoch_thread_token;
+        _M_token->_M_references = 1;
+        _M_token->_M_alive = 1;
+
+        for (size_t _Index = 0; _Index < _Cache_size; _Index++)
+        {
+            _M_cache[_Index]._M_domain_id = 0;
+            _M_cache[_Index]._M_record = NULL;
+        }
+    }
+
+    ~_Epoch_thread()
+    {
+        _Atomic_store_release(&_M_token->_M_alive, 0);
+        _Release_epoch_thread_token(_M_token);
+    }
+
+    static _Epoch_thread& _Current()
+    {
+        static thread_local _Epoch_thread _S_thread;
+        return _S_thread;
+    }
+
+    const size_t          _M_index;    // Spreads per-thread data, such as counter stripes
+    _Epoch_thread_token * _M_token;
+    _Cache_entry          _M_cache[_Cache_size];
+
+private:
+    _Epoch_thread(const _Epoch_thread&);
+    _Epoch_thread& operator=(const _Epoch_thread&);
+};
+
+// The reclamation epoch of one concurrent data structure and the epoch records of the
+// threads using it. Every concurrency-safe operation runs inside a _Guard, which publishes
+// the epoch the operation started in to the calling thread's record; a thread claims its
+// record in a domain once and then only stores to it. The epoch advances only when every
+// operation in progress has observed the current one, so whatever was unlinked before the
+// epoch moved from N to N + 1 cannot be reached by any operation once it reaches N + 2.
+// The data structure keeps its own retired lists, one per epoch, and frees the oldest one
+// while advancing the epoch.
+class _Epoch_domain
+{
+public:
+    // Objects retired in epoch N are freed when the epoch advances to N + 2
+    static const size_t _Epoch_count = 3;
+
+    // Scoped registration of a concurrency-safe operation with the epoch. Objects reachable
+    // when the guard is constructed stay allocated until it is destroyed.
+    class _Guard
+    {
+    public:
+        explicit _Guard(const _Epoch_domain& _Domain) : _M_record(_Domain._Enter())
+        {
+        }
+
+        ~_Guard()
+        {
+            _Leave(_M_record);
+        }
+
+    private:
+        _Guard(const _Guard&);
+        _Guard& operator=(const _Guard&);
+
+        _Epoch_record * _M_record;
+    };
+
+    _Epoch_domain() : _M_id(_Next_epoch_domain_id()), _M_records(NULL), _M_claiming(0), _M_epoch(0), _M_advancing(0)
+    {
+    }
+
+    ~_Epoch_domain()
+    {
+        _Epoch_record * _Record = _M_records;
+        while (_Record != NULL)
+        {
+            _Epoch_record * _Next = _Record->_M_next;
+            if (_Record->_M_owner != NULL)
+            {
+                _Release_epoch_thread_token(_Record->_M_owner);
+            }
+
+            delete _Record;
+            _Record = _Next;
+        }
+    }
+
+    long _Current() const
+    {
+        return _M_epoch;
+    }
+
+    // Start advancing the epoch. Returns false if another thread is already advancing it, or
+    // if some operation in progress has not observed the current epoch yet. Otherwise sets
+    // _Oldest to the index of the retired list whose objects can no longer be reached; the
+    // caller detaches that list and then calls _End_advance.
+    bool _Begin_advance(size_t& _Oldest)
+    {
+        if (_Atomic_compare_exchange(&_M_advancing, 1, 0) != 0)
+        {
+            return false;
+        }
+
+        long _Epoch = _M_epoch;
+        long _Current_state = (_Epoch << 1) | 1;
+
+        for (_Epoch_record * _Record = _M_records; _Record != NULL; _Record = _Record->_M_next)
+        {
+            long _State = _Atomic_load_acquire(&_Record->_M_state);
+            if (_State != 0 && _State != _Current_state)
+            {
+                _Atomic_exchange(&_M_advancing, 0);
+                return false;
+            }
+        }
+
+        _Oldest = (_Epoch + 1) % _Epoch_count;
+        return true;
+    }
+
+    // Publish the next epoch after a successful _Begin_advance
+    void _End_advance()
+    {
+        _Atomic_exchange(&_M_epoch, _M_epoch + 1);
+        _Atomic_exchange(&_M_advancing, 0);
+    }
+
+private:
+    _Epoch_domain(const _Epoch_domain&);
+    _Epoch_domain& operator=(const _Epoch_domain&);
+
+    // Publish the current epoch in the calling thread's record. Nested operations of the
+    // same thread keep the epoch of the outermost one.
+    _Epoch_record * _Enter() const
+    {
+        _Epoch_thread& _Thread = _Epoch_thread::_Current();
+        _Epoch_thread::_Cache_entry& _Entry = _Thread._M_cache[_M_id & (_Epoch_thread::_Cache_size - 1)];
+
+        if (_Entry._M_domain_id != _M_id)
+        {
+            _Entry._M_record = _Claim_record(_Thread._M_token);
+            _Entry._M_domain_id = _M_id;
+        }
+
+        _Epoch_record * _Record = _Entry._M_record;
+        if (_Record->_M_depth++ == 0)
+        {
+            // The record must be visible to _Begin_advance before anything is read
+            _Atomic_store_fence(&_Record->_M_state, (_M_epoch << 1) | 1);
+        }
+
+        return _Record;
+    }
+
+    static void _Leave(_Epoch_record * _Record)
+    {
+        if (--_Record->_M_depth == 0)
+        {
+            _Atomic_store_release(&_Record->_M_state, 0);
+        }
+    }
+
+    // Find the record the thread already owns in this domain, or claim one left behind by
+    // an exited thread, or add a new one. Claims are serialized by _M_claiming; they only
+    // happen the first time a thread uses the domain or after its cache entry was evicted.
+    _Epoch_record * _Claim_record(_Epoch_thread_token * _Token) const
+    {
+        while (_Atomic_compare_exchange(&_M_claiming, 1, 0) != 0)
+        {
+            _Atomic_yield();
+        }
+
+        _Epoch_record * _Claimed = NULL;
+        _Epoch_record * _Free = NULL;
+
+        for (_Epoch_record * _Record = _M_records; _Record != NULL; _Record = _Record->_M_next)
+        {
+            _Epoch_thread_token * _Owner = _Record->_M_owner;
+            if (_Owner == _Token)
+            {
+                _Claimed = _Record;
+                break;
+            }
+
+            // Owners only change under _M_claiming, and each record holds a reference on
+            // its owner, so the token can be read here
+            if (_Free == NULL && _Atomic_load_acquire(&_Owner->_M_alive) == 0)
+            {
+                _Free = _Record;
+            }
+        }
+
+        if (_Claimed == NULL)
+        {
+            _Atomic_increment(&_Token->_M_references);
+
+            if (_Free != NULL)
+            {
+                _Epoch_thread_token * _Previous_owner = _Free->_M_owner;
+                _Free->_M_owner = _Token;
+                _Release_epoch_thread_token(_Previous_owner);
+                _Claimed = _Free;
+            }
+            else
+            {
+                _Claimed = new _Epoch_record;
+                _Claimed->_M_state = 0;
+                _Claimed->_M_depth = 0;
+                _Claimed->_M_owner = _Token;
+                _Claimed->_M_next = _M_records;
+
+                // Publish the initialized record to _Begin_advance
+                _Atomic_compare_exchange_pointer((void * volatile *) &_M_records, _Claimed, _Claimed->_M_next);
+            }
+        }
+
+        _Atomic_store_release(&_M_claiming, 0);
+        return _Claimed;
+    }
+
+    const size_t          _M_id;               // Identifies the domain in the threads' record caches
+    mutable _Epoch_record * volatile _M_records; // Every thread's epoch record, never shrinks
+    mutable volatile long _M_claiming;         // Set while a thread is claiming a record
+    volatile long         _M_epoch;            // Current reclamation epoch
+    volatile long         _M_advancing;        // Set while a thread is advancing the epoch
+};
+
+// An element count split across cache-line sized stripes, so that concurrent inserts
+// and erases do not all contend on one interlocked counter. A thread updates the stripe
+// picked by its _Epoch_thread index; threads only share a stripe when there are more of
+// them than stripes. Each stripe holds a signed delta; whenever a stripe's delta reaches
+// +/-_Flush_threshold, that amount is moved into the shared total. The shared total is
+// therefore an approximation that is off by less than _Flush_threshold per stripe, and
+// the exact count is the shared total plus the sum of all stripes.
+class _Striped_counter
+{
+public:
+    _Striped_counter() : _M_total(0)
+    {
+        _M_stripes = new _Stripe[_Stripe_count];
+        _Reset();
+    }
+
+    ~_Striped_counter()
+    {
+        delete [] _M_stripes;
+    }
+
+    // Add one to the count. Returns the shared total plus the calling thread's stripe, an
+    // approximation of the new count that is off by less than _Flush_threshold for every
+    // other stripe.
+    size_t _Increment()
+    {
+        volatile long * _Pstripe = _Current_stripe();
+        long _Delta = _Atomic_increment(_Pstripe);
+        if (_Delta == _Flush_threshold)
+        {
+            _Atomic_add(&_M_total, _Flush_threshold);
+            _Delta = _Atomic_add(_Pstripe, -_Flush_threshold);
+        }
+
+        long _Count = _M_total + _Delta;
+        return (_Count > 0) ? (size_t) _Count : 0;
+    }
+
+    // Add _Value to the count
+    void _Add(long _Value)
+    {
+        _Atomic_add(&_M_total, _Value);
+    }
+
+    // Subtract one from the count
+    void _Decrement()
+    {
+        volatile long * _Pstripe = _Current_stripe();
+        if (_Atomic_decrement(_Pstripe) == -_Flush_threshold)
+        {
+            _Atomic_add(&_M_total, -_Flush_threshold);
+            _Atomic_add(_Pstripe, _Flush_threshold);
+        }
+    }
+
+    // Returns the shared total without reading the stripes
+    size_t _Approximate() const
+    {
+        long _Count = _M_total;
+        return (_Count > 0) ? (size_t) _Count : 0;
+    }
+
+    // Returns the sum of the shared total and all the stripes. The result is exact
+    // unless updates are in progress.
+    size_t _Exact() const
+    {
+        long _Count = _M_total;
+        for (size_t _Index = 0; _Index < _Stripe_count; _Index++)
+        {
+            _Count += _M_stripes[_Index]._M_delta;
+        }
+
+        return (_Count > 0) ? (size_t) _Count : 0;
+    }
+
+    // Set the count to zero. Not concurrency safe.
+    void _Reset()
+    {
+        _M_total = 0;
+        for (size_t _Index = 0; _Index < _Stripe_count; _Index++)
+        {
+            _M_stripes[_Index]._M_delta = 0;
+        }
+    }
+
+    // Exchange counts with another counter. Not concurrency safe.
+    void _Swap(_Striped_counter& _Right)
+    {
+        std::swap(_M_stripes, _Right._M_stripes);
+
+        long _Total = _M_total;
+        _M_total = _Right._M_total;
+        _Right._M_total = _Total;
+    }
+
+private:
+    // Number of stripes, a power of two
+    static const size_t _Stripe_count = 32;
+
+    // Stripe delta at which the stripe is folded into the shared total
+    static const long _Flush_threshold = 16;
+
+    struct _Stripe
+    {
+        volatile long _M_delta;
+        char          _M_pad[64 - sizeof(long)];
+    };
+
+    _Striped_counter(const _Striped_counter&);
+    _Striped_counter& operator=(const _Striped_counter&);
+
+    volatile long * _Current_stripe() const
+    {
+        return &_M_stripes[_Epoch_thread::_Current()._M_index & (_Stripe_count - 1)]._M_delta;
+    }
+
+    _Stripe *     _M_stripes;
+    volatile long _M_total;
+};
+
+// Forward list in which elements are sorted in a split-order.
+//
+// Insertion is a single compare-and-swap on the predecessor's next pointer. Erasure
+// first marks the node's own next pointer (logical erase), then swings the
+// predecessor past it (physical unlink); any traversal that modifies the list helps
+// unlink marked nodes it passes. Lookups only read next pointers and never retry.
+//
+// Unlinked nodes may still be in use by concurrent traversals, so they are retired
+// rather than freed. Every concurrency-safe operation runs inside an _Epoch_guard of
+// the list's _Epoch_domain, and nodes retired two epochs before the current one are
+// freed whenever the epoch advances.
 template <typename _Element_type, typename _Element_allocator_type = std::allocator<_Element_type> >
 class _Split_ordered_list : _Split_order_list_value<_Element_type, _Element_allocator_type>
 {
@@ -368,12 +821,37 @@ public:
 
     typedef _Solist_const_iterator<_Mybase> const_iterator;
     typedef _Solist_iterator<_Mybase> iterator;
-    typedef std::_Flist_const_iterator<_Mybase> _Full_const_iterator;
-    typedef std::_Flist_iterator<_Mybase> _Full_iterator;
     typedef std::pair<iterator, bool> _Pairib;
-    using _Split_order_list_value<_Element_type, _Element_allocator_type>::_Buynode;
-    _Split_ordered_list(_Allocator_type _Allocator = allocator_type()) : _Mybase(_Allocator), _M_element_count(0)
+
+    using _Mybase::_Buynode;
+    using _Mybase::_Myhead;
+    using _Mybase::_Myval;
+    using _Mybase::_Get_next;
+    using _Mybase::_Get_key;
+    using _Mybase::_Is_erased;
+    using _Mybase::_M_node_allocator;
+    using _Mybase::_M_value_allocator;
+
+    // Number of retired nodes between attempts to advance the epoch
+    static const long _Reclaim_interval = 64;
+
+    // Scoped registration of a concurrency-safe operation with the list's reclamation epoch.
+    // Nodes reachable when the guard is constructed stay allocated until it is destroyed.
+    class _Epoch_guard : public _Epoch_domain::_Guard
+    {
+    public:
+        explicit _Epoch_guard(const _Mytype& _List) : _Epoch_domain::_Guard(_List._M_epochs)
+        {
+        }
+    };
+
+    _Split_ordered_list(_Allocator_type _Allocator = allocator_type()) : _Mybase(_Allocator),
+        _M_retired_count(0)
     {
+        for (size_t _Index = 0; _Index < _Epoch_count; _Index++)
+        {
+            _M_retired[_Index] = NULL;
+        }
     }
 
     ~_Split_ordered_list()
@@ -385,7 +863,7 @@ public:
         _Nodeptr _Pnode = _Myhead;
         _Myhead = NULL;
 
-        _ASSERT_EXPR(_Pnode != NULL && _Nextnode(_Pnode) == NULL, L"Invalid head list node");
+        _ASSERT_EXPR(_Pnode != NULL && _Get_next(_Pnode) == NULL, L"Invalid head list node");
 
         _Erase(_Pnode);
     }
@@ -399,40 +877,35 @@ public:
 
     void clear()
     {
-#if _ITERATOR_DEBUG_LEVEL == 2 /*IFSTRIP=IGN*/ 
-        _Orphan_ptr(*this, 0);
-#endif /* _ITERATOR_DEBUG_LEVEL == 2 */
-
         _Nodeptr _Pnext;
         _Nodeptr _Pnode = _Myhead;
 
         _ASSERT_EXPR(_Myhead != NULL, L"Invalid head list node");
-        _Pnext = _Nextnode(_Pnode);
+        _Pnext = _Get_next(_Pnode);
         _Pnode->_M_next = NULL;
         _Pnode = _Pnext;
 
         while (_Pnode != NULL)
         {
-            _Pnext = _Nextnode(_Pnode);
+            _Pnext = _Get_next(_Pnode);
             _Erase(_Pnode);
             _Pnode = _Pnext;
         }
 
-        _M_element_count = 0;
+        _Reclaim_all();
+        _M_element_count._Reset();
     }
 
     // Returns a first non-dummy element in the SOL
     iterator begin()
     {
-        _Full_iterator _Iterator = _Begin();
-        return _Get_first_real_iterator(_Iterator);
+        return _Get_first_real_iterator(_Myhead);
     }
 
     // Returns a first non-dummy element in the SOL
     const_iterator begin() const
     {
-        _Full_const_iterator _Iterator = _Begin();
-        return _Get_first_real_iterator(_Iterator);
+        return _Get_first_real_iterator(_Myhead);
     }
 
     iterator end()
@@ -458,13 +931,20 @@ public:
     // Checks if the number of elements (non-dummy) is 0
     bool empty() const
     {
-        return (_M_element_count == 0);
+        return (_M_element_count._Exact() == 0);
     }
 
     // Returns the number of non-dummy elements in the list
     size_type size() const
     {
-        return _M_element_count;
+        return _M_element_count._Exact();
+    }
+
+    // Returns the number of non-dummy elements in the list, without summing the count
+    // stripes. Off by less than 16 per stripe; see _Striped_counter.
+    size_type _Approximate_size() const
+    {
+        return _M_element_count._Approximate();
     }
 
     // Returns the maximum size of the list, determined by the allocator
@@ -482,11 +962,14 @@ public:
             return;
         }
 
+        // Neither list is in use, so nodes waiting for the epoch to advance can go now
+        _Reclaim_all();
+        _Right._Reclaim_all();
+
         if (_M_value_allocator == _Right._M_value_allocator)
         {
-            _Swap_all(_Right);
             std::swap(_Myhead, _Right._Myhead);
-            std::swap(_M_element_count, _Right._M_element_count);
+            _M_element_count._Swap(_Right._M_element_count);
         }
         else
         {
@@ -500,52 +983,23 @@ public:
     // Split-order list functions
 
     // Returns a first element in the SOL, which is always a dummy
-    _Full_iterator _Begin()
+    _Nodeptr _Begin() const
     {
-        return _Full_iterator(_Myhead, this);
+        return _Myhead;
     }
 
-    // Returns a first element in the SOL, which is always a dummy
-    _Full_const_iterator _Begin() const
+    // Returns a public iterator for a node. Public iterator must not point to a dummy node.
+    iterator _Get_iterator(_Nodeptr _Pnode)
     {
-        return _Full_const_iterator(_Myhead, this);
+        _ASSERT_EXPR(_Pnode != NULL && !_Pnode->_Is_dummy(), L"Invalid user node (dummy)");
+        return iterator(_Pnode, this);
     }
 
-    _Full_iterator _End()
+    // Returns a public iterator for a node. Public iterator must not point to a dummy node.
+    const_iterator _Get_iterator(_Nodeptr _Pnode) const
     {
-        return _Full_iterator(0, this);
-    }
-
-    _Full_const_iterator _End() const
-    {
-        return _Full_const_iterator(0, this);
-    }
-
-    static _Split_order_key _Get_key(const _Full_const_iterator& _Iterator)
-    {
-        return _Iterator._Mynode()->_Get_order_key();
-    }
-
-    // Returns a public iterator version of the internal iterator. Public iterator must not
-    // be a dummy private iterator.
-    iterator _Get_iterator(_Full_iterator _Iterator)
-    {
-        _ASSERT_EXPR(_Iterator._Mynode() != NULL && !_Iterator._Mynode()->_Is_dummy(), L"Invalid user node (dummy)");
-        return iterator(_Iterator._Mynode(), this);
-    }
-
-    // Returns a public iterator version of the internal iterator. Public iterator must not
-    // be a dummy private iterator.
-    const_iterator _Get_iterator(_Full_const_iterator _Iterator) const
-    {
-        _ASSERT_EXPR(_Iterator._Mynode() != NULL && !_Iterator._Mynode()->_Is_dummy(), L"Invalid user node (dummy)");
-        return const_iterator(_Iterator._Mynode(), this);
-    }
-
-    // Returns a non-const version of the _Full_iterator
-    _Full_iterator _Get_iterator(_Full_const_iterator _Iterator)
-    {
-        return _Full_iterator(_Iterator._Mynode(), this);
+        _ASSERT_EXPR(_Pnode != NULL && !_Pnode->_Is_dummy(), L"Invalid user node (dummy)");
+        return const_iterator(_Pnode, this);
     }
 
     // Returns a non-const version of the iterator
@@ -554,33 +1008,19 @@ public:
         return iterator(_Iterator._Mynode(), this);
     }
 
-    // Returns a public iterator version of a first non-dummy internal iterator at or after
-    // the passed in internal iterator.
-    iterator _Get_first_real_iterator(_Full_iterator _Iterator)
+    // Returns a public iterator to the first live, non-dummy node at or after the passed in node.
+    iterator _Get_first_real_iterator(_Nodeptr _Pnode)
     {
-        // Skip all dummy, internal only iterators
-        while (_Iterator != _End() && _Iterator._Mynode()->_Is_dummy())
-        {
-            _Iterator++;
-        }
-
-        return iterator(_Iterator._Mynode(), this);
+        return iterator(_First_real_node(_Pnode), this);
     }
 
-    // Returns a public iterator version of a first non-dummy internal iterator at or after
-    // the passed in internal iterator.
-    const_iterator _Get_first_real_iterator(_Full_const_iterator _Iterator) const
+    // Returns a public iterator to the first live, non-dummy node at or after the passed in node.
+    const_iterator _Get_first_real_iterator(_Nodeptr _Pnode) const
     {
-        // Skip all dummy, internal only iterators
-        while (_Iterator != _End() && _Iterator._Mynode()->_Is_dummy())
-        {
-            _Iterator++;
-        }
-
-        return const_iterator(_Iterator._Mynode(), this);
+        return const_iterator(_First_real_node(_Pnode), this);
     }
 
-    // Erase an element using the allocator
+    // Erase a node using the allocator
     void _Erase(_Nodeptr _Delete_node)
     {
         if (!_Delete_node->_Is_dummy())
@@ -591,188 +1031,330 @@ public:
         _M_node_allocator.deallocate(_Delete_node, 1);
     }
 
-    // Try to insert a new element in the list. If insert fails, return the node that
-    // was inserted instead.
-    _Nodeptr _Insert(_Nodeptr _Previous, _Nodeptr _New_node, _Nodeptr _Current_node)
+    // Find the insertion point for _Order_key, starting at the dummy node _Head: returns the
+    // first live node whose order key is not less than _Order_key (greater than, if
+    // _Skip_equal is true), and its live predecessor in _Previous. Erased nodes passed on
+    // the way are unlinked. Must be called under an _Epoch_guard.
+    _Nodeptr _Search(_Nodeptr _Head, _Split_order_key _Order_key, _Nodeptr& _Previous, bool _Skip_equal = false)
     {
-        _New_node->_M_next = _Current_node;
-        return _Previous->_Atomic_set_next(_New_node, _Current_node);
+        _ASSERT_EXPR(_Head != NULL && _Head->_Is_dummy(), L"Invalid head node");
+
+        for (;;)
+        {
+            _Nodeptr _Prevnode = _Head;
+            _Nodeptr _Pnode = _Get_next(_Prevnode);
+            bool _Restart = false;
+
+            while (_Pnode != NULL)
+            {
+                _Nodeptr _Pnext = _Pnode->_M_next;
+
+                if ((((size_t) _Pnext) & 0x1) != 0)
+                {
+                    // _Pnode is erased; swing the predecessor past it. This fails if the
+                    // predecessor changed or was erased itself, in which case start over.
+                    _Pnext = _Get_next(_Pnode);
+                    if (_Prevnode->_Atomic_set_next(_Pnext, _Pnode) != _Pnode)
+                    {
+                        _Restart = true;
+                        break;
+                    }
+
+                    _Retire(_Pnode);
+                    _Pnode = _Pnext;
+                    continue;
+                }
+
+                if (_Get_key(_Pnode) > _Order_key || (!_Skip_equal && _Get_key(_Pnode) == _Order_key))
+                {
+                    break;
+                }
+
+                _Prevnode = _Pnode;
+                _Pnode = _Pnext;
+            }
+
+            if (!_Restart)
+            {
+                _Previous = _Prevnode;
+                return _Pnode;
+            }
+        }
     }
-    
-    // Insert a new element between passed in iterators
-    _Pairib _Insert(_Full_iterator _Iterator, _Full_iterator _Next, _Nodeptr _List_node, long * _New_count)
+
+    // Try to link a new element between _Previous and _Current_node. Fails if _Previous no longer
+    // points to _Current_node, or has been erased.
+    bool _Insert(_Nodeptr _Previous, _Nodeptr _New_node, _Nodeptr _Current_node, size_type * _New_count)
     {
-        _Nodeptr _Inserted_node = _Insert(_Iterator._Mynode(), _List_node, _Next._Mynode());
+        _New_node->_M_next = _Current_node;
 
-        if (_Inserted_node == _List_node)
+        if (_Previous->_Atomic_set_next(_New_node, _Current_node) == _Current_node)
         {
-            // If the insert succeeded, check that the order is correct and increment the element count
+            // If the insert succeeded, check that the order is correct and increment the element count.
+            // The new count is approximate; see _Striped_counter.
             _Check_range();
-            *_New_count = _InterlockedIncrement(&_M_element_count);
-            return _Pairib(iterator(_List_node, this), true);
-        }
-        else
-        {
-            return _Pairib(end(), false);
+            *_New_count = _M_element_count._Increment();
+            return true;
         }
+
+        return false;
     }
 
     // Insert a new dummy element, starting search at a parent dummy element
-    _Full_iterator _Insert_dummy(_Full_iterator _Iterator, _Split_order_key _Order_key)
+    _Nodeptr _Insert_dummy(_Nodeptr _Parent, _Split_order_key _Order_key)
     {
-        _Full_iterator _Last = _End();
-        _Full_iterator _Where = _Iterator;
-
-        _ASSERT_EXPR(_Where != _Last, L"Invalid head node");
-
-        _Where++;
-
         // Create a dummy element up front, even though it may be discarded (due to concurrent insertion)
         _Nodeptr _Dummy_node = _Buynode(_Order_key);
 
         for (;;)
         {
-            _ASSERT_EXPR(_Iterator != _Last, L"Invalid head list node");
+            _Nodeptr _Previous;
+            _Nodeptr _Where = _Search(_Parent, _Order_key, _Previous);
 
-            // If the head iterator is at the end of the list, or past the point where this dummy
-            // node needs to be inserted, then try to insert it.
-            if (_Where == _Last || _Get_key(_Where) > _Order_key)
+            if (_Where != NULL && _Get_key(_Where) == _Order_key)
             {
-                _ASSERT_EXPR(_Get_key(_Iterator) < _Order_key, L"Invalid node order in the list");
+                // Another dummy node with the same value found, discard the new one.
+                _Erase(_Dummy_node);
+                return _Where;
+            }
 
-                // Try to insert it in the right place
-                _Nodeptr _Inserted_node = _Insert(_Iterator._Mynode(), _Dummy_node, _Where._Mynode());
+            _ASSERT_EXPR(_Get_key(_Previous) < _Order_key, L"Invalid node order in the list");
 
-                if (_Inserted_node == _Dummy_node)
-                {
-                    // Insertion succeeded, check the list for order violations
-                    _Check_range();
-                    return _Full_iterator(_Dummy_node, this);
-                }
-                else
-                {
-                    // Insertion failed: either dummy node was inserted by another thread, or
-                    // a real element was inserted at exactly the same place as dummy node.
-                    // Proceed with the search from the previous location where order key was
-                    // known to be larger (note: this is legal only because there is no safe
-                    // concurrent erase operation supported).
-                    _Where = _Iterator;
-                    _Where++;
-                    continue;
-                }
+            _Dummy_node->_M_next = _Where;
+            if (_Previous->_Atomic_set_next(_Dummy_node, _Where) == _Where)
+            {
+                // Insertion succeeded, check the list for order violations
+                _Check_range();
+                return _Dummy_node;
             }
-            else if (_Get_key(_Where) == _Order_key)
+
+            // Insertion failed: either dummy node was inserted by another thread, or
+            // the neighborhood changed. Search again from the parent.
+        }
+    }
+
+    // Concurrency-safe erase of a real node whose live predecessor was _Previous when it was
+    // found; _Head is the dummy node of its bucket. Returns false if another thread erased
+    // the node first. Must be called under an _Epoch_guard.
+    bool _Erase(_Nodeptr _Head, _Nodeptr _Previous, _Nodeptr _Pnode)
+    {
+        _ASSERT_EXPR(!_Pnode->_Is_dummy(), L"Dummy nodes cannot be erased");
+
+        // Logically erase the node by marking its next pointer
+        _Nodeptr _Pnext;
+        for (;;)
+        {
+            _Pnext = _Pnode->_M_next;
+            if ((((size_t) _Pnext) & 0x1) != 0)
             {
-                // Another dummy node with the same value found, discard the new one.
-                _Erase(_Dummy_node);
-                return _Where;
+                return false;
             }
 
-            // Move the iterator forward
-            _Iterator = _Where;
-            _Where++;
+            _Nodeptr _Marked = (_Nodeptr)(((size_t) _Pnext) | 0x1);
+            if (_Pnode->_Atomic_set_next(_Marked, _Pnext) == _Pnext)
+            {
+                break;
+            }
+        }
+
+        _M_element_count._Decrement();
+
+        // Physically unlink it. If the predecessor changed, let a search past the node do it.
+        if (_Previous->_Atomic_set_next(_Pnext, _Pnode) == _Pnode)
+        {
+            _Retire(_Pnode);
+        }
+        else
+        {
+            _Nodeptr _Unused;
+            _Search(_Head, _Get_key(_Pnode), _Unused, true);
         }
 
+        return true;
     }
 
-    // This erase function can handle both real and dummy nodes
-    void _Erase(_Full_iterator _Previous, _Full_const_iterator& _Where)
+    // Erase the node following _Previous and free it immediately. Not concurrency safe.
+    _Nodeptr _Unsafe_erase(_Nodeptr _Previous, _Nodeptr _Pnode)
     {
-#if _ITERATOR_DEBUG_LEVEL == 2 /*IFSTRIP=IGN*/ 
-        if (_Where._Getcont() != this || _Where._Ptr == _Myhead)
+        _ASSERT_EXPR(_Get_next(_Previous) == _Pnode, L"Erase must take consecutive nodes");
+
+        _Nodeptr _Pnext = _Get_next(_Pnode);
+        _Previous->_M_next = _Pnext;
+
+        if (!_Is_erased(_Pnode))
         {
-            std::_DEBUG_ERROR("list erase iterator outside range");
+            _M_element_count._Decrement();
         }
-        _Nodeptr _Pnode = (_Where++)._Mynode();
-        _Orphan_ptr(*this, _Pnode);
-#else /* _ITERATOR_DEBUG_LEVEL == 2 */
-        _Nodeptr _Pnode = (_Where++)._Mynode();
-#endif /* _ITERATOR_DEBUG_LEVEL == 2 */
-
-        _Nodeptr _Prevnode = _Previous._Mynode();
-        _ASSERT_EXPR(_Prevnode->_M_next == _Pnode, L"Erase must take consecutive iterators");
-        _Prevnode->_M_next = _Pnode->_M_next;
 
         _Erase(_Pnode);
+        return _Pnext;
+    }
+
+    // Returns the node following _Previous, first unlinking and freeing any erased nodes
+    // in between. Not concurrency safe.
+    _Nodeptr _Unsafe_next_live(_Nodeptr _Previous)
+    {
+        _Nodeptr _Pnode = _Get_next(_Previous);
+        while (_Pnode != NULL && _Is_erased(_Pnode))
+        {
+            _Pnode = _Unsafe_erase(_Previous, _Pnode);
+        }
+
+        return _Pnode;
     }
 
-    // Erase the element (previous node needs to be passed because this is a forward only list)
-    iterator _Erase(_Full_iterator _Previous, const_iterator _Where)
+    // Link _New_node between _Previous and its successor. The element count is not updated,
+    // so callers linking many elements can add them up once with _Unsafe_add_count. Not
+    // concurrency safe.
+    void _Unsafe_link(_Nodeptr _Previous, _Nodeptr _New_node)
     {
-        _Full_const_iterator _Iterator = _Where;
-        _Erase(_Previous, _Iterator);
-        _M_element_count--;
+        _New_node->_M_next = _Get_next(_Previous);
+        _Previous->_M_next = _New_node;
+    }
 
-        return _Get_iterator(_Get_first_real_iterator(_Iterator));
+    void _Unsafe_add_count(size_type _Count)
+    {
+        _M_element_count._Add((long) _Count);
     }
 
     // Move all elements from the passed in split-ordered list to this one
     void _Move_all(_Mytype& _Source_list)
     {
-        _Full_const_iterator _First = _Source_list._Begin();
-        _Full_const_iterator _Last = _Source_list._End();
+        _Nodeptr _Previous_node = _Myhead;
+        _Nodeptr _Source_head = _Source_list._Myhead;
 
-        if (_First == _Last)
+        // Move all elements one by one, including dummy ones
+        while (_Get_next(_Source_head) != NULL)
         {
-            return;
-        }
+            _Nodeptr _Node = _Get_next(_Source_head);
 
-        _Nodeptr _Previous_node = _Myhead;
-        _Full_const_iterator _Begin_iterator = _First++;
+            if (!_Is_erased(_Node))
+            {
+                _Nodeptr _New_node = _Node->_Is_dummy() ? _Buynode(_Node->_Get_order_key()) : _Buynode(_Node->_Get_order_key(), _Myval(_Node));
+                _Previous_node->_M_next = _New_node;
+                _Previous_node = _New_node;
 
-        // Move all elements one by one, including dummy ones
-        for (_Full_const_iterator _Iterator = _First; _Iterator != _Last;)
+                if (!_New_node->_Is_dummy())
+                {
+                    _M_element_count._Increment();
+                }
+            }
+
+            _Source_list._Unsafe_erase(_Source_head, _Node);
+        }
+    }
+
+    // Advance the epoch as far as the operations in progress allow, freeing the nodes retired
+    // in the epochs left behind. When no operation is in progress, every retired node is freed.
+    // Concurrency safe.
+    void _Try_reclaim()
+    {
+        for (size_t _Index = 0; _Index < _Epoch_count; _Index++)
         {
-            _Nodeptr _Node = _Iterator._Mynode();
+            _Try_advance_epoch();
+        }
+    }
 
-            _Nodeptr _Dummy_node = _Node->_Is_dummy() ? _Buynode(_Node->_Get_order_key()) : _Buynode(_Node->_Get_order_key(), _Myval(_Node));
-            _Previous_node = _Insert(_Previous_node, _Dummy_node, NULL);
-            _ASSERT_EXPR(_Previous_node != NULL, L"Insertion must succeed");
-            _Full_const_iterator _Where = _Iterator++;
-            _Source_list._Erase(_Get_iterator(_Begin_iterator), _Where);
+    // Free every retired node. Only safe when no operation is in progress on the list.
+    void _Reclaim_all()
+    {
+        for (size_t _Index = 0; _Index < _Epoch_count; _Index++)
+        {
+            _Free_retired(_M_retired[_Index]);
+            _M_retired[_Index] = NULL;
         }
     }
 
 private:
 
-    // Check the list for order violations
-    void _Check_range()
+    static const size_t _Epoch_count = _Epoch_domain::_Epoch_count;
+
+    // Queue an unlinked node to be freed once no operation can still be looking at it
+    void _Retire(_Nodeptr _Pnode)
     {
-#if defined (_DEBUG)
-        for (_Full_iterator _Iterator = _Begin(); _Iterator != _End(); _Iterator++)
+        _Nodeptr volatile * _Plist = &_M_retired[_M_epochs._Current() % _Epoch_count];
+
+        for (;;)
         {
-            _Full_iterator _Next_iterator = _Iterator;
-            _Next_iterator++;
+            _Nodeptr _Old_head = *_Plist;
+            _Pnode->_M_retired_next = _Old_head;
 
-            _ASSERT_EXPR(_Next_iterator == end() || _Next_iterator._Mynode()->_Get_order_key() >= _Iterator._Mynode()->_Get_order_key(), L"!!! List order inconsistency !!!");
+            if (_Atomic_compare_exchange_pointer((void * volatile *) _Plist, _Pnode, _Old_head) == _Old_head)
+            {
+                break;
+            }
+        }
+
+        if ((_Atomic_increment(&_M_retired_count) % _Reclaim_interval) == 0)
+        {
+            _Try_advance_epoch();
         }
-#endif
     }
 
-#if _ITERATOR_DEBUG_LEVEL == 2 /*IFSTRIP=IGN*/ 
-    void _Orphan_ptr(_Mytype& _Cont, _Nodeptr _Ptr) const
+    // Advance the epoch if every operation in progress has observed it, and free the nodes
+    // retired two epochs ago.
+    void _Try_advance_epoch()
     {
-        std::_Lockit _Lock(_LOCK_DEBUG);
-        const_iterator **_Pnext = (const_iterator **)_Cont._Getpfirst();
-        if (_Pnext != 0)
+        size_t _Oldest;
+        if (!_M_epochs._Begin_advance(_Oldest))
+        {
+            return;
+        }
+
+        // Detach the oldest list before publishing the new epoch; nothing is retired
+        // into it until the epoch has advanced.
+        _Nodeptr volatile * _Plist = &_M_retired[_Oldest];
+        _Nodeptr _Reclaimable;
+        for (;;)
         {
-            while (*_Pnext != 0)
+            _Reclaimable = *_Plist;
+            if (_Atomic_compare_exchange_pointer((void * volatile *) _Plist, NULL, _Reclaimable) == _Reclaimable)
             {
-                if ((*_Pnext)->_Ptr == (_Nodeptr)&_Myhead || _Ptr != 0 && (*_Pnext)->_Ptr != _Ptr)
-                {
-                    _Pnext = (const_iterator **)(*_Pnext)->_Getpnext();
-                }
-                else
-                {
-                    (*_Pnext)->_Clrcont();
-                    *_Pnext = *(const_iterator **)(*_Pnext)->_Getpnext();
-                }
+                break;
             }
         }
+
+        _M_epochs._End_advance();
+        _Free_retired(_Reclaimable);
+    }
+
+    void _Free_retired(_Nodeptr _Pnode)
+    {
+        while (_Pnode != NULL)
+        {
+            _Nodeptr _Pnext = _Pnode->_M_retired_next;
+            _Erase(_Pnode);
+            _Pnode = _Pnext;
+        }
+    }
+
+    // Returns the first live, non-dummy node at or after _Pnode
+    static _Nodeptr _First_real_node(_Nodeptr _Pnode)
+    {
+        while (_Pnode != NULL && (_Pnode->_Is_dummy() || _Is_erased(_Pnode)))
+        {
+            _Pnode = _Get_next(_Pnode);
+        }
+
+        return _Pnode;
+    }
+
+    // Check the list for order violations
+    void _Check_range()
+    {
+#if defined (_DEBUG)
+        for (_Nodeptr _Pnode = _Myhead; _Pnode != NULL; _Pnode = _Get_next(_Pnode))
+        {
+            _Nodeptr _Pnext = _Get_next(_Pnode);
+            _ASSERT_EXPR(_Pnext == NULL || _Get_key(_Pnext) >= _Get_key(_Pnode), L"!!! List order inconsistency !!!");
+        }
+#endif
     }
-#endif /* _ITERATOR_DEBUG_LEVEL == 2 */
 
-    volatile long _M_element_count; // Total item count, not counting dummy nodes
+    _Striped_counter    _M_element_count;            // Total item count, not counting dummy nodes
+    _Epoch_domain       _M_epochs;                   // Reclamation epoch and the threads' epoch records
+    volatile long       _M_retired_count;            // Nodes retired so far, paces epoch advancement
+    _Nodeptr volatile   _M_retired[_Epoch_count];    // Unlinked nodes by the epoch they were retired in
 };
 
 } // namespace details;
@@ -10,10 +10,30 @@
 
 #pragma once
 
+// Defining CONCRTEXTRAS_STD_THREAD_BACKEND builds the algorithms in this file on top of the portable std::thread
+// work-stealing scheduler in work_stealing_scheduler.h instead of the Concurrency Runtime. The Concurrency Runtime
+// only ships with Visual C++, so other compilers always use the portable scheduler.
+#if !defined(_MSC_VER) && !defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+#define CONCRTEXTRAS_STD_THREAD_BACKEND
+#endif
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+#include "work_stealing_scheduler.h"
+#else
 #include <ppl.h>
+#endif
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <iterator>
 #include <numeric>
 #include <vector>
+#include "internal_atomics.h"
+#if !defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
 #include "concrt_extras.h"
+#endif
 namespace Concurrency
 {
 namespace samples
@@ -87,17 +107,65 @@ inline typename std::iterator_traits<in_it>::difference_type
 {
     typedef typename std::iterator_traits<in_it>::value_type item_type;
 
-    combinable<iterator_traits<in_it>::difference_type> sums;
+    combinable<typename std::iterator_traits<in_it>::difference_type> sums;
 
     parallel_for_each(first,last,[&](const item_type& cur){
         if (pred(cur))
             ++sums.local();
     });
 
-    return sums.combine(std::plus<iterator_traits<in_it>::difference_type>());
+    return sums.combine(std::plus<typename std::iterator_traits<in_it>::difference_type>());
 }
 namespace details
 {
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+    template <bool is_iterator>
+    struct fixed_chunk_invoke
+    {
+        template <typename random_iterator, typename index_type, typename function>
+        static void invoke(const random_iterator& first, index_type index, const function& func)
+        {
+            func(first + index);
+        }
+    };
+
+    template <>
+    struct fixed_chunk_invoke<true>
+    {
+        template <typename random_iterator, typename index_type, typename function>
+        static void invoke(const random_iterator& first, index_type index, const function& func)
+        {
+            func(first[index]);
+        }
+    };
+
+    template <typename random_iterator, typename index_type, typename function>
+    void parallel_for_impl(random_iterator first, random_iterator last, index_type step, const function& func)
+    {
+        const bool is_iterator = !(std::is_same<random_iterator, index_type>::value);
+
+        // The step argument must be 1 or greater; otherwise it is an invalid argument
+        if (step < 1)
+        {
+            throw std::invalid_argument("step");
+        }
+
+        // If there are no elements in this range we just return
+        if (first >= last)
+        {
+            return;
+        }
+
+        index_type range = static_cast<index_type>(last - first);
+        index_type iterations = (step != 1) ? ((range - 1) / step) + 1 : range;
+
+        // One fixed chunk per virtual processor, the same partitioning the Concurrency Runtime version uses
+        ::Concurrency::samples::details::_Ws_parallel_for_static(iterations, [&first, &step, &func](index_type iteration)
+        {
+            fixed_chunk_invoke<is_iterator>::invoke(first, static_cast<index_type>(iteration * step), func);
+        });
+    }
+#else
     template <typename random_iterator, typename index_type, typename function, bool is_iterator>
     class fixed_chunk_class
     {
@@ -133,7 +201,7 @@ namespace details
     template <typename random_iterator, typename index_type, typename function>
     void parallel_for_impl(random_iterator first, random_iterator last, index_type step, const function& func)
     {
-        const bool is_iterator = !(std::tr1::is_same<random_iterator, index_type>::value);
+        const bool is_iterator = !(std::is_same<random_iterator, index_type>::value);
         typedef details::fixed_chunk_class<random_iterator, index_type, function, is_iterator> worker_class;
 
         // The step argument must be 1 or greater; otherwise it is an invalid argument
@@ -178,11 +246,12 @@ namespace details
             ::Concurrency::_Parallel_chunk_impl(first, iterations, step, func, task_group, chunk_helpers, num_chunks, true);
         }
     }
+#endif
 
     template <typename random_iterator, typename function>
     void parallel_for_each_impl(const random_iterator& first, const random_iterator& last, const function& func, std::random_access_iterator_tag)
     {
-        std::iterator_traits<random_iterator>::difference_type step = 1;
+        typename std::iterator_traits<random_iterator>::difference_type step = 1;
         details::parallel_for_impl(first, last, step, func);
     }
 
@@ -282,6 +351,9 @@ namespace details
 template <typename index_type, typename function>
 void parallel_for_fixed(index_type first, index_type last, index_type step, const function& func)
 {
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+    details::parallel_for_impl(first, last, step, func);
+#else
     _Trace_ppl_function(PPLParallelForEventGuid, _TRACE_LEVEL_INFORMATION, CONCRT_EVENT_START);
 #if _MSC_VER > 1600
     ::concurrency::parallel_for(first, last, step, func, static_partitioner());
@@ -289,6 +361,7 @@ void parallel_for_fixed(index_type first, index_type last, index_type step, cons
     details::parallel_for_impl(first, last, step, func);
 #endif
     _Trace_ppl_function(PPLParallelForEventGuid, _TRACE_LEVEL_INFORMATION, CONCRT_EVENT_END);
+#endif
 }
 
 /// <summary>
@@ -334,6 +407,9 @@ void parallel_for_fixed(index_type first, index_type last, const function& func)
 template <typename iterator, typename function>
 void parallel_for_each_fixed(iterator first, iterator last, const function& func)
 {
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+    details::parallel_for_each_impl(first, last, func, typename std::iterator_traits<iterator>::iterator_category());
+#else
     _Trace_ppl_function(PPLParallelForeachEventGuid, _TRACE_LEVEL_INFORMATION, CONCRT_EVENT_START);
 #if _MSC_VER > 1600
     ::concurrency::parallel_for_each(first, last, func, static_partitioner());
@@ -342,1473 +418,3856 @@ void parallel_for_each_fixed(iterator first, iterator last, const function& func
 #endif
     
     _Trace_ppl_function(PPLParallelForeachEventGuid, _TRACE_LEVEL_INFORMATION, CONCRT_EVENT_END);
+#endif
 }
 
+// Partitioners for parallel_for_fixed and parallel_for_each_fixed
+
 namespace details
 {
-    //
-    // _MallocaArrayHolder is used when the allocation size is known up front, and the memory must be allocated in a contiguous space
-    //
-    template<typename _ElemType>
-    class _MallocaArrayHolder
+    // The base of the partitioners, which selects the parallel_for_fixed overloads that take one
+    class partitioner_base
     {
-    public:
-
-        _MallocaArrayHolder() : _M_ElemArray(NULL), _M_ElemsConstructed(0) {}
+    };
+}
 
-        // _Initialize takes the pointer to the memory allocated by the user via _malloca
-        void _Initialize(_ElemType * _Elem)
-        {
-            _M_ElemArray = _Elem;
-            _M_ElemsConstructed = 0;
-        }
+/// <summary>
+///     Divides the iterations into one contiguous chunk per virtual processor. This is what parallel_for_fixed does
+///     without a partitioner, and is the cheapest choice when every iteration costs about the same.
+/// </summary>
+class fixed_partitioner : public details::partitioner_base
+{
+};
 
-        // Register the next slot for destruction. Because we only keep the index of the last slot to be destructed,
-        // this method must be called sequentially from 0 to N where N < _ElemCount.
-        void _IncrementConstructedElemsCount()
-        {
-            _M_ElemsConstructed++;
-        }
+/// <summary>
+///     Divides the iterations into chunks of a given size and deals them out to the virtual processors in turn, so that 
+///     each processor gets chunks from all over the range. This balances loops whose cost grows or shrinks along the range
+///     without any synchronization between the processors.
+/// </summary>
+class static_chunk_partitioner : public details::partitioner_base
+{
+public:
+    /// <summary>
+    ///     Constructs a static_chunk_partitioner.
+    /// </summary>
+    /// <param name="chunk_size">
+    ///     The number of consecutive iterations dealt out at a time.
+    /// </param>
+    explicit static_chunk_partitioner(size_t chunk_size = 1) : m_chunk_size((chunk_size < 1) ? 1 : chunk_size)
+    {
+    }
 
-        virtual ~_MallocaArrayHolder()
-        {
-            for( size_t _I=0; _I < _M_ElemsConstructed; ++_I )
-            {
-                _M_ElemArray[_I]._ElemType::~_ElemType();
-            }
-            // Works even when object was not initialized, i.e. _M_ElemArray == NULL
-            _freea(_M_ElemArray);
-        }
-    private:
-        _ElemType * _M_ElemArray;
-        size_t     _M_ElemsConstructed;
+    size_t chunk_size() const
+    {
+        return m_chunk_size;
+    }
 
-        // not supposed to be copy-constructed or assigned
-        _MallocaArrayHolder(const _MallocaArrayHolder & );
-        _MallocaArrayHolder&  operator = (const _MallocaArrayHolder & );
-    };
+private:
+    size_t m_chunk_size;
 };
 
-// Disable C4180: qualifier applied to function type has no meaning; ignored
-// Warning fires for passing Foo function pointer to parallel_for instead of &Foo.
-#pragma warning(push)
-#pragma warning(disable: 4180)
+/// <summary>
+///     Hands out the iterations in chunks that each processor takes when it is done with its previous one. Each chunk is
+///     a share of what is left, so the chunks start large and shrink towards the end of the range, where they even out 
+///     the finishing times of the processors.
+/// </summary>
+class guided_partitioner : public details::partitioner_base
+{
+public:
+    /// <summary>
+    ///     Constructs a guided_partitioner.
+    /// </summary>
+    /// <param name="min_chunk_size">
+    ///     The smallest number of iterations handed out at a time, except for the last chunk.
+    /// </param>
+    explicit guided_partitioner(size_t min_chunk_size = 1) : m_min_chunk_size((min_chunk_size < 1) ? 1 : min_chunk_size)
+    {
+    }
+
+    size_t min_chunk_size() const
+    {
+        return m_min_chunk_size;
+    }
+
+private:
+    size_t m_min_chunk_size;
+};
 
 /// <summary>
-///     This template function is semantically similar with <c>std::accumulate</c>, except that it requires associativity (not commutativity) 
-///     for the reduce functor and an identity value instead of the initial value in std::accumulate. The execution will be parallelized 
-///     to fully utilize all CPUs, the execution order of each chunk is not determined.
+///     Splits the iterations in half recursively into about two pieces per virtual processor, and splits a piece further
+///     only when it is stolen by an idle processor. A balanced loop therefore runs in as few pieces as with the 
+///     fixed_partitioner, while the work of a straggler is split up for as long as other processors are idle.
 /// </summary>
-/// <typeparam name="_Forward_iterator">
-///     The iterator type of input range, it must at least to be a <c>forward_iterator</c>.
-/// </typeparam>
-/// <param name="_Begin">
-///     The position of the first element to be included for reduce.
-/// </param>
-/// <param name="_End">
-///     The position of the first element not to be included for reduce.
-/// </param>
-/// <param name="_Identity">
-///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
-/// </param>
-/// <returns>
-///     The result of the reduction.
-/// </returns>
-/// <remarks>
-///     For the first function overload, the iterator's value_type <c>T</c> must be the same as the identity value type as well as the reduction 
-///     result type. 
-///     <para>The <c>T T::operator + (T)</c> is required to reduce elements in each chunk and sub results reduced from chunks. Particularly, for 
-///     the first phase reduction, operator, <c>T = T + T</c> will be applied in each chunk with the identity value as the initial value. In the
-///     second phase, the operator <c>T = T + T</c> will be applied to reduce the sub results of first phase reduce. </para>
-///     <para>For the second function overload, the iterator's value_type <c>T</c> must be the same as the initial value type as well as the 
-///     reduction result type. A symmetric binary functor <c>_Sym_fun</c>: <c>T (T, T)</c> is required to reduce elements in each chunk and sub 
-///     results reduced from chunks. Particularly, for the first phase reduce, functor <c>_Sym_fun</c>: <c>T (T, T)</c> will be applied on each 
-///     chunk with the identity value as the initial value. In the second phase,<c>_Sym_fun</c>: <c>T (T, T)</c> will be used to reduce sub results 
-///     from the first phase.</para>
-///     <para>For the third function overload, the iterator's value_type <c>T</c> can be different from the identity value type or the reduce result 
-///     type <c>_Reduce_type</c>. The range reduce functor <c>_Range_fun: _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> is 
-///     required in first phase reduce, and symmetric binary functor <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> is required in the 
-///     second phase reduce. Particularly, for the first phase reduce, functor <c>_Range_fun: 
-///     _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> will be applied with the identity value as the initial value. In the 
-///     second phase, <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> will be applied to reduce the sub results from first phase, and the 
-///     result will be returned as final result.</para>
-///     <para>The user should not have any assumptions on chunk division.</para>
-/// </remarks>
-/**/
-template<typename _Forward_iterator>
-inline typename std::iterator_traits<_Forward_iterator>::value_type parallel_reduce(
-    _Forward_iterator _Begin, _Forward_iterator _End, const typename std::iterator_traits<_Forward_iterator>::value_type &_Identity)
+class adaptive_partitioner : public details::partitioner_base
+{
+public:
+    /// <summary>
+    ///     Constructs an adaptive_partitioner.
+    /// </summary>
+    /// <param name="grain_size">
+    ///     The number of iterations below which a piece is never split.
+    /// </param>
+    explicit adaptive_partitioner(size_t grain_size = 1) : m_grain_size((grain_size < 1) ? 1 : grain_size)
+    {
+    }
+
+    size_t grain_size() const
+    {
+        return m_grain_size;
+    }
+
+private:
+    size_t m_grain_size;
+};
+
+class affinity_partitioner;
+
+namespace details
 {
-    return parallel_reduce(_Begin, _End, _Identity, std::plus<std::iterator_traits<_Forward_iterator>::value_type>());
+    template <typename function>
+    void partitioned_for(size_t iterations, const function& body, const affinity_partitioner& part);
 }
 
 /// <summary>
-///     This template function is semantically similar with <c>std::accumulate</c>, except that it requires associativity (not commutativity) 
-///     for the reduce functor and an identity value instead of the initial value in std::accumulate. The execution will be parallelized 
-///     to fully utilize all CPUs, the execution order of each chunk is not determined.
+///     Divides the iterations into a few chunks per virtual processor and remembers which processor ran each chunk.
+///     When the same partitioner is passed to a later loop over the same number of iterations, every processor first runs
+///     the chunks it ran the last time, so the data those iterations touch is still in its cache. Processors that are done
+///     with their own chunks take the chunks of processors that are late, and the new assignment is remembered.
 /// </summary>
-/// <typeparam name="_Forward_iterator">
-///     The iterator type of input range, it must at least to be a <c>forward_iterator</c>.
-/// </typeparam>
-/// <typeparam name="_Sym_reduce_fun">
-///     The symmetric reduce function type <c>_Reduce_type (_Reduce_type, _Reduce_type)</c>. 
-///     This type (return type and arguments type) should be consistent with the output type of <c>_Range_reduce_fun</c> and
-///     return type of this <c>parallel_reduce</c> function.
-/// </typeparam>
-/// <param name="_Begin">
-///     The position of the first element to be included for reduce.
-/// </param>
-/// <param name="_End">
-///     The position of the first element not to be included for reduce.
-/// </param>
-/// <param name="_Identity">
-///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
-/// </param>
-/// <param name="_Sym_fun">
-///     The reduce function that will be used in the second phase reduce, for more information please refer to remarks.
-/// </param>
-/// <returns>
-///     The result of the reduction.
-/// </returns>
 /// <remarks>
-///     For the first function overload, the iterator's value_type <c>T</c> must be the same as the identity value type as well as the reduction 
-///     result type. 
-///     <para>The <c>T T::operator + (T)</c> is required to reduce elements in each chunk and sub results reduced from chunks. Particularly, for 
-///     the first phase reduction, operator, <c>T = T + T</c> will be applied in each chunk with the identity value as the initial value. In the
-///     second phase, the operator <c>T = T + T</c> will be applied to reduce the sub results of first phase reduce. </para>
-///     <para>For the second function overload, the iterator's value_type <c>T</c> must be the same as the initial value type as well as the 
-///     reduction result type. A symmetric binary functor <c>_Sym_fun</c>: <c>T (T, T)</c> is required to reduce elements in each chunk and sub 
-///     results reduced from chunks. Particularly, for the first phase reduce, functor <c>_Sym_fun</c>: <c>T (T, T)</c> will be applied on each 
-///     chunk with the identity value as the initial value. In the second phase,<c>_Sym_fun</c>: <c>T (T, T)</c> will be used to reduce sub results 
-///     from the first phase.</para>
-///     <para>For the third function overload, the iterator's value_type <c>T</c> can be different from the identity value type or the reduce result 
-///     type <c>_Reduce_type</c>. The range reduce functor <c>_Range_fun: _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> is 
-///     required in first phase reduce, and symmetric binary functor <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> is required in the 
-///     second phase reduce. Particularly, for the first phase reduce, functor <c>_Range_fun: 
-///     _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> will be applied with the identity value as the initial value. In the 
-///     second phase, <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> will be applied to reduce the sub results from first phase, and the 
-///     result will be returned as final result.</para>
-///     <para>The user should not have any assumptions on chunk division.</para>
+///     The partitioner has to outlive the loops that replay its assignment, as it does when it is declared outside of a 
+///     time step loop. It must not be used by two loops at the same time.
 /// </remarks>
-/**/
-template<typename _Forward_iterator, typename _Sym_reduce_fun>
-inline typename std::iterator_traits<_Forward_iterator>::value_type parallel_reduce(_Forward_iterator _Begin, _Forward_iterator _End, 
-    const typename std::iterator_traits<_Forward_iterator>::value_type &_Identity, _Sym_reduce_fun _Sym_fun)
+class affinity_partitioner : public details::partitioner_base
+{
+public:
+    /// <summary>
+    ///     Constructs an affinity_partitioner that has not recorded an assignment yet.
+    /// </summary>
+    affinity_partitioner() : m_iterations(0)
+    {
+    }
+
+private:
+    template <typename function>
+    friend void details::partitioned_for(size_t iterations, const function& body, const affinity_partitioner& part);
+
+    // The number of iterations of the loop that the assignment was recorded for, and the processor of each chunk
+    mutable size_t m_iterations;
+    mutable std::vector<unsigned int> m_owners;
+};
+
+namespace details
 {
-    typedef typename std::remove_cv<std::iterator_traits<_Forward_iterator>::value_type>::type _Reduce_type;
+    // Identifies the worker that runs the calling code, to tell whether a task was stolen
+    inline unsigned int current_worker_id()
+    {
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+        return static_cast<unsigned int>(::Concurrency::samples::details::_Ws_scheduler::_Instance()._Current_worker_index());
+#else
+        return Context::Id();
+#endif
+    }
 
-    return parallel_reduce(_Begin, _End, _Identity, 
-        [_Sym_fun](_Forward_iterator _Begin, _Forward_iterator _End, _Reduce_type _Init)->_Reduce_type 
+    template <typename function>
+    void partitioned_for(size_t iterations, const function& body, const fixed_partitioner&)
     {
-        while (_Begin != _End)
+        ::Concurrency::samples::parallel_for_fixed(size_t(0), iterations, body);
+    }
+
+    template <typename function>
+    void partitioned_for(size_t iterations, const function& body, const static_chunk_partitioner& part)
+    {
+        size_t chunk_size = part.chunk_size();
+        size_t num_chunks = (iterations + chunk_size - 1) / chunk_size;
+        size_t num_workers = (std::min)(static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), num_chunks);
+
+        ::Concurrency::samples::parallel_for_fixed(size_t(0), num_workers, [&](size_t worker)
         {
-            _Init = _Sym_fun(_Init, *_Begin++); 
-        }
+            for (size_t chunk = worker; chunk < num_chunks; chunk += num_workers)
+            {
+                size_t last = (std::min)((chunk + 1) * chunk_size, iterations);
+                for (size_t i = chunk * chunk_size; i < last; ++i)
+                {
+                    body(i);
+                }
+            }
+        });
+    }
 
-        return _Init;
-    },
-        _Sym_fun);
-}
+    template <typename function>
+    void partitioned_for(size_t iterations, const function& body, const guided_partitioner& part)
+    {
+        size_t min_chunk_size = part.min_chunk_size();
+        size_t num_workers = (std::min)(static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), iterations);
+        volatile size_t next = 0;
 
-/// <summary>
-///     This template function is semantically similar with <c>std::accumulate</c>, except that it requires associativity (not commutativity) 
-///     for the reduce functor and an identity value instead of the initial value in std::accumulate. The execution will be parallelized 
-///     to fully utilize all CPUs, the execution order of each chunk is not determined.
-/// </summary>
-/// <typeparam name="_Reduce_type">
-///     The type that the input will reduce to, which can be different from the input element type. 
-///     The return value and identity value will has this type.
-/// </typeparam>
-/// <typeparam name="_Forward_iterator">
-///     The iterator type of input range, it must at least to be a <c>forward_iterator</c>.
-/// </typeparam>
-/// <typeparam name="_Range_reduce_fun">
-///     The type of reduce function with type <c>_Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c>. 
-///     The type of this function should be consistent with the input iterators and identity value.
-/// </typeparam>
-/// <typeparam name="_Sym_reduce_fun">
-///     The symmetric reduce function type <c>_Reduce_type (_Reduce_type, _Reduce_type)</c>. 
-///     This type (return type and arguments type) should be consistent with the output type of <c>_Range_reduce_fun</c> and
-///     return type of this <c>parallel_reduce</c> function.
-/// </typeparam>
-/// <param name="_Begin">
-///     The position of the first element to be included for reduce.
-/// </param>
-/// <param name="_End">
-///     The position of the first element not to be included for reduce.
-/// </param>
-/// <param name="_Identity">
-///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
-/// </param>
-/// <param name="_Range_fun">
-///     The reduce function that will be used in the first phase reduce, for more information please refer to remarks.
-/// </param>
-/// <param name="_Sym_fun">
-///     The reduce function that will be used in the second phase reduce, for more information please refer to remarks.
-/// </param>
-/// <returns>
-///     The result of the reduction.
-/// </returns>
-/// <remarks>
-///     For the first function overload, the iterator's value_type <c>T</c> must be the same as the identity value type as well as the reduction 
-///     result type. 
-///     <para>The <c>T T::operator + (T)</c> is required to reduce elements in each chunk and sub results reduced from chunks. Particularly, for 
-///     the first phase reduction, operator, <c>T = T + T</c> will be applied in each chunk with the identity value as the initial value. In the
-///     second phase, the operator <c>T = T + T</c> will be applied to reduce the sub results of first phase reduce. </para>
-///     <para>For the second function overload, the iterator's value_type <c>T</c> must be the same as the initial value type as well as the 
-///     reduction result type. A symmetric binary functor <c>_Sym_fun</c>: <c>T (T, T)</c> is required to reduce elements in each chunk and sub 
-///     results reduced from chunks. Particularly, for the first phase reduce, functor <c>_Sym_fun</c>: <c>T (T, T)</c> will be applied on each 
-///     chunk with the identity value as the initial value. In the second phase,<c>_Sym_fun</c>: <c>T (T, T)</c> will be used to reduce sub results 
-///     from the first phase.</para>
-///     <para>For the third function overload, the iterator's value_type <c>T</c> can be different from the identity value type or the reduce result 
-///     type <c>_Reduce_type</c>. The range reduce functor <c>_Range_fun: _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> is 
-///     required in first phase reduce, and symmetric binary functor <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> is required in the 
-///     second phase reduce. Particularly, for the first phase reduce, functor <c>_Range_fun: 
-///     _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> will be applied with the identity value as the initial value. In the 
-///     second phase, <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> will be applied to reduce the sub results from first phase, and the 
-///     result will be returned as final result.</para>
-///     <para>The user should not have any assumptions on chunk division.</para>
-/// </remarks>
-/**/
-template<typename _Reduce_type, typename _Forward_iterator, typename _Range_reduce_fun, typename _Sym_reduce_fun>
-inline _Reduce_type parallel_reduce(_Forward_iterator _Begin, _Forward_iterator _End, const _Reduce_type& _Identity, 
-    const _Range_reduce_fun &_Range_fun, const _Sym_reduce_fun &_Sym_fun)
-{
-    typedef typename std::iterator_traits<_Forward_iterator>::value_type _Value_type;
+        ::Concurrency::samples::parallel_for_fixed(size_t(0), num_workers, [&](size_t)
+        {
+            size_t first = next;
+            while (first < iterations)
+            {
+                // Take half of this worker's share of what is left
+                size_t chunk_size = (std::max)((iterations - first) / (2 * num_workers), min_chunk_size);
+                size_t last = (std::min)(first + chunk_size, iterations);
 
-    static_assert(!std::tr1::is_same<typename std::iterator_traits<_Forward_iterator>::iterator_category, std::input_iterator_tag>::value
-        && !std::tr1::is_same<typename std::iterator_traits<_Forward_iterator>::iterator_category, std::output_iterator_tag>::value, 
-        "iterator can not be input_iterator or output_iterator.");
+                size_t seen = _Atomic_compare_exchange_size_t(&next, last, first);
+                if (seen != first)
+                {
+                    // Another worker took the chunk
+                    first = seen;
+                    continue;
+                }
 
-    return _Parallel_reduce_impl(_Begin, _End,
-        _Reduce_functor_helper<_Reduce_type, _Range_reduce_fun, 
-        _Order_combinable<_Reduce_type, _Sym_reduce_fun>>(_Identity, _Range_fun, _Order_combinable<_Reduce_type, _Sym_reduce_fun>(_Sym_fun)),
-        std::iterator_traits<_Forward_iterator>::iterator_category());
-}
+                for (size_t i = first; i < last; ++i)
+                {
+                    body(i);
+                }
 
-// Ordered serial combinable object
-template<typename _Ty, typename _Sym_fun>
-class _Order_combinable
-{
-public:
-    // Only write once, limited contention will be caused
-    struct _Bucket
+                first = next;
+            }
+        });
+    }
+
+    // Identifies the processor that runs the calling code, whose cache an affinity_partitioner tries to reuse
+    inline unsigned int current_processor_id()
     {
-        // Allocate enough space in the Bucket to hold a value
-        char _Value[(sizeof(_Ty) / sizeof(char))];
-        _Bucket * _Next;
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+        return static_cast<unsigned int>(::Concurrency::samples::details::_Ws_scheduler::_Instance()._Current_worker_index());
+#else
+        return Context::VirtualProcessorId();
+#endif
+    }
 
-        _Bucket(_Bucket *_N)
+    template <typename function>
+    void partitioned_for(size_t iterations, const function& body, const affinity_partitioner& part)
+    {
+        // A few chunks per processor, so that the late processors can be helped out
+        const size_t chunks_per_processor = 4;
+        const unsigned int no_owner = static_cast<unsigned int>(-1);
+
+        size_t num_processors = static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors());
+
+        if (part.m_iterations != iterations || part.m_owners.empty())
         {
-            _Next = _N;
+            part.m_iterations = iterations;
+            part.m_owners.assign((std::min)(num_processors * chunks_per_processor, iterations), no_owner);
         }
 
-        void _Insert(_Bucket *_Item)
+        size_t num_chunks = part.m_owners.size();
+        std::vector<long> claimed(num_chunks, 0);
+        std::vector<unsigned int> owners(part.m_owners);
+
+        auto run_chunk = [&](size_t chunk, unsigned int self) -> bool
         {
-            // No need to lock, only one thread will insert
-            _Item->_Next = _Next;
-            _Next = _Item;
-        }
+            if (_Atomic_exchange(&claimed[chunk], 1) != 0)
+            {
+                return false;
+            }
 
-        // Construct value in bucket
-        void _Put(const _Ty &_Cur)
+            owners[chunk] = self;
+
+            size_t last = (chunk + 1) * iterations / num_chunks;
+            for (size_t i = chunk * iterations / num_chunks; i < last; ++i)
+            {
+                body(i);
+            }
+
+            return true;
+        };
+
+        ::Concurrency::samples::parallel_for_fixed(size_t(0), (std::min)(num_processors, num_chunks), [&](size_t worker)
         {
-            new(reinterpret_cast<_Ty *>(&_Value)) _Ty(_Cur);
-        }
-    };
+            unsigned int self = current_processor_id();
 
-private:
-    const _Sym_fun &_M_fun;
-    size_t _M_number;
-    _Bucket *_M_root;
-    _Order_combinable &operator =(const _Order_combinable &other);
+            // The chunks this processor ran the last time
+            for (size_t chunk = 0; chunk < num_chunks; ++chunk)
+            {
+                if (part.m_owners[chunk] == self)
+                {
+                    run_chunk(chunk, self);
+                }
+            }
 
-public:
-    _Bucket *_Construct(_Bucket *_Par = 0)
-    {
-        _Bucket * _Ret = static_cast<_Bucket *>(Concurrency::Alloc(sizeof(_Bucket)));
-        return new(_Ret)_Bucket(_Par);
-    }
+            // The chunks nobody has run yet, spread out so that the workers don't all start at the same chunk
+            for (size_t offset = 0; offset < num_chunks; ++offset)
+            {
+                size_t chunk = (worker * chunks_per_processor + offset) % num_chunks;
+                if (part.m_owners[chunk] == no_owner)
+                {
+                    run_chunk(chunk, self);
+                }
+            }
 
-    _Order_combinable(const _Sym_fun &_Fun): _M_fun(_Fun)
-    {
-        _M_root = 0;
-        _M_number = 0;
+            // The chunks of the processors that are late, from the end, where their owners get to last
+            for (size_t chunk = num_chunks; chunk-- > 0; )
+            {
+                run_chunk(chunk, self);
+            }
+        });
+
+        part.m_owners.swap(owners);
     }
 
-    ~_Order_combinable()
+    // The additional levels of splitting that a stolen piece of an adaptive loop is allowed
+    const int adaptive_steal_depth = 2;
+
+    template <typename function>
+    void adaptive_for(size_t first, size_t last, size_t grain_size, int depth, unsigned int spawner, const function& body)
     {
-        while (_M_root)
+        unsigned int self = current_worker_id();
+
+        // A stolen piece means that a worker was idle, so it may be split again for the other idle workers
+        if (self != spawner)
         {
-            _Bucket *_Cur = _M_root;
-            _M_root = _M_root->_Next;
-            reinterpret_cast<_Ty &>(_Cur->_Value).~_Ty();
-            Concurrency::Free(_Cur);
+            depth += adaptive_steal_depth;
         }
-    }
 
-    // Serially combine and release the list, return result
-    _Ty _Serial_combine_release()
-    {
-        _Ty _Ret(reinterpret_cast<_Ty &>(_M_root->_Value));
-        _Bucket *_Cur = _M_root;
-        _M_root = _M_root->_Next;
-
-        while (_M_root)
+        task_group tasks;
+        while (last - first > grain_size && depth > 0)
         {
-            reinterpret_cast<_Ty &>(_Cur->_Value).~_Ty();
-            Concurrency::Free(_Cur);
-            _Cur = _M_root;
-            _Ret = _M_fun(reinterpret_cast <_Ty &> (_Cur->_Value), _Ret);
-            _M_root = _M_root->_Next;
+            --depth;
+            size_t middle = first + (last - first) / 2;
+            tasks.run([middle, last, grain_size, depth, self, &body]
+            {
+                adaptive_for(middle, last, grain_size, depth, self, body);
+            });
+            last = middle;
         }
 
-        reinterpret_cast<_Ty &>(_Cur->_Value).~_Ty();
-        Concurrency::Free(_Cur);
+        for (size_t i = first; i < last; ++i)
+        {
+            body(i);
+        }
 
-        return _Ret;
+        tasks.wait();
     }
 
-    // allocate a bucket and push back to the list
-    _Bucket *_Unsafe_push_back()
+    template <typename function>
+    void partitioned_for(size_t iterations, const function& body, const adaptive_partitioner& part)
     {
-        return _M_root = _Construct(_M_root);
-    }
-};
+        // Enough levels for about two pieces per virtual processor
+        int depth = 1;
+        for (unsigned int pieces = CurrentScheduler::Get()->GetNumberOfVirtualProcessors(); pieces > 1; pieces = (pieces + 1) / 2)
+        {
+            ++depth;
+        }
 
-// Implementation for the parallel reduce
-template <typename _Forward_iterator, typename _Function>
-typename _Function::_Reduce_type _Parallel_reduce_impl(_Forward_iterator _First, const _Forward_iterator& _Last, const _Function& _Func, 
-    std::forward_iterator_tag)
-{
-    // Since this is a forward iterator, it is difficult to validate that _First comes before _Last, so
-    // it is up to the user to provide valid range.
-    if (_First != _Last)
-    {
-        task_group _Task_group;
-        _Parallel_reduce_forward_executor(_First, _Last, _Func, _Task_group);
-        _Task_group.wait();
-        return _Func._Combinable._Serial_combine_release();
-    }
-    else
-    {
-        return _Func._Identity_value;
+        adaptive_for(0, iterations, part.grain_size(), depth, current_worker_id(), body);
     }
 }
 
-template <typename _Random_iterator, typename _Function>
-typename _Function::_Reduce_type _Parallel_reduce_impl(_Random_iterator _First, _Random_iterator _Last, const _Function& _Func, 
-    std::random_access_iterator_tag)
+/// <summary>
+///     Performs parallel iteration over a range of indices from first
+///     to last, not including last, dividing the iterations among the processors with the given partitioner.
+/// </summary>
+/// <param name="first">
+///     First index to be included in parallel iteration.
+/// </param>
+/// <param name="last">
+///     First index after first not to be included in parallel iteration.
+/// </param>
+/// <param name="step">
+///     Step to be used in computing index for the given iteration. Only positive step is supported;
+///     exception is thrown if step is smaller than or equal to 0.
+/// </param>
+/// <param name="func">
+///     Function object to be executed on each iteration.
+/// </param>
+/// <param name="part">
+///     One of fixed_partitioner, static_chunk_partitioner, guided_partitioner, adaptive_partitioner or affinity_partitioner.
+/// </param>
+/// <remarks>
+///     For more information, see <see cref="Parallel Algorithms"/>.
+/// </remarks>
+template <typename index_type, typename function, typename partitioner>
+void parallel_for_fixed(index_type first, index_type last, index_type step, const function& func, const partitioner& part)
 {
-    typedef _Parallel_reduce_fixed_worker<_Random_iterator, _Function> _Worker_class;
+    static_assert(std::is_base_of<details::partitioner_base, partitioner>::value, "part must be a partitioner.");
 
-    // Special case for 0, 1 element
-    if (_First >= _Last)
-    {
-        return _Func._Identity_value;
-    }
-    // Directly compute if size is too small
-    else if (_Last - _First <= 1)
+    // The step argument must be 1 or greater; otherwise it is an invalid argument
+    if (step < 1)
     {
-        _Worker_class(_First, _Last, _Func)();
-        return _Func._Combinable._Serial_combine_release();
+        throw std::invalid_argument("step");
     }
-    else
+
+    if (first >= last)
     {
-        // Use fixed ordered chunk partition to schedule works
-        _Parallel_reduce_random_executor<_Worker_class>(_First, _Last, _Func);
-        return _Func._Combinable._Serial_combine_release();
+        return;
     }
-}
-
-// Helper function assemble all functors
-template <typename _Reduce_type, typename _Sub_function, typename _Combinable_type>
-struct _Reduce_functor_helper
-{
-    const _Sub_function &_Sub_fun;
-    const _Reduce_type &_Identity_value;
 
-    mutable _Combinable_type &_Combinable;
-
-    typedef _Reduce_type _Reduce_type;
-    typedef typename _Combinable_type::_Bucket Bucket_type;
+    index_type range = last - first;
+    size_t iterations = static_cast<size_t>((step != 1) ? ((range - 1) / step) + 1 : range);
 
-    _Reduce_functor_helper(const _Reduce_type &_Identity, const _Sub_function &_Sub_fun, _Combinable_type &&comb):
-    _Sub_fun(_Sub_fun), _Combinable(comb), _Identity_value(_Identity)
+    details::partitioned_for(iterations, [&first, &step, &func](size_t iteration)
     {
-    }
-
-private:
-    _Reduce_functor_helper &operator =(const _Reduce_functor_helper &other);
-};
+        func(static_cast<index_type>(first + static_cast<index_type>(iteration) * step));
+    }, part);
+}
 
-// All the code below is the worker without range stealing
-template<typename _Forward_iterator, typename _Functor>
-class _Parallel_reduce_fixed_worker
-{
-public:
-    // The bucket allocation order will depend on the worker construction order
-    _Parallel_reduce_fixed_worker(_Forward_iterator _Begin, _Forward_iterator _End, const _Functor &_Fun):
-        _M_begin(_Begin), _M_end(_End), _M_fun(_Fun), _M_bucket(_M_fun._Combinable._Unsafe_push_back())
+/// <summary>
+///     Performs parallel iteration over a range of indices from first
+///     to last, not including last, dividing the iterations among the processors with the given partitioner.
+/// </summary>
+/// <param name="first">
+///     First index to be included in parallel iteration.
+/// </param>
+/// <param name="last">
+///     First index after first not to be included in parallel iteration.
+/// </param>
+/// <param name="func">
+///     Function object to be executed on each iteration.
+/// </param>
+/// <param name="part">
+///     One of fixed_partitioner, static_chunk_partitioner, guided_partitioner, adaptive_partitioner or affinity_partitioner.
+/// </param>
+/// <remarks>
+///     For more information, see <see cref="Parallel Algorithms"/>.
+/// </remarks>
+template <typename index_type, typename function, typename partitioner>
+typename std::enable_if<std::is_base_of<details::partitioner_base, partitioner>::value>::type 
+    parallel_for_fixed(index_type first, index_type last, const function& func, const partitioner& part)
+{
+    parallel_for_fixed(first, last, index_type(1), func, part);
+}
+
+/// <summary>
+///     This template function is semantically equivalent to std::for_each, except that
+///     the iteration is done in parallel and ordering is unspecified, and the elements are
+///     divided among the processors with the given partitioner.
+/// </summary>
+/// <param name="first">
+///     First element to be included in parallel iteration. The iterator must be a random access iterator.
+/// </param>
+/// <param name="last">
+///     First element after first not to be included in parallel iteration.
+/// </param>
+/// <param name="func">
+///     Function object to be executed on each iteration.
+/// </param>
+/// <param name="part">
+///     One of fixed_partitioner, static_chunk_partitioner, guided_partitioner, adaptive_partitioner or affinity_partitioner.
+/// </param>
+/// <remarks>
+///     For more information, see <see cref="Parallel Algorithms"/>.
+/// </remarks>
+template <typename iterator, typename function, typename partitioner>
+void parallel_for_each_fixed(iterator first, iterator last, const function& func, const partitioner& part)
+{
+    static_assert(std::is_same<typename std::iterator_traits<iterator>::iterator_category, std::random_access_iterator_tag>::value, 
+        "iterator must be a random_access_iterator.");
+    static_assert(std::is_base_of<details::partitioner_base, partitioner>::value, "part must be a partitioner.");
+
+    if (first < last)
+    {
+        details::partitioned_for(static_cast<size_t>(last - first), [&first, &func](size_t index)
         {
-        }
+            func(first[index]);
+        }, part);
+    }
+}
 
-        void operator ()() const
+namespace details
+{
+    // Splits a range until its pieces are no longer divisible, appending the pieces to _Pieces in order.
+    // Splitting up front bounds the number of tasks by the number of workers rather than by the grain size.
+    template <typename _Range>
+    void _Split_range(const _Range& _Rng, std::vector<_Range>& _Pieces)
+    {
+        std::vector<_Range> _Pending(1, _Rng);
+
+        while (!_Pending.empty())
         {
-            _M_bucket->_Put(_M_fun._Sub_fun(_M_begin, _M_end, _M_fun._Identity_value));
-        }
+            _Range _Lower = _Pending.back();
+            _Pending.pop_back();
 
-private:
-    const _Functor &_M_fun;
-    const _Forward_iterator _M_begin, _M_end;
-    typename _Functor::Bucket_type * const _M_bucket;
-    _Parallel_reduce_fixed_worker &operator =(const _Parallel_reduce_fixed_worker &other);
+            if (_Lower.is_divisible())
+            {
+                _Range _Upper = _Lower.split();
+                _Pending.push_back(_Upper);
+                _Pending.push_back(_Lower);
+            }
+            else
+            {
+                _Pieces.push_back(_Lower);
+            }
+        }
+    }
 };
 
-// the parallel worker executor for fixed iterator
-// it will divide fixed number of chunks
-// almost same as fixed parallel for, except keep the chunk dividing order
-template <typename _Worker, typename _Random_iterator, typename _Function>
-void _Parallel_reduce_random_executor(_Random_iterator _Begin, _Random_iterator _End, const _Function& _Fun)
+/// <summary>
+///     Applies a function to every element of a splittable range, in parallel. The range is split until its
+///     pieces are no longer divisible, and each piece is traversed serially by one task.
+/// </summary>
+/// <typeparam name="_Range">
+///     The range type, for example <c>concurrent_unordered_map::range_type</c>. It must be copyable and provide
+///     <c>begin()</c>, <c>end()</c>, <c>is_divisible()</c> and <c>split()</c>, which moves the upper part of the
+///     range into a new range and returns it.
+/// </typeparam>
+/// <param name="_Rng">
+///     The range to iterate over.
+/// </param>
+/// <param name="_Func">
+///     Function object to be executed on each element.
+/// </param>
+/// <remarks>
+///     The order in which the elements are visited is unspecified.
+/// </remarks>
+/**/
+template <typename _Range, typename _Function>
+void parallel_for_each_range(const _Range& _Rng, const _Function& _Func)
 {
-    size_t _Cpu_num = static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), _Size = _End - _Begin;
+    std::vector<_Range> _Pieces;
+    details::_Split_range(_Rng, _Pieces);
 
-    structured_task_group _Tg;
-    Concurrency::samples::details::_MallocaArrayHolder<task_handle<_Worker>> _Holder;
-    task_handle<_Worker> *_Tasks = static_cast<task_handle<_Worker> *>(_malloca(sizeof(task_handle<_Worker>) * (_Cpu_num - 1)));
-    _Holder._Initialize(_Tasks);
+    parallel_for_each(_Pieces.begin(), _Pieces.end(), [&_Func](const _Range& _Piece) {
+        for (typename _Range::iterator _Iter = _Piece.begin(); _Iter != _Piece.end(); ++_Iter)
+        {
+            _Func(*_Iter);
+        }
+    });
+}
 
-    size_t _Begin_index = 0;
-    size_t _Step = _Size / _Cpu_num;
-    size_t _NumRemaining = _Size - _Step * _Cpu_num;
+/// <summary>
+///     Reduces a splittable range in parallel. The range is split until its pieces are no longer divisible,
+///     the pieces are reduced in parallel and their results are combined in order.
+/// </summary>
+/// <typeparam name="_Reduce_type">
+///     The type that the input will reduce to. The return value and identity value have this type.
+/// </typeparam>
+/// <typeparam name="_Range">
+///     The range type, for example <c>concurrent_unordered_map::range_type</c>. It must be copyable and provide
+///     <c>begin()</c>, <c>end()</c>, <c>is_divisible()</c> and <c>split()</c>, which moves the upper part of the
+///     range into a new range and returns it.
+/// </typeparam>
+/// <param name="_Rng">
+///     The range to reduce.
+/// </param>
+/// <param name="_Identity">
+///     The identity value, used as the initial value of the reduction of each group of pieces.
+/// </param>
+/// <param name="_Range_fun">
+///     The functor <c>_Reduce_type (_Range::iterator, _Range::iterator, _Reduce_type)</c> that reduces one piece,
+///     starting from the given value.
+/// </param>
+/// <param name="_Sym_fun">
+///     The associative functor <c>_Reduce_type (_Reduce_type, _Reduce_type)</c> that combines partial results.
+/// </param>
+/// <returns>
+///     The result of the reduction.
+/// </returns>
+/**/
+template<typename _Reduce_type, typename _Range, typename _Range_reduce_fun, typename _Sym_reduce_fun>
+inline _Reduce_type parallel_reduce_range(const _Range& _Rng, const _Reduce_type& _Identity,
+    const _Range_reduce_fun &_Range_fun, const _Sym_reduce_fun &_Sym_fun)
+{
+    typedef typename std::vector<_Range>::const_iterator _Piece_iterator;
 
-    for(size_t _I = 0; _I < _Cpu_num - 1; _I++)
-    {
-        size_t _Next = _Begin_index + _Step;
+    std::vector<_Range> _Pieces;
+    details::_Split_range(_Rng, _Pieces);
 
-        // Add remaining to each chunk
-        if (_NumRemaining)
+    return parallel_reduce(_Pieces.begin(), _Pieces.end(), _Identity,
+        [&_Range_fun](_Piece_iterator _Begin, _Piece_iterator _End, _Reduce_type _Init)->_Reduce_type
+    {
+        for (; _Begin != _End; ++_Begin)
         {
-            --_NumRemaining;
-            ++_Next;
+            _Init = _Range_fun(_Begin->begin(), _Begin->end(), _Init);
         }
 
-        // New up a task_handle "in-place", in the array preallocated on the stack
-        new (_Tasks + _I) task_handle<_Worker>(_Worker(_Begin + _Begin_index, _Begin + _Next, _Fun));
-        _Holder._IncrementConstructedElemsCount();
-
-        // Run each of the chunk _Tasks in parallel
-        _Tg.run(_Tasks[_I]);
-        _Begin_index = _Next;
-    }
-
-    task_handle<_Worker> _Tail(_Worker(_Begin + _Begin_index, _End, _Fun));
-    _Tg.run_and_wait(_Tail);
+        return _Init;
+    },
+        _Sym_fun);
 }
 
-// The parallel worker executor for forward iterators
-// Divide chunks on the fly
-template <typename _Forward_iterator, typename _Function, int _Default_worker_size, int _Default_chunk_size>
-struct _Parallel_reduce_forward_executor_helper
+namespace details
 {
-    typedef _Parallel_reduce_fixed_worker<_Forward_iterator, _Function> _Worker_class;
-    mutable std::auto_ptr<task_handle<_Worker_class>> _Workers;
-    int _Worker_size;
-
-    _Parallel_reduce_forward_executor_helper(_Forward_iterator &_First, _Forward_iterator _Last, const _Function& _Func):
-    _Workers(static_cast<task_handle<_Worker_class> *>(Concurrency::Alloc(sizeof(task_handle<_Worker_class>) * _Default_worker_size)))
+    //
+    // _MallocaArrayHolder is used when the allocation size is known up front, and the memory must be allocated in a contiguous space
+    //
+    template<typename _ElemType>
+    class _MallocaArrayHolder
     {
-        _Worker_size = 0;
-        while (_Worker_size < _Default_worker_size && _First != _Last)
-        {
-            // Copy the range _Head
-            _Forward_iterator _Head = _First;
+    public:
 
-            // Read from forward iterator
-            for (size_t _I = 0; _I < _Default_chunk_size && _First != _Last; ++_I, ++_First) 
-            {
-                // Body is empty
-            }
+        _MallocaArrayHolder() : _M_ElemArray(NULL), _M_ElemsConstructed(0) {}
 
-            // _First will be the end of current chunk
-            new (_Workers.get() + _Worker_size++) task_handle<_Worker_class>(_Worker_class(_Head, _First, _Func));
+        // _Initialize takes the pointer to the memory allocated by the user via _malloca
+        void _Initialize(_ElemType * _Elem)
+        {
+            _M_ElemArray = _Elem;
+            _M_ElemsConstructed = 0;
         }
-    }
-
-    _Parallel_reduce_forward_executor_helper(const _Parallel_reduce_forward_executor_helper &_Other): 
-    _Workers(_Other._Workers), _Worker_size(_Other._Worker_size)
-    {
-    }
 
-    void operator ()() const
-    {
-        structured_task_group _Tg;
-        for(int _I = 0; _I < _Worker_size; _I++)
+        // Register the next slot for destruction. Because we only keep the index of the last slot to be destructed,
+        // this method must be called sequentially from 0 to N where N < _ElemCount.
+        void _IncrementConstructedElemsCount()
         {
-            _Tg.run(_Workers.get()[_I]);
+            _M_ElemsConstructed++;
         }
-        _Tg.wait();
-    }
 
-    ~_Parallel_reduce_forward_executor_helper()
-    {
-        if (_Workers.get())
+        virtual ~_MallocaArrayHolder()
         {
-            for (int _I = 0; _I < _Worker_size; _I++)
+            for( size_t _I=0; _I < _M_ElemsConstructed; ++_I )
             {
-                _Workers.get()[_I].~task_handle<_Worker_class>();
+                _M_ElemArray[_I]._ElemType::~_ElemType();
             }
-            Concurrency::Free(_Workers.release());
+            // Works even when object was not initialized, i.e. _M_ElemArray == NULL
+            _freea(_M_ElemArray);
         }
-    }
+    private:
+        _ElemType * _M_ElemArray;
+        size_t     _M_ElemsConstructed;
+
+        // not supposed to be copy-constructed or assigned
+        _MallocaArrayHolder(const _MallocaArrayHolder & );
+        _MallocaArrayHolder&  operator = (const _MallocaArrayHolder & );
+    };
 };
 
-template <typename _Forward_iterator, typename _Function>
-void _Parallel_reduce_forward_executor(_Forward_iterator _First, _Forward_iterator _Last, const _Function& _Func, task_group& _Task_group)
-{
-    const static int _Internal_worker_number = 1024, _Default_chunk_size = 512;
-    typedef _Parallel_reduce_fixed_worker<_Forward_iterator, _Function> _Worker_class;
+// Disable C4180: qualifier applied to function type has no meaning; ignored
+// Warning fires for passing Foo function pointer to parallel_for instead of &Foo.
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable: 4180)
+#endif
 
-    structured_task_group _Worker_group;
-    Concurrency::samples::details::_MallocaArrayHolder<task_handle<_Worker_class>> _Holder;
-    task_handle<_Worker_class>* _Workers = static_cast<task_handle<_Worker_class>*>(_malloca(_Internal_worker_number * sizeof(task_handle<_Worker_class>)));
-    _Holder._Initialize(_Workers);
+// Forward declarations; the overloads below refer to each other and to the helpers that follow them
+template<typename _Ty, typename _Sym_fun>
+class _Order_combinable;
 
-    // Start execution first
-    int _Index = 0;
-    while (_Index < _Internal_worker_number && _First != _Last)
-    {
-        // Copy the range _Head
-        _Forward_iterator _Head = _First;
+template <typename _Ty, typename _Sub_function, typename _Combinable_type>
+struct _Reduce_functor_helper;
 
-        // Read from forward iterator
-        for (size_t _I = 0; _I < _Default_chunk_size && _First != _Last; ++_I, ++_First)
-        {
-            // Body is empty
-        };
+template<typename _Forward_iterator, typename _Functor>
+class _Parallel_reduce_fixed_worker;
 
-        // Create a new task, _First is range _End
-        new (_Workers + _Index) task_handle<_Worker_class>(_Worker_class(_Head, _First, _Func));
-        _Holder._IncrementConstructedElemsCount();
-        _Worker_group.run(_Workers[_Index]);
-        ++_Index;
+template <typename _Worker, typename _Random_iterator, typename _Function>
+void _Parallel_reduce_random_executor(_Random_iterator _Begin, _Random_iterator _End, const _Function& _Fun);
+
+template <typename _Forward_iterator, typename _Function>
+void _Parallel_reduce_forward_executor(_Forward_iterator _First, _Forward_iterator _Last, const _Function& _Func, task_group& _Task_group);
+
+template<typename _Forward_iterator, typename _Sym_reduce_fun>
+inline typename std::iterator_traits<_Forward_iterator>::value_type parallel_reduce(_Forward_iterator _Begin, _Forward_iterator _End, 
+    const typename std::iterator_traits<_Forward_iterator>::value_type &_Identity, _Sym_reduce_fun _Sym_fun);
+
+/// <summary>
+///     A function object that returns the smaller of its two arguments, the first one if they are equivalent.
+///     <c>parallel_reduce</c> recognizes it over contiguous ranges of arithmetic values and uses a vectorizable kernel.
+/// </summary>
+/**/
+template<typename _Ty>
+struct minimum
+{
+    _Ty operator()(const _Ty &_Left, const _Ty &_Right) const
+    {
+        return (_Right < _Left) ? _Right : _Left;
     }
+};
 
-    // Divide and append the left
-    while (_First != _Last)
+/// <summary>
+///     A function object that returns the larger of its two arguments, the first one if they are equivalent.
+///     <c>parallel_reduce</c> recognizes it over contiguous ranges of arithmetic values and uses a vectorizable kernel.
+/// </summary>
+/**/
+template<typename _Ty>
+struct maximum
+{
+    _Ty operator()(const _Ty &_Left, const _Ty &_Right) const
     {
-        _Task_group.run(_Parallel_reduce_forward_executor_helper<_Forward_iterator, _Function, _Internal_worker_number, _Default_chunk_size>(_First, _Last, _Func));
+        return (_Left < _Right) ? _Right : _Left;
     }
+};
 
-    _Worker_group.wait();
-}
+// Whether the iterator points into contiguous storage of _Ty: a pointer or a vector iterator
+template<typename _Iterator, typename _Ty>
+struct _Is_contiguous_iterator
+{
+    static const bool value = std::is_same<_Iterator, _Ty *>::value || std::is_same<_Iterator, const _Ty *>::value
+        || std::is_same<_Iterator, typename std::vector<_Ty>::iterator>::value || std::is_same<_Iterator, typename std::vector<_Ty>::const_iterator>::value;
+};
 
-#pragma warning(pop)
+// Whether a reduction is one of the arithmetic operators that have a vectorizable kernel
+template<typename _Ty, typename _Sym_reduce_fun>
+struct _Is_vectorizable_reduction
+{
+    static const bool value = std::is_arithmetic<_Ty>::value && !std::is_same<_Ty, bool>::value
+        && (std::is_same<_Sym_reduce_fun, std::plus<_Ty>>::value || std::is_same<_Sym_reduce_fun, minimum<_Ty>>::value 
+            || std::is_same<_Sym_reduce_fun, maximum<_Ty>>::value);
+};
 
+// The number of independent accumulators of the vectorizable kernel. It hides the latency of the operator, and the 
+// compiler packs the accumulators into the SIMD registers of whatever instruction set it targets.
+#pragma push_macro("_REDUCE_KERNEL_ACCUMULATORS")
+#undef _REDUCE_KERNEL_ACCUMULATORS
+#define _REDUCE_KERNEL_ACCUMULATORS 8
 
-// Disable C4180: qualifier applied to function type has no meaning; ignored
-// Warning fires for passing Foo function pointer to parallel_for instead of &Foo.
-#pragma warning(push)
-#pragma warning(disable: 4180)
-
-//
-// Dispatch the execution and handle the condition that all of the iterators are random access
-//
-template<typename _Any_input_traits, typename _Any_output_traits>
-struct _Unary_transform_impl_helper
-{
-    template<typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
-    static void _Parallel_transform_unary_impl(_Input_iterator _Begin, _Input_iterator _End, _Output_iterator& _Result, const _Unary_operator& _Unary_op)
-    {
-        task_group _Tg;
-        _Parallel_transform_unary_impl2(_Begin, _End, _Result, _Unary_op, _Tg);
-        _Tg.wait();
-    }
-};
-
-template<>
-struct _Unary_transform_impl_helper<std::random_access_iterator_tag, std::random_access_iterator_tag>
+// Reduces [_First, _Last) with independent accumulators that each take every _REDUCE_KERNEL_ACCUMULATORS-th element,
+// and then combines them. This changes the association of the operator, which parallel_reduce allows anyway.
+template<typename _Ty, typename _Sym_reduce_fun>
+_Ty _Reduce_contiguous_kernel(const _Ty *_First, const _Ty *_Last, _Ty _Init, const _Sym_reduce_fun &_Sym_fun)
 {
-    template<typename _Random_input_iterator, typename _Random_output_iterator, typename _Unary_operator>
-    static void _Parallel_transform_unary_impl(_Random_input_iterator _Begin, _Random_input_iterator _End, 
-        _Random_output_iterator& _Result, const _Unary_operator& _Unary_op)
+    if (_Last - _First >= 2 * _REDUCE_KERNEL_ACCUMULATORS)
     {
-        if (_Begin < _End)
+        _Ty _Acc[_REDUCE_KERNEL_ACCUMULATORS];
+        for (int _I = 0; _I < _REDUCE_KERNEL_ACCUMULATORS; ++_I)
         {
-            Concurrency::_Parallel_for_impl(static_cast<size_t>(0), static_cast<size_t>(_End - _Begin), static_cast<size_t>(1), 
-                [_Begin, &_Result, &_Unary_op](size_t _Index)
-            {
-                _Result[_Index] = _Unary_op(_Begin[_Index]);
-            });
-            _Result += _End - _Begin;
+            _Acc[_I] = _First[_I];
         }
-    }
-};
-
-template<typename _Any_input_traits1, typename _Any_input_traits2, typename _Any_output_traits>
-struct _Binary_transform_impl_helper
-{
-
-    template<typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
-    static void _Parallel_transform_binary_impl(_Input_iterator1 _Begin1, _Input_iterator1 _End1, _Input_iterator2 _Begin2, 
-        _Output_iterator& _Result, const _Binary_operator& _Binary_op)
-    {
-        task_group _Tg;
-        _Parallel_transform_binary_impl2(_Begin1, _End1, _Begin2, _Result, _Binary_op, _Tg);
-        _Tg.wait();
-    }
-};
 
-template<>
-struct _Binary_transform_impl_helper<std::random_access_iterator_tag, std::random_access_iterator_tag, std::random_access_iterator_tag>
-{
-    template<typename _Random_input_iterator1, typename _Random_input_iterator2, typename _Random_output_iterator, typename _Binary_operator>
-    static void _Parallel_transform_binary_impl(_Random_input_iterator1 _Begin1, _Random_input_iterator1 _End1, 
-        _Random_input_iterator2 _Begin2, _Random_output_iterator& _Result, const _Binary_operator& _Binary_op)
-    {
-        if (_Begin1 < _End1)
+        for (_First += _REDUCE_KERNEL_ACCUMULATORS; _Last - _First >= _REDUCE_KERNEL_ACCUMULATORS; _First += _REDUCE_KERNEL_ACCUMULATORS)
         {
-            Concurrency::_Parallel_for_impl(static_cast<size_t>(0), static_cast<size_t>(_End1 - _Begin1), static_cast<size_t>(1), 
-                [_Begin1, _Begin2, &_Result, &_Binary_op](size_t _Index)
+            for (int _I = 0; _I < _REDUCE_KERNEL_ACCUMULATORS; ++_I)
             {
-                _Result[_Index] = _Binary_op(_Begin1[_Index], _Begin2[_Index]);
-            });
-            _Result += _End1 - _Begin1;
+                _Acc[_I] = _Sym_fun(_Acc[_I], _First[_I]);
+            }
         }
-    }
-};
-
-//
-// The implementation for at least one of the iterator is forward iterator
-//
-template <typename _Forward_iterator, typename _Iterator_kind>
-class _Iterator_helper
-{
-public:
-    static const size_t _Size = 1024;
-    typedef typename std::iterator_traits<_Forward_iterator>::value_type value_type;
-
-    _Iterator_helper()
-    {
-        static_assert(!std::is_same<_Iterator_kind, std::input_iterator_tag>::value 
-            && !std::is_same<_Iterator_kind, std::output_iterator_tag>::value,
-            "iterator can not be input_iterator or output_iterator.");
-    }
-
-    size_t _Populate(_Forward_iterator& _First, _Forward_iterator _Last)
-    {
-        size_t _Length = 0;
-        static_assert(std::is_lvalue_reference<decltype(*_First)>::value, "lvalue required for forward iterator operator *");
 
-        for (size_t _Index=0; (_Index < _Size) && (_First != _Last); _Index++)
+        for (int _Width = _REDUCE_KERNEL_ACCUMULATORS / 2; _Width > 0; _Width /= 2)
         {
-            // We only support l-value here, so it's safe
-            _M_element_array[_Length++] = &(*_First++);
+            for (int _I = 0; _I < _Width; ++_I)
+            {
+                _Acc[_I] = _Sym_fun(_Acc[_I], _Acc[_I + _Width]);
+            }
         }
 
-        return _Length;
-    }
-
-    void _Populate(_Forward_iterator& _First, size_t _Length)
-    {
-        for (size_t _Index=0; _Index < _Length; _Index++)
-        {
-            _M_element_array[_Index] = &(*_First++);
-        }
+        _Init = _Sym_fun(_Init, _Acc[0]);
     }
 
-    void _Store(const value_type& _Elem, size_t _Index) const
+    while (_First != _Last)
     {
-        *(_M_element_array[_Index]) = _Elem;
+        _Init = _Sym_fun(_Init, *_First++);
     }
 
-    typename std::iterator_traits<_Forward_iterator>::reference _Load(size_t _Index) const
-    {
-        return *(_M_element_array[_Index]);
-    }
+    return _Init;
+}
 
-private:
-    typename std::iterator_traits<_Forward_iterator>::pointer _M_element_array[_Size];
-};
+#pragma pop_macro("_REDUCE_KERNEL_ACCUMULATORS")
 
-template <typename _Random_iterator>
-class _Iterator_helper<_Random_iterator, std::random_access_iterator_tag>
+// The range reduce function built from a symmetric reduce function: a plain loop, or the vectorizable kernel when the 
+// range is contiguous and the reduction is a known arithmetic operator
+template<typename _Forward_iterator, typename _Sym_reduce_fun, 
+    bool _Vectorize = _Is_contiguous_iterator<_Forward_iterator, typename std::iterator_traits<_Forward_iterator>::value_type>::value
+        && _Is_vectorizable_reduction<typename std::iterator_traits<_Forward_iterator>::value_type, _Sym_reduce_fun>::value>
+struct _Range_reduce_function
 {
-public:
-    static const size_t _Size = 1024;
-    typedef typename std::iterator_traits<_Random_iterator>::value_type value_type;
+    typedef typename std::remove_cv<typename std::iterator_traits<_Forward_iterator>::value_type>::type _Reduce_type;
 
-    _Iterator_helper()
+    _Sym_reduce_fun _Sym_fun;
+
+    _Range_reduce_function(const _Sym_reduce_fun &_Fun) : _Sym_fun(_Fun)
     {
     }
 
-    size_t _Populate(_Random_iterator& _First, _Random_iterator _Last)
+    _Reduce_type operator()(_Forward_iterator _Begin, _Forward_iterator _End, _Reduce_type _Init) const
     {
-        std::iterator_traits<_Random_iterator>::difference_type _Range = _Last - _First;
-        std::iterator_traits<_Random_iterator>::difference_type _Sized = _Size;
-        _M_first = _First;
-
-        if (_Range > _Sized)
-        {
-            _First += _Size;
-            return _Size;
-        }
-        else
+        while (_Begin != _End)
         {
-            _First += _Range;
-            return static_cast<size_t>(_Range);
+            _Init = _Sym_fun(_Init, *_Begin++); 
         }
-    }
-
-    void _Populate(_Random_iterator& _First, size_t _Length)
-    {
-        _M_first = _First;
-        _First += _Length;
-    }
-
-    void _Store(const value_type& _Elem, size_t _Index) const
-    {
-        _M_first[_Index] = _Elem;
-    }
 
-    typename std::iterator_traits<_Random_iterator>::reference _Load(size_t _Index) const
-    {
-        // We only support l-value here
-        return _M_first[_Index];
+        return _Init;
     }
-
-private:
-    _Random_iterator _M_first;
 };
 
-template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
-class _Parallel_transform_binary_helper
+template<typename _Forward_iterator, typename _Sym_reduce_fun>
+struct _Range_reduce_function<_Forward_iterator, _Sym_reduce_fun, true>
 {
-public:
-    _Parallel_transform_binary_helper(_Input_iterator1& _First1, _Input_iterator1 _Last1, _Input_iterator2& _First2, 
-        _Output_iterator& _Result, const _Binary_operator& _Binary_op) :
-    _M_binary_op(_Binary_op), _M_len(0)
-    {
-        _M_len = _M_input_helper1._Populate(_First1, _Last1);
-        _M_input_helper2._Populate(_First2, _M_len);
-        _M_output_helper._Populate(_Result, _M_len);
-    }
+    typedef typename std::remove_cv<typename std::iterator_traits<_Forward_iterator>::value_type>::type _Reduce_type;
 
-    void operator()() const
-    {
-        // Invoke parallel_for on the batched up array of elements
-        Concurrency::_Parallel_for_impl(static_cast<size_t>(0), _M_len, static_cast<size_t>(1),
-            [this] (size_t _Index)
-        {
-            _M_output_helper._Store(_M_binary_op(_M_input_helper1._Load(_Index), _M_input_helper2._Load(_Index)), _Index);
-        });
-    }
-
-private:
-
-    _Iterator_helper<_Input_iterator1, typename std::iterator_traits<_Input_iterator1>::iterator_category>   _M_input_helper1;
-    _Iterator_helper<_Input_iterator2, typename std::iterator_traits<_Input_iterator2>::iterator_category>   _M_input_helper2;
-    _Iterator_helper<_Output_iterator, typename std::iterator_traits<_Output_iterator>::iterator_category>   _M_output_helper;
-    const _Binary_operator&                                                                                  _M_binary_op;
-    size_t                                                                                                   _M_len;
-
-    _Parallel_transform_binary_helper const & operator=(_Parallel_transform_binary_helper const&);    // no assignment operator
-};
+    _Sym_reduce_fun _Sym_fun;
 
-template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
-void _Parallel_transform_binary_impl2(_Input_iterator1 _First1, _Input_iterator1 _Last1, _Input_iterator2 _First2, _Output_iterator &_Result,
-    const _Binary_operator& _Binary_op, task_group& _Tg)
-{
-    // This functor will be copied on the heap and will execute the chunk in parallel
+    _Range_reduce_function(const _Sym_reduce_fun &_Fun) : _Sym_fun(_Fun)
     {
-        _Parallel_transform_binary_helper<_Input_iterator1, _Input_iterator2, _Output_iterator, _Binary_operator> functor(_First1, _Last1, _First2, _Result, _Binary_op);
-        _Tg.run(functor);
     }
 
-    // If there is a tail, push the tail
-    if (_First1 != _Last1)
+    _Reduce_type operator()(_Forward_iterator _Begin, _Forward_iterator _End, _Reduce_type _Init) const
     {
-        _Tg.run(
-            [=, &_Result, &_Binary_op, &_Tg]
-        {
-            _Parallel_transform_binary_impl2(_First1, _Last1, _First2, _Result, _Binary_op, _Tg);
-        });
-    }
-}
-
-template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
-class _Parallel_transform_unary_helper
-{
-public:
-    _Parallel_transform_unary_helper(_Input_iterator& _First, _Input_iterator _Last, _Output_iterator &_Result, const _Unary_operator& _Unary_op) :
-        _M_unary_op(_Unary_op), _M_len(0)
-        {
-            _M_len = _M_input_helper._Populate(_First, _Last);
-            _M_output_helper._Populate(_Result, _M_len);
-        }
-
-        void operator()() const
+        if (_Begin == _End)
         {
-            // Invoke parallel_for on the batched up array of elements
-            Concurrency::_Parallel_for_impl(static_cast<size_t>(0), _M_len, static_cast<size_t>(1),
-                [this] (size_t _Index)
-            {
-                _M_output_helper._Store(_M_unary_op(_M_input_helper._Load(_Index)), _Index);
-            });
+            return _Init;
         }
 
-private:
-
-    _Iterator_helper<_Input_iterator, typename std::iterator_traits<_Input_iterator>::iterator_category>   _M_input_helper;
-    _Iterator_helper<_Output_iterator, typename std::iterator_traits<_Output_iterator>::iterator_category> _M_output_helper;
-    const _Unary_operator&                                                                                     _M_unary_op;
-    size_t                                                                                              _M_len;
-
-    _Parallel_transform_unary_helper const & operator=(_Parallel_transform_unary_helper const&);    // no assignment operator
-};
-
-template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
-void _Parallel_transform_unary_impl2(_Input_iterator _First, _Input_iterator _Last, _Output_iterator &_Result, 
-    const _Unary_operator& _Unary_op, task_group& _Tg)
-{
-    // This functor will be copied on the heap and will execute the chunk in parallel
-    {
-        _Parallel_transform_unary_helper<_Input_iterator, _Output_iterator, _Unary_operator> functor(_First, _Last, _Result, _Unary_op);
-        _Tg.run(functor);
+        const _Reduce_type *_First = &*_Begin;
+        return _Reduce_contiguous_kernel(_First, _First + (_End - _Begin), _Init, _Sym_fun);
     }
+};
 
-    // If there is a tail, push the tail
-    if (_First != _Last)
-    {
-        _Tg.run(
-            [=, &_Result, &_Unary_op, &_Tg]
-        {
-            _Parallel_transform_unary_impl2(_First, _Last, _Result, _Unary_op, _Tg);
-        });
-    }
-}
+template<typename _Reduce_type, typename _Forward_iterator, typename _Range_reduce_fun, typename _Sym_reduce_fun>
+inline _Reduce_type parallel_reduce(_Forward_iterator _Begin, _Forward_iterator _End, const _Reduce_type& _Identity, 
+    const _Range_reduce_fun &_Range_fun, const _Sym_reduce_fun &_Sym_fun);
 
 /// <summary>
-///     This template function is semantically equivalent to <c>std::transform</c>, except that
-///     the iteration is done in parallel and ordering is unspecified. 
+///     This template function is semantically similar with <c>std::accumulate</c>, except that it requires associativity (not commutativity) 
+///     for the reduce functor and an identity value instead of the initial value in std::accumulate. The execution will be parallelized 
+///     to fully utilize all CPUs, the execution order of each chunk is not determined.
 /// </summary>
-/// <typeparam name="_Input_iterator">
-///     The type of input iterator.
+/// <typeparam name="_Forward_iterator">
+///     The iterator type of input range, it must at least to be a <c>forward_iterator</c>.
 /// </typeparam>
-/// <typeparam name="_Output_iterator">
-///     The type of output iterator.
+/// <param name="_Begin">
+///     The position of the first element to be included for reduce.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for reduce.
+/// </param>
+/// <param name="_Identity">
+///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
+/// </param>
+/// <returns>
+///     The result of the reduction.
+/// </returns>
+/// <remarks>
+///     For the first function overload, the iterator's value_type <c>T</c> must be the same as the identity value type as well as the reduction 
+///     result type. 
+///     <para>The <c>T T::operator + (T)</c> is required to reduce elements in each chunk and sub results reduced from chunks. Particularly, for 
+///     the first phase reduction, operator, <c>T = T + T</c> will be applied in each chunk with the identity value as the initial value. In the
+///     second phase, the operator <c>T = T + T</c> will be applied to reduce the sub results of first phase reduce. </para>
+///     <para>For the second function overload, the iterator's value_type <c>T</c> must be the same as the initial value type as well as the 
+///     reduction result type. A symmetric binary functor <c>_Sym_fun</c>: <c>T (T, T)</c> is required to reduce elements in each chunk and sub 
+///     results reduced from chunks. Particularly, for the first phase reduce, functor <c>_Sym_fun</c>: <c>T (T, T)</c> will be applied on each 
+///     chunk with the identity value as the initial value. In the second phase,<c>_Sym_fun</c>: <c>T (T, T)</c> will be used to reduce sub results 
+///     from the first phase.</para>
+///     <para>For the third function overload, the iterator's value_type <c>T</c> can be different from the identity value type or the reduce result 
+///     type <c>_Reduce_type</c>. The range reduce functor <c>_Range_fun: _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> is 
+///     required in first phase reduce, and symmetric binary functor <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> is required in the 
+///     second phase reduce. Particularly, for the first phase reduce, functor <c>_Range_fun: 
+///     _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> will be applied with the identity value as the initial value. In the 
+///     second phase, <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> will be applied to reduce the sub results from first phase, and the 
+///     result will be returned as final result.</para>
+///     <para>For the first two function overloads, when the range is a pointer or <c>vector</c> iterator range of arithmetic values and the 
+///     reduce functor is <c>std::plus</c>, <c>minimum</c> or <c>maximum</c>, each chunk is reduced with several independent accumulators,
+///     which the compiler can keep in SIMD registers.</para>
+///     <para>The user should not have any assumptions on chunk division.</para>
+/// </remarks>
+/**/
+template<typename _Forward_iterator>
+inline typename std::iterator_traits<_Forward_iterator>::value_type parallel_reduce(
+    _Forward_iterator _Begin, _Forward_iterator _End, const typename std::iterator_traits<_Forward_iterator>::value_type &_Identity)
+{
+    return parallel_reduce(_Begin, _End, _Identity, std::plus<typename std::iterator_traits<_Forward_iterator>::value_type>());
+}
+
+/// <summary>
+///     This template function is semantically similar with <c>std::accumulate</c>, except that it requires associativity (not commutativity) 
+///     for the reduce functor and an identity value instead of the initial value in std::accumulate. The execution will be parallelized 
+///     to fully utilize all CPUs, the execution order of each chunk is not determined.
+/// </summary>
+/// <typeparam name="_Forward_iterator">
+///     The iterator type of input range, it must at least to be a <c>forward_iterator</c>.
 /// </typeparam>
-/// <typeparam name="_Unary_operator">
-///     The unary functor type to be executed on each iteration.
+/// <typeparam name="_Sym_reduce_fun">
+///     The symmetric reduce function type <c>_Reduce_type (_Reduce_type, _Reduce_type)</c>. 
+///     This type (return type and arguments type) should be consistent with the output type of <c>_Range_reduce_fun</c> and
+///     return type of this <c>parallel_reduce</c> function.
 /// </typeparam>
-/// <param name="_First">
-///     The position of the first element to be included in input iterator.
+/// <param name="_Begin">
+///     The position of the first element to be included for reduce.
 /// </param>
-/// <param name="_Last">
-///     The position of the first element not to be included in input iterator.
+/// <param name="_End">
+///     The position of the first element not to be included for reduce.
 /// </param>
-/// <param name="_Result">
-///     The position of first element in output iterator.
+/// <param name="_Identity">
+///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
 /// </param>
-/// <param name="_Unary_op">
-///     Function object to be executed on each iteration, a unary operator.
+/// <param name="_Sym_fun">
+///     The reduce function that will be used in the second phase reduce, for more information please refer to remarks.
 /// </param>
 /// <returns>
-///     The position after last result element in output iterator.
+///     The result of the reduction.
 /// </returns>
 /// <remarks>
-///     <para>For the first overloading function, function argument <c> _Unary_op </c> must support 
-///     <c>operator()(T)</c> where <c>T</c> is the item type of the range being iterated over.</para>
-///     <para>For the second overloading function, function argument <c> _Binary_op </c> must support 
-///     <c>operator()(T, U)</c> where <c>T</c>, <c>U</c> are value_types of the two input iterators.</para>
-///     <para>For more information, see <see cref="Parallel Algorithms"/>.</para>
+///     For the first function overload, the iterator's value_type <c>T</c> must be the same as the identity value type as well as the reduction 
+///     result type. 
+///     <para>The <c>T T::operator + (T)</c> is required to reduce elements in each chunk and sub results reduced from chunks. Particularly, for 
+///     the first phase reduction, operator, <c>T = T + T</c> will be applied in each chunk with the identity value as the initial value. In the
+///     second phase, the operator <c>T = T + T</c> will be applied to reduce the sub results of first phase reduce. </para>
+///     <para>For the second function overload, the iterator's value_type <c>T</c> must be the same as the initial value type as well as the 
+///     reduction result type. A symmetric binary functor <c>_Sym_fun</c>: <c>T (T, T)</c> is required to reduce elements in each chunk and sub 
+///     results reduced from chunks. Particularly, for the first phase reduce, functor <c>_Sym_fun</c>: <c>T (T, T)</c> will be applied on each 
+///     chunk with the identity value as the initial value. In the second phase,<c>_Sym_fun</c>: <c>T (T, T)</c> will be used to reduce sub results 
+///     from the first phase.</para>
+///     <para>For the third function overload, the iterator's value_type <c>T</c> can be different from the identity value type or the reduce result 
+///     type <c>_Reduce_type</c>. The range reduce functor <c>_Range_fun: _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> is 
+///     required in first phase reduce, and symmetric binary functor <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> is required in the 
+///     second phase reduce. Particularly, for the first phase reduce, functor <c>_Range_fun: 
+///     _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> will be applied with the identity value as the initial value. In the 
+///     second phase, <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> will be applied to reduce the sub results from first phase, and the 
+///     result will be returned as final result.</para>
+///     <para>For the first two function overloads, when the range is a pointer or <c>vector</c> iterator range of arithmetic values and the 
+///     reduce functor is <c>std::plus</c>, <c>minimum</c> or <c>maximum</c>, each chunk is reduced with several independent accumulators,
+///     which the compiler can keep in SIMD registers.</para>
+///     <para>The user should not have any assumptions on chunk division.</para>
 /// </remarks>
 /**/
-template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
-_Output_iterator parallel_transform(_Input_iterator _First, _Input_iterator _Last, _Output_iterator _Result, const _Unary_operator& _Unary_op)
+template<typename _Forward_iterator, typename _Sym_reduce_fun>
+inline typename std::iterator_traits<_Forward_iterator>::value_type parallel_reduce(_Forward_iterator _Begin, _Forward_iterator _End, 
+    const typename std::iterator_traits<_Forward_iterator>::value_type &_Identity, _Sym_reduce_fun _Sym_fun)
 {
-#if _MSC_VER > 1600
-    return ::concurrency::parallel_transform(_First, _Last, _Result, _Unary_op);
-#else
-    typedef std::iterator_traits<_Input_iterator>::iterator_category _Input_iterator_type;
-    typedef std::iterator_traits<_Output_iterator>::iterator_category _Output_iterator_type;
-
-    if (_First != _Last)
-    {
-        _Unary_transform_impl_helper<_Input_iterator_type, _Output_iterator_type>
-            ::_Parallel_transform_unary_impl(_First, _Last, _Result, _Unary_op);
-    }
-
-    return _Result;
-#endif
+    return parallel_reduce(_Begin, _End, _Identity, _Range_reduce_function<_Forward_iterator, _Sym_reduce_fun>(_Sym_fun), _Sym_fun);
 }
 
 /// <summary>
-///     This template function is semantically equivalent to <c>std::transform</c>, except that
-///     the iteration is done in parallel and ordering is unspecified.
+///     This template function is semantically similar with <c>std::accumulate</c>, except that it requires associativity (not commutativity) 
+///     for the reduce functor and an identity value instead of the initial value in std::accumulate. The execution will be parallelized 
+///     to fully utilize all CPUs, the execution order of each chunk is not determined.
 /// </summary>
-/// <typeparam name="_Input_iterator1">
-///     The type of first input iterator.
+/// <typeparam name="_Reduce_type">
+///     The type that the input will reduce to, which can be different from the input element type. 
+///     The return value and identity value will has this type.
 /// </typeparam>
-/// <typeparam name="_Input_iterator2">
-///     The type of second input iterator.
+/// <typeparam name="_Forward_iterator">
+///     The iterator type of input range, it must at least to be a <c>forward_iterator</c>.
 /// </typeparam>
-/// <typeparam name="_Output_iterator">
-///     The type of output iterator.
+/// <typeparam name="_Range_reduce_fun">
+///     The type of reduce function with type <c>_Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c>. 
+///     The type of this function should be consistent with the input iterators and identity value.
 /// </typeparam>
-/// <typeparam name="_Binary_operator">
-///     The binary functor type to be executed on each iteration.
+/// <typeparam name="_Sym_reduce_fun">
+///     The symmetric reduce function type <c>_Reduce_type (_Reduce_type, _Reduce_type)</c>. 
+///     This type (return type and arguments type) should be consistent with the output type of <c>_Range_reduce_fun</c> and
+///     return type of this <c>parallel_reduce</c> function.
 /// </typeparam>
-/// <param name="_First1">
-///     The position of the first element to be included in first input iterator.
+/// <param name="_Begin">
+///     The position of the first element to be included for reduce.
 /// </param>
-/// <param name="_Last1">
-///     The position of the first element not to be included in first input iterator.
+/// <param name="_End">
+///     The position of the first element not to be included for reduce.
 /// </param>
-/// <param name="_First2">
-///     The position of the first element to be included in second input iterator.
+/// <param name="_Identity">
+///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
 /// </param>
-/// <param name="_Result">
-///     The position of first element in output iterator.
+/// <param name="_Range_fun">
+///     The reduce function that will be used in the first phase reduce, for more information please refer to remarks.
 /// </param>
-/// <param name="_Binary_op">
-///     Function object to be executed on each iteration, a binary operator.
+/// <param name="_Sym_fun">
+///     The reduce function that will be used in the second phase reduce, for more information please refer to remarks.
 /// </param>
 /// <returns>
-///     The position after the last result element in output iterator.
+///     The result of the reduction.
 /// </returns>
 /// <remarks>
-///     <para>For the first overloading function, function argument <c> _Unary_op </c> must support 
-///     <c>operator()(T)</c> where <c>T</c> is the item type of the range being iterated over.</para>
-///     <para>For the second overloading function, function argument <c> _Binary_op </c> must support 
-///     <c>operator()(T, U)</c> where <c>T</c>, <c>U</c> are value_types of the two input iterators.</para>
-///     <para>For more information, see <see cref="Parallel Algorithms"/>.</para>
+///     For the first function overload, the iterator's value_type <c>T</c> must be the same as the identity value type as well as the reduction 
+///     result type. 
+///     <para>The <c>T T::operator + (T)</c> is required to reduce elements in each chunk and sub results reduced from chunks. Particularly, for 
+///     the first phase reduction, operator, <c>T = T + T</c> will be applied in each chunk with the identity value as the initial value. In the
+///     second phase, the operator <c>T = T + T</c> will be applied to reduce the sub results of first phase reduce. </para>
+///     <para>For the second function overload, the iterator's value_type <c>T</c> must be the same as the initial value type as well as the 
+///     reduction result type. A symmetric binary functor <c>_Sym_fun</c>: <c>T (T, T)</c> is required to reduce elements in each chunk and sub 
+///     results reduced from chunks. Particularly, for the first phase reduce, functor <c>_Sym_fun</c>: <c>T (T, T)</c> will be applied on each 
+///     chunk with the identity value as the initial value. In the second phase,<c>_Sym_fun</c>: <c>T (T, T)</c> will be used to reduce sub results 
+///     from the first phase.</para>
+///     <para>For the third function overload, the iterator's value_type <c>T</c> can be different from the identity value type or the reduce result 
+///     type <c>_Reduce_type</c>. The range reduce functor <c>_Range_fun: _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> is 
+///     required in first phase reduce, and symmetric binary functor <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> is required in the 
+///     second phase reduce. Particularly, for the first phase reduce, functor <c>_Range_fun: 
+///     _Reduce_type (_Forward_iterator, _Forward_iterator, _Reduce_type)</c> will be applied with the identity value as the initial value. In the 
+///     second phase, <c>_Sym_fun: _Reduce_type (_Reduce_type, _Reduce_type) </c> will be applied to reduce the sub results from first phase, and the 
+///     result will be returned as final result.</para>
+///     <para>For the first two function overloads, when the range is a pointer or <c>vector</c> iterator range of arithmetic values and the 
+///     reduce functor is <c>std::plus</c>, <c>minimum</c> or <c>maximum</c>, each chunk is reduced with several independent accumulators,
+///     which the compiler can keep in SIMD registers.</para>
+///     <para>The user should not have any assumptions on chunk division.</para>
 /// </remarks>
 /**/
-template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
-_Output_iterator parallel_transform(_Input_iterator1 _First1, _Input_iterator1 _Last1, _Input_iterator2 _First2, 
-    _Output_iterator _Result, const _Binary_operator& _Binary_op)
+template<typename _Reduce_type, typename _Forward_iterator, typename _Range_reduce_fun, typename _Sym_reduce_fun>
+inline _Reduce_type parallel_reduce(_Forward_iterator _Begin, _Forward_iterator _End, const _Reduce_type& _Identity, 
+    const _Range_reduce_fun &_Range_fun, const _Sym_reduce_fun &_Sym_fun)
 {
-#if _MSC_VER > 1600
-    return ::concurrency::parallel_transform(_First1, _Last1, _First2, _Result, _Binary_op);
-#else
-    typedef std::iterator_traits<_Input_iterator1>::iterator_category _Input_iterator_type1;
-    typedef std::iterator_traits<_Input_iterator2>::iterator_category _Input_iterator_type2;
-    typedef std::iterator_traits<_Output_iterator>::iterator_category _Output_iterator_type;
-
-    if (_First1 != _Last1)
-    {
-        _Binary_transform_impl_helper<_Input_iterator_type1, _Input_iterator_type2, _Output_iterator_type>
-            ::_Parallel_transform_binary_impl(_First1, _Last1, _First2, _Result, _Binary_op);
-    }
+    static_assert(!std::is_same<typename std::iterator_traits<_Forward_iterator>::iterator_category, std::input_iterator_tag>::value
+        && !std::is_same<typename std::iterator_traits<_Forward_iterator>::iterator_category, std::output_iterator_tag>::value, 
+        "iterator can not be input_iterator or output_iterator.");
 
-    return _Result;
-#endif
+    return _Parallel_reduce_impl(_Begin, _End,
+        _Reduce_functor_helper<_Reduce_type, _Range_reduce_fun, 
+        _Order_combinable<_Reduce_type, _Sym_reduce_fun>>(_Identity, _Range_fun, _Order_combinable<_Reduce_type, _Sym_reduce_fun>(_Sym_fun)),
+        typename std::iterator_traits<_Forward_iterator>::iterator_category());
 }
 
-#pragma warning(pop)
+#pragma push_macro("_DETERMINISTIC_REDUCE_CHUNK_SIZE")
 
+#undef _DETERMINISTIC_REDUCE_CHUNK_SIZE
 
-namespace details
+// The number of elements in each leaf of the deterministic reduce tree. Changing it changes the rounding of floating point results.
+#define _DETERMINISTIC_REDUCE_CHUNK_SIZE 2048
+
+// Reduces the chunks [_First_chunk, _Last_chunk) of the range with a tree whose shape only depends on the number of chunks:
+// the chunks are split in half, each half is reduced, and the left result is combined with the right one.
+template<typename _Reduce_type, typename _Random_iterator, typename _Range_reduce_fun, typename _Sym_reduce_fun>
+_Reduce_type _Parallel_deterministic_reduce_impl(_Random_iterator _Begin, size_t _Size, size_t _First_chunk, size_t _Last_chunk, 
+    const _Reduce_type& _Identity, const _Range_reduce_fun &_Range_fun, const _Sym_reduce_fun &_Sym_fun)
 {
-    /// <summary>
-    ///     An implementation of parallel partial sum that splits the work into smallest possible chunks
-    ///     using recursion. This is efficient when the binary operation is dependent on the values as work
-    ///     stealing would provide automatic load balancing
-    /// </summary>
-    /// <param name="out_randomIterator">
-    ///     Type of the iterator to the container that will hold the output values
-    /// </param>
-    /// <param name="size_type">
-    ///     Type of the size of the container
-    /// </param>
-    /// <param name="BinaryOperator">
-    ///     The binary operator that computes the sum of two values
-    /// </param>
-    template <typename out_randomIterator, typename size_type, typename BinaryOperator>
-    void parallel_partial_sum_impl_recursive(out_randomIterator begin, size_type size, size_type skip, BinaryOperator sumFunction)
+    if (_Last_chunk - _First_chunk == 1)
     {
-        if (size <= 1)
-        {
-            return;
-        }
-
-        size_type halfLength = size / 2;
-
-        // pairwise combine
-        parallel_for<size_t>(0, halfLength, [begin, skip, sumFunction](size_type index)
-        {
-            out_randomIterator loc = begin + (index * 2 * skip);
-            *(loc + skip) = sumFunction(*loc, *(loc + skip));
-        });
+        size_t _Chunk_begin = _First_chunk * _DETERMINISTIC_REDUCE_CHUNK_SIZE;
+        size_t _Chunk_end = (std::min)(_Chunk_begin + _DETERMINISTIC_REDUCE_CHUNK_SIZE, _Size);
+        return _Range_fun(_Begin + _Chunk_begin, _Begin + _Chunk_end, _Identity);
+    }
 
-        // Recursively prefix scan the pairwise computations
-        parallel_partial_sum_impl_recursive(begin + skip, halfLength, skip*2, sumFunction);
+    size_t _Mid_chunk = _First_chunk + (_Last_chunk - _First_chunk) / 2;
+    _Reduce_type _Left(_Identity), _Right(_Identity);
 
-        // Pairwise combine
-        parallel_for<size_t>(0, (size % 2 == 0) ? halfLength - 1 : halfLength, [begin, skip, sumFunction](size_type index)
-        {
-            out_randomIterator loc = begin + (index * 2 * skip) + skip;
-            *(loc + skip) = sumFunction(*loc, *(loc + skip));
-        });
-    }
+    structured_task_group _Tg;
+    auto _Left_task = make_task([&]
+    {
+        _Left = _Parallel_deterministic_reduce_impl(_Begin, _Size, _First_chunk, _Mid_chunk, _Identity, _Range_fun, _Sym_fun);
+    });
 
-    /// <summary>
-    ///     An implementation of parallel partial sum that splits the work into fixed chunks.
-    ///     This is efficient when the binary operation is relatively fast and independent of the values.
-    /// </summary>
-    /// <param name="input_iterator">
-    ///     Type of the iterator to the container that holds the input values
-    /// </param>
-    /// <param name="out_randomIterator">
-    ///     Type of the iterator to the container that will hold the output values
-    /// </param>
-    /// <param name="BinaryOperator">
-    ///     The binary operator that computes the sum of two values
-    /// </param>
-    template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator>
-    void parallel_partial_sum_impl(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction)
+    _Tg.run(_Left_task);
+    _Tg.run_and_wait([&]
     {
-        typedef typename std::iterator_traits<out_randomIterator>::value_type value_type;
-        typedef std::iterator_traits<in_randomIterator>::difference_type size_type;
+        _Right = _Parallel_deterministic_reduce_impl(_Begin, _Size, _Mid_chunk, _Last_chunk, _Identity, _Range_fun, _Sym_fun);
+    });
 
-        // We will use the number of virtual processors to compute the number of chunks
-        const int oversubscription = 2;
-        size_type numChunks = static_cast<size_type>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors() * oversubscription);
-        size_type size = end - begin;
+    return _Sym_fun(_Left, _Right);
+}
 
-        if (size < numChunks)
-        {
-            // Not enough iterations to warrant parallel computation
-            std::partial_sum(begin, end, result, sumFunction);            
-            return;
-        }
-
-        std::vector<value_type> tempSum(numChunks);
-
-        // Determine the range for each chunk
-        size_type chunkSize = size / numChunks;
-        _ASSERTE(chunkSize >= 1);
-
-        parallel_for(size_type(0), numChunks, [begin, end, result, sumFunction, chunkSize, numChunks, &tempSum](size_type index)
-        {
-            // Compute partial sum for this chunk.
-
-            in_randomIterator start = begin + (index * chunkSize);
-            in_randomIterator last = (index == (numChunks - 1)) ? end : start + chunkSize;
-
-            out_randomIterator resultStart = result + (index * chunkSize);
-            out_randomIterator resultEnd = resultStart + (last - start);
-
-            std::partial_sum(start, last, resultStart, sumFunction);
-
-            // Store the upper bounds into intermediate buffer.
-            tempSum[index] = *(resultEnd-1);
-        });
-
-        // Compute partial sum on the intermediate buffer
-        std::partial_sum(tempSum.begin(), tempSum.end(), tempSum.begin(), sumFunction);
-
-        // The first chunk is already correct. For the other chunks propagate the partial
-        // sum from the intermediate buffer
-        parallel_for(size_type(1), numChunks, [begin, end, result, sumFunction, chunkSize, numChunks, tempSum](size_type index)
-        {
-            // Add the partial sum from the previous chunk to all the
-            // elements in this chunk
-            in_randomIterator start = begin + (index * chunkSize);
-            in_randomIterator last = (index == (numChunks - 1)) ? end : start + chunkSize;
-
-            out_randomIterator resultStart = result + (index * chunkSize);
-            out_randomIterator resultEnd = resultStart + (last - start);
-
-            for (out_randomIterator iter = resultStart; iter < resultEnd; ++iter)
-            {
-                *iter = sumFunction(*iter, tempSum[index-1]);
-            }
-        });
-    }
-}
 /// <summary>
-///     Compute inclusive partial sum
+///     This template function computes the same reduction as <c>parallel_reduce</c>, but the result does not depend on 
+///     the scheduling or on the number of processors: the range is split into fixed chunks, and their results are 
+///     combined with a fixed balanced tree. A non-associative reduction, such as a floating point sum, therefore gives 
+///     bit for bit the same result on every run and every machine.
 /// </summary>
-/// <param name="in_randomIterator">
-///     Type of the iterator to the container that holds the input values
-/// </param>
-/// <param name="out_randomIterator">
-///     Type of the iterator to the container that will hold the output values
+/// <typeparam name="_Reduce_type">
+///     The type that the input will reduce to, which can be different from the input element type. 
+///     The return value and identity value will has this type.
+/// </typeparam>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of input range, it must be a <c>random_access_iterator</c>.
+/// </typeparam>
+/// <typeparam name="_Range_reduce_fun">
+///     The type of reduce function with type <c>_Reduce_type (_Random_iterator, _Random_iterator, _Reduce_type)</c>. 
+/// </typeparam>
+/// <typeparam name="_Sym_reduce_fun">
+///     The symmetric reduce function type <c>_Reduce_type (_Reduce_type, _Reduce_type)</c>. 
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for reduce.
 /// </param>
-/// <param name="BinaryOperator">
-///     The binary operator that computes the sum of two values
+/// <param name="_End">
+///     The position of the first element not to be included for reduce.
 /// </param>
-template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator>
-void parallel_partial_sum_fixed(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction)
-{
-    return details::parallel_partial_sum_impl(begin, end, result, sumFunction);
-}
-
-/// <summary>
-///     Compute inclusive partial sum
-/// </summary>
-/// <param name="in_randomIterator">
-///     Type of the iterator to the container that holds the input values
+/// <param name="_Identity">
+///     The identity value has the <c>_Reduce_type</c> type; it will be directly passed to <c>_Range_fun</c> function.
 /// </param>
-/// <param name="out_randomIterator">
-///     Type of the iterator to the container that will hold the output values
+/// <param name="_Range_fun">
+///     The reduce function that will be applied to each chunk with the identity value as the initial value.
 /// </param>
-/// <param name="BinaryOperator">
-///     The binary operator that computes the sum of two values
+/// <param name="_Sym_fun">
+///     The reduce function that will be used to combine the results of two adjacent groups of chunks.
 /// </param>
-template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator>
-void parallel_partial_sum(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction)
+/// <returns>
+///     The result of the reduction.
+/// </returns>
+/// <remarks>
+///     This overload reduces each chunk with <c>_Range_fun</c> and combines the results of the chunks with <c>_Sym_fun</c>.
+///     The overload without <c>_Range_fun</c> uses <c>_Sym_fun</c>: <c>T (T, T)</c> for both, and the overload without either 
+///     uses <c>T T::operator + (T)</c>.
+///     <para>The chunks and the tree depend only on the number of elements. Since every chunk starts from the identity value, 
+///     the result for a floating point sum also differs from a serial <c>std::accumulate</c>, usually by being more accurate.
+///     See <c>parallel_compensated_sum</c> for a floating point sum whose result is as accurate as the inputs allow.</para>
+/// </remarks>
+/**/
+template<typename _Reduce_type, typename _Random_iterator, typename _Range_reduce_fun, typename _Sym_reduce_fun>
+inline _Reduce_type parallel_deterministic_reduce(_Random_iterator _Begin, _Random_iterator _End, const _Reduce_type& _Identity, 
+    const _Range_reduce_fun &_Range_fun, const _Sym_reduce_fun &_Sym_fun)
 {
-    typedef std::iterator_traits<in_randomIterator>::difference_type size_type;
+    static_assert(std::is_same<typename std::iterator_traits<_Random_iterator>::iterator_category, std::random_access_iterator_tag>::value, 
+        "iterator must be a random_access_iterator.");
 
-    // Copy input to output first
-    out_randomIterator out = result;
-    for (in_randomIterator in = begin; in < end; ++in)
+    size_t _Size = static_cast<size_t>(_End - _Begin);
+    if (_Size == 0)
     {
-        *out = *in;
-        ++out;                
+        return _Identity;
     }
 
-    // Perform in place partial sum
-    return details::parallel_partial_sum_impl_recursive(result, (end-begin), size_type(1), sumFunction);
+    size_t _Chunk_num = (_Size + _DETERMINISTIC_REDUCE_CHUNK_SIZE - 1) / _DETERMINISTIC_REDUCE_CHUNK_SIZE;
+    return _Parallel_deterministic_reduce_impl(_Begin, _Size, static_cast<size_t>(0), _Chunk_num, _Identity, _Range_fun, _Sym_fun);
 }
 
 /// <summary>
-///     Compute inclusive partial sum. This overload performs the operation in place.
+///     This template function computes the same reduction as <c>parallel_reduce</c>, but the result does not depend on 
+///     the scheduling or on the number of processors. See the overload that takes a range reduce function for details.
 /// </summary>
-/// <param name="in_randomIterator">
-///     Type of the iterator to the container that holds the input values
-/// </param>
-/// <param name="BinaryOperator">
-///     The binary operator that computes the sum of two values
-/// </param>
-template <typename in_randomIterator, typename BinaryOperator>
-void parallel_partial_sum(in_randomIterator begin, in_randomIterator end, BinaryOperator sumFunction)
+/**/
+template<typename _Random_iterator, typename _Sym_reduce_fun>
+inline typename std::iterator_traits<_Random_iterator>::value_type parallel_deterministic_reduce(_Random_iterator _Begin, _Random_iterator _End, 
+    const typename std::iterator_traits<_Random_iterator>::value_type &_Identity, _Sym_reduce_fun _Sym_fun)
 {
-    typedef std::iterator_traits<in_randomIterator>::difference_type size_type;
-    return details::parallel_partial_sum_impl_recursive(begin, (end-begin), size_type(1), sumFunction);
+    return parallel_deterministic_reduce(_Begin, _End, _Identity, _Range_reduce_function<_Random_iterator, _Sym_reduce_fun>(_Sym_fun), _Sym_fun);
 }
+
 /// <summary>
-///  merge two sorted sequences in parallel
+///     This template function computes the same reduction as <c>parallel_reduce</c>, but the result does not depend on 
+///     the scheduling or on the number of processors. See the overload that takes a range reduce function for details.
 /// </summary>
-/// <param name="ran_it">
-///     Type of the iterator to the container that holds the input values
-/// </param>
-/// <param name="out_it">
-///     Type of the iterator to the container that holds the output values
-/// </param>
-template<typename ran_it, typename out_it>
-inline void parallel_merge(ran_it first1, ran_it last1, ran_it first2, ran_it last2, out_it out)
+/**/
+template<typename _Random_iterator>
+inline typename std::iterator_traits<_Random_iterator>::value_type parallel_deterministic_reduce(
+    _Random_iterator _Begin, _Random_iterator _End, const typename std::iterator_traits<_Random_iterator>::value_type &_Identity)
 {
-    int sequence1Length = last1 - first1;
-    int sequence2Length = last2 - first2;
+    return parallel_deterministic_reduce(_Begin, _End, _Identity, std::plus<typename std::iterator_traits<_Random_iterator>::value_type>());
+}
 
-    if (min(sequence2Length, sequence1Length ) < 512)
-    {
-        std::merge( first1, last1, first2, last2, out);
-        return;
-    }
+// A floating point sum that carries the rounding error of its additions in a second value (Neumaier's variant of Kahan summation)
+template<typename _Ty>
+struct _Compensated_sum
+{
+    _Ty _Sum;
+    _Ty _Compensation;
 
-    if( sequence1Length < sequence2Length )
+    _Compensated_sum() : _Sum(0), _Compensation(0)
     {
-        std::swap(first1, first2);
-        std::swap(last1, last2);
     }
 
-    ran_it mid1 = first1 + (last1-first1)/2;
+    void _Add(_Ty _Value)
+    {
+        _Ty _New_sum = _Sum + _Value;
 
-    ran_it m2 = std::lower_bound( first2, last2, *mid1 );
+        // Whichever of the two is larger is exact in the sum, the low order bits of the other one are lost
+        if (std::abs(_Sum) >= std::abs(_Value))
+        {
+            _Compensation += (_Sum - _New_sum) + _Value;
+        }
+        else
+        {
+            _Compensation += (_Value - _New_sum) + _Sum;
+        }
 
-    structured_task_group tasks;
+        _Sum = _New_sum;
+    }
 
-    auto t = make_task([&](){parallel_merge(first1, mid1, first2, m2, out);});
-    tasks.run(t);
+    _Compensated_sum _Combine(const _Compensated_sum &_Other) const
+    {
+        _Compensated_sum _Result = *this;
+        _Result._Add(_Other._Sum);
+        _Result._Compensation += _Other._Compensation;
+        return _Result;
+    }
+};
 
-    out_it out_right = out;
-    out_right += (mid1 - first1) + (m2 - first2);
+/// <summary>
+///     This template function computes the sum of a range of floating point values with compensated (Kahan) summation,
+///     in a fixed order like <c>parallel_deterministic_reduce</c>. The rounding errors of the additions are accumulated 
+///     separately and added back at the end, so the result is close to the exact sum rounded once, and bit for bit the 
+///     same on every run and every machine.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of input range, it must be a <c>random_access_iterator</c> over <c>float</c>, <c>double</c> or 
+///     <c>long double</c>.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for the sum.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for the sum.
+/// </param>
+/// <returns>
+///     The sum of the elements.
+/// </returns>
+/**/
+template<typename _Random_iterator>
+inline typename std::iterator_traits<_Random_iterator>::value_type parallel_compensated_sum(_Random_iterator _Begin, _Random_iterator _End)
+{
+    typedef typename std::remove_cv<typename std::iterator_traits<_Random_iterator>::value_type>::type _Value_type;
+    typedef _Compensated_sum<_Value_type> _Reduce_type;
 
-    tasks.run_and_wait([&](){parallel_merge(mid1, last1, m2, last2, out_right );});
-}
+    static_assert(std::is_floating_point<_Value_type>::value, "parallel_compensated_sum requires floating point values.");
 
-#pragma push_macro("_MAX_NUM_TASKS_PER_CORE")
-#pragma push_macro("_FINE_GRAIN_CHUNK_SIZE")
-#pragma push_macro("_SORT_MAX_RECURSION_DEPTH")
+    _Reduce_type _Sum = parallel_deterministic_reduce(_Begin, _End, _Reduce_type(), 
+        [](_Random_iterator _Begin, _Random_iterator _End, _Reduce_type _Init)->_Reduce_type 
+    {
+        while (_Begin != _End)
+        {
+            _Init._Add(*_Begin++);
+        }
 
-// This number is used to control dynamic task splitting
-// The ideal chunk (task) division is that the number of cores is equal to the number of tasks, but it will 
-// perform very poorly when tasks are not balanced. The simple solution is to allocate more tasks than number 
-// of cores.  _MAX_NUM_TASKS_PER_CORE provides a maximum number of tasks that will be allocated per core.
-// If this number is too small, the load balancing problem will affect efficiency very seriously, especially
-// when the compare operation is expensive.
-//
-// Note that this number is a maximum number -- the dynamic partition system will reduce the number of partitions
-// per core based on the dynamic load. If all cores are very busy, the number of partitions will shrink to 
-// reduce the scheduler overhead.
-//
-// Initially, the total tasks(chunks) number of partitions "_Div_num" will be: core number * _MAX_NUM_TASKS_PER_CORE.
-// The _Div_num will be divided by 2 after each task splitting. There are two special numbers for _Div_num:
-//     1. When _Div_num reaches the point that _Div_num < _MAX_NUM_TASKS_PER_CORE, it means we have split more tasks than cores.
-//     2. When _Div_num reaches the point that _Div_num <= 1, it means stop splitting more tasks and begin sorting serially.
-#define _MAX_NUM_TASKS_PER_CORE 1024
+        return _Init;
+    },
+        [](const _Reduce_type &_Left, const _Reduce_type &_Right) { return _Left._Combine(_Right); });
 
-// This is a number mainly is used to control the sampling and dynamic task splitting strategies.
-// If the user configurable minimal divisible chunk size (default is 2048) is smaller than FINE_GRAIN_CHUNK_SIZE,
-// the random sampling algorithm for quicksort will enter fine-grained mode, and take a strategy that reduces the sampling 
-// overhead. Also, the dynamic task splitting will enter fine-grained mode, which will split as many tasks as possible.
-#define _FINE_GRAIN_CHUNK_SIZE 512
+    return _Sum._Sum + _Sum._Compensation;
+}
 
-// This is the maximum depth that the quicksort will be called recursively.  If we allow too far, a stack overflow may occur.
-#define _SORT_MAX_RECURSION_DEPTH 64
+#pragma pop_macro("_DETERMINISTIC_REDUCE_CHUNK_SIZE")
 
-template<typename _Random_iterator, typename _Function>
-inline size_t _Median_of_three(const _Random_iterator &_Begin, size_t _A, size_t _B, size_t _C, const _Function &_Func, bool &_Potentially_equal)
+// Ordered serial combinable object
+template<typename _Ty, typename _Sym_fun>
+class _Order_combinable
 {
-    _Potentially_equal = false;
-    if (_Func(_Begin[_A], _Begin[_B]))
+public:
+    // Only write once, limited contention will be caused
+    struct _Bucket
     {
-        if (_Func(_Begin[_A], _Begin[_C]))
-        {
-            return _Func(_Begin[_B], _Begin[_C]) ? _B : _C;
-        }
-        else
+        // Allocate enough space in the Bucket to hold a value
+        char _Value[(sizeof(_Ty) / sizeof(char))];
+        _Bucket * _Next;
+
+        _Bucket(_Bucket *_N)
         {
-            return _A;
+            _Next = _N;
         }
-    }
-    else
-    {
-        if (_Func(_Begin[_B], _Begin[_C]))
+
+        void _Insert(_Bucket *_Item)
         {
-            return _Func(_Begin[_A], _Begin[_C]) ? _A : _C;
+            // No need to lock, only one thread will insert
+            _Item->_Next = _Next;
+            _Next = _Item;
         }
-        else
+
+        // Construct value in bucket
+        void _Put(const _Ty &_Cur)
         {
-            _Potentially_equal = true;
-            return _B;
+            new(reinterpret_cast<_Ty *>(&_Value)) _Ty(_Cur);
         }
-    }
-}
+    };
 
-template<typename _Random_iterator, typename _Function>
-inline size_t _Median_of_nine(const _Random_iterator &_Begin, size_t _Size, const _Function &_Func, bool &_Potentially_equal)
-{
-    size_t _Offset = _Size / 8;
-    size_t _A = _Median_of_three(_Begin, 0, _Offset, _Offset * 2, _Func, _Potentially_equal),
-        _B = _Median_of_three(_Begin, _Offset * 3, _Offset * 4, _Offset * 5, _Func, _Potentially_equal),
-        _C = _Median_of_three(_Begin, _Offset * 6, _Offset * 7, _Size - 1, _Func, _Potentially_equal);
-    _B = _Median_of_three(_Begin, _A, _B, _C, _Func, _Potentially_equal);
+private:
+    const _Sym_fun &_M_fun;
+    size_t _M_number;
+    _Bucket *_M_root;
+    _Order_combinable &operator =(const _Order_combinable &other);
 
-    if (_Potentially_equal)
+public:
+    _Bucket *_Construct(_Bucket *_Par = 0)
     {
-        _Potentially_equal = !_Func(_Begin[_C], _Begin[_A]);
+        _Bucket * _Ret = static_cast<_Bucket *>(Concurrency::Alloc(sizeof(_Bucket)));
+        return new(_Ret)_Bucket(_Par);
     }
 
-    return _B;
-}
-
-// _Potentially_equal means that potentially all the values in the buffer are equal to the pivot value
-template<typename _Random_iterator, typename _Function>
-inline size_t _Select_median_pivot(const _Random_iterator &_Begin, size_t _Size, const _Function &_Func, const size_t _Chunk_size, bool &_Potentially_equal)
-{
-    // Base on different chunk size, apply different sampling optimization
-    if (_Chunk_size < _FINE_GRAIN_CHUNK_SIZE && _Size <= max(_Chunk_size * 4, static_cast<size_t>(15)))
+    _Order_combinable(const _Sym_fun &_Fun): _M_fun(_Fun)
     {
-        bool _Never_care_equal;
-        return _Median_of_three(_Begin, 0, _Size / 2, _Size - 1, _Func, _Never_care_equal);
+        _M_root = 0;
+        _M_number = 0;
     }
-    else
-    {
-        return _Median_of_nine(_Begin, _Size, _Func, _Potentially_equal);
-    }
-}
-
-// Find out two middle points for two sorted arrays by binary search so that the number of total elements on the left part of two middle points is equal
-// to the number of total elements on the right part of two sorted arrays and all elements on the left part is smaller than right part. 
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
-size_t _Search_mid_point(const _Random_iterator &_Begin1, size_t &_Len1, const _Random_buffer_iterator &_Begin2, size_t &_Len2, const _Function &_Func)
-{
-    size_t _Len = (_Len1 + _Len2) / 2, _Index1 = 0, _Index2 = 0;
 
-    while (_Index1 < _Len1 && _Index2 < _Len2)
+    ~_Order_combinable()
     {
-        size_t _Mid1 = (_Index1 + _Len1) / 2, _Mid2 = (_Index2 + _Len2) / 2;
-        if (_Func(_Begin1[_Mid1], _Begin2[_Mid2]))
+        while (_M_root)
         {
-            if (_Mid1 + _Mid2 < _Len)
-            {
-                _Index1 = _Mid1 + 1;
-            }
-            else
-            {
-                _Len2 = _Mid2;
-            }
+            _Bucket *_Cur = _M_root;
+            _M_root = _M_root->_Next;
+            reinterpret_cast<_Ty &>(_Cur->_Value).~_Ty();
+            Concurrency::Free(_Cur);
         }
-        else
+    }
+
+    // Serially combine and release the list, return result
+    _Ty _Serial_combine_release()
+    {
+        _Ty _Ret(reinterpret_cast<_Ty &>(_M_root->_Value));
+        _Bucket *_Cur = _M_root;
+        _M_root = _M_root->_Next;
+
+        while (_M_root)
         {
-            if (_Mid1 + _Mid2 < _Len)
-            {
-                _Index2 = _Mid2 + 1;
-            }
-            else
-            {
-                _Len1 = _Mid1;
-            }
+            reinterpret_cast<_Ty &>(_Cur->_Value).~_Ty();
+            Concurrency::Free(_Cur);
+            _Cur = _M_root;
+            _Ret = _M_fun(reinterpret_cast <_Ty &> (_Cur->_Value), _Ret);
+            _M_root = _M_root->_Next;
         }
+
+        reinterpret_cast<_Ty &>(_Cur->_Value).~_Ty();
+        Concurrency::Free(_Cur);
+
+        return _Ret;
+    }
+
+    // allocate a bucket and push back to the list
+    _Bucket *_Unsafe_push_back()
+    {
+        return _M_root = _Construct(_M_root);
     }
+};
 
-    if (_Index1 == _Len1)
+// Implementation for the parallel reduce
+template <typename _Forward_iterator, typename _Function>
+typename _Function::_Reduce_type _Parallel_reduce_impl(_Forward_iterator _First, const _Forward_iterator& _Last, const _Function& _Func, 
+    std::forward_iterator_tag)
+{
+    // Since this is a forward iterator, it is difficult to validate that _First comes before _Last, so
+    // it is up to the user to provide valid range.
+    if (_First != _Last)
     {
-        _Len2 = _Len - _Len1;
+        task_group _Task_group;
+        _Parallel_reduce_forward_executor(_First, _Last, _Func, _Task_group);
+        _Task_group.wait();
+        return _Func._Combinable._Serial_combine_release();
     }
     else
     {
-        _Len1 = _Len - _Len2;
+        return _Func._Identity_value;
     }
-
-    return _Len;
 }
 
-// "move" operation is applied between buffers
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Random_output_iterator, typename _Function>
-void _Merge_chunks(_Random_iterator _Begin1, const _Random_iterator &_End1, _Random_buffer_iterator _Begin2, const _Random_buffer_iterator &_End2, 
-    _Random_output_iterator _Output, const _Function &_Func)
+template <typename _Random_iterator, typename _Function>
+typename _Function::_Reduce_type _Parallel_reduce_impl(_Random_iterator _First, _Random_iterator _Last, const _Function& _Func, 
+    std::random_access_iterator_tag)
 {
-    while (_Begin1 != _End1 && _Begin2 != _End2)
+    typedef _Parallel_reduce_fixed_worker<_Random_iterator, _Function> _Worker_class;
+
+    // Special case for 0, 1 element
+    if (_First >= _Last)
     {
-        if (_Func(*_Begin1, *_Begin2))
-        {
-            *_Output++ = std::move(*_Begin1++);
-        }
-        else
-        {
-            *_Output++ = std::move(*_Begin2++);
-        }
+        return _Func._Identity_value;
     }
-
-    if (_Begin1 != _End1)
+    // Directly compute if size is too small
+    else if (_Last - _First <= 1)
     {
-        std::_Move(_Begin1, _End1, _Output);
+        _Worker_class(_First, _Last, _Func)();
+        return _Func._Combinable._Serial_combine_release();
     }
-    else if (_Begin2 != _End2)
+    else
     {
-        std::_Move(_Begin2, _End2, _Output);
+        // Use fixed ordered chunk partition to schedule works
+        _Parallel_reduce_random_executor<_Worker_class>(_First, _Last, _Func);
+        return _Func._Combinable._Serial_combine_release();
     }
 }
 
-// _Div_num of threads(tasks) merge two chunks in parallel, _Div_num should be power of 2, if not, the largest power of 2 that is
-// smaller than _Div_num will be used
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Random_output_iterator, typename _Function>
-void _Parallel_merge(_Random_iterator _Begin1, size_t _Len1, _Random_buffer_iterator _Begin2, size_t _Len2, _Random_output_iterator _Output, 
-    const _Function &_Func, size_t _Div_num)
+// Helper function assemble all functors
+template <typename _Ty, typename _Sub_function, typename _Combinable_type>
+struct _Reduce_functor_helper
 {
-    // Turn to serial merge or continue splitting chunks base on "_Div_num"
-    if (_Div_num <= 1 || (_Len1 <= 1 && _Len2 <= 1))
+    typedef _Ty _Reduce_type;
+
+    const _Sub_function &_Sub_fun;
+    const _Reduce_type &_Identity_value;
+
+    _Combinable_type &_Combinable;
+
+    typedef typename _Combinable_type::_Bucket Bucket_type;
+
+    _Reduce_functor_helper(const _Reduce_type &_Identity, const _Sub_function &_Sub_fun, _Combinable_type &&comb):
+    _Sub_fun(_Sub_fun), _Identity_value(_Identity), _Combinable(comb)
     {
-        _Merge_chunks(_Begin1, _Begin1 + _Len1, _Begin2, _Begin2 + _Len2, _Output, _Func);
     }
-    else
-    {
-        size_t _Mid_len1 = _Len1, _Mid_len2 = _Len2;
-        size_t _Mid = _Search_mid_point(_Begin1, _Mid_len1, _Begin2, _Mid_len2, _Func);
 
-        structured_task_group _Tg;
-        auto _Handle = make_task([&] 
+private:
+    _Reduce_functor_helper &operator =(const _Reduce_functor_helper &other);
+};
+
+// All the code below is the worker without range stealing
+template<typename _Forward_iterator, typename _Functor>
+class _Parallel_reduce_fixed_worker
+{
+public:
+    // The bucket allocation order will depend on the worker construction order
+    _Parallel_reduce_fixed_worker(_Forward_iterator _Begin, _Forward_iterator _End, const _Functor &_Fun):
+        _M_fun(_Fun), _M_begin(_Begin), _M_end(_End), _M_bucket(_M_fun._Combinable._Unsafe_push_back())
         {
-            _Parallel_merge(_Begin1, _Mid_len1, _Begin2, _Mid_len2, _Output, _Func, _Div_num / 2); 
-        });
-        _Tg.run(_Handle);
+        }
 
-        _Parallel_merge(_Begin1 + _Mid_len1, _Len1 - _Mid_len1, _Begin2 + _Mid_len2, _Len2 - _Mid_len2, _Output + _Mid, _Func, _Div_num / 2);
+        _Parallel_reduce_fixed_worker(const _Parallel_reduce_fixed_worker &_Other):
+        _M_fun(_Other._M_fun), _M_begin(_Other._M_begin), _M_end(_Other._M_end), _M_bucket(_Other._M_bucket)
+        {
+        }
 
-        _Tg.wait();
-    }
-}
+        void operator ()() const
+        {
+            _M_bucket->_Put(_M_fun._Sub_fun(_M_begin, _M_end, _M_fun._Identity_value));
+        }
 
-// Return current sorting byte from key 
-template<typename _Ty, typename _Function>
-inline size_t _Radix_key(const _Ty& _Val, size_t _Radix, _Function _Proj_func)
-{
-    return static_cast<size_t>(_Proj_func(_Val) >> static_cast<int>(8 * _Radix) & 255);
-}
+private:
+    const _Functor &_M_fun;
+    const _Forward_iterator _M_begin, _M_end;
+    typename _Functor::Bucket_type * const _M_bucket;
+    _Parallel_reduce_fixed_worker &operator =(const _Parallel_reduce_fixed_worker &other);
+};
 
-// One pass of radix sort
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
-void _Integer_radix_pass(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output, size_t _Radix, _Function _Proj_func)
+// the parallel worker executor for fixed iterator
+// it will divide fixed number of chunks
+// almost same as fixed parallel for, except keep the chunk dividing order
+template <typename _Worker, typename _Random_iterator, typename _Function>
+void _Parallel_reduce_random_executor(_Random_iterator _Begin, _Random_iterator _End, const _Function& _Fun)
 {
-    if (!_Size)
-    {
-        return;
-    }
+    size_t _Cpu_num = static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), _Size = _End - _Begin;
 
-    size_t _Pos[256] = {0};
+    structured_task_group _Tg;
+    Concurrency::samples::details::_MallocaArrayHolder<task_handle<_Worker>> _Holder;
+    task_handle<_Worker> *_Tasks = static_cast<task_handle<_Worker> *>(_malloca(sizeof(task_handle<_Worker>) * (_Cpu_num - 1)));
+    _Holder._Initialize(_Tasks);
 
-    for (size_t _I = 0; _I < _Size; _I++)
-    {
-        ++_Pos[_Radix_key(_Begin[_I], _Radix, _Proj_func)];
-    }
+    size_t _Begin_index = 0;
+    size_t _Step = _Size / _Cpu_num;
+    size_t _NumRemaining = _Size - _Step * _Cpu_num;
 
-    for (size_t _I = 1; _I < 256; _I++)
+    for(size_t _I = 0; _I < _Cpu_num - 1; _I++)
     {
-        _Pos[_I] += _Pos[_I - 1];
-    }
+        size_t _Next = _Begin_index + _Step;
 
-    // _Size > 0
-    for (size_t _I = _Size - 1; _I != 0; _I--)
-    {
-        _Output[--_Pos[_Radix_key(_Begin[_I], _Radix, _Proj_func)]] = std::move(_Begin[_I]);
+        // Add remaining to each chunk
+        if (_NumRemaining)
+        {
+            --_NumRemaining;
+            ++_Next;
+        }
+
+        // New up a task_handle "in-place", in the array preallocated on the stack
+        new (_Tasks + _I) task_handle<_Worker>(_Worker(_Begin + _Begin_index, _Begin + _Next, _Fun));
+        _Holder._IncrementConstructedElemsCount();
+
+        // Run each of the chunk _Tasks in parallel
+        _Tg.run(_Tasks[_I]);
+        _Begin_index = _Next;
     }
 
-    _Output[--_Pos[_Radix_key(_Begin[0], _Radix, _Proj_func)]] = std::move(_Begin[0]);
+    task_handle<_Worker> _Tail(_Worker(_Begin + _Begin_index, _End, _Fun));
+    _Tg.run_and_wait(_Tail);
 }
 
-// Serial least-significant-byte radix sort, it will sort base on last "_Radix" number of bytes
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
-void _Integer_radix_sort(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output, 
-    size_t _Radix, _Function _Proj_func, size_t _Deep = 0)
+// The parallel worker executor for forward iterators
+// Divide chunks on the fly
+template <typename _Forward_iterator, typename _Function, int _Default_worker_size, int _Default_chunk_size>
+struct _Parallel_reduce_forward_executor_helper
 {
-    size_t _Cur_radix = 0;
-    if (_Size == 0)
-    {
-        return;
-    }
+    typedef _Parallel_reduce_fixed_worker<_Forward_iterator, _Function> _Worker_class;
+    // Owned; a copy takes ownership, as the task group copies the helper when it runs it
+    mutable task_handle<_Worker_class> * _Workers;
+    int _Worker_size;
 
-    while (_Cur_radix < _Radix)
+    _Parallel_reduce_forward_executor_helper(_Forward_iterator &_First, _Forward_iterator _Last, const _Function& _Func):
+    _Workers(static_cast<task_handle<_Worker_class> *>(Concurrency::Alloc(sizeof(task_handle<_Worker_class>) * _Default_worker_size)))
     {
-        _Integer_radix_pass(_Begin, _Size, _Output, _Cur_radix++, _Proj_func);
-        _Integer_radix_pass(_Output, _Size, _Begin, _Cur_radix++, _Proj_func);
+        _Worker_size = 0;
+        while (_Worker_size < _Default_worker_size && _First != _Last)
+        {
+            // Copy the range _Head
+            _Forward_iterator _Head = _First;
+
+            // Read from forward iterator
+            for (size_t _I = 0; _I < _Default_chunk_size && _First != _Last; ++_I, ++_First) 
+            {
+                // Body is empty
+            }
+
+            // _First will be the end of current chunk
+            new (_Workers + _Worker_size++) task_handle<_Worker_class>(_Worker_class(_Head, _First, _Func));
+        }
     }
 
-    if (_Cur_radix == _Radix)
+    _Parallel_reduce_forward_executor_helper(const _Parallel_reduce_forward_executor_helper &_Other): 
+    _Workers(_Other._Workers), _Worker_size(_Other._Worker_size)
     {
-        _Integer_radix_pass(_Begin, _Size, _Output, _Cur_radix++, _Proj_func);
+        _Other._Workers = NULL;
     }
 
-    // if odd round is passed, then move result back to input buffer
-    if (_Deep + _Radix + 1 & 1)
+    void operator ()() const
     {
-        if (_Radix + 1 & 1)
-        {
-            std::_Move(_Output, _Output + _Size, _Begin);
-        }
-        else
+        structured_task_group _Tg;
+        for(int _I = 0; _I < _Worker_size; _I++)
         {
-            std::_Move(_Begin, _Begin + _Size, _Output);
+            _Tg.run(_Workers[_I]);
         }
+        _Tg.wait();
     }
-}
 
-// Parallel most-significant-byte _Radix sort.
-// In the end, it will turn to serial least-significant-byte radix sort
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
-void _Parallel_integer_radix_sort(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output, 
-    size_t _Radix, _Function _Proj_func, const size_t _Chunk_size, size_t _Deep = 0)
-{
-    // If the chunk _Size is too small, then turn to serial least-significant-byte radix sort
-    if (_Size <= _Chunk_size || _Radix < 1)
+    ~_Parallel_reduce_forward_executor_helper()
     {
-        return _Integer_radix_sort(_Begin, _Size, _Output, _Radix, _Proj_func, _Deep);
+        if (_Workers != NULL)
+        {
+            for (int _I = 0; _I < _Worker_size; _I++)
+            {
+                _Workers[_I].~task_handle<_Worker_class>();
+            }
+            Concurrency::Free(_Workers);
+        }
+    }
+};
+
+template <typename _Forward_iterator, typename _Function>
+void _Parallel_reduce_forward_executor(_Forward_iterator _First, _Forward_iterator _Last, const _Function& _Func, task_group& _Task_group)
+{
+    const static int _Internal_worker_number = 1024, _Default_chunk_size = 512;
+    typedef _Parallel_reduce_fixed_worker<_Forward_iterator, _Function> _Worker_class;
+
+    structured_task_group _Worker_group;
+    Concurrency::samples::details::_MallocaArrayHolder<task_handle<_Worker_class>> _Holder;
+    task_handle<_Worker_class>* _Workers = static_cast<task_handle<_Worker_class>*>(_malloca(_Internal_worker_number * sizeof(task_handle<_Worker_class>)));
+    _Holder._Initialize(_Workers);
+
+    // Start execution first
+    int _Index = 0;
+    while (_Index < _Internal_worker_number && _First != _Last)
+    {
+        // Copy the range _Head
+        _Forward_iterator _Head = _First;
+
+        // Read from forward iterator
+        for (size_t _I = 0; _I < _Default_chunk_size && _First != _Last; ++_I, ++_First)
+        {
+            // Body is empty
+        };
+
+        // Create a new task, _First is range _End
+        new (_Workers + _Index) task_handle<_Worker_class>(_Worker_class(_Head, _First, _Func));
+        _Holder._IncrementConstructedElemsCount();
+        _Worker_group.run(_Workers[_Index]);
+        ++_Index;
+    }
+
+    // Divide and append the left
+    while (_First != _Last)
+    {
+        _Task_group.run(_Parallel_reduce_forward_executor_helper<_Forward_iterator, _Function, _Internal_worker_number, _Default_chunk_size>(_First, _Last, _Func));
+    }
+
+    _Worker_group.wait();
+}
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+
+// Disable C4180: qualifier applied to function type has no meaning; ignored
+// Warning fires for passing Foo function pointer to parallel_for instead of &Foo.
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning(disable: 4180)
+#endif
+
+template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
+void _Parallel_transform_binary_impl2(_Input_iterator1 _First1, _Input_iterator1 _Last1, _Input_iterator2 _First2, _Output_iterator &_Result,
+    const _Binary_operator& _Binary_op, task_group& _Tg);
+
+template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
+void _Parallel_transform_unary_impl2(_Input_iterator _First, _Input_iterator _Last, _Output_iterator &_Result, 
+    const _Unary_operator& _Unary_op, task_group& _Tg);
+
+//
+// Dispatch the execution and handle the condition that all of the iterators are random access
+//
+template<typename _Any_input_traits, typename _Any_output_traits>
+struct _Unary_transform_impl_helper
+{
+    template<typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
+    static void _Parallel_transform_unary_impl(_Input_iterator _Begin, _Input_iterator _End, _Output_iterator& _Result, const _Unary_operator& _Unary_op)
+    {
+        task_group _Tg;
+        _Parallel_transform_unary_impl2(_Begin, _End, _Result, _Unary_op, _Tg);
+        _Tg.wait();
+    }
+};
+
+template<>
+struct _Unary_transform_impl_helper<std::random_access_iterator_tag, std::random_access_iterator_tag>
+{
+    template<typename _Random_input_iterator, typename _Random_output_iterator, typename _Unary_operator>
+    static void _Parallel_transform_unary_impl(_Random_input_iterator _Begin, _Random_input_iterator _End, 
+        _Random_output_iterator& _Result, const _Unary_operator& _Unary_op)
+    {
+        if (_Begin < _End)
+        {
+            Concurrency::_Parallel_for_impl(static_cast<size_t>(0), static_cast<size_t>(_End - _Begin), static_cast<size_t>(1), 
+                [_Begin, &_Result, &_Unary_op](size_t _Index)
+            {
+                _Result[_Index] = _Unary_op(_Begin[_Index]);
+            });
+            _Result += _End - _Begin;
+        }
+    }
+};
+
+template<typename _Any_input_traits1, typename _Any_input_traits2, typename _Any_output_traits>
+struct _Binary_transform_impl_helper
+{
+
+    template<typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
+    static void _Parallel_transform_binary_impl(_Input_iterator1 _Begin1, _Input_iterator1 _End1, _Input_iterator2 _Begin2, 
+        _Output_iterator& _Result, const _Binary_operator& _Binary_op)
+    {
+        task_group _Tg;
+        _Parallel_transform_binary_impl2(_Begin1, _End1, _Begin2, _Result, _Binary_op, _Tg);
+        _Tg.wait();
+    }
+};
+
+template<>
+struct _Binary_transform_impl_helper<std::random_access_iterator_tag, std::random_access_iterator_tag, std::random_access_iterator_tag>
+{
+    template<typename _Random_input_iterator1, typename _Random_input_iterator2, typename _Random_output_iterator, typename _Binary_operator>
+    static void _Parallel_transform_binary_impl(_Random_input_iterator1 _Begin1, _Random_input_iterator1 _End1, 
+        _Random_input_iterator2 _Begin2, _Random_output_iterator& _Result, const _Binary_operator& _Binary_op)
+    {
+        if (_Begin1 < _End1)
+        {
+            Concurrency::_Parallel_for_impl(static_cast<size_t>(0), static_cast<size_t>(_End1 - _Begin1), static_cast<size_t>(1), 
+                [_Begin1, _Begin2, &_Result, &_Binary_op](size_t _Index)
+            {
+                _Result[_Index] = _Binary_op(_Begin1[_Index], _Begin2[_Index]);
+            });
+            _Result += _End1 - _Begin1;
+        }
+    }
+};
+
+//
+// The implementation for at least one of the iterator is forward iterator
+//
+template <typename _Forward_iterator, typename _Iterator_kind>
+class _Iterator_helper
+{
+public:
+    static const size_t _Size = 1024;
+    typedef typename std::iterator_traits<_Forward_iterator>::value_type value_type;
+
+    _Iterator_helper()
+    {
+        static_assert(!std::is_same<_Iterator_kind, std::input_iterator_tag>::value 
+            && !std::is_same<_Iterator_kind, std::output_iterator_tag>::value,
+            "iterator can not be input_iterator or output_iterator.");
+    }
+
+    size_t _Populate(_Forward_iterator& _First, _Forward_iterator _Last)
+    {
+        size_t _Length = 0;
+        static_assert(std::is_lvalue_reference<decltype(*_First)>::value, "lvalue required for forward iterator operator *");
+
+        for (size_t _Index=0; (_Index < _Size) && (_First != _Last); _Index++)
+        {
+            // We only support l-value here, so it's safe
+            _M_element_array[_Length++] = &(*_First++);
+        }
+
+        return _Length;
+    }
+
+    void _Populate(_Forward_iterator& _First, size_t _Length)
+    {
+        for (size_t _Index=0; _Index < _Length; _Index++)
+        {
+            _M_element_array[_Index] = &(*_First++);
+        }
+    }
+
+    void _Store(const value_type& _Elem, size_t _Index) const
+    {
+        *(_M_element_array[_Index]) = _Elem;
+    }
+
+    typename std::iterator_traits<_Forward_iterator>::reference _Load(size_t _Index) const
+    {
+        return *(_M_element_array[_Index]);
+    }
+
+private:
+    typename std::iterator_traits<_Forward_iterator>::pointer _M_element_array[_Size];
+};
+
+template <typename _Random_iterator>
+class _Iterator_helper<_Random_iterator, std::random_access_iterator_tag>
+{
+public:
+    static const size_t _Size = 1024;
+    typedef typename std::iterator_traits<_Random_iterator>::value_type value_type;
+
+    _Iterator_helper()
+    {
+    }
+
+    size_t _Populate(_Random_iterator& _First, _Random_iterator _Last)
+    {
+        typename std::iterator_traits<_Random_iterator>::difference_type _Range = _Last - _First;
+        typename std::iterator_traits<_Random_iterator>::difference_type _Sized = _Size;
+        _M_first = _First;
+
+        if (_Range > _Sized)
+        {
+            _First += _Size;
+            return _Size;
+        }
+        else
+        {
+            _First += _Range;
+            return static_cast<size_t>(_Range);
+        }
+    }
+
+    void _Populate(_Random_iterator& _First, size_t _Length)
+    {
+        _M_first = _First;
+        _First += _Length;
+    }
+
+    void _Store(const value_type& _Elem, size_t _Index) const
+    {
+        _M_first[_Index] = _Elem;
+    }
+
+    typename std::iterator_traits<_Random_iterator>::reference _Load(size_t _Index) const
+    {
+        // We only support l-value here
+        return _M_first[_Index];
+    }
+
+private:
+    _Random_iterator _M_first;
+};
+
+template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
+class _Parallel_transform_binary_helper
+{
+public:
+    _Parallel_transform_binary_helper(_Input_iterator1& _First1, _Input_iterator1 _Last1, _Input_iterator2& _First2, 
+        _Output_iterator& _Result, const _Binary_operator& _Binary_op) :
+    _M_binary_op(_Binary_op), _M_len(0)
+    {
+        _M_len = _M_input_helper1._Populate(_First1, _Last1);
+        _M_input_helper2._Populate(_First2, _M_len);
+        _M_output_helper._Populate(_Result, _M_len);
+    }
+
+    void operator()() const
+    {
+        // Invoke parallel_for on the batched up array of elements
+        Concurrency::_Parallel_for_impl(static_cast<size_t>(0), _M_len, static_cast<size_t>(1),
+            [this] (size_t _Index)
+        {
+            _M_output_helper._Store(_M_binary_op(_M_input_helper1._Load(_Index), _M_input_helper2._Load(_Index)), _Index);
+        });
+    }
+
+private:
+
+    _Iterator_helper<_Input_iterator1, typename std::iterator_traits<_Input_iterator1>::iterator_category>   _M_input_helper1;
+    _Iterator_helper<_Input_iterator2, typename std::iterator_traits<_Input_iterator2>::iterator_category>   _M_input_helper2;
+    _Iterator_helper<_Output_iterator, typename std::iterator_traits<_Output_iterator>::iterator_category>   _M_output_helper;
+    const _Binary_operator&                                                                                  _M_binary_op;
+    size_t                                                                                                   _M_len;
+
+    _Parallel_transform_binary_helper const & operator=(_Parallel_transform_binary_helper const&);    // no assignment operator
+};
+
+template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
+void _Parallel_transform_binary_impl2(_Input_iterator1 _First1, _Input_iterator1 _Last1, _Input_iterator2 _First2, _Output_iterator &_Result,
+    const _Binary_operator& _Binary_op, task_group& _Tg)
+{
+    // This functor will be copied on the heap and will execute the chunk in parallel
+    {
+        _Parallel_transform_binary_helper<_Input_iterator1, _Input_iterator2, _Output_iterator, _Binary_operator> functor(_First1, _Last1, _First2, _Result, _Binary_op);
+        _Tg.run(functor);
+    }
+
+    // If there is a tail, push the tail
+    if (_First1 != _Last1)
+    {
+        _Tg.run(
+            [=, &_Result, &_Binary_op, &_Tg]
+        {
+            _Parallel_transform_binary_impl2(_First1, _Last1, _First2, _Result, _Binary_op, _Tg);
+        });
+    }
+}
+
+template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
+class _Parallel_transform_unary_helper
+{
+public:
+    _Parallel_transform_unary_helper(_Input_iterator& _First, _Input_iterator _Last, _Output_iterator &_Result, const _Unary_operator& _Unary_op) :
+        _M_unary_op(_Unary_op), _M_len(0)
+        {
+            _M_len = _M_input_helper._Populate(_First, _Last);
+            _M_output_helper._Populate(_Result, _M_len);
+        }
+
+        void operator()() const
+        {
+            // Invoke parallel_for on the batched up array of elements
+            Concurrency::_Parallel_for_impl(static_cast<size_t>(0), _M_len, static_cast<size_t>(1),
+                [this] (size_t _Index)
+            {
+                _M_output_helper._Store(_M_unary_op(_M_input_helper._Load(_Index)), _Index);
+            });
+        }
+
+private:
+
+    _Iterator_helper<_Input_iterator, typename std::iterator_traits<_Input_iterator>::iterator_category>   _M_input_helper;
+    _Iterator_helper<_Output_iterator, typename std::iterator_traits<_Output_iterator>::iterator_category> _M_output_helper;
+    const _Unary_operator&                                                                                     _M_unary_op;
+    size_t                                                                                              _M_len;
+
+    _Parallel_transform_unary_helper const & operator=(_Parallel_transform_unary_helper const&);    // no assignment operator
+};
+
+template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
+void _Parallel_transform_unary_impl2(_Input_iterator _First, _Input_iterator _Last, _Output_iterator &_Result, 
+    const _Unary_operator& _Unary_op, task_group& _Tg)
+{
+    // This functor will be copied on the heap and will execute the chunk in parallel
+    {
+        _Parallel_transform_unary_helper<_Input_iterator, _Output_iterator, _Unary_operator> functor(_First, _Last, _Result, _Unary_op);
+        _Tg.run(functor);
+    }
+
+    // If there is a tail, push the tail
+    if (_First != _Last)
+    {
+        _Tg.run(
+            [=, &_Result, &_Unary_op, &_Tg]
+        {
+            _Parallel_transform_unary_impl2(_First, _Last, _Result, _Unary_op, _Tg);
+        });
+    }
+}
+
+/// <summary>
+///     This template function is semantically equivalent to <c>std::transform</c>, except that
+///     the iteration is done in parallel and ordering is unspecified. 
+/// </summary>
+/// <typeparam name="_Input_iterator">
+///     The type of input iterator.
+/// </typeparam>
+/// <typeparam name="_Output_iterator">
+///     The type of output iterator.
+/// </typeparam>
+/// <typeparam name="_Unary_operator">
+///     The unary functor type to be executed on each iteration.
+/// </typeparam>
+/// <param name="_First">
+///     The position of the first element to be included in input iterator.
+/// </param>
+/// <param name="_Last">
+///     The position of the first element not to be included in input iterator.
+/// </param>
+/// <param name="_Result">
+///     The position of first element in output iterator.
+/// </param>
+/// <param name="_Unary_op">
+///     Function object to be executed on each iteration, a unary operator.
+/// </param>
+/// <returns>
+///     The position after last result element in output iterator.
+/// </returns>
+/// <remarks>
+///     <para>For the first overloading function, function argument <c> _Unary_op </c> must support 
+///     <c>operator()(T)</c> where <c>T</c> is the item type of the range being iterated over.</para>
+///     <para>For the second overloading function, function argument <c> _Binary_op </c> must support 
+///     <c>operator()(T, U)</c> where <c>T</c>, <c>U</c> are value_types of the two input iterators.</para>
+///     <para>For more information, see <see cref="Parallel Algorithms"/>.</para>
+/// </remarks>
+/**/
+template <typename _Input_iterator, typename _Output_iterator, typename _Unary_operator>
+_Output_iterator parallel_transform(_Input_iterator _First, _Input_iterator _Last, _Output_iterator _Result, const _Unary_operator& _Unary_op)
+{
+#if _MSC_VER > 1600
+    return ::concurrency::parallel_transform(_First, _Last, _Result, _Unary_op);
+#else
+    typedef typename std::iterator_traits<_Input_iterator>::iterator_category _Input_iterator_type;
+    typedef typename std::iterator_traits<_Output_iterator>::iterator_category _Output_iterator_type;
+
+    if (_First != _Last)
+    {
+        _Unary_transform_impl_helper<_Input_iterator_type, _Output_iterator_type>
+            ::_Parallel_transform_unary_impl(_First, _Last, _Result, _Unary_op);
+    }
+
+    return _Result;
+#endif
+}
+
+/// <summary>
+///     This template function is semantically equivalent to <c>std::transform</c>, except that
+///     the iteration is done in parallel and ordering is unspecified.
+/// </summary>
+/// <typeparam name="_Input_iterator1">
+///     The type of first input iterator.
+/// </typeparam>
+/// <typeparam name="_Input_iterator2">
+///     The type of second input iterator.
+/// </typeparam>
+/// <typeparam name="_Output_iterator">
+///     The type of output iterator.
+/// </typeparam>
+/// <typeparam name="_Binary_operator">
+///     The binary functor type to be executed on each iteration.
+/// </typeparam>
+/// <param name="_First1">
+///     The position of the first element to be included in first input iterator.
+/// </param>
+/// <param name="_Last1">
+///     The position of the first element not to be included in first input iterator.
+/// </param>
+/// <param name="_First2">
+///     The position of the first element to be included in second input iterator.
+/// </param>
+/// <param name="_Result">
+///     The position of first element in output iterator.
+/// </param>
+/// <param name="_Binary_op">
+///     Function object to be executed on each iteration, a binary operator.
+/// </param>
+/// <returns>
+///     The position after the last result element in output iterator.
+/// </returns>
+/// <remarks>
+///     <para>For the first overloading function, function argument <c> _Unary_op </c> must support 
+///     <c>operator()(T)</c> where <c>T</c> is the item type of the range being iterated over.</para>
+///     <para>For the second overloading function, function argument <c> _Binary_op </c> must support 
+///     <c>operator()(T, U)</c> where <c>T</c>, <c>U</c> are value_types of the two input iterators.</para>
+///     <para>For more information, see <see cref="Parallel Algorithms"/>.</para>
+/// </remarks>
+/**/
+template <typename _Input_iterator1, typename _Input_iterator2, typename _Output_iterator, typename _Binary_operator>
+_Output_iterator parallel_transform(_Input_iterator1 _First1, _Input_iterator1 _Last1, _Input_iterator2 _First2, 
+    _Output_iterator _Result, const _Binary_operator& _Binary_op)
+{
+#if _MSC_VER > 1600
+    return ::concurrency::parallel_transform(_First1, _Last1, _First2, _Result, _Binary_op);
+#else
+    typedef typename std::iterator_traits<_Input_iterator1>::iterator_category _Input_iterator_type1;
+    typedef typename std::iterator_traits<_Input_iterator2>::iterator_category _Input_iterator_type2;
+    typedef typename std::iterator_traits<_Output_iterator>::iterator_category _Output_iterator_type;
+
+    if (_First1 != _Last1)
+    {
+        _Binary_transform_impl_helper<_Input_iterator_type1, _Input_iterator_type2, _Output_iterator_type>
+            ::_Parallel_transform_binary_impl(_First1, _Last1, _First2, _Result, _Binary_op);
+    }
+
+    return _Result;
+#endif
+}
+
+#if defined(_MSC_VER)
+#pragma warning(pop)
+#endif
+
+
+namespace details
+{
+    /// <summary>
+    ///     The identity transformation, used by the scans that don't transform their input.
+    /// </summary>
+    struct scan_identity
+    {
+        template <typename value_type>
+        const value_type& operator()(const value_type& value) const
+        {
+            return value;
+        }
+    };
+
+    /// <summary>
+    ///     What one chunk of the single-pass scan has published for the chunks after it.
+    /// </summary>
+    template <typename value_type>
+    struct scan_chunk_state
+    {
+        // 0 when nothing is published yet, 1 when aggregate holds the sum of the chunk itself, 2 when inclusive holds the sum of
+        // all elements up to and including the chunk
+        volatile long flag;
+        value_type aggregate;
+        value_type inclusive;
+
+        scan_chunk_state() : flag(0), aggregate(), inclusive()
+        {
+        }
+    };
+
+    /// <summary>
+    ///     An implementation of parallel scan that reads the input from memory once, using a decoupled look-back:
+    ///     the chunks are handed out to the workers in order; a worker reduces its chunk, publishes the aggregate, and 
+    ///     then walks back over the chunks before it, adding up their aggregates until it finds one that has already
+    ///     published its inclusive prefix. It then publishes its own inclusive prefix and writes the scan of the chunk,
+    ///     whose input is still in the cache from the reduction.
+    ///     The chunks before a chunk were all handed out earlier and publish their aggregate without waiting for anything,
+    ///     so the look-back only waits for work that is already in progress.
+    /// </summary>
+    /// <param name="size_type">
+    ///     Type of the number of elements and of their indices
+    /// </param>
+    /// <param name="value_type">
+    ///     Type of the partial sums
+    /// </param>
+    /// <param name="BinaryOperator">
+    ///     The associative binary operator that computes the sum of two values
+    /// </param>
+    /// <param name="LoadFunction">
+    ///     Returns the value to be summed at an index
+    /// </param>
+    /// <param name="StoreFunction">
+    ///     Stores the partial sum at an index
+    /// </param>
+    /// <remarks>
+    ///     When exclusive is set, the value stored at index i is the sum of init and the first i values, and init must be given.
+    ///     Otherwise it is the sum of the first i + 1 values, preceded by init if given. The value at an index is always loaded
+    ///     before the partial sum at that index is stored.
+    ///     <para>If load, store or sumFunction throws, the workers stop and the first exception is rethrown once they have
+    ///     all returned. Chunks that were not finished by then are left partially written.</para>
+    /// </remarks>
+    template <typename size_type, typename value_type, typename LoadFunction, typename StoreFunction, typename BinaryOperator>
+    void parallel_scan_lookback_core(size_type size, LoadFunction load, StoreFunction store, BinaryOperator sumFunction, 
+        bool exclusive, const value_type * init)
+    {
+        // Large enough to amortize the look-back, small enough for the input of a chunk to stay in the cache between its two reads
+        const size_type chunkSize = 16384;
+
+        if (size <= 0)
+        {
+            return;
+        }
+
+        size_type numChunks = (size + chunkSize - 1) / chunkSize;
+        size_type numWorkers = (std::min)(static_cast<size_type>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), numChunks);
+
+        std::vector<scan_chunk_state<value_type>> states(static_cast<size_t>(numChunks));
+        volatile long nextChunk = 0;
+        volatile long aborted = 0;
+        std::exception_ptr exception;
+
+        auto worker = [&](size_type)
+        {
+            try
+            {
+                for (;;)
+                {
+                    size_type index = static_cast<size_type>(_Atomic_increment(&nextChunk)) - 1;
+                    if (index >= numChunks || _Atomic_load_acquire(&aborted) != 0)
+                    {
+                        break;
+                    }
+
+                    size_type start = index * chunkSize;
+                    size_type last = (std::min)(start + chunkSize, size);
+                    scan_chunk_state<value_type> &state = states[static_cast<size_t>(index)];
+
+                    // Reduce the chunk and publish its aggregate
+                    value_type aggregate = load(start);
+                    for (size_type i = start + 1; i < last; ++i)
+                    {
+                        aggregate = sumFunction(aggregate, load(i));
+                    }
+
+                    state.aggregate = aggregate;
+                    _Atomic_exchange(&state.flag, 1);
+
+                    // Look back for the sum of everything before this chunk
+                    bool hasPrefix = false;
+                    value_type prefix = value_type();
+
+                    if (index == 0)
+                    {
+                        if (init != NULL)
+                        {
+                            prefix = *init;
+                            hasPrefix = true;
+                        }
+                    }
+                    else
+                    {
+                        for (size_type previous = index - 1; ; --previous)
+                        {
+                            scan_chunk_state<value_type> &previousState = states[static_cast<size_t>(previous)];
+
+                            long flag;
+                            while ((flag = _Atomic_load_acquire(&previousState.flag)) == 0)
+                            {
+                                // A chunk that threw never publishes anything
+                                if (_Atomic_load_acquire(&aborted) != 0)
+                                {
+                                    return;
+                                }
+
+                                _Atomic_yield();
+                            }
+
+                            const value_type &value = (flag == 2) ? previousState.inclusive : previousState.aggregate;
+                            prefix = hasPrefix ? sumFunction(value, prefix) : value;
+                            hasPrefix = true;
+
+                            // The first chunk always publishes its inclusive prefix, so this stops there at the latest
+                            if (flag == 2)
+                            {
+                                break;
+                            }
+                        }
+                    }
+
+                    state.inclusive = hasPrefix ? sumFunction(prefix, aggregate) : aggregate;
+                    _Atomic_exchange(&state.flag, 2);
+
+                    // Write the scan of the chunk. Each input is loaded before its output is stored, so the scan can be in place.
+                    if (exclusive)
+                    {
+                        for (size_type i = start; i < last; ++i)
+                        {
+                            value_type value = load(i);
+                            store(i, prefix);
+                            prefix = sumFunction(prefix, value);
+                        }
+                    }
+                    else
+                    {
+                        value_type running = hasPrefix ? sumFunction(prefix, load(start)) : load(start);
+                        store(start, running);
+                        for (size_type i = start + 1; i < last; ++i)
+                        {
+                            running = sumFunction(running, load(i));
+                            store(i, running);
+                        }
+                    }
+                }
+            }
+            catch (...)
+            {
+                // Keep the first exception and release the workers waiting in their look-back
+                if (_Atomic_compare_exchange(&aborted, 1, 0) == 0)
+                {
+                    exception = std::current_exception();
+                }
+            }
+        };
+
+        if (numWorkers < 2)
+        {
+            worker(0);
+        }
+        else
+        {
+            parallel_for(size_type(0), numWorkers, worker);
+        }
+
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    /// <summary>
+    ///     Single-pass parallel scan over iterators, see parallel_scan_lookback_core.
+    /// </summary>
+    /// <param name="in_randomIterator">
+    ///     Type of the iterator to the container that holds the input values
+    /// </param>
+    /// <param name="out_randomIterator">
+    ///     Type of the iterator to the container that will hold the output values
+    /// </param>
+    /// <param name="value_type">
+    ///     Type of the partial sums
+    /// </param>
+    /// <param name="BinaryOperator">
+    ///     The associative binary operator that computes the sum of two values
+    /// </param>
+    /// <param name="UnaryOperator">
+    ///     The transformation applied to each input value before it is summed
+    /// </param>
+    /// <remarks>
+    ///     When exclusive is set, element i of the output is the sum of init and the first i inputs, and init must be given.
+    ///     Otherwise it is the sum of the first i + 1 inputs, preceded by init if given. The output may be the input.
+    /// </remarks>
+    template <typename in_randomIterator, typename out_randomIterator, typename value_type, typename BinaryOperator, typename UnaryOperator>
+    void parallel_scan_lookback_impl(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction, 
+        UnaryOperator transform, bool exclusive, const value_type * init)
+    {
+        typedef typename std::iterator_traits<in_randomIterator>::difference_type size_type;
+
+        parallel_scan_lookback_core(end - begin, 
+            [&](size_type index) -> value_type { return transform(begin[index]); }, 
+            [&](size_type index, const value_type& value) { result[index] = value; }, 
+            sumFunction, exclusive, init);
+    }
+
+    /// <summary>
+    ///     An element of a segmented scan: a value and whether it starts a new segment.
+    /// </summary>
+    template <typename value_type>
+    struct segmented_value
+    {
+        value_type value;
+        bool head;
+
+        segmented_value() : value(), head(false)
+        {
+        }
+
+        segmented_value(const value_type& _value, bool _head) : value(_value), head(_head)
+        {
+        }
+    };
+
+    /// <summary>
+    ///     Lifts a binary operator to segmented values: the sum restarts at every segment head. The lifted operator is
+    ///     associative when the operator is, which is what lets a segmented scan run as a single flat scan.
+    /// </summary>
+    template <typename value_type, typename BinaryOperator>
+    struct segmented_operator
+    {
+        BinaryOperator sumFunction;
+
+        segmented_operator(const BinaryOperator& _sumFunction) : sumFunction(_sumFunction)
+        {
+        }
+
+        segmented_value<value_type> operator()(const segmented_value<value_type>& left, const segmented_value<value_type>& right) const
+        {
+            if (right.head)
+            {
+                return right;
+            }
+
+            return segmented_value<value_type>(sumFunction(left.value, right.value), left.head);
+        }
+    };
+
+    /// <summary>
+    ///     An implementation of segmented reduce that balances the work by elements rather than by segments.
+    ///     The elements are split into fixed chunks that are reduced in parallel. A segment that lies within a chunk
+    ///     is written directly; a segment that crosses chunk boundaries leaves one partial sum in each chunk it touches, 
+    ///     and those are combined in order afterwards.
+    /// </summary>
+    /// <param name="in_randomIterator">
+    ///     Type of the iterator to the container that holds the input values
+    /// </param>
+    /// <param name="offset_randomIterator">
+    ///     Type of the iterator to the container that holds the segment offsets
+    /// </param>
+    /// <param name="out_randomIterator">
+    ///     Type of the iterator to the container that will hold one sum per segment
+    /// </param>
+    /// <param name="value_type">
+    ///     Type of the identity value and of the sums
+    /// </param>
+    /// <param name="BinaryOperator">
+    ///     The associative binary operator that computes the sum of two values
+    /// </param>
+    template <typename in_randomIterator, typename offset_randomIterator, typename out_randomIterator, typename value_type, typename BinaryOperator>
+    void parallel_segmented_reduce_impl(in_randomIterator begin, offset_randomIterator offsetsBegin, offset_randomIterator offsetsEnd, 
+        out_randomIterator result, const value_type& identity, BinaryOperator sumFunction)
+    {
+        typedef typename std::iterator_traits<in_randomIterator>::difference_type size_type;
+
+        const size_type chunkSize = 16384;
+
+        size_type numSegments = (offsetsEnd - offsetsBegin) - 1;
+        if (numSegments <= 0)
+        {
+            return;
+        }
+
+        size_type first = static_cast<size_type>(offsetsBegin[0]);
+        size_type size = static_cast<size_type>(offsetsBegin[numSegments]) - first;
+        size_type numChunks = (size + chunkSize - 1) / chunkSize;
+
+        // The segment that holds element position, skipping empty segments
+        auto segmentOf = [=](size_type position) -> size_type
+        {
+            return (std::upper_bound(offsetsBegin, offsetsEnd, first + position, 
+                [](size_type value, typename std::iterator_traits<offset_randomIterator>::value_type offset) { 
+                    return value < static_cast<size_type>(offset); 
+                }) - offsetsBegin) - 1;
+        };
+
+        // The partial sums that a chunk leaves for the segments it shares with other chunks
+        struct chunk_partials
+        {
+            size_type carryIndex;
+            size_type tailIndex;
+            value_type carry;
+            value_type tail;
+        };
+
+        std::vector<chunk_partials> partials(static_cast<size_t>(numChunks));
+
+        parallel_for(size_type(0), numChunks, [&](size_type index)
+        {
+            size_type start = index * chunkSize;
+            size_type last = (std::min)(start + chunkSize, size);
+            chunk_partials &partial = partials[static_cast<size_t>(index)];
+
+            partial.carryIndex = -1;
+            partial.tailIndex = -1;
+
+            // This chunk owns the segments after the last segment that the previous chunk touched, up to its own last one
+            size_type segment = (index == 0) ? 0 : segmentOf(start - 1) + 1;
+            size_type lastSegment = segmentOf(last - 1);
+            size_type position = start;
+
+            // The rest of a segment that started in an earlier chunk
+            if (index != 0 && segment - 1 <= lastSegment && static_cast<size_type>(offsetsBegin[segment]) - first > start)
+            {
+                size_type end = (std::min)(static_cast<size_type>(offsetsBegin[segment]) - first, last);
+                value_type sum = begin[first + position];
+                for (++position; position < end; ++position)
+                {
+                    sum = sumFunction(sum, begin[first + position]);
+                }
+
+                partial.carryIndex = segment - 1;
+                partial.carry = sum;
+            }
+
+            for (; segment <= lastSegment; ++segment)
+            {
+                size_type segmentEnd = static_cast<size_type>(offsetsBegin[segment + 1]) - first;
+                if (position == segmentEnd)
+                {
+                    result[segment] = identity;
+                    continue;
+                }
+
+                size_type end = (std::min)(segmentEnd, last);
+                value_type sum = begin[first + position];
+                for (++position; position < end; ++position)
+                {
+                    sum = sumFunction(sum, begin[first + position]);
+                }
+
+                if (segmentEnd > last)
+                {
+                    // Continues in the next chunk
+                    partial.tailIndex = segment;
+                    partial.tail = sum;
+                }
+                else
+                {
+                    result[segment] = sumFunction(identity, sum);
+                }
+            }
+        });
+
+        // Each crossing segment starts as a tail and collects the carries of the chunks after it, in order
+        for (size_type index = 0; index < numChunks; ++index)
+        {
+            const chunk_partials &partial = partials[static_cast<size_t>(index)];
+            if (partial.carryIndex >= 0)
+            {
+                result[partial.carryIndex] = sumFunction(result[partial.carryIndex], partial.carry);
+            }
+
+            if (partial.tailIndex >= 0)
+            {
+                result[partial.tailIndex] = sumFunction(identity, partial.tail);
+            }
+        }
+
+        // Empty segments after the last element, including all of them when there are no elements
+        for (size_type segment = (size == 0) ? 0 : segmentOf(size - 1) + 1; segment < numSegments; ++segment)
+        {
+            result[segment] = identity;
+        }
+    }
+
+    /// <summary>
+    ///     An implementation of parallel partial sum that splits the work into fixed chunks.
+    ///     This is efficient when the binary operation is relatively fast and independent of the values.
+    /// </summary>
+    /// <param name="input_iterator">
+    ///     Type of the iterator to the container that holds the input values
+    /// </param>
+    /// <param name="out_randomIterator">
+    ///     Type of the iterator to the container that will hold the output values
+    /// </param>
+    /// <param name="BinaryOperator">
+    ///     The binary operator that computes the sum of two values
+    /// </param>
+    template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator>
+    void parallel_partial_sum_impl(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction)
+    {
+        typedef typename std::iterator_traits<out_randomIterator>::value_type value_type;
+        typedef typename std::iterator_traits<in_randomIterator>::difference_type size_type;
+
+        // We will use the number of virtual processors to compute the number of chunks
+        const int oversubscription = 2;
+        size_type numChunks = static_cast<size_type>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors() * oversubscription);
+        size_type size = end - begin;
+
+        if (size < numChunks)
+        {
+            // Not enough iterations to warrant parallel computation
+            std::partial_sum(begin, end, result, sumFunction);            
+            return;
+        }
+
+        std::vector<value_type> tempSum(numChunks);
+
+        // Determine the range for each chunk
+        size_type chunkSize = size / numChunks;
+        _ASSERTE(chunkSize >= 1);
+
+        parallel_for(size_type(0), numChunks, [begin, end, result, sumFunction, chunkSize, numChunks, &tempSum](size_type index)
+        {
+            // Compute partial sum for this chunk.
+
+            in_randomIterator start = begin + (index * chunkSize);
+            in_randomIterator last = (index == (numChunks - 1)) ? end : start + chunkSize;
+
+            out_randomIterator resultStart = result + (index * chunkSize);
+            out_randomIterator resultEnd = resultStart + (last - start);
+
+            std::partial_sum(start, last, resultStart, sumFunction);
+
+            // Store the upper bounds into intermediate buffer.
+            tempSum[index] = *(resultEnd-1);
+        });
+
+        // Compute partial sum on the intermediate buffer
+        std::partial_sum(tempSum.begin(), tempSum.end(), tempSum.begin(), sumFunction);
+
+        // The first chunk is already correct. For the other chunks propagate the partial
+        // sum from the intermediate buffer
+        parallel_for(size_type(1), numChunks, [begin, end, result, sumFunction, chunkSize, numChunks, tempSum](size_type index)
+        {
+            // Add the partial sum from the previous chunk to all the
+            // elements in this chunk
+            in_randomIterator start = begin + (index * chunkSize);
+            in_randomIterator last = (index == (numChunks - 1)) ? end : start + chunkSize;
+
+            out_randomIterator resultStart = result + (index * chunkSize);
+            out_randomIterator resultEnd = resultStart + (last - start);
+
+            for (out_randomIterator iter = resultStart; iter < resultEnd; ++iter)
+            {
+                *iter = sumFunction(*iter, tempSum[index-1]);
+            }
+        });
+    }
+}
+/// <summary>
+///     Compute inclusive partial sum
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values
+/// </param>
+/// <param name="BinaryOperator">
+///     The binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator>
+void parallel_partial_sum_fixed(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction)
+{
+    return details::parallel_partial_sum_impl(begin, end, result, sumFunction);
+}
+
+/// <summary>
+///     Compute inclusive partial sum
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values
+/// </param>
+/// <param name="BinaryOperator">
+///     The binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator>
+void parallel_partial_sum(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction)
+{
+    typedef typename std::iterator_traits<out_randomIterator>::value_type value_type;
+
+    return details::parallel_scan_lookback_impl(begin, end, result, sumFunction, details::scan_identity(), false, 
+        static_cast<const value_type *>(NULL));
+}
+
+/// <summary>
+///     Compute inclusive partial sum. This overload performs the operation in place.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="BinaryOperator">
+///     The binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename BinaryOperator>
+void parallel_partial_sum(in_randomIterator begin, in_randomIterator end, BinaryOperator sumFunction)
+{
+    typedef typename std::iterator_traits<in_randomIterator>::value_type value_type;
+
+    return details::parallel_scan_lookback_impl(begin, end, begin, sumFunction, details::scan_identity(), false, 
+        static_cast<const value_type *>(NULL));
+}
+
+/// <summary>
+///     Compute exclusive partial sum: element i of the output is the sum of init and the first i input values.
+///     The input is read from memory once.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="value_type">
+///     Type of the initial value and of the partial sums
+/// </param>
+/// <param name="BinaryOperator">
+///     The associative binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename out_randomIterator, typename value_type, typename BinaryOperator>
+void parallel_exclusive_scan(in_randomIterator begin, in_randomIterator end, out_randomIterator result, value_type init, BinaryOperator sumFunction)
+{
+    return details::parallel_scan_lookback_impl(begin, end, result, sumFunction, details::scan_identity(), true, &init);
+}
+
+/// <summary>
+///     Compute exclusive partial sum with operator +: element i of the output is the sum of init and the first i input values.
+///     The input is read from memory once.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="value_type">
+///     Type of the initial value and of the partial sums
+/// </param>
+template <typename in_randomIterator, typename out_randomIterator, typename value_type>
+void parallel_exclusive_scan(in_randomIterator begin, in_randomIterator end, out_randomIterator result, value_type init)
+{
+    return parallel_exclusive_scan(begin, end, result, init, std::plus<value_type>());
+}
+
+/// <summary>
+///     Compute inclusive partial sum of the transformed input values: element i of the output is the sum of 
+///     transform applied to the first i + 1 input values. The input is read from memory once.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="BinaryOperator">
+///     The associative binary operator that computes the sum of two values
+/// </param>
+/// <param name="UnaryOperator">
+///     The transformation applied to each input value before it is summed
+/// </param>
+template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator, typename UnaryOperator>
+void parallel_transform_inclusive_scan(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction, 
+    UnaryOperator transform)
+{
+    typedef typename std::iterator_traits<out_randomIterator>::value_type value_type;
+
+    return details::parallel_scan_lookback_impl(begin, end, result, sumFunction, transform, false, static_cast<const value_type *>(NULL));
+}
+
+/// <summary>
+///     Compute inclusive partial sum of the transformed input values, starting from init: element i of the output is
+///     the sum of init and transform applied to the first i + 1 input values. The input is read from memory once.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="BinaryOperator">
+///     The associative binary operator that computes the sum of two values
+/// </param>
+/// <param name="UnaryOperator">
+///     The transformation applied to each input value before it is summed
+/// </param>
+/// <param name="value_type">
+///     Type of the initial value and of the partial sums
+/// </param>
+template <typename in_randomIterator, typename out_randomIterator, typename BinaryOperator, typename UnaryOperator, typename value_type>
+void parallel_transform_inclusive_scan(in_randomIterator begin, in_randomIterator end, out_randomIterator result, BinaryOperator sumFunction, 
+    UnaryOperator transform, value_type init)
+{
+    return details::parallel_scan_lookback_impl(begin, end, result, sumFunction, transform, false, &init);
+}
+
+/// <summary>
+///     Compute inclusive partial sum within each segment: element i of the output is the sum of the input values from the
+///     start of its segment up to and including i. A segment starts at every element whose flag is nonzero, and at the
+///     first element. All the segments are scanned in one parallel pass that is balanced by elements, however long the
+///     segments are.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="flag_randomIterator">
+///     Type of the iterator to the container that holds one segment head flag per input value
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="BinaryOperator">
+///     The associative binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename flag_randomIterator, typename out_randomIterator, typename BinaryOperator>
+void parallel_segmented_partial_sum(in_randomIterator begin, in_randomIterator end, flag_randomIterator flagsBegin, out_randomIterator result, 
+    BinaryOperator sumFunction)
+{
+    typedef typename std::iterator_traits<out_randomIterator>::value_type value_type;
+    typedef typename std::iterator_traits<in_randomIterator>::difference_type size_type;
+    typedef details::segmented_value<value_type> segmented_type;
+
+    details::parallel_scan_lookback_core(end - begin, 
+        [&](size_type index) { return segmented_type(begin[index], index == 0 || flagsBegin[index]); }, 
+        [&](size_type index, const segmented_type& sum) { result[index] = sum.value; }, 
+        details::segmented_operator<value_type, BinaryOperator>(sumFunction), false, static_cast<const segmented_type *>(NULL));
+}
+
+/// <summary>
+///     Compute exclusive partial sum within each segment: element i of the output is the sum of init and the input values
+///     from the start of its segment up to but not including i. A segment starts at every element whose flag is nonzero,
+///     and at the first element. All the segments are scanned in one parallel pass that is balanced by elements, however 
+///     long the segments are.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="flag_randomIterator">
+///     Type of the iterator to the container that holds one segment head flag per input value
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="value_type">
+///     Type of the initial value and of the partial sums
+/// </param>
+/// <param name="BinaryOperator">
+///     The associative binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename flag_randomIterator, typename out_randomIterator, typename value_type, typename BinaryOperator>
+void parallel_segmented_exclusive_scan(in_randomIterator begin, in_randomIterator end, flag_randomIterator flagsBegin, out_randomIterator result, 
+    value_type init, BinaryOperator sumFunction)
+{
+    typedef typename std::iterator_traits<in_randomIterator>::difference_type size_type;
+    typedef details::segmented_value<value_type> segmented_type;
+
+    // Every segment head carries init, so that the running sum of a segment already starts from it
+    segmented_type segmentedInit(init, true);
+
+    details::parallel_scan_lookback_core(end - begin, 
+        [&](size_type index) { 
+            return (index == 0 || flagsBegin[index]) ? segmented_type(sumFunction(init, begin[index]), true) : segmented_type(begin[index], false); 
+        }, 
+        [&](size_type index, const segmented_type& sum) { result[index] = (index == 0 || flagsBegin[index]) ? init : sum.value; }, 
+        details::segmented_operator<value_type, BinaryOperator>(sumFunction), true, &segmentedInit);
+}
+
+/// <summary>
+///     Compute exclusive partial sum with operator + within each segment: element i of the output is the sum of init and the 
+///     input values from the start of its segment up to but not including i. A segment starts at every element whose flag 
+///     is nonzero, and at the first element.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="flag_randomIterator">
+///     Type of the iterator to the container that holds one segment head flag per input value
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold the output values, which may be the input container
+/// </param>
+/// <param name="value_type">
+///     Type of the initial value and of the partial sums
+/// </param>
+template <typename in_randomIterator, typename flag_randomIterator, typename out_randomIterator, typename value_type>
+void parallel_segmented_exclusive_scan(in_randomIterator begin, in_randomIterator end, flag_randomIterator flagsBegin, out_randomIterator result, 
+    value_type init)
+{
+    return parallel_segmented_exclusive_scan(begin, end, flagsBegin, result, init, std::plus<value_type>());
+}
+
+/// <summary>
+///     Reduce each segment of the input to one value: element k of the output is the sum of identity and the input values
+///     from begin[offsets[k]] up to but not including begin[offsets[k + 1]], or identity for an empty segment.
+///     All the segments are reduced in one parallel pass that is balanced by elements, however long the segments are.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="offset_randomIterator">
+///     Type of the iterator to the container that holds the segment offsets, in increasing order. There is one offset more
+///     than there are segments, the last one being the end of the last segment.
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold one sum per segment
+/// </param>
+/// <param name="value_type">
+///     Type of the identity value and of the sums
+/// </param>
+/// <param name="BinaryOperator">
+///     The associative binary operator that computes the sum of two values
+/// </param>
+template <typename in_randomIterator, typename offset_randomIterator, typename out_randomIterator, typename value_type, typename BinaryOperator>
+void parallel_segmented_reduce(in_randomIterator begin, offset_randomIterator offsetsBegin, offset_randomIterator offsetsEnd, 
+    out_randomIterator result, value_type identity, BinaryOperator sumFunction)
+{
+    return details::parallel_segmented_reduce_impl(begin, offsetsBegin, offsetsEnd, result, identity, sumFunction);
+}
+
+/// <summary>
+///     Reduce each segment of the input to one value with operator +: element k of the output is the sum of identity and the
+///     input values from begin[offsets[k]] up to but not including begin[offsets[k + 1]], or identity for an empty segment.
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="offset_randomIterator">
+///     Type of the iterator to the container that holds the segment offsets, in increasing order. There is one offset more
+///     than there are segments, the last one being the end of the last segment.
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the iterator to the container that will hold one sum per segment
+/// </param>
+/// <param name="value_type">
+///     Type of the identity value and of the sums
+/// </param>
+template <typename in_randomIterator, typename offset_randomIterator, typename out_randomIterator, typename value_type>
+void parallel_segmented_reduce(in_randomIterator begin, offset_randomIterator offsetsBegin, offset_randomIterator offsetsEnd, 
+    out_randomIterator result, value_type identity)
+{
+    return parallel_segmented_reduce(begin, offsetsBegin, offsetsEnd, result, identity, std::plus<value_type>());
+}
+namespace details
+{
+    /// <summary>
+    ///     Finds where a diagonal of the merge path crosses it: the number of elements taken from the first sequence
+    ///     when the first diagonal elements of the merged output have been written. Elements of the first sequence go
+    ///     before equivalent elements of the second one.
+    /// </summary>
+    template<typename ran_it1, typename ran_it2, typename size_type, typename compare>
+    size_type merge_path_split(ran_it1 first1, size_type length1, ran_it2 first2, size_type length2, size_type diagonal, const compare& comp)
+    {
+        size_type low = (diagonal > length2) ? diagonal - length2 : 0;
+        size_type high = (std::min)(diagonal, length1);
+
+        while (low < high)
+        {
+            size_type middle = low + (high - low) / 2;
+            if (comp(first2[diagonal - middle - 1], first1[middle]))
+            {
+                high = middle;
+            }
+            else
+            {
+                low = middle + 1;
+            }
+        }
+
+        return low;
+    }
+
+    /// <summary>
+    ///     Merges two sorted sequences by cutting the output into equal parts along the diagonals of the merge path, 
+    ///     and merging each part serially. Every part writes the same number of elements, whatever the values are.
+    /// </summary>
+    template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+    out_it parallel_merge_path_impl(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, const compare& comp)
+    {
+        // Below this many output elements per part, the search and the task cost more than they save
+        const size_t minPartSize = 4096;
+
+        size_t length1 = static_cast<size_t>(last1 - first1);
+        size_t length2 = static_cast<size_t>(last2 - first2);
+        size_t total = length1 + length2;
+
+        size_t numParts = (std::min)(static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()) * 2, total / minPartSize);
+        if (numParts < 2)
+        {
+            return std::merge(first1, last1, first2, last2, out, comp);
+        }
+
+        // All the splits are found before any part is merged, since merging through move iterators empties the input
+        std::vector<size_t> splits(numParts + 1);
+        for (size_t part = 0; part <= numParts; ++part)
+        {
+            splits[part] = merge_path_split(first1, length1, first2, length2, part * total / numParts, comp);
+        }
+
+        parallel_for(size_t(0), numParts, [&](size_t part)
+        {
+            size_t diagonal = part * total / numParts;
+            size_t nextDiagonal = (part + 1) * total / numParts;
+
+            std::merge(first1 + splits[part], first1 + splits[part + 1], first2 + (diagonal - splits[part]), 
+                first2 + (nextDiagonal - splits[part + 1]), out + diagonal, comp);
+        });
+
+        return out + total;
+    }
+}
+
+/// <summary>
+///  merge two sorted sequences in parallel
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <param name="compare">
+///     The binary predicate the sequences are sorted by
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+/// <remarks>
+///     The output is cut into equal parts that are merged in parallel. The merge is stable: elements of the first sequence 
+///     go before equivalent elements of the second one, as with std::merge.
+/// </remarks>
+template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+inline out_it parallel_merge(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, compare comp)
+{
+    return details::parallel_merge_path_impl(first1, last1, first2, last2, out, comp);
+}
+
+/// <summary>
+///  merge two sequences sorted with operator &lt; in parallel
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+template<typename ran_it1, typename ran_it2, typename out_it>
+inline out_it parallel_merge(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out)
+{
+    return parallel_merge(first1, last1, first2, last2, out, std::less<typename std::iterator_traits<ran_it1>::value_type>());
+}
+
+/// <summary>
+///  merge the two consecutive sorted sequences [first, middle) and [middle, last) in parallel, so that [first, last) is sorted
+/// </summary>
+/// <param name="ran_it">
+///     Type of the iterator to the container that holds the sequences
+/// </param>
+/// <param name="compare">
+///     The binary predicate the sequences are sorted by
+/// </param>
+/// <remarks>
+///     The sequences are merged into a temporary buffer of last - first elements, which are moved back in parallel.
+///     The merge is stable, as with std::inplace_merge. The element type must be default constructible.
+/// </remarks>
+template<typename ran_it, typename compare>
+inline void parallel_inplace_merge(ran_it first, ran_it middle, ran_it last, compare comp)
+{
+    typedef typename std::iterator_traits<ran_it>::value_type value_type;
+
+    if (first == middle || middle == last)
+    {
+        return;
+    }
+
+    size_t size = static_cast<size_t>(last - first);
+    std::vector<value_type> buffer(size);
+
+    details::parallel_merge_path_impl(std::make_move_iterator(first), std::make_move_iterator(middle), 
+        std::make_move_iterator(middle), std::make_move_iterator(last), buffer.begin(), comp);
+
+    // Move back in one chunk per virtual processor
+    size_t numChunks = (std::min)(static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()), size / 4096 + 1);
+    parallel_for(size_t(0), numChunks, [&](size_t chunk)
+    {
+        std::move(buffer.begin() + chunk * size / numChunks, buffer.begin() + (chunk + 1) * size / numChunks, first + chunk * size / numChunks);
+    });
+}
+
+/// <summary>
+///  merge the two consecutive sequences [first, middle) and [middle, last), sorted with operator &lt;, in parallel
+/// </summary>
+/// <param name="ran_it">
+///     Type of the iterator to the container that holds the sequences
+/// </param>
+template<typename ran_it>
+inline void parallel_inplace_merge(ran_it first, ran_it middle, ran_it last)
+{
+    parallel_inplace_merge(first, middle, last, std::less<typename std::iterator_traits<ran_it>::value_type>());
+}
+
+namespace details
+{
+    // An output iterator that only counts what is written to it
+    class counting_output_iterator
+    {
+    public:
+        typedef std::output_iterator_tag iterator_category;
+        typedef void value_type;
+        typedef void difference_type;
+        typedef void pointer;
+        typedef void reference;
+
+        counting_output_iterator() : m_count(0)
+        {
+        }
+
+        size_t count() const
+        {
+            return m_count;
+        }
+
+        counting_output_iterator& operator*()
+        {
+            return *this;
+        }
+
+        template <typename value_type>
+        counting_output_iterator& operator=(const value_type&)
+        {
+            ++m_count;
+            return *this;
+        }
+
+        counting_output_iterator& operator++()
+        {
+            return *this;
+        }
+
+        counting_output_iterator& operator++(int)
+        {
+            return *this;
+        }
+
+    private:
+        size_t m_count;
+    };
+
+    struct set_union_operation
+    {
+        template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+        out_it operator()(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, const compare& comp) const
+        {
+            return std::set_union(first1, last1, first2, last2, out, comp);
+        }
+    };
+
+    struct set_intersection_operation
+    {
+        template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+        out_it operator()(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, const compare& comp) const
+        {
+            return std::set_intersection(first1, last1, first2, last2, out, comp);
+        }
+    };
+
+    struct set_difference_operation
+    {
+        template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+        out_it operator()(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, const compare& comp) const
+        {
+            return std::set_difference(first1, last1, first2, last2, out, comp);
+        }
+    };
+
+    struct set_symmetric_difference_operation
+    {
+        template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+        out_it operator()(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, const compare& comp) const
+        {
+            return std::set_symmetric_difference(first1, last1, first2, last2, out, comp);
+        }
+    };
+
+    /// <summary>
+    ///     Runs a set operation on two sorted sequences in parallel. The merged order of the inputs is cut into equal 
+    ///     parts along the diagonals of the merge path, and each cut is moved back to the start of the run of equivalent 
+    ///     elements it falls into, so that the elements a set operation matches up are always in the same part.
+    ///     Each part first counts its output, an exclusive scan of the counts gives where each part writes, and then the
+    ///     parts write their output.
+    /// </summary>
+    template<typename ran_it1, typename ran_it2, typename out_it, typename compare, typename set_operation>
+    out_it parallel_set_operation_impl(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, const compare& comp, 
+        const set_operation& operation)
+    {
+        // Below this many input elements per part, the searches and the two passes cost more than they save
+        const size_t minPartSize = 4096;
+
+        size_t length1 = static_cast<size_t>(last1 - first1);
+        size_t length2 = static_cast<size_t>(last2 - first2);
+        size_t total = length1 + length2;
+
+        size_t numParts = (std::min)(static_cast<size_t>(CurrentScheduler::Get()->GetNumberOfVirtualProcessors()) * 2, total / minPartSize);
+        if (numParts < 2)
+        {
+            return operation(first1, last1, first2, last2, out, comp);
+        }
+
+        std::vector<size_t> splits1(numParts + 1), splits2(numParts + 1);
+        for (size_t part = 0; part < numParts; ++part)
+        {
+            size_t diagonal = part * total / numParts;
+            size_t split1 = merge_path_split(first1, length1, first2, length2, diagonal, comp);
+            size_t split2 = diagonal - split1;
+
+            // Cut in front of the next element in merged order, and of everything equivalent to it in both sequences
+            if (split1 < length1 && (split2 == length2 || !comp(first2[split2], first1[split1])))
+            {
+                split1 = std::lower_bound(first1, first1 + split1, first1[split1], comp) - first1;
+                split2 = std::lower_bound(first2, first2 + split2, first1[split1], comp) - first2;
+            }
+            else if (split2 < length2)
+            {
+                split2 = std::lower_bound(first2, first2 + split2, first2[split2], comp) - first2;
+                split1 = std::lower_bound(first1, first1 + split1, first2[split2], comp) - first1;
+            }
+
+            splits1[part] = split1;
+            splits2[part] = split2;
+        }
+
+        splits1[numParts] = length1;
+        splits2[numParts] = length2;
+
+        std::vector<size_t> offsets(numParts);
+        parallel_for(size_t(0), numParts, [&](size_t part)
+        {
+            offsets[part] = operation(first1 + splits1[part], first1 + splits1[part + 1], first2 + splits2[part], first2 + splits2[part + 1], 
+                counting_output_iterator(), comp).count();
+        });
+
+        size_t size = offsets[numParts - 1];
+        parallel_exclusive_scan(offsets.begin(), offsets.end(), offsets.begin(), size_t(0));
+        size += offsets[numParts - 1];
+
+        parallel_for(size_t(0), numParts, [&](size_t part)
+        {
+            operation(first1 + splits1[part], first1 + splits1[part + 1], first2 + splits2[part], first2 + splits2[part + 1], 
+                out + offsets[part], comp);
+        });
+
+        return out + size;
+    }
+}
+
+/// <summary>
+///  compute the union of two sorted sequences in parallel, with the same result as std::set_union
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <param name="compare">
+///     The binary predicate the sequences are sorted by
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+/// <remarks>
+///     The inputs are read twice: once to count the output of each part, and once to write it.
+/// </remarks>
+template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+inline out_it parallel_set_union(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, compare comp)
+{
+    return details::parallel_set_operation_impl(first1, last1, first2, last2, out, comp, details::set_union_operation());
+}
+
+/// <summary>
+///  compute the union of two sequences sorted with operator &lt; in parallel, with the same result as std::set_union
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+template<typename ran_it1, typename ran_it2, typename out_it>
+inline out_it parallel_set_union(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out)
+{
+    return parallel_set_union(first1, last1, first2, last2, out, std::less<typename std::iterator_traits<ran_it1>::value_type>());
+}
+
+/// <summary>
+///  compute the intersection of two sorted sequences in parallel, with the same result as std::set_intersection
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <param name="compare">
+///     The binary predicate the sequences are sorted by
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+/// <remarks>
+///     The inputs are read twice: once to count the output of each part, and once to write it.
+/// </remarks>
+template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+inline out_it parallel_set_intersection(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, compare comp)
+{
+    return details::parallel_set_operation_impl(first1, last1, first2, last2, out, comp, details::set_intersection_operation());
+}
+
+/// <summary>
+///  compute the intersection of two sequences sorted with operator &lt; in parallel, with the same result as std::set_intersection
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+template<typename ran_it1, typename ran_it2, typename out_it>
+inline out_it parallel_set_intersection(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out)
+{
+    return parallel_set_intersection(first1, last1, first2, last2, out, std::less<typename std::iterator_traits<ran_it1>::value_type>());
+}
+
+/// <summary>
+///  compute the difference of two sorted sequences in parallel, with the same result as std::set_difference
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <param name="compare">
+///     The binary predicate the sequences are sorted by
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+/// <remarks>
+///     The inputs are read twice: once to count the output of each part, and once to write it.
+/// </remarks>
+template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+inline out_it parallel_set_difference(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, compare comp)
+{
+    return details::parallel_set_operation_impl(first1, last1, first2, last2, out, comp, details::set_difference_operation());
+}
+
+/// <summary>
+///  compute the difference of two sequences sorted with operator &lt; in parallel, with the same result as std::set_difference
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+template<typename ran_it1, typename ran_it2, typename out_it>
+inline out_it parallel_set_difference(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out)
+{
+    return parallel_set_difference(first1, last1, first2, last2, out, std::less<typename std::iterator_traits<ran_it1>::value_type>());
+}
+
+/// <summary>
+///  compute the symmetric difference of two sorted sequences in parallel, with the same result as std::set_symmetric_difference
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <param name="compare">
+///     The binary predicate the sequences are sorted by
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+/// <remarks>
+///     The inputs are read twice: once to count the output of each part, and once to write it.
+/// </remarks>
+template<typename ran_it1, typename ran_it2, typename out_it, typename compare>
+inline out_it parallel_set_symmetric_difference(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out, compare comp)
+{
+    return details::parallel_set_operation_impl(first1, last1, first2, last2, out, comp, details::set_symmetric_difference_operation());
+}
+
+/// <summary>
+///  compute the symmetric difference of two sequences sorted with operator &lt; in parallel, with the same result as 
+///  std::set_symmetric_difference
+/// </summary>
+/// <param name="ran_it1">
+///     Type of the iterator to the container that holds the first sequence
+/// </param>
+/// <param name="ran_it2">
+///     Type of the iterator to the container that holds the second sequence
+/// </param>
+/// <param name="out_it">
+///     Type of the random access iterator to the container that holds the output values
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+template<typename ran_it1, typename ran_it2, typename out_it>
+inline out_it parallel_set_symmetric_difference(ran_it1 first1, ran_it1 last1, ran_it2 first2, ran_it2 last2, out_it out)
+{
+    return parallel_set_symmetric_difference(first1, last1, first2, last2, out, std::less<typename std::iterator_traits<ran_it1>::value_type>());
+}
+
+namespace details
+{
+    // The number of elements that one task of the stream compaction counts and then scatters
+    const size_t compactChunkSize = 16384;
+
+    /// <summary>
+    ///     Stream compaction: copies the elements at the positions for which keep returns true, in order, to a dense output.
+    ///     The range is cut into fixed chunks; each chunk counts the elements it keeps, a parallel_partial_sum of the counts
+    ///     gives where each chunk writes, and each chunk then scatters its elements there.
+    /// </summary>
+    /// <param name="keep">
+    ///     Called as keep(index) in the counting pass.
+    /// </param>
+    /// <param name="allocate">
+    ///     Called as allocate(count) with the number of elements kept, returns where the output goes.
+    /// </param>
+    /// <param name="scatter">
+    ///     Called as scatter(start, end, out) for every chunk that keeps elements, writes them to out.
+    /// </param>
+    template <typename out_randomIterator, typename KeepFunction, typename AllocateFunction, typename ScatterFunction>
+    size_t parallel_compact_impl(size_t size, const KeepFunction& keep, const AllocateFunction& allocate, const ScatterFunction& scatter)
+    {
+        size_t numChunks = (size + compactChunkSize - 1) / compactChunkSize;
+        if (numChunks == 0)
+        {
+            return 0;
+        }
+
+        std::vector<size_t> counts(numChunks), ends(numChunks);
+        parallel_for(size_t(0), numChunks, [&](size_t chunk)
+        {
+            size_t count = 0;
+            size_t last = (std::min)((chunk + 1) * compactChunkSize, size);
+            for (size_t i = chunk * compactChunkSize; i < last; ++i)
+            {
+                if (keep(i))
+                {
+                    ++count;
+                }
+            }
+
+            counts[chunk] = count;
+        });
+
+        parallel_partial_sum(counts.begin(), counts.end(), ends.begin(), std::plus<size_t>());
+        out_randomIterator out = allocate(ends[numChunks - 1]);
+
+        parallel_for(size_t(0), numChunks, [&](size_t chunk)
+        {
+            if (counts[chunk] != 0)
+            {
+                scatter(chunk * compactChunkSize, (std::min)((chunk + 1) * compactChunkSize, size), out + (ends[chunk] - counts[chunk]));
+            }
+        });
+
+        return ends[numChunks - 1];
+    }
+
+    /// <summary>
+    ///     Returns the smallest index for which match returns true, or size if there is none. Every chunk is searched in 
+    ///     parallel up to its own first match, and the smallest of those wins.
+    /// </summary>
+    template <typename MatchFunction>
+    size_t parallel_find_first_impl(size_t size, const MatchFunction& match)
+    {
+        size_t numChunks = (size + compactChunkSize - 1) / compactChunkSize;
+        if (numChunks == 0)
+        {
+            return size;
+        }
+
+        std::vector<size_t> firsts(numChunks);
+        parallel_for(size_t(0), numChunks, [&](size_t chunk)
+        {
+            size_t i = chunk * compactChunkSize;
+            size_t last = (std::min)(i + compactChunkSize, size);
+            while (i < last && !match(i))
+            {
+                ++i;
+            }
+
+            firsts[chunk] = (i < last) ? i : size;
+        });
+
+        return *std::min_element(firsts.begin(), firsts.end());
+    }
+
+    /// <summary>
+    ///     Moves the elements of the buffer back to the range, in parallel.
+    /// </summary>
+    template <typename randomIterator, typename value_type>
+    void parallel_move_back(std::vector<value_type>& buffer, randomIterator first)
+    {
+        size_t size = buffer.size();
+        size_t numChunks = (size + compactChunkSize - 1) / compactChunkSize;
+
+        parallel_for(size_t(0), numChunks, [&](size_t chunk)
+        {
+            size_t start = chunk * compactChunkSize;
+            size_t last = (std::min)(start + compactChunkSize, size);
+            std::move(buffer.begin() + start, buffer.begin() + last, first + start);
+        });
+    }
+}
+
+/// <summary>
+///     Copy the elements that satisfy a predicate to a dense output, in parallel, with the same result as std::copy_if
+/// </summary>
+/// <param name="in_randomIterator">
+///     Type of the iterator to the container that holds the input values
+/// </param>
+/// <param name="out_randomIterator">
+///     Type of the random access iterator to the container that will hold the output values
+/// </param>
+/// <param name="UnaryPredicate">
+///     The predicate that selects the elements to copy. It is called twice on every element.
+/// </param>
+/// <returns>
+///     The end of the output.
+/// </returns>
+template <typename in_randomIterator, typename out_randomIterator, typename UnaryPredicate>
+out_randomIterator parallel_copy_if(in_randomIterator begin, in_randomIterator end, out_randomIterator result, UnaryPredicate pred)
+{
+    size_t size = details::parallel_compact_impl<out_randomIterator>(static_cast<size_t>(end - begin), 
+        [&](size_t index) -> bool { return pred(begin[index]); }, 
+        [&](size_t) { return result; }, 
+        [&](size_t start, size_t last, out_randomIterator out) { std::copy_if(begin + start, begin + last, out, pred); });
+
+    return result + size;
+}
+
+/// <summary>
+///     Remove the elements that satisfy a predicate, in parallel, with the same result as std::remove_if: the elements 
+///     that are kept are moved to the front of the range in order, and the rest of the range is left in a valid but
+///     unspecified state.
+/// </summary>
+/// <param name="randomIterator">
+///     Type of the iterator to the container that holds the values
+/// </param>
+/// <param name="UnaryPredicate">
+///     The predicate that selects the elements to remove. It is called up to three times on an element.
+/// </param>
+/// <returns>
+///     The end of the elements that are kept.
+/// </returns>
+/// <remarks>
+///     The kept elements are compacted into a temporary buffer and moved back, so the element type must be default constructible.
+/// </remarks>
+template <typename randomIterator, typename UnaryPredicate>
+randomIterator parallel_remove_if(randomIterator begin, randomIterator end, UnaryPredicate pred)
+{
+    typedef typename std::iterator_traits<randomIterator>::value_type value_type;
+
+    // The elements in front of the first one to remove stay where they are
+    size_t size = static_cast<size_t>(end - begin);
+    size_t first = details::parallel_find_first_impl(size, [&](size_t index) -> bool { return pred(begin[index]); });
+
+    if (first == size)
+    {
+        return end;
+    }
+
+    randomIterator rest = begin + first;
+    std::vector<value_type> buffer;
+
+    size_t count = details::parallel_compact_impl<typename std::vector<value_type>::iterator>(size - first, 
+        [&](size_t index) -> bool { return !pred(rest[index]); }, 
+        [&](size_t count) -> typename std::vector<value_type>::iterator { buffer.resize(count); return buffer.begin(); }, 
+        [&](size_t start, size_t last, typename std::vector<value_type>::iterator out) 
+        { 
+            for (size_t i = start; i < last; ++i)
+            {
+                if (!pred(rest[i]))
+                {
+                    *out++ = std::move(rest[i]);
+                }
+            }
+        });
+
+    details::parallel_move_back(buffer, rest);
+    return rest + count;
+}
+
+/// <summary>
+///     Remove all but the first element of every group of consecutive equivalent elements, in parallel, with the same result
+///     as std::unique: the elements that are kept are moved to the front of the range in order, and the rest of the range 
+///     is left in a valid but unspecified state.
+/// </summary>
+/// <param name="randomIterator">
+///     Type of the iterator to the container that holds the values
+/// </param>
+/// <param name="BinaryPredicate">
+///     The equivalence relation between the elements.
+/// </param>
+/// <returns>
+///     The end of the elements that are kept.
+/// </returns>
+/// <remarks>
+///     The kept elements are compacted into a temporary buffer and moved back, so the element type must be default constructible.
+/// </remarks>
+template <typename randomIterator, typename BinaryPredicate>
+randomIterator parallel_unique(randomIterator begin, randomIterator end, BinaryPredicate pred)
+{
+    typedef typename std::iterator_traits<randomIterator>::value_type value_type;
+
+    size_t size = static_cast<size_t>(end - begin);
+    if (size < 2)
+    {
+        return end;
+    }
+
+    auto keep = [&](size_t index) -> bool { return index == 0 || !pred(begin[index - 1], begin[index]); };
+
+    // The first element of each chunk is compared with the last element of the chunk before, which that chunk may already 
+    // have moved by the time it is scattered, so the decisions for the chunk boundaries are made up front
+    size_t numChunks = (size + details::compactChunkSize - 1) / details::compactChunkSize;
+    std::vector<char> keepFirst(numChunks);
+    for (size_t chunk = 0; chunk < numChunks; ++chunk)
+    {
+        keepFirst[chunk] = keep(chunk * details::compactChunkSize);
+    }
+
+    std::vector<value_type> buffer;
+
+    size_t count = details::parallel_compact_impl<typename std::vector<value_type>::iterator>(size, keep, 
+        [&](size_t count) -> typename std::vector<value_type>::iterator { buffer.resize(count); return buffer.begin(); }, 
+        [&](size_t start, size_t last, typename std::vector<value_type>::iterator out) 
+        { 
+            // Each element is compared with the one before before either of them is moved
+            bool keepCurrent = keepFirst[start / details::compactChunkSize] != 0;
+            for (size_t i = start; i < last; ++i)
+            {
+                bool keepNext = (i + 1 < last) && !pred(begin[i], begin[i + 1]);
+                if (keepCurrent)
+                {
+                    *out++ = std::move(begin[i]);
+                }
+
+                keepCurrent = keepNext;
+            }
+        });
+
+    details::parallel_move_back(buffer, begin);
+    return begin + count;
+}
+
+/// <summary>
+///     Remove all but the first element of every group of consecutive equal elements, in parallel, with the same result
+///     as std::unique.
+/// </summary>
+/// <param name="randomIterator">
+///     Type of the iterator to the container that holds the values
+/// </param>
+/// <returns>
+///     The end of the elements that are kept.
+/// </returns>
+template <typename randomIterator>
+randomIterator parallel_unique(randomIterator begin, randomIterator end)
+{
+    return parallel_unique(begin, end, std::equal_to<typename std::iterator_traits<randomIterator>::value_type>());
+}
+
+#pragma push_macro("_MAX_NUM_TASKS_PER_CORE")
+#pragma push_macro("_FINE_GRAIN_CHUNK_SIZE")
+#pragma push_macro("_SORT_MAX_RECURSION_DEPTH")
+#pragma push_macro("_RADIX_WC_LINE_SIZE")
+#pragma push_macro("_RADIX_WC_MIN_SIZE")
+#pragma push_macro("_SAMPLE_SORT_MIN_SIZE")
+#pragma push_macro("_SAMPLE_SORT_OVERSAMPLING")
+
+// This number is used to control dynamic task splitting
+// The ideal chunk (task) division is that the number of cores is equal to the number of tasks, but it will 
+// perform very poorly when tasks are not balanced. The simple solution is to allocate more tasks than number 
+// of cores.  _MAX_NUM_TASKS_PER_CORE provides a maximum number of tasks that will be allocated per core.
+// If this number is too small, the load balancing problem will affect efficiency very seriously, especially
+// when the compare operation is expensive.
+//
+// Note that this number is a maximum number -- the dynamic partition system will reduce the number of partitions
+// per core based on the dynamic load. If all cores are very busy, the number of partitions will shrink to 
+// reduce the scheduler overhead.
+//
+// Initially, the total tasks(chunks) number of partitions "_Div_num" will be: core number * _MAX_NUM_TASKS_PER_CORE.
+// The _Div_num will be divided by 2 after each task splitting. There are two special numbers for _Div_num:
+//     1. When _Div_num reaches the point that _Div_num < _MAX_NUM_TASKS_PER_CORE, it means we have split more tasks than cores.
+//     2. When _Div_num reaches the point that _Div_num <= 1, it means stop splitting more tasks and begin sorting serially.
+#define _MAX_NUM_TASKS_PER_CORE 1024
+
+// This is a number mainly is used to control the sampling and dynamic task splitting strategies.
+// If the user configurable minimal divisible chunk size (default is 2048) is smaller than FINE_GRAIN_CHUNK_SIZE,
+// the random sampling algorithm for quicksort will enter fine-grained mode, and take a strategy that reduces the sampling 
+// overhead. Also, the dynamic task splitting will enter fine-grained mode, which will split as many tasks as possible.
+#define _FINE_GRAIN_CHUNK_SIZE 512
+
+// This is the maximum depth that the quicksort will be called recursively.  If we allow too far, a stack overflow may occur.
+#define _SORT_MAX_RECURSION_DEPTH 64
+
+// The radix sort scatter stages small elements in lines of this many bytes (one cache line) before writing them out.
+#define _RADIX_WC_LINE_SIZE 64
+
+// Scatters of fewer elements than this are done directly, without staging: their destination stays in the second level
+// cache, and there the staging copy costs more than it saves.
+#define _RADIX_WC_MIN_SIZE (1 << 18)
+
+// Inputs of at least this many elements are sorted by parallel_buffered_sort with a sample sort rather than the 
+// split-and-merge tree. Below it the log(P) merge passes are cheap enough and the merge keeps better cache locality.
+#define _SAMPLE_SORT_MIN_SIZE (1 << 20)
+
+// Number of samples taken per bucket when choosing the sample sort splitters. More samples make the buckets more even 
+// at the cost of a larger serial sort of the sample.
+#define _SAMPLE_SORT_OVERSAMPLING 32
+
+template<typename _Random_iterator, typename _Function>
+inline size_t _Median_of_three(const _Random_iterator &_Begin, size_t _A, size_t _B, size_t _C, const _Function &_Func, bool &_Potentially_equal)
+{
+    _Potentially_equal = false;
+    if (_Func(_Begin[_A], _Begin[_B]))
+    {
+        if (_Func(_Begin[_A], _Begin[_C]))
+        {
+            return _Func(_Begin[_B], _Begin[_C]) ? _B : _C;
+        }
+        else
+        {
+            return _A;
+        }
+    }
+    else
+    {
+        if (_Func(_Begin[_B], _Begin[_C]))
+        {
+            return _Func(_Begin[_A], _Begin[_C]) ? _A : _C;
+        }
+        else
+        {
+            _Potentially_equal = true;
+            return _B;
+        }
+    }
+}
+
+template<typename _Random_iterator, typename _Function>
+inline size_t _Median_of_nine(const _Random_iterator &_Begin, size_t _Size, const _Function &_Func, bool &_Potentially_equal)
+{
+    size_t _Offset = _Size / 8;
+    size_t _A = _Median_of_three(_Begin, 0, _Offset, _Offset * 2, _Func, _Potentially_equal),
+        _B = _Median_of_three(_Begin, _Offset * 3, _Offset * 4, _Offset * 5, _Func, _Potentially_equal),
+        _C = _Median_of_three(_Begin, _Offset * 6, _Offset * 7, _Size - 1, _Func, _Potentially_equal);
+    _B = _Median_of_three(_Begin, _A, _B, _C, _Func, _Potentially_equal);
+
+    if (_Potentially_equal)
+    {
+        _Potentially_equal = !_Func(_Begin[_C], _Begin[_A]);
+    }
+
+    return _B;
+}
+
+// _Potentially_equal means that potentially all the values in the buffer are equal to the pivot value
+template<typename _Random_iterator, typename _Function>
+inline size_t _Select_median_pivot(const _Random_iterator &_Begin, size_t _Size, const _Function &_Func, const size_t _Chunk_size, bool &_Potentially_equal)
+{
+    // Base on different chunk size, apply different sampling optimization
+    if (_Chunk_size < _FINE_GRAIN_CHUNK_SIZE && _Size <= (std::max)(_Chunk_size * 4, static_cast<size_t>(15)))
+    {
+        bool _Never_care_equal;
+        return _Median_of_three(_Begin, 0, _Size / 2, _Size - 1, _Func, _Never_care_equal);
+    }
+    else
+    {
+        return _Median_of_nine(_Begin, _Size, _Func, _Potentially_equal);
+    }
+}
+
+// Find out two middle points for two sorted arrays by binary search so that the number of total elements on the left part of two middle points is equal
+// to the number of total elements on the right part of two sorted arrays and all elements on the left part is smaller than right part. 
+// Equal elements are split the way a stable merge would order them: those of the first array go before those of the second array, so
+// merging the two halves separately is still stable.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+size_t _Search_mid_point(const _Random_iterator &_Begin1, size_t &_Len1, const _Random_buffer_iterator &_Begin2, size_t &_Len2, const _Function &_Func)
+{
+    size_t _Len = (_Len1 + _Len2) / 2;
+
+    // Find the number of elements _Mid1 taken from the first array: the smallest one for which the next element of the first array
+    // goes after the last element taken from the second array
+    size_t _Low = (_Len > _Len2) ? _Len - _Len2 : 0, _High = (std::min)(_Len, _Len1);
+
+    while (_Low < _High)
+    {
+        size_t _Mid1 = (_Low + _High) / 2;
+        if (_Func(_Begin2[_Len - _Mid1 - 1], _Begin1[_Mid1]))
+        {
+            _High = _Mid1;
+        }
+        else
+        {
+            _Low = _Mid1 + 1;
+        }
+    }
+
+    _Len1 = _Low;
+    _Len2 = _Len - _Low;
+
+    return _Len;
+}
+
+// "move" operation is applied between buffers
+// The merge is stable: of two equal elements, the one from the first chunk is moved first.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Random_output_iterator, typename _Function>
+void _Merge_chunks(_Random_iterator _Begin1, const _Random_iterator &_End1, _Random_buffer_iterator _Begin2, const _Random_buffer_iterator &_End2, 
+    _Random_output_iterator _Output, const _Function &_Func)
+{
+    while (_Begin1 != _End1 && _Begin2 != _End2)
+    {
+        if (_Func(*_Begin2, *_Begin1))
+        {
+            *_Output++ = std::move(*_Begin2++);
+        }
+        else
+        {
+            *_Output++ = std::move(*_Begin1++);
+        }
+    }
+
+    if (_Begin1 != _End1)
+    {
+        std::move(_Begin1, _End1, _Output);
+    }
+    else if (_Begin2 != _End2)
+    {
+        std::move(_Begin2, _End2, _Output);
+    }
+}
+
+// _Div_num of threads(tasks) merge two chunks in parallel, _Div_num should be power of 2, if not, the largest power of 2 that is
+// smaller than _Div_num will be used
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Random_output_iterator, typename _Function>
+void _Parallel_merge(_Random_iterator _Begin1, size_t _Len1, _Random_buffer_iterator _Begin2, size_t _Len2, _Random_output_iterator _Output, 
+    const _Function &_Func, size_t _Div_num)
+{
+    // Turn to serial merge or continue splitting chunks base on "_Div_num"
+    if (_Div_num <= 1 || (_Len1 <= 1 && _Len2 <= 1))
+    {
+        _Merge_chunks(_Begin1, _Begin1 + _Len1, _Begin2, _Begin2 + _Len2, _Output, _Func);
+    }
+    else
+    {
+        size_t _Mid_len1 = _Len1, _Mid_len2 = _Len2;
+        size_t _Mid = _Search_mid_point(_Begin1, _Mid_len1, _Begin2, _Mid_len2, _Func);
+
+        structured_task_group _Tg;
+        auto _Handle = make_task([&] 
+        {
+            _Parallel_merge(_Begin1, _Mid_len1, _Begin2, _Mid_len2, _Output, _Func, _Div_num / 2); 
+        });
+        _Tg.run(_Handle);
+
+        _Parallel_merge(_Begin1 + _Mid_len1, _Len1 - _Mid_len1, _Begin2 + _Mid_len2, _Len2 - _Mid_len2, _Output + _Mid, _Func, _Div_num / 2);
+
+        _Tg.wait();
+    }
+}
+
+// Return current sorting byte from key 
+template<typename _Ty, typename _Function>
+inline size_t _Radix_key(const _Ty& _Val, size_t _Radix, _Function _Proj_func)
+{
+    return static_cast<size_t>(_Proj_func(_Val) >> static_cast<int>(8 * _Radix) & 255);
+}
+
+// Scatter the elements of segment [_Beg_index, _End_index) of buffer "_Begin" into buffer "_Output" by their byte at "_Radix".
+// _Pos holds the end position of each of the 256 destination chunks and is moved down to the start of the elements written.
+// The segment is walked backwards so that the scatter is stable.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+inline void _Radix_scatter(const _Random_iterator &_Begin, size_t _Beg_index, size_t _End_index, const _Random_buffer_iterator &_Output, 
+    size_t * _Pos, size_t _Radix, _Function _Proj_func, std::false_type)
+{
+    while (_End_index != _Beg_index)
+    {
+        --_End_index;
+        _Output[--_Pos[_Radix_key(_Begin[_End_index], _Radix, _Proj_func)]] = std::move(_Begin[_End_index]);
+    }
+}
+
+// Write-combining version of the scatter for small plain-old-data elements.
+// With 256 destination chunks, nearly every store of the plain scatter touches a different cache line (and, for large buffers,
+// a different page), so the scatter is dominated by cache and TLB misses. Instead each chunk gets a cache-line sized staging 
+// line which is filled first and then written out to the destination in one piece.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+inline void _Radix_scatter(const _Random_iterator &_Begin, size_t _Beg_index, size_t _End_index, const _Random_buffer_iterator &_Output, 
+    size_t * _Pos, size_t _Radix, _Function _Proj_func, std::true_type)
+{
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _Value_type;
+    const size_t _Line_elems = _RADIX_WC_LINE_SIZE / sizeof(_Value_type);
+
+    Concurrency::samples::details::_MallocaArrayHolder<_Value_type> _Holder;
+    _Value_type * _Lines = static_cast<_Value_type *>(_malloca(sizeof(_Value_type) * 256 * _Line_elems));
+    _Holder._Initialize(_Lines);
+
+    // Lines are filled from the back, matching the backward walk over the segment
+    size_t _Fill[256] = {0};
+
+    while (_End_index != _Beg_index)
+    {
+        --_End_index;
+        size_t _Key = _Radix_key(_Begin[_End_index], _Radix, _Proj_func);
+        _Value_type * _Line = _Lines + _Key * _Line_elems;
+
+        _Line[_Line_elems - ++_Fill[_Key]] = _Begin[_End_index];
+        if (_Fill[_Key] == _Line_elems)
+        {
+            _Pos[_Key] -= _Line_elems;
+            std::copy(_Line, _Line + _Line_elems, _Output + _Pos[_Key]);
+            _Fill[_Key] = 0;
+        }
+    }
+
+    // Flush the partially filled lines
+    for (size_t _Key = 0; _Key < 256; ++_Key)
+    {
+        if (_Fill[_Key])
+        {
+            _Value_type * _Line = _Lines + _Key * _Line_elems;
+            _Pos[_Key] -= _Fill[_Key];
+            std::copy(_Line + _Line_elems - _Fill[_Key], _Line + _Line_elems, _Output + _Pos[_Key]);
+        }
+    }
+}
+
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+inline void _Radix_scatter(const _Random_iterator &_Begin, size_t _Beg_index, size_t _End_index, const _Random_buffer_iterator &_Output, 
+    size_t * _Pos, size_t _Radix, _Function _Proj_func)
+{
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _Value_type;
+
+    // Staging only pays off when the destination is much bigger than the caches
+    if (_End_index - _Beg_index >= _RADIX_WC_MIN_SIZE)
+    {
+        _Radix_scatter(_Begin, _Beg_index, _End_index, _Output, _Pos, _Radix, _Proj_func, 
+            std::integral_constant<bool, std::is_pod<_Value_type>::value && sizeof(_Value_type) * 4 <= _RADIX_WC_LINE_SIZE>());
+    }
+    else
+    {
+        _Radix_scatter(_Begin, _Beg_index, _End_index, _Output, _Pos, _Radix, _Proj_func, std::false_type());
+    }
+}
+
+// Serial least-significant-byte radix sort, it will sort base on last "_Radix" number of bytes
+//
+// The histograms of all the bytes are built together in a single read pass, since the count of a byte doesn't depend
+// on the order of the elements. That also tells up front which bytes are the same for every element; these bytes are 
+// skipped because the pass would not reorder anything.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+void _Integer_radix_sort(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output, 
+    size_t _Radix, _Function _Proj_func, size_t _Deep = 0)
+{
+    typedef typename std::remove_const<typename std::remove_reference<decltype(_Proj_func(*_Begin))>::type>::type _Integer_type;
+
+    if (_Size == 0)
+    {
+        return;
+    }
+
+    Concurrency::samples::details::_MallocaArrayHolder<size_t> _Holder;
+    size_t (*_Pos)[256] = static_cast<size_t (*)[256]>(_malloca(sizeof(size_t) * 256 * (_Radix + 1)));
+    _Holder._Initialize(_Pos[0]);
+
+    memset(_Pos, 0, sizeof(size_t) * 256 * (_Radix + 1));
+
+    // Project each key once and count all of its bytes; the counters of different bytes are independent so the 
+    // increments of one element don't wait on each other
+    for (size_t _I = 0; _I < _Size; _I++)
+    {
+        _Integer_type _Key = _Proj_func(_Begin[_I]);
+        for (size_t _R = 0; _R <= _Radix; _R++)
+        {
+            ++_Pos[_R][static_cast<size_t>(_Key & 255)];
+            _Key >>= 8;
+        }
+    }
+
+    // Every element has the same byte as the first one when that byte is trivial
+    _Integer_type _First_key = _Proj_func(_Begin[0]);
+    bool _Result_in_begin = true;
+
+    for (size_t _R = 0; _R <= _Radix; _R++)
+    {
+        if (_Pos[_R][static_cast<size_t>(_First_key & 255)] != _Size)
+        {
+            for (size_t _I = 1; _I < 256; _I++)
+            {
+                _Pos[_R][_I] += _Pos[_R][_I - 1];
+            }
+
+            if (_Result_in_begin)
+            {
+                _Radix_scatter(_Begin, 0, _Size, _Output, _Pos[_R], _R, _Proj_func);
+            }
+            else
+            {
+                _Radix_scatter(_Output, 0, _Size, _Begin, _Pos[_R], _R, _Proj_func);
+            }
+
+            _Result_in_begin = !_Result_in_begin;
+        }
+
+        _First_key >>= 8;
+    }
+
+    // The buffers swap roles at each level of the parallel most-significant-byte sort, so at an odd depth the original 
+    // input is buffer "_Output". Move the result there if it ended up in the other buffer.
+    bool _Begin_is_input = (_Deep & 1) == 0;
+    if (_Result_in_begin != _Begin_is_input)
+    {
+        if (_Result_in_begin)
+        {
+            std::move(_Begin, _Begin + _Size, _Output);
+        }
+        else
+        {
+            std::move(_Output, _Output + _Size, _Begin);
+        }
+    }
+}
+
+// Parallel most-significant-byte _Radix sort.
+// In the end, it will turn to serial least-significant-byte radix sort
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+void _Parallel_integer_radix_sort(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output, 
+    size_t _Radix, _Function _Proj_func, const size_t _Chunk_size, size_t _Deep = 0)
+{
+    // If the chunk _Size is too small, then turn to serial least-significant-byte radix sort
+    if (_Size <= _Chunk_size || _Radix < 1)
+    {
+        return _Integer_radix_sort(_Begin, _Size, _Output, _Radix, _Proj_func, _Deep);
     }
 
     size_t _Threads_num = Concurrency::CurrentScheduler::Get()->GetNumberOfVirtualProcessors();
@@ -1816,60 +4275,427 @@ void _Parallel_integer_radix_sort(const _Random_iterator &_Begin, size_t _Size,
     size_t _Step = _Size / _Threads_num;
     size_t _Remain = _Size % _Threads_num;
 
-    Concurrency::samples::details::_MallocaArrayHolder<size_t [256]> _Holder;
-    size_t (*_Chunks)[256] = static_cast<size_t (*)[256]>(_malloca(_Buffer_size));
-    _Holder._Initialize(_Chunks);
+    Concurrency::samples::details::_MallocaArrayHolder<size_t> _Holder;
+    size_t (*_Chunks)[256] = static_cast<size_t (*)[256]>(_malloca(_Buffer_size));
+    _Holder._Initialize(_Chunks[0]);
+
+    memset(_Chunks, 0, _Buffer_size);
+
+    // Our purpose is to map unsorted data in buffer "_Begin" to buffer "_Output" so that all elements who have the same 
+    // byte value in the "_Radix" position will be grouped together in the buffer "_Output"
+    //
+    // Serial version:
+    // To understand this algorithm, first consider a serial version. In following example, we treat 1 digit as 1 byte, so we have a 
+    // total of 10 elements for each digit instead of 256 elements in each byte. Let's suppose "_Radix" == 1 (right most is 0), and:
+    //
+    //      begin:  [ 32 | 62 | 21 | 43 | 55 | 43 | 23 | 44 ]
+    // 
+    // We want to divide the output buffer "_Output" into 10 chunks, and each the element in the "_Begin" buffer should be mapped into 
+    // the proper destination chunk based on its current digit (byte) indicated by "_Radix"
+    //
+    // Because "_Radix" == 1, after a pass of this function, the chunks in the "_Output" should look like:
+    //
+    //      buffer: [   |   | 21 23 | 32 | 43 43 44 | 55 | 62 |   |   |   ]
+    //                0   1     2      3      4        5    6   7   8   9
+    // 
+    // The difficulty is determining where to insert values into the "_Output" to get the above result. The way to get the
+    // start position of each chunk of the buffer is:
+    //      1. Count the number of elements for each chunk (in above example, chunk0 is 0, chunk1 is 0, chunk2 is 2, chunk3 is 1 ...
+    //      2. Make a partial sum for these chunks( in above example,  we will get chunk0=chunk0=0, chunk1=chunk0+chunk1=0, 
+    //         chunk2=chunk0+chunk1+chunk2=2, chunk3=chunk0+chunk1+chunk2+chunk3=3
+    //
+    // After these steps, we will get the end position of each chunk in the "_Output". The begin position of each chunk will be the end 
+    // point of last chunk (begin point is close but the end point is open). After that,  we can scan the original array again and directly 
+    // put elements from original buffer "_Begin" into specified chunk on buffer "_Output".
+    // Finally, we invoke _parallel_integer_radix_sort in parallel for each chunk and sort them in parallel based on the next digit (byte).
+    // Because this is a STABLE sort algorithm, if two numbers has same key value on this byte (digit), their original order should be kept.
+    //
+    // Parallel version:
+    // Almost the same as the serial version, the differences are:
+    //      1. The count for each chunk is executed in parallel, and each thread will count one segment of the input buffer "_Begin".
+    //         The count result will be separately stored in their own chunk size counting arrays so we have a total of threads-number 
+    //         of chunk count arrays.
+    //         For example, we may have chunk00, chunk01, ..., chunk09 for first thread, chunk10, chunk11, ..., chunk19 for second thread, ...
+    //      2. The partial sum should be executed across these chunk counting arrays that belong to different threads, instead of just 
+    //         making a partial sum in one counting array. 
+    //         This is because we need to put values from different segments into one final buffer, and the absolute buffer position for 
+    //         each chunkXX is needed.
+    //      3. Make a parallel scan for original buffer again, and move numbers in parallel into the corresponding chunk on each buffer based
+    //         on these threads' chunk size counters.
+
+    // Count in parallel and separately save their local results without reducing
+    Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [=](size_t _Index) 
+    {
+        size_t _Beg_index, _End_index;
+
+        // Calculate the segment position
+        if (_Index < _Remain)
+        {
+            _Beg_index = _Index * (_Step + 1);
+            _End_index = _Beg_index + (_Step + 1);
+        }
+        else
+        {
+            _Beg_index = _Remain * (_Step + 1) + (_Index - _Remain) * _Step;
+            _End_index = _Beg_index + _Step;
+        }
+
+        // Do a counting
+        while (_Beg_index != _End_index)
+        {
+            ++_Chunks[_Index][_Radix_key(_Begin[_Beg_index++], _Radix, _Proj_func)];
+        }
+    });
+
+    int _Count = 0;
+
+    // Partial sum cross different threads' chunk counters
+    for (int _I = 0; _I < 256; _I++)
+    {
+        size_t _Last = _I ? _Chunks[_Threads_num - 1][_I - 1] : 0;
+        _Chunks[0][_I] += _Last;
+
+        for (size_t _J = 1; _J < _Threads_num; _J++)
+        {
+            _Chunks[_J][_I] += _Chunks[_J - 1][_I];
+        }
+
+        // "_Chunks[_Threads_num - 1][_I] - _Last" will get the global _Size for chunk _I(including all threads local _Size for chunk _I)
+        // this will chunk whether the chunk _I is empty or not. If it's not empty, it will be recorded.
+        if (_Chunks[_Threads_num - 1][_I] - _Last)
+        {
+            ++_Count;
+        }
+    }
+
+    // If there is more than 1 chunk that has content, then continue the original algorithm
+    if (_Count > 1)
+    {
+        // Move the elements in parallel into each chunk
+        Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [=](size_t _Index) 
+        {
+            size_t _Beg_index, _End_index;
+
+            // Calculate the segment position
+            if (_Index < _Remain)
+            {
+                _Beg_index = _Index * (_Step + 1);
+                _End_index = _Beg_index + (_Step + 1);
+            }
+            else
+            {
+                _Beg_index = _Remain * (_Step + 1) + (_Index - _Remain) * _Step;
+                _End_index = _Beg_index + _Step;
+            }
+
+            // Do a move operation to directly put each value into its destination chunk
+            // Chunk pointer is moved after each put operation.
+            _Radix_scatter(_Begin, _Beg_index, _End_index, _Output, _Chunks[_Index], _Radix, _Proj_func);
+        });
+
+        // Invoke _parallel_integer_radix_sort in parallel for each chunk 
+        Concurrency::parallel_for(static_cast<size_t>(0), static_cast<size_t>(256), [=](size_t _Index) 
+        {
+            if (_Index < 256 - 1)
+            {
+                _Parallel_integer_radix_sort(_Output + _Chunks[0][_Index], _Chunks[0][_Index + 1] - _Chunks[0][_Index], 
+                    _Begin + _Chunks[0][_Index], _Radix - 1, _Proj_func, _Chunk_size, _Deep + 1);
+            }
+            else
+            {
+                _Parallel_integer_radix_sort(_Output + _Chunks[0][_Index], _Size - _Chunks[0][_Index], 
+                    _Begin + _Chunks[0][_Index], _Radix - 1, _Proj_func, _Chunk_size, _Deep + 1);
+            }
+        });
+    }
+    else
+    {
+        // Only one chunk has content
+        // A special optimization is applied because one chunk means all numbers have a same value on this particular byte (digit).
+        // Since we cannot sort them at all (they are all equal at this point), directly call _parallel_integer_radix_sort to
+        // sort next byte (digit)
+        _Parallel_integer_radix_sort(_Begin, _Size, _Output, _Radix - 1, _Proj_func, _Chunk_size, _Deep);
+    }
+}
+
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+void _Parallel_integer_sort_asc(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output,
+    _Function _Proj_func, const size_t _Chunk_size)
+{
+    // The key type of the radix sort, this must be an "unsigned integer-like" type, i.e., it needs support: 
+    //     operator>> (int), operator>>= (int), operator& (int), operator <, operator size_t ()
+    typedef typename std::remove_const<typename std::remove_reference<decltype(_Proj_func(*_Begin))>::type>::type _Integer_type;
+
+    // Find out the max value, which will be used to determine the highest differing byte (the radix position)
+    _Integer_type _Max_val = Concurrency::samples::parallel_reduce(_Begin, _Begin + _Size, _Proj_func(*_Begin), 
+        [=](_Random_iterator _Begin, _Random_iterator _End, _Integer_type _Init) -> _Integer_type 
+    {
+        while (_Begin != _End)
+        {
+            _Integer_type _Ret = _Proj_func(*_Begin++);
+            if (_Init < _Ret)
+            {
+                _Init = _Ret;
+            }
+        }
 
-    memset(_Chunks, 0, _Buffer_size);
+        return _Init;
+    }, [](_Integer_type _Left, _Integer_type _Right) -> _Integer_type
+    {
+        return (_Left < _Right) ? _Right : _Left;
+    });
+    size_t _Radix = 0;
 
-    // Our purpose is to map unsorted data in buffer "_Begin" to buffer "_Output" so that all elements who have the same 
-    // byte value in the "_Radix" position will be grouped together in the buffer "_Output"
-    //
-    // Serial version:
-    // To understand this algorithm, first consider a serial version. In following example, we treat 1 digit as 1 byte, so we have a 
-    // total of 10 elements for each digit instead of 256 elements in each byte. Let's suppose "_Radix" == 1 (right most is 0), and:
-    //
-    //      begin:  [ 32 | 62 | 21 | 43 | 55 | 43 | 23 | 44 ]
-    // 
-    // We want to divide the output buffer "_Output" into 10 chunks, and each the element in the "_Begin" buffer should be mapped into 
-    // the proper destination chunk based on its current digit (byte) indicated by "_Radix"
-    //
-    // Because "_Radix" == 1, after a pass of this function, the chunks in the "_Output" should look like:
-    //
-    //      buffer: [   |   | 21 23 | 32 | 43 43 44 | 55 | 62 |   |   |   ]
-    //                0   1     2      3      4        5    6   7   8   9
-    // 
-    // The difficulty is determining where to insert values into the "_Output" to get the above result. The way to get the
-    // start position of each chunk of the buffer is:
-    //      1. Count the number of elements for each chunk (in above example, chunk0 is 0, chunk1 is 0, chunk2 is 2, chunk3 is 1 ...
-    //      2. Make a partial sum for these chunks( in above example,  we will get chunk0=chunk0=0, chunk1=chunk0+chunk1=0, 
-    //         chunk2=chunk0+chunk1+chunk2=2, chunk3=chunk0+chunk1+chunk2+chunk3=3
-    //
-    // After these steps, we will get the end position of each chunk in the "_Output". The begin position of each chunk will be the end 
-    // point of last chunk (begin point is close but the end point is open). After that,  we can scan the original array again and directly 
-    // put elements from original buffer "_Begin" into specified chunk on buffer "_Output".
-    // Finally, we invoke _parallel_integer_radix_sort in parallel for each chunk and sort them in parallel based on the next digit (byte).
-    // Because this is a STABLE sort algorithm, if two numbers has same key value on this byte (digit), their original order should be kept.
-    //
-    // Parallel version:
-    // Almost the same as the serial version, the differences are:
-    //      1. The count for each chunk is executed in parallel, and each thread will count one segment of the input buffer "_Begin".
-    //         The count result will be separately stored in their own chunk size counting arrays so we have a total of threads-number 
-    //         of chunk count arrays.
-    //         For example, we may have chunk00, chunk01, ..., chunk09 for first thread, chunk10, chunk11, ..., chunk19 for second thread, ...
-    //      2. The partial sum should be executed across these chunk counting arrays that belong to different threads, instead of just 
-    //         making a partial sum in one counting array. 
-    //         This is because we need to put values from different segments into one final buffer, and the absolute buffer position for 
-    //         each chunkXX is needed.
-    //      3. Make a parallel scan for original buffer again, and move numbers in parallel into the corresponding chunk on each buffer based
-    //         on these threads' chunk size counters.
+    // Find out highest differing byte
+    while (_Max_val >>= 8)
+    {
+        ++_Radix;
+    }
 
-    // Count in parallel and separately save their local results without reducing
-    Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [=](size_t _Index) 
+    _Parallel_integer_radix_sort(_Begin, _Size, _Output, _Radix, _Proj_func, _Chunk_size);
+}
+
+template<typename _Random_iterator, typename _Function>
+void _Parallel_quicksort_impl(const _Random_iterator &_Begin, size_t _Size, const _Function &_Func, size_t _Div_num, const size_t _Chunk_size, int _Depth)
+{
+    if (_Depth >= _SORT_MAX_RECURSION_DEPTH || _Size <= _Chunk_size || _Size <= static_cast<size_t>(3) || (_Chunk_size >= _FINE_GRAIN_CHUNK_SIZE && _Div_num <= 1))
+    {
+        return std::sort(_Begin, _Begin + _Size, _Func);
+    }
+
+    // Determine whether we need to do a three-way quick sort
+    // We benefit from three-way merge if there are a lot of elements that are EQUAL to the median value,
+    // _Select_median_pivot function will test redundant density by sampling
+    bool _Is_three_way_split = false;
+    size_t _Mid_index = _Select_median_pivot(_Begin, _Size, _Func, _Chunk_size, _Is_three_way_split);
+
+    // Move the median value to the _Begin position.
+    if (_Mid_index)
+    {
+        std::swap(*_Begin, _Begin[_Mid_index]);
+    }
+    size_t _I = 1, _J = _Size - 1;
+
+    // Three-way or two-way partition
+    // _Div_num < _MAX_NUM_TASKS_PER_CORE is checked to make sure it will never do three-way split before splitting enough tasks
+    if (_Is_three_way_split && _Div_num < _MAX_NUM_TASKS_PER_CORE)
+    {
+        while (_Func(*_Begin, _Begin[_J]))
+        {
+            --_J;
+        }
+
+        while (_Func(_Begin[_I], *_Begin))
+        {
+            ++_I;
+        }
+
+        // Starting from this point, left side of _I will less than median value, right side of _J will be greater than median value, 
+        // and the middle part will be equal to median. _K is used to scan between _I and _J
+        size_t _K = _J;
+        while (_I <= _K)
+        {
+            if (_Func(_Begin[_K], *_Begin))
+            {
+                std::swap(_Begin[_I++], _Begin[_K]);
+            }
+            else
+            {
+                --_K;
+            }
+
+            while (_Func(*_Begin, _Begin[_K]))
+            {
+                std::swap(_Begin[_K--], _Begin[_J--]);
+            }
+        }
+
+        ++_J;
+    }
+    else
+    {
+        while (_I <= _J)
+        {
+            // Will stop before _Begin
+            while (_Func(*_Begin, _Begin[_J]))
+            {
+                --_J;
+            }
+
+            // There must be another element equal or greater than *_Begin
+            while (_Func(_Begin[_I], *_Begin))
+            {
+                ++_I;
+            }
+
+            if (_I < _J)
+            {
+                std::swap(_Begin[_I++], _Begin[_J--]);
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        _I = ++_J;
+    }
+
+    std::swap(*_Begin, _Begin[--_I]);
+
+    structured_task_group _Tg;
+    volatile size_t _Next_div = _Div_num / 2;
+    auto _Handle = make_task([&] 
+    {
+        _Parallel_quicksort_impl(_Begin + _J, _Size - _J, _Func, _Next_div, _Chunk_size, _Depth+1);
+    });
+    _Tg.run(_Handle);
+
+    _Parallel_quicksort_impl(_Begin, _I, _Func, _Next_div, _Chunk_size, _Depth+1);
+
+    // If at this point, the work hasn't been scheduled, then slow down creating new tasks
+    if (_Div_num < _MAX_NUM_TASKS_PER_CORE)
+    {
+        _Next_div /= 2;
+    }
+
+    _Tg.wait();
+}
+
+// This function will be called to sort the elements in the "_Begin" buffer. However, we can't tell whether the result will end up in buffer
+// "_Begin", or buffer "_Output" when it returned. The return value is designed to indicate which buffer holds the sorted result.
+// Return true if the merge result is in the "_Begin" buffer; return false if the result is in the "_Output" buffer.
+// We can't always put the result into one assigned buffer because that may cause frequent buffer copies at return time.
+// When _Stable is set, the chunks are sorted with std::stable_sort; the merges are always stable, so the whole sort is then stable.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+inline bool _Parallel_buffered_sort_impl(const _Random_iterator &_Begin, size_t _Size, _Random_buffer_iterator _Output, const _Function &_Func, 
+    int _Div_num, const size_t _Chunk_size, bool _Stable = false)
+{
+    static_assert(std::is_same<typename std::iterator_traits<_Random_iterator>::value_type, typename std::iterator_traits<_Random_buffer_iterator>::value_type>::value, 
+        "same value type expected");
+
+    if (_Div_num <= 1 || _Size <= _Chunk_size)
+    {
+        if (_Stable)
+        {
+            std::stable_sort(_Begin, _Begin + _Size, _Func);
+        }
+        else
+        {
+            _Parallel_quicksort_impl(_Begin, _Size, _Func, _MAX_NUM_TASKS_PER_CORE, _Chunk_size, 0);
+        }
+
+        // In case _Size <= _Chunk_size happened BEFORE the planned stop time (when _Div_num == 1) we need to calculate how many turns of 
+        // binary divisions are left. If there are an odd number of turns left, then the buffer move is necessary to make sure the final 
+        // merge result will be in the original input array.
+        int _Left_div_turns = 0;
+        while (_Div_num >>= 1)
+        {
+            _Left_div_turns++;
+        }
+
+        if (_Left_div_turns & 1)
+        {
+            std::move(_Begin, _Begin + _Size, _Output);
+            return true;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    else
+    {
+        size_t _Mid = _Size / 2;
+        structured_task_group _Tg;
+
+        auto _Handle = make_task([&, _Chunk_size] 
+        {
+            _Parallel_buffered_sort_impl(_Begin, _Mid, _Output, _Func, _Div_num / 2, _Chunk_size, _Stable); 
+        });
+        _Tg.run(_Handle);
+
+        bool _Is_buffer_swap = _Parallel_buffered_sort_impl(_Begin + _Mid, _Size - _Mid, _Output + _Mid, _Func, _Div_num / 2, _Chunk_size, _Stable);
+
+        _Tg.wait();
+
+        if (_Is_buffer_swap)
+        {
+            _Parallel_merge(_Output, _Mid, _Output + _Mid, _Size - _Mid, _Begin, _Func, _Div_num);
+        }
+        else
+        {
+            _Parallel_merge(_Begin, _Mid, _Begin + _Mid, _Size - _Mid, _Output, _Func, _Div_num);
+        }
+
+        return !_Is_buffer_swap;
+    }
+}
+
+// Aligns the highest bit of _Core_num to a power(2, even number), that is a power of 4, rounding up. Splitting the input into that
+// many chunks makes the merge passes of _Parallel_buffered_sort_impl end in the original input array; see parallel_buffered_sort.
+inline size_t _Align_core_num_to_power_of_four(size_t _Core_num)
+{
+    const size_t _Core_num_mask = 0x55555555;
+    return (_Core_num & _Core_num_mask) | ((_Core_num << 1) & _Core_num_mask);
+}
+
+// Parallel sample sort, used by parallel_buffered_sort for very large inputs.
+// The split-and-merge tree in _Parallel_buffered_sort_impl streams the whole array through memory once per merge level,
+// which is log(P) full passes. When the input is far larger than the caches the sort is bound by memory bandwidth, so
+// instead we:
+//      1. Draw an oversampled, evenly strided sample from the input, sort it serially and pick _Bucket_num - 1 splitters.
+//      2. Classify every element against the splitters in parallel. Each thread owns one segment of the input and counts
+//         its elements per bucket in its own histogram; the bucket of every element is remembered in a byte array so that
+//         the comparisons are not repeated.
+//      3. Make a partial sum across the per-thread histograms (bucket-major, then thread) which gives each thread its own
+//         destination range inside every bucket, and scatter the segments into buffer "_Output" in parallel.
+//      4. Sort the buckets independently in parallel and move each one back into place in buffer "_Begin".
+// That is two passes over the data (classify/scatter and sort/move back) whatever the number of cores.
+// Like the radix sort, the scatter is stable within a bucket, but the bucket sort is not, so neither is the whole sort.
+template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
+void _Parallel_sample_sort_impl(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output, const _Function &_Func, 
+    size_t _Core_num, const size_t _Chunk_size)
+{
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _Value_type;
+
+    // Several buckets per core so that an uneven split still balances out; at most 256 so that a bucket index fits in a byte
+    const size_t _Bucket_num = (std::min)(static_cast<size_t>(256), _Core_num * 8);
+    const size_t _Sample_num = _Bucket_num * _SAMPLE_SORT_OVERSAMPLING;
+    const size_t _Stride = _Size / _Sample_num;
+
+    _ASSERTE(_Stride > 0);
+
+    // Take one sample from each stride of the input, at a pseudo-random offset within the stride so that periodic 
+    // inputs don't defeat the sampling
+    std::vector<_Value_type> _Samples;
+    _Samples.reserve(_Sample_num);
+
+    unsigned int _Seed = 0x9E3779B9;
+    for (size_t _I = 0; _I < _Sample_num; ++_I)
+    {
+        _Seed ^= _Seed << 13;
+        _Seed ^= _Seed >> 17;
+        _Seed ^= _Seed << 5;
+        _Samples.push_back(_Begin[_I * _Stride + _Seed % _Stride]);
+    }
+
+    std::sort(_Samples.begin(), _Samples.end(), _Func);
+
+    std::vector<_Value_type> _Splitters;
+    _Splitters.reserve(_Bucket_num - 1);
+    for (size_t _I = 1; _I < _Bucket_num; ++_I)
     {
-        size_t _Beg_index, _End_index;
+        _Splitters.push_back(std::move(_Samples[_I * _SAMPLE_SORT_OVERSAMPLING]));
+    }
+    _Samples.clear();
 
-        // Calculate the segment position
+    size_t _Threads_num = _Core_num;
+    size_t _Step = _Size / _Threads_num;
+    size_t _Remain = _Size % _Threads_num;
+
+    auto _Segment = [=](size_t _Index, size_t &_Beg_index, size_t &_End_index)
+    {
         if (_Index < _Remain)
         {
             _Beg_index = _Index * (_Step + 1);
@@ -1880,377 +4706,938 @@ void _Parallel_integer_radix_sort(const _Random_iterator &_Begin, size_t _Size,
             _Beg_index = _Remain * (_Step + 1) + (_Index - _Remain) * _Step;
             _End_index = _Beg_index + _Step;
         }
+    };
 
-        // Do a counting
-        while (_Beg_index != _End_index)
-        {
-            ++_Chunks[_Index][_Radix_key(_Begin[_Beg_index++], _Radix, _Proj_func)];
-        }
-    });
+    std::vector<unsigned char> _Bucket_of(_Size);
+    std::vector<size_t> _Chunks(_Threads_num * _Bucket_num, 0);
 
-    int _Index = -1, _Count = 0;
+    const _Value_type * _Splitter_begin = _Splitters.data();
+    const _Value_type * _Splitter_end = _Splitter_begin + _Splitters.size();
+    unsigned char * _Bucket_ptr = _Bucket_of.data();
+    size_t * _Chunk_ptr = _Chunks.data();
 
-    // Partial sum cross different threads' chunk counters
-    for (int _I = 0; _I < 256; _I++)
+    // Classify and count in parallel; element x goes to bucket i where splitter[i-1] <= x < splitter[i]
+    Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [&](size_t _Index)
     {
-        size_t _Last = _I ? _Chunks[_Threads_num - 1][_I - 1] : 0;
-        _Chunks[0][_I] += _Last;
+        size_t _Beg_index, _End_index;
+        _Segment(_Index, _Beg_index, _End_index);
 
-        for (size_t _J = 1; _J < _Threads_num; _J++)
+        size_t * _Counts = _Chunk_ptr + _Index * _Bucket_num;
+        for (; _Beg_index != _End_index; ++_Beg_index)
         {
-            _Chunks[_J][_I] += _Chunks[_J - 1][_I];
+            size_t _Bucket = std::upper_bound(_Splitter_begin, _Splitter_end, _Begin[_Beg_index], _Func) - _Splitter_begin;
+            _Bucket_ptr[_Beg_index] = static_cast<unsigned char>(_Bucket);
+            ++_Counts[_Bucket];
         }
+    });
 
-        // "_Chunks[_Threads_num - 1][_I] - _Last" will get the global _Size for chunk _I(including all threads local _Size for chunk _I)
-        // this will chunk whether the chunk _I is empty or not. If it's not empty, it will be recorded.
-        if (_Chunks[_Threads_num - 1][_I] - _Last)
+    // Partial sum across the threads' counters, turning each counter into that thread's write position in the bucket
+    std::vector<size_t> _Bucket_begin(_Bucket_num + 1);
+    size_t _Offset = 0;
+    for (size_t _Bucket = 0; _Bucket < _Bucket_num; ++_Bucket)
+    {
+        _Bucket_begin[_Bucket] = _Offset;
+        for (size_t _Index = 0; _Index < _Threads_num; ++_Index)
         {
-            ++_Count;
-            _Index = _I;
+            size_t _Count = _Chunk_ptr[_Index * _Bucket_num + _Bucket];
+            _Chunk_ptr[_Index * _Bucket_num + _Bucket] = _Offset;
+            _Offset += _Count;
         }
     }
+    _Bucket_begin[_Bucket_num] = _Offset;
 
-    // If there is more than 1 chunk that has content, then continue the original algorithm
-    if (_Count > 1)
+    // Scatter each segment into its buckets in buffer "_Output"
+    Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [&](size_t _Index)
     {
-        // Move the elements in parallel into each chunk
-        Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [=](size_t _Index) 
+        size_t _Beg_index, _End_index;
+        _Segment(_Index, _Beg_index, _End_index);
+
+        size_t * _Positions = _Chunk_ptr + _Index * _Bucket_num;
+        for (; _Beg_index != _End_index; ++_Beg_index)
         {
-            size_t _Beg_index, _End_index;
+            _Output[_Positions[_Bucket_ptr[_Beg_index]]++] = std::move(_Begin[_Beg_index]);
+        }
+    });
 
-            // Calculate the segment position
-            if (_Index < _Remain)
-            {
-                _Beg_index = _Index * (_Step + 1);
-                _End_index = _Beg_index + (_Step + 1);
-            }
-            else
-            {
-                _Beg_index = _Remain * (_Step + 1) + (_Index - _Remain) * _Step;
-                _End_index = _Beg_index + _Step;
-            }
+    // Release the classification before the sort pass rather than holding on to it
+    std::vector<unsigned char>().swap(_Bucket_of);
 
-            // Do a move operation to directly put each value into its destination chunk
-            // Chunk pointer is moved after each put operation.
-            if (_Beg_index != _End_index--)
-            {
-                while (_Beg_index != _End_index)
-                {
-                    _Output[--_Chunks[_Index][_Radix_key(_Begin[_End_index], _Radix, _Proj_func)]] = std::move(_Begin[_End_index]);
-                    --_End_index;
-                }
-                _Output[--_Chunks[_Index][_Radix_key(_Begin[_End_index], _Radix, _Proj_func)]] = std::move(_Begin[_End_index]);
-            }
-        });
+    // Sort the buckets and move them back. A bucket that is much bigger than its share (heavy duplicates, skewed data)
+    // is sorted with the parallel quicksort so that it does not serialize the tail of the sort.
+    const size_t _Large_bucket = _Size / _Core_num;
+    Concurrency::parallel_for(static_cast<size_t>(0), _Bucket_num, [&](size_t _Bucket)
+    {
+        size_t _Lo = _Bucket_begin[_Bucket];
+        size_t _Hi = _Bucket_begin[_Bucket + 1];
 
-        // Invoke _parallel_integer_radix_sort in parallel for each chunk 
-        Concurrency::parallel_for(static_cast<size_t>(0), static_cast<size_t>(256), [=](size_t _Index) 
+        if (_Hi - _Lo > _Large_bucket)
         {
-            if (_Index < 256 - 1)
-            {
-                _Parallel_integer_radix_sort(_Output + _Chunks[0][_Index], _Chunks[0][_Index + 1] - _Chunks[0][_Index], 
-                    _Begin + _Chunks[0][_Index], _Radix - 1, _Proj_func, _Chunk_size, _Deep + 1);
-            }
-            else
-            {
-                _Parallel_integer_radix_sort(_Output + _Chunks[0][_Index], _Size - _Chunks[0][_Index], 
-                    _Begin + _Chunks[0][_Index], _Radix - 1, _Proj_func, _Chunk_size, _Deep + 1);
-            }
-        });
-    }
-    else
+            _Parallel_quicksort_impl(_Output + _Lo, _Hi - _Lo, _Func, _Core_num * _MAX_NUM_TASKS_PER_CORE, _Chunk_size, 0);
+        }
+        else
+        {
+            std::sort(_Output + _Lo, _Output + _Hi, _Func);
+        }
+
+        std::move(_Output + _Lo, _Output + _Hi, _Begin + _Lo);
+    });
+}
+
+// Disable the warning saying constant value in condition expression.
+// This is by design that lets the compiler optimize the trivial constructor.
+#if defined(_MSC_VER)
+#pragma warning (push)
+#pragma warning (disable: 4127)
+#endif
+
+// The pre-standard trait names are what the Visual C++ 2010 library provides
+#if defined(CONCRTEXTRAS_STD_THREAD_BACKEND)
+template<typename _Ty>
+struct _Has_trivial_default_constructor : std::is_trivially_default_constructible<_Ty> {};
+
+template<typename _Ty>
+struct _Has_trivial_destructor : std::is_trivially_destructible<_Ty> {};
+#else
+template<typename _Ty>
+struct _Has_trivial_default_constructor : std::has_trivial_default_constructor<_Ty> {};
+
+template<typename _Ty>
+struct _Has_trivial_destructor : std::has_trivial_destructor<_Ty> {};
+#endif
+
+// Allocate and construct a buffer
+template<typename _Allocator>
+inline typename _Allocator::pointer _Construct_buffer(size_t _N, _Allocator &_Alloc)
+{
+    typename _Allocator::pointer _P = _Alloc.allocate(_N);
+
+    // If the objects being sorted have trivial default constructors, they do not need to be 
+    // constructed here. This can benefit performance.
+    if (!_Has_trivial_default_constructor<typename _Allocator::value_type>::value)
     {
-        // Only one chunk has content
-        // A special optimization is applied because one chunk means all numbers have a same value on this particular byte (digit).
-        // Since we cannot sort them at all (they are all equal at this point), directly call _parallel_integer_radix_sort to
-        // sort next byte (digit)
-        _Parallel_integer_radix_sort(_Begin, _Size, _Output, _Radix - 1, _Proj_func, _Chunk_size, _Deep);
+        for (size_t _I = 0; _I < _N; _I++)
+        {
+            // Objects being sorted must have a default constructor
+            typename _Allocator::value_type _T;
+            _Alloc.construct(_P + _I, std::forward<typename _Allocator::value_type>(_T));
+        }
     }
+
+    return _P;
 }
 
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
-void _Parallel_integer_sort_asc(const _Random_iterator &_Begin, size_t _Size, const _Random_buffer_iterator &_Output,
-    _Function _Proj_func, const size_t _Chunk_size)
+// Destroy and deallocate a buffer
+template<typename _Allocator>
+inline void _Destroy_buffer(typename _Allocator::pointer _P, size_t _N, _Allocator &_Alloc)
 {
-    typedef typename std::iterator_traits<_Random_iterator>::value_type _Value_type;
-    // The key type of the radix sort, this must be an "unsigned integer-like" type, i.e., it needs support: 
-    //     operator>> (int), operator>>= (int), operator& (int), operator <, operator size_t ()
-    typedef std::remove_const<std::remove_reference<decltype(_Proj_func(*_Begin))>::type>::type _Integer_type;
-
-    // Find out the max value, which will be used to determine the highest differing byte (the radix position)
-    _Integer_type _Max_val = Concurrency::samples::parallel_reduce(_Begin, _Begin + _Size, _Proj_func(*_Begin), 
-        [=](_Random_iterator _Begin, _Random_iterator _End, _Integer_type _Init) -> _Integer_type 
+    // If the objects being sorted have trivial default destructors, they do not need to be 
+    // destructed here. This can benefit performance.
+    if (!_Has_trivial_destructor<typename _Allocator::value_type>::value)
     {
-        while (_Begin != _End)
+        for (size_t _I = 0; _I < _N; _I++)
         {
-            _Integer_type _Ret = _Proj_func(*_Begin++);
-            if (_Init < _Ret)
-            {
-                _Init = _Ret;
-            }
+            _Alloc.destroy(_P + _I);
         }
+    }
 
-        return _Init;
-    }, std::max<_Integer_type>);
-    size_t _Radix = 0;
+    _Alloc.deallocate(_P, _N);
+}
 
-    // Find out highest differing byte
-    while (_Max_val >>= 8)
+//
+// Exception safe RAII wrapper for the allocated buffers
+//
+
+template<typename _Allocator>
+class _AllocatedBufferHolder
+{
+public:
+    _AllocatedBufferHolder(size_t _Size, _Allocator _Alloc)
     {
-        ++_Radix;
+        _M_size = _Size;
+        _M_alloc = _Alloc;
+        _M_buffer = _Construct_buffer(_Size, _Alloc);
     }
 
-    _Parallel_integer_radix_sort(_Begin, _Size, _Output, _Radix, _Proj_func, _Chunk_size);
+    ~_AllocatedBufferHolder()
+    {
+        _Destroy_buffer(_M_buffer, _M_size, _M_alloc);
+    }
+
+    typename _Allocator::pointer _Get_buffer()
+    {
+        return _M_buffer;
+    }
+
+private:
+    size_t _M_size;
+    _Allocator _M_alloc;
+    typename _Allocator::pointer _M_buffer;
+};
+
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
+/// <summary>
+///     This template function is semantically similar with <c>std::sort</c> that it is a compare-based unstable in-place sort.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The binary comparison predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for sort.
+/// </param>
+/// <param name="_Func">
+///     The binary comparison prediction functor.
+/// </param>
+/// <param name="_Chunk_size">
+///     The minimal divisible chunk size that can be split for parallel execution.
+/// </param>
+/// <remarks>
+///     There are two overloads.
+///     <para>For the first function overload, it is using an in-place sorting algorithm. A default <c>std::less</c> binary 
+///     compare functor will be applied, so the compare operator <c>operator </c> is required for the element type, and the 
+///     sorting result will be in increasing order. </para>
+///     <para>For the second function overload, it is using an in-place sorting algorithm. A binary compare predicate functor 
+///     <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is the element type.</para>
+///     <para>
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial 
+///     sort as soon as  the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before 
+///     that point. Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     </para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Function>
+inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
+{
+    // We make the guarantee that if the sort is part of a tree that has been canceled before starting, it will
+    // not begin at all.
+    if (is_current_task_group_canceling())
+    {
+        return;
+    }
+
+    size_t _Size = _End - _Begin;
+    size_t _Core_num = Concurrency::CurrentScheduler::Get()->GetNumberOfVirtualProcessors();
+
+    if (_Size <= _Chunk_size || _Core_num < 2)
+    {
+        return std::sort(_Begin, _End, _Func);
+    }
+
+    _Parallel_quicksort_impl(_Begin, _Size, _Func, _Core_num * _MAX_NUM_TASKS_PER_CORE, _Chunk_size, 0);
+}
+
+/// <summary>
+///     This template function is semantically similar with <c>std::sort</c> that it is a compare-based unstable in-place sort.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for sort.
+/// </param>
+/// <remarks>
+///     There are two overloads.
+///     <para>For the first function overload, it is using an in-place sorting algorithm. A default <c>std::less</c> binary 
+///     compare functor will be applied, so the compare operator <c>operator </c> is required for the element type, and the 
+///     sorting result will be in increasing order. </para>
+///     <para>For the second function overload, it is using an in-place sorting algorithm. A binary compare predicate functor 
+///     <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is the element type.</para>
+///     <para>
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial 
+///     sort as soon as  the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before 
+///     that point. Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     </para>
+/// </remarks>
+/**/
+template<typename _Random_iterator>
+inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
+{
+    parallel_sort(_Begin, _End, std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
 }
 
-template<typename _Random_iterator, typename _Function>
-void _Parallel_quicksort_impl(const _Random_iterator &_Begin, size_t _Size, const _Function &_Func, size_t _Div_num, const size_t _Chunk_size, int _Depth)
+// Parallel in-place partition: moves the elements that satisfy _Pred to the front and returns how many there are.
+// Each thread first partitions its own segment of the range. After that, the elements that satisfy _Pred are at the front
+// of every segment, and the only elements out of place are the ones that don't satisfy _Pred but lie before the final 
+// partition point, and the ones that do satisfy it but lie after. There are as many of the one as of the other, so they are
+// swapped pairwise, again in parallel.
+template<typename _Random_iterator, typename _Predicate>
+size_t _Parallel_partition(const _Random_iterator &_Begin, size_t _Size, const _Predicate &_Pred, const size_t _Chunk_size)
 {
-    if (_Depth >= _SORT_MAX_RECURSION_DEPTH || _Size <= _Chunk_size || _Size <= static_cast<size_t>(3) || _Chunk_size >= _FINE_GRAIN_CHUNK_SIZE && _Div_num <= 1)
+    size_t _Threads_num = Concurrency::CurrentScheduler::Get()->GetNumberOfVirtualProcessors();
+
+    if (_Size <= _Chunk_size || _Threads_num < 2)
     {
-        return std::sort(_Begin, _Begin + _Size, _Func);
+        return std::partition(_Begin, _Begin + _Size, _Pred) - _Begin;
     }
 
-    // Determine whether we need to do a three-way quick sort
-    // We benefit from three-way merge if there are a lot of elements that are EQUAL to the median value,
-    // _Select_median_pivot function will test redundant density by sampling
-    bool _Is_three_way_split = false;
-    size_t _Mid_index = _Select_median_pivot(_Begin, _Size, _Func, _Chunk_size, _Is_three_way_split);
+    size_t _Step = _Size / _Threads_num;
+    size_t _Remain = _Size % _Threads_num;
+    std::vector<size_t> _Seg_begin(_Threads_num + 1), _True_count(_Threads_num);
 
-    // Move the median value to the _Begin position.
-    if (_Mid_index)
+    for (size_t _Index = 0; _Index <= _Threads_num; ++_Index)
     {
-        std::swap(*_Begin, _Begin[_Mid_index]);
+        _Seg_begin[_Index] = (_Index < _Remain) ? _Index * (_Step + 1) : _Remain * (_Step + 1) + (_Index - _Remain) * _Step;
     }
-    size_t _I = 1, _J = _Size - 1;
 
-    // Three-way or two-way partition
-    // _Div_num < _MAX_NUM_TASKS_PER_CORE is checked to make sure it will never do three-way split before splitting enough tasks
-    if (_Is_three_way_split && _Div_num < _MAX_NUM_TASKS_PER_CORE)
+    Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [&](size_t _Index)
     {
-        while (_Func(*_Begin, _Begin[_J]))
+        _Random_iterator _Seg = _Begin + _Seg_begin[_Index];
+        _True_count[_Index] = std::partition(_Seg, _Begin + _Seg_begin[_Index + 1], _Pred) - _Seg;
+    });
+
+    size_t _Total = std::accumulate(_True_count.begin(), _True_count.end(), static_cast<size_t>(0));
+
+    // Collect the misplaced runs of each kind, in position order, with the running count of misplaced elements before each run
+    std::vector<size_t> _False_run, _False_before(1, 0), _True_run, _True_before(1, 0);
+    for (size_t _Index = 0; _Index < _Threads_num; ++_Index)
+    {
+        size_t _Split = _Seg_begin[_Index] + _True_count[_Index];
+
+        if (_Split < _Total && _Split < _Seg_begin[_Index + 1])
         {
-            --_J;
+            _False_run.push_back(_Split);
+            _False_before.push_back(_False_before.back() + (std::min)(_Total, _Seg_begin[_Index + 1]) - _Split);
         }
 
-        while (_Func(_Begin[_I], *_Begin))
+        size_t _True_begin = (std::max)(_Seg_begin[_Index], _Total);
+        if (_True_begin < _Split)
         {
-            ++_I;
+            _True_run.push_back(_True_begin);
+            _True_before.push_back(_True_before.back() + _Split - _True_begin);
         }
+    }
 
-        // Starting from this point, left side of _I will less than median value, right side of _J will be greater than median value, 
-        // and the middle part will be equal to median. _K is used to scan between _I and _J
-        size_t _K = _J;
-        while (_I <= _K)
+    size_t _Misplaced = _False_before.back();
+    _ASSERTE(_Misplaced == _True_before.back());
+
+    if (_Misplaced > 0)
+    {
+        size_t _Swap_chunks = (std::min)(_Threads_num, (_Misplaced + _FINE_GRAIN_CHUNK_SIZE - 1) / _FINE_GRAIN_CHUNK_SIZE);
+
+        Concurrency::parallel_for(static_cast<size_t>(0), _Swap_chunks, [&](size_t _Chunk)
         {
-            if (_Func(_Begin[_K], *_Begin))
-            {
-                std::swap(_Begin[_I++], _Begin[_K]);
-            }
-            else
-            {
-                --_K;
-            }
+            size_t _Lo = _Misplaced * _Chunk / _Swap_chunks, _Hi = _Misplaced * (_Chunk + 1) / _Swap_chunks;
 
-            while (_Func(*_Begin, _Begin[_K]))
+            // Find the runs holding the _Lo-th misplaced element of each kind, then walk both lists together
+            size_t _F = std::upper_bound(_False_before.begin(), _False_before.end(), _Lo) - _False_before.begin() - 1;
+            size_t _T = std::upper_bound(_True_before.begin(), _True_before.end(), _Lo) - _True_before.begin() - 1;
+            size_t _F_pos = _False_run[_F] + _Lo - _False_before[_F];
+            size_t _T_pos = _True_run[_T] + _Lo - _True_before[_T];
+
+            for (size_t _K = _Lo; _K < _Hi; ++_K)
             {
-                std::swap(_Begin[_K--], _Begin[_J--]);
-            }
-        }
+                if (_K == _False_before[_F + 1])
+                {
+                    _F_pos = _False_run[++_F];
+                }
 
-        ++_J;
+                if (_K == _True_before[_T + 1])
+                {
+                    _T_pos = _True_run[++_T];
+                }
+
+                std::iter_swap(_Begin + _F_pos++, _Begin + _T_pos++);
+            }
+        });
     }
-    else
+
+    return _Total;
+}
+
+// Parallel quickselect. Every round picks a pivot the same way as _Parallel_quicksort_impl, and splits the range in parallel into the
+// elements less than, equal to and greater than the pivot. Only the part that holds the n-th position is kept for the next round.
+template<typename _Random_iterator, typename _Function>
+void _Parallel_nth_element_impl(_Random_iterator _Begin, size_t _Size, size_t _Nth, const _Function &_Func, const size_t _Chunk_size)
+{
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _Value_type;
+
+    for (int _Depth = 0; ; ++_Depth)
     {
-        while (_I <= _J)
+        if (_Depth >= _SORT_MAX_RECURSION_DEPTH || _Size <= _Chunk_size || _Size <= static_cast<size_t>(3))
         {
-            // Will stop before _Begin
-            while (_Func(*_Begin, _Begin[_J]))
-            {
-                --_J;
-            }
+            return std::nth_element(_Begin, _Begin + _Nth, _Begin + _Size, _Func);
+        }
 
-            // There must be another element equal or greater than *_Begin
-            while (_Func(_Begin[_I], *_Begin))
-            {
-                ++_I;
-            }
+        bool _Potentially_equal = false;
+        size_t _Mid_index = _Select_median_pivot(_Begin, _Size, _Func, _Chunk_size, _Potentially_equal);
 
-            if (_I < _J)
-            {
-                std::swap(_Begin[_I++], _Begin[_J--]);
-            }
-            else
-            {
-                break;
-            }
+        // Keep the pivot at the front while the rest is partitioned, then put it between the two parts
+        if (_Mid_index)
+        {
+            std::swap(*_Begin, _Begin[_Mid_index]);
         }
 
-        _I = ++_J;
+        const _Value_type &_Front = *_Begin;
+        size_t _Less = 1 + _Parallel_partition(_Begin + 1, _Size - 1, [&](const _Value_type &_Val) { return _Func(_Val, _Front); }, _Chunk_size);
+        std::swap(*_Begin, _Begin[_Less - 1]);
+
+        size_t _Pivot = _Less - 1;
+        if (_Nth < _Pivot)
+        {
+            _Size = _Pivot;
+            continue;
+        }
+
+        // Gather the elements equal to the pivot right after it; none of them needs to be looked at again
+        const _Value_type &_Pivot_val = _Begin[_Pivot];
+        size_t _Equal = _Less + _Parallel_partition(_Begin + _Less, _Size - _Less, 
+            [&](const _Value_type &_Val) { return !_Func(_Pivot_val, _Val); }, _Chunk_size);
+
+        if (_Nth < _Equal)
+        {
+            return;
+        }
+
+        _Begin += _Equal;
+        _Size -= _Equal;
+        _Nth -= _Equal;
     }
+}
 
-    std::swap(*_Begin, _Begin[--_I]);
+/// <summary>
+///     This template function is semantically equivalent to <c>std::nth_element</c>: it rearranges the range so that the element at 
+///     <c>_Nth</c> is the one that would be there if the whole range were sorted, no element before it is greater and no element after 
+///     it is less. The partitioning is done in parallel.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The binary comparison predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_Nth">
+///     The position of the element to be selected.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <param name="_Func">
+///     The binary comparison predicate functor.
+/// </param>
+/// <param name="_Chunk_size">
+///     The size below which the selection turns to serial <c>std::nth_element</c>.
+/// </param>
+/// <remarks>
+///     There are two overloads. For the first function overload a binary compare predicate functor <c>_Func: bool (T, T) </c> is 
+///     required, in which <c>T</c> is the element type. For the second function overload a default <c>std::less</c> binary compare 
+///     functor will be applied.
+///     <para>Each round partitions the remaining range in parallel around a pivot and keeps only the part holding <c>_Nth</c>, so the 
+///     expected work is linear in the size of the range. No additional space is needed apart from per-thread bookkeeping.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Function>
+inline void parallel_nth_element(const _Random_iterator &_Begin, const _Random_iterator &_Nth, const _Random_iterator &_End, const _Function &_Func, 
+    const size_t _Chunk_size = 2048)
+{
+    // We make the guarantee that if the selection is part of a tree that has been canceled before starting, it will
+    // not begin at all.
+    if (is_current_task_group_canceling())
+    {
+        return;
+    }
 
-    structured_task_group _Tg;
-    volatile size_t _Next_div = _Div_num / 2;
-    auto _Handle = make_task([&] 
+    if (_Nth == _End)
     {
-        _Parallel_quicksort_impl(_Begin + _J, _Size - _J, _Func, _Next_div, _Chunk_size, _Depth+1);
-    });
-    _Tg.run(_Handle);
+        return;
+    }
 
-    _Parallel_quicksort_impl(_Begin, _I, _Func, _Next_div, _Chunk_size, _Depth+1);
+    _Parallel_nth_element_impl(_Begin, static_cast<size_t>(_End - _Begin), static_cast<size_t>(_Nth - _Begin), _Func, _Chunk_size);
+}
+
+/// <summary>
+///     This template function is semantically equivalent to <c>std::nth_element</c>: it rearranges the range so that the element at 
+///     <c>_Nth</c> is the one that would be there if the whole range were sorted, no element before it is greater and no element after 
+///     it is less. The partitioning is done in parallel.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_Nth">
+///     The position of the element to be selected.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <remarks>
+///     There are two overloads. For the first function overload a binary compare predicate functor <c>_Func: bool (T, T) </c> is 
+///     required, in which <c>T</c> is the element type. For the second function overload a default <c>std::less</c> binary compare 
+///     functor will be applied.
+///     <para>Each round partitions the remaining range in parallel around a pivot and keeps only the part holding <c>_Nth</c>, so the 
+///     expected work is linear in the size of the range. No additional space is needed apart from per-thread bookkeeping.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator>
+inline void parallel_nth_element(const _Random_iterator &_Begin, const _Random_iterator &_Nth, const _Random_iterator &_End)
+{
+    parallel_nth_element(_Begin, _Nth, _End, std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
+}
+
+/// <summary>
+///     This template function is semantically equivalent to <c>std::partition</c>: it moves the elements that satisfy the predicate 
+///     in front of the ones that don't. The partitioning is done in parallel, and like <c>std::partition</c> it is not stable.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Predicate">
+///     The unary predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <param name="_Pred">
+///     The predicate that selects the elements to move to the front.
+/// </param>
+/// <param name="_Chunk_size">
+///     The size below which the partitioning turns to serial <c>std::partition</c>.
+/// </param>
+/// <returns>
+///     The position of the first element that does not satisfy the predicate.
+/// </returns>
+/// <remarks>
+///     Each thread partitions its own segment of the range, and the elements that end up on the wrong side of the partition point 
+///     are then swapped pairwise in parallel. No additional space is needed apart from per-thread bookkeeping.
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Predicate>
+inline _Random_iterator parallel_partition(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Predicate &_Pred, 
+    const size_t _Chunk_size = 2048)
+{
+    return _Begin + _Parallel_partition(_Begin, static_cast<size_t>(_End - _Begin), _Pred, _Chunk_size);
+}
+
+/// <summary>
+///     This template function is semantically equivalent to <c>std::partial_sort</c>: it puts the <c>_Middle - _Begin</c> smallest 
+///     elements of the range, sorted, into <c>[_Begin, _Middle)</c>, leaving the remaining elements in unspecified order.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The binary comparison predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_Middle">
+///     The position up to which the range is to be sorted.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <param name="_Func">
+///     The binary comparison predicate functor.
+/// </param>
+/// <param name="_Chunk_size">
+///     The minimal divisible chunk size that can be split for parallel execution.
+/// </param>
+/// <remarks>
+///     There are two overloads. For the first function overload a binary compare predicate functor <c>_Func: bool (T, T) </c> is 
+///     required, in which <c>T</c> is the element type. For the second function overload a default <c>std::less</c> binary compare 
+///     functor will be applied.
+///     <para>The smallest elements are first selected with <see cref="parallel_nth_element Function"/> and then sorted with 
+///     <see cref="parallel_sort Function"/>.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Function>
+inline void parallel_partial_sort(const _Random_iterator &_Begin, const _Random_iterator &_Middle, const _Random_iterator &_End, const _Function &_Func, 
+    const size_t _Chunk_size = 2048)
+{
+    if (_Middle == _Begin)
+    {
+        return;
+    }
+
+    if (_Middle != _End)
+    {
+        parallel_nth_element(_Begin, _Middle - 1, _End, _Func, _Chunk_size);
+    }
+
+    parallel_sort(_Begin, _Middle, _Func, _Chunk_size);
+}
+
+/// <summary>
+///     This template function is semantically equivalent to <c>std::partial_sort</c>: it puts the <c>_Middle - _Begin</c> smallest 
+///     elements of the range, sorted, into <c>[_Begin, _Middle)</c>, leaving the remaining elements in unspecified order.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_Middle">
+///     The position up to which the range is to be sorted.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <remarks>
+///     There are two overloads. For the first function overload a binary compare predicate functor <c>_Func: bool (T, T) </c> is 
+///     required, in which <c>T</c> is the element type. For the second function overload a default <c>std::less</c> binary compare 
+///     functor will be applied.
+///     <para>The smallest elements are first selected with <see cref="parallel_nth_element Function"/> and then sorted with 
+///     <see cref="parallel_sort Function"/>.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator>
+inline void parallel_partial_sort(const _Random_iterator &_Begin, const _Random_iterator &_Middle, const _Random_iterator &_End)
+{
+    parallel_partial_sort(_Begin, _Middle, _End, std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
+}
+
+/// <summary>
+///     This template function copies the <c>_K</c> elements of the range that rank first by <c>_Func</c> into <c>_Result</c>, in that 
+///     order, without modifying the range. With <c>std::greater</c>, which the overload without a predicate uses, these are the 
+///     <c>_K</c> largest elements in decreasing order.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Output_iterator">
+///     The iterator type of the output range.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The binary comparison predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <param name="_K">
+///     The number of elements to be selected.
+/// </param>
+/// <param name="_Result">
+///     The position of the first element of the output range, which has room for <c>min(_K, _End - _Begin)</c> elements.
+/// </param>
+/// <param name="_Func">
+///     The binary comparison predicate functor; <c>_Func(a, b)</c> returns true when <c>a</c> ranks before <c>b</c>.
+/// </param>
+/// <returns>
+///     The position after the last element written.
+/// </returns>
+/// <remarks>
+///     There are two overloads. For the first function overload a binary compare predicate functor <c>_Func: bool (T, T) </c> is 
+///     required, in which <c>T</c> is the element type. For the second function overload a default <c>std::greater</c> binary 
+///     compare functor will be applied.
+///     <para>Every thread scans a segment of the range keeping its best <c>_K</c> elements in a bounded heap, where most elements 
+///     are rejected with a single comparison against the heap top. The per-thread heaps are merged at the end. <c>p * _K</c> 
+///     elements of additional space are needed, where <c>p</c> is the number of threads, so this is meant for <c>_K</c> much smaller
+///     than the range; otherwise use <see cref="parallel_partial_sort Function"/>. The element type must be copy constructible.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Output_iterator, typename _Function>
+_Output_iterator parallel_top_k(const _Random_iterator &_Begin, const _Random_iterator &_End, size_t _K, _Output_iterator _Result, const _Function &_Func)
+{
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _Value_type;
+
+    // We make the guarantee that if the selection is part of a tree that has been canceled before starting, it will
+    // not begin at all.
+    if (is_current_task_group_canceling())
+    {
+        return _Result;
+    }
 
-    // If at this point, the work hasn't been scheduled, then slow down creating new tasks
-    if (_Div_num < _MAX_NUM_TASKS_PER_CORE)
+    size_t _Size = _End - _Begin;
+    _K = (std::min)(_K, _Size);
+    if (_K == 0)
     {
-        _Next_div /= 2;
+        return _Result;
     }
 
-    _Tg.wait();
-}
+    size_t _Threads_num = Concurrency::CurrentScheduler::Get()->GetNumberOfVirtualProcessors();
+    size_t _Step = _Size / _Threads_num;
+    size_t _Remain = _Size % _Threads_num;
 
-// This function will be called to sort the elements in the "_Begin" buffer. However, we can't tell whether the result will end up in buffer
-// "_Begin", or buffer "_Output" when it returned. The return value is designed to indicate which buffer holds the sorted result.
-// Return true if the merge result is in the "_Begin" buffer; return false if the result is in the "_Output" buffer.
-// We can't always put the result into one assigned buffer because that may cause frequent buffer copies at return time.
-template<typename _Random_iterator, typename _Random_buffer_iterator, typename _Function>
-inline bool _Parallel_buffered_sort_impl(const _Random_iterator &_Begin, size_t _Size, _Random_buffer_iterator _Output, const _Function &_Func, 
-    int _Div_num, const size_t _Chunk_size)
-{
-    static_assert(std::is_same<std::iterator_traits<_Random_iterator>::value_type, std::iterator_traits<_Random_buffer_iterator>::value_type>::value, 
-        "same value type expected");
+    // The heap top is the element ranking last among those kept, which is what a new element has to beat
+    std::vector<std::vector<_Value_type>> _Heaps(_Threads_num);
 
-    if (_Div_num <= 1 || _Size <= _Chunk_size)
+    Concurrency::parallel_for(static_cast<size_t>(0), _Threads_num, [&](size_t _Index)
     {
-        _Parallel_quicksort_impl(_Begin, _Size, _Func, _MAX_NUM_TASKS_PER_CORE, _Chunk_size, 0);
-
-        // In case _Size <= _Chunk_size happened BEFORE the planned stop time (when _Div_num == 1) we need to calculate how many turns of 
-        // binary divisions are left. If there are an odd number of turns left, then the buffer move is necessary to make sure the final 
-        // merge result will be in the original input array.
-        int _Left_div_turns = 0;
-        while (_Div_num >>= 1)
-        {
-            _Left_div_turns++;
-        }
+        size_t _Beg_index, _End_index;
 
-        if (_Left_div_turns & 1)
+        // Calculate the segment position
+        if (_Index < _Remain)
         {
-            std::move(_Begin, _Begin + _Size, _Output);
-            return true;
+            _Beg_index = _Index * (_Step + 1);
+            _End_index = _Beg_index + (_Step + 1);
         }
         else
         {
-            return false;
+            _Beg_index = _Remain * (_Step + 1) + (_Index - _Remain) * _Step;
+            _End_index = _Beg_index + _Step;
         }
-    }
-    else
-    {
-        size_t _Mid = _Size / 2;
-        structured_task_group _Tg;
-
-        auto _Handle = make_task([&, _Chunk_size] 
-        {
-            _Parallel_buffered_sort_impl(_Begin, _Mid, _Output, _Func, _Div_num / 2, _Chunk_size); 
-        });
-        _Tg.run(_Handle);
-
-        bool _Is_buffer_swap = _Parallel_buffered_sort_impl(_Begin + _Mid, _Size - _Mid, _Output + _Mid, _Func, _Div_num / 2, _Chunk_size);
 
-        _Tg.wait();
+        std::vector<_Value_type> &_Heap = _Heaps[_Index];
+        _Heap.reserve((std::min)(_K, _End_index - _Beg_index));
 
-        if (_Is_buffer_swap)
+        for (; _Beg_index != _End_index && _Heap.size() < _K; ++_Beg_index)
         {
-            _Parallel_merge(_Output, _Mid, _Output + _Mid, _Size - _Mid, _Begin, _Func, _Div_num);
+            _Heap.push_back(_Begin[_Beg_index]);
+            std::push_heap(_Heap.begin(), _Heap.end(), _Func);
         }
-        else
+
+        for (; _Beg_index != _End_index; ++_Beg_index)
         {
-            _Parallel_merge(_Begin, _Mid, _Begin + _Mid, _Size - _Mid, _Output, _Func, _Div_num);
+            if (_Func(_Begin[_Beg_index], _Heap.front()))
+            {
+                std::pop_heap(_Heap.begin(), _Heap.end(), _Func);
+                _Heap.back() = _Begin[_Beg_index];
+                std::push_heap(_Heap.begin(), _Heap.end(), _Func);
+            }
         }
+    });
 
-        return !_Is_buffer_swap;
-    }
-}
-
-// Disable the warning saying constant value in condition expression.
-// This is by design that lets the compiler optimize the trivial constructor.
-#pragma warning (push)
-#pragma warning (disable: 4127)
-
-// Allocate and construct a buffer
-template<typename _Allocator>
-inline typename _Allocator::pointer _Construct_buffer(size_t _N, _Allocator &_Alloc)
-{
-    typename _Allocator::pointer _P = _Alloc.allocate(_N);
-
-    // If the objects being sorted have trivial default constructors, they do not need to be 
-    // constructed here. This can benefit performance.
-    if (!std::has_trivial_default_constructor<typename _Allocator::value_type>::value)
+    std::vector<_Value_type> _Candidates;
+    _Candidates.reserve(_K * _Threads_num);
+    for (size_t _Index = 0; _Index < _Threads_num; ++_Index)
     {
-        for (size_t _I = 0; _I < _N; _I++)
-        {
-            // Objects being sorted must have a default constructor
-            _Allocator::value_type _T;
-            _Alloc.construct(_P + _I, std::forward<_Allocator::value_type>(_T));
-        }
+        std::move(_Heaps[_Index].begin(), _Heaps[_Index].end(), std::back_inserter(_Candidates));
+        std::vector<_Value_type>().swap(_Heaps[_Index]);
     }
 
-    return _P;
+    parallel_partial_sort(_Candidates.begin(), _Candidates.begin() + _K, _Candidates.end(), _Func);
+
+    return std::move(_Candidates.begin(), _Candidates.begin() + _K, _Result);
 }
 
-// Destroy and deallocate a buffer
-template<typename _Allocator>
-inline void _Destroy_buffer(typename _Allocator::pointer _P, size_t _N, _Allocator &_Alloc)
+/// <summary>
+///     This template function copies the <c>_K</c> largest elements of the range into <c>_Result</c>, in decreasing order, without 
+///     modifying the range.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Output_iterator">
+///     The iterator type of the output range.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element of the range.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included in the range.
+/// </param>
+/// <param name="_K">
+///     The number of elements to be selected.
+/// </param>
+/// <param name="_Result">
+///     The position of the first element of the output range, which has room for <c>min(_K, _End - _Begin)</c> elements.
+/// </param>
+/// <returns>
+///     The position after the last element written.
+/// </returns>
+/// <remarks>
+///     There are two overloads. For the first function overload a binary compare predicate functor <c>_Func: bool (T, T) </c> is 
+///     required, in which <c>T</c> is the element type. For the second function overload a default <c>std::greater</c> binary 
+///     compare functor will be applied.
+///     <para>Every thread scans a segment of the range keeping its best <c>_K</c> elements in a bounded heap, where most elements 
+///     are rejected with a single comparison against the heap top. The per-thread heaps are merged at the end. <c>p * _K</c> 
+///     elements of additional space are needed, where <c>p</c> is the number of threads, so this is meant for <c>_K</c> much smaller
+///     than the range; otherwise use <see cref="parallel_partial_sort Function"/>. The element type must be copy constructible.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Output_iterator>
+inline _Output_iterator parallel_top_k(const _Random_iterator &_Begin, const _Random_iterator &_End, size_t _K, _Output_iterator _Result)
 {
-    // If the objects being sorted have trivial default destructors, they do not need to be 
-    // destructed here. This can benefit performance.
-    if (!std::has_trivial_destructor<typename _Allocator::value_type>::value)
-    {
-        for (size_t _I = 0; _I < _N; _I++)
-        {
-            _Alloc.destroy(_P + _I);
-        }
-    }
-
-    _Alloc.deallocate(_P, _N);
+    return parallel_top_k(_Begin, _End, _K, _Result, std::greater<typename std::iterator_traits<_Random_iterator>::value_type>());
 }
 
-//
-// Exception safe RAII wrapper for the allocated buffers
-//
-
-template<typename _Allocator>
-class _AllocatedBufferHolder
+/// <summary>
+///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
+///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
+/// </summary>
+/// <typeparam name="_Allocator">
+///     The STL compatible memory allocator type.
+/// </typeparam>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The binary comparison predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for sort.
+/// </param>
+/// <param name="_Func">
+///     The binary comparison predicate functor.
+/// </param>
+/// <param name="_Chunk_size">
+///     The minimal divisible chunk size that can be split for parallel execution.
+/// </param>
+/// <remarks>
+///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
+///     to be sorted, and <c>T</c> is the element type.
+///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
+///     the buffer for this function.</para>
+///     <para>For the second function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. To allocate the buffer for this algorithm, users should provide an allocator 
+///     template argument. For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>For the third function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer in this function.</para>
+///     <para>For the fourth function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. To allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
+///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
+///     Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     </para>
+///     <para>For inputs of a million elements or more, the elements are first distributed into buckets around splitters drawn from 
+///     a sample of the input and the buckets are then sorted independently, which takes two passes over the data instead of one pass 
+///     per merge level. The additional space required is <c>n * (sizeof(T) + 1)</c> in that case.</para>
+/// </remarks>
+/**/
+template<typename _Allocator, typename _Random_iterator, typename _Function>
+inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
 {
-public:
-    _AllocatedBufferHolder(size_t _Size, _Allocator _Alloc)
+    // We make the guarantee that if the sort is part of a tree that has been canceled before starting, it will
+    // not begin at all.
+    if (is_current_task_group_canceling())
     {
-        _M_size = _Size;
-        _M_alloc = _Alloc;
-        _M_buffer = _Construct_buffer(_Size, _Alloc);
+        return;
     }
 
-    ~_AllocatedBufferHolder()
+    size_t _Size = _End - _Begin;
+    size_t _Core_num = Concurrency::CurrentScheduler::Get()->GetNumberOfVirtualProcessors();
+
+    if (_Size <= _Chunk_size || _Core_num < 2)
     {
-        _Destroy_buffer(_M_buffer, _M_size, _M_alloc);
+        return std::sort(_Begin, _End, _Func);
     }
 
-    typename _Allocator::pointer _Get_buffer()
+    _Allocator _Alloc;
+    _AllocatedBufferHolder<_Allocator> _Holder(_Size, _Alloc);
+
+    // This buffered sort algorithm will divide chunks and apply parallel quicksort on each chunk. In the end, it will 
+    // apply parallel merge to these sorted chunks.
+    // 
+    // We need to decide the number of chunks to divide the input buffer into. If we divide it into n chunks, log(n) 
+    // merges will be needed to get the final sorted result.  In this algorithm, we have two buffers for each merge 
+    // operation, let's say buffer A and B. Buffer A is the original input array, buffer B is the additional allocated 
+    // buffer.  Each turn's merge will put the merge result into the other buffer; for example, if we decided to split 
+    // into 8 chunks in buffer A at very beginning, after one pass of merging, there will be 4 chunks in buffer B.
+    // If we apply one more pass of merging, there will be 2 chunks in buffer A again.
+    // 
+    // The problem is we want to the final merge pass to put the result back in buffer A, so that we don't need 
+    // one extra copy to put the sorted data back to buffer A.
+    // To make sure the final result is in buffer A (original input array), we need an even number of merge passes,
+    // which means log(n) must be an even number. Thus n must be a number power(2, even number). For example, when the
+    // even number is 2, n is power(2, 2) = 4, when even number is 4, n is power(2, 4) = 16. When we divide chunks 
+    // into these numbers, the final merge result will be in the original input array. Now we need to decide the chunk(split) 
+    // number based on this property and the number of cores.
+    // 
+    // We want to get a chunk (split) number close the the core number (or a little more than the number of cores), 
+    // and it also needs to satisfy above property. For a 8 core machine, the best chunk number should be 16, because it's 
+    // the smallest number that satisfies the above property and is bigger than the core number (so that we can utilize all 
+    // cores, a little more than core number is OK, we need to split more tasks anyway). 
+    // 
+    // In this algorithm, we will make this alignment by bit operations (it's easy and clear). For a binary representation, 
+    // all the numbers that satisfy power(2, even number) will be 1, 100, 10000, 1000000, 100000000 ...
+    // After OR-ing these numbers together, we will get a mask (... 0101 0101 0101) which is all possible combinations of 
+    // power(2, even number). _Align_core_num_to_power_of_four uses (_Core_num & mask) | ((_Core_num << 1) & mask) to align 
+    // _Core_num's highest bit into a power(2, even number).
+    // 
+    // It means if _Core_num = 8, the highest bit in binary is bin(1000) which is not power(2, even number). After this 
+    // bit-wise operation, it will align to bin(10000) = 16 which is power(2, even number). If the _Core_num = 16, after 
+    // alignment it still returns 16. The trick is to make sure the highest bit of _Core_num will align to the "1" bit of the 
+    // mask bin(... 0101 0101 0101) We don't care about the other bits on the aligned result except the highest bit, since they 
+    // will be ignored in the function.
+    //
+    // For very large inputs those log(n) merge passes over the whole array dominate, since each of them is bound by memory 
+    // bandwidth. There we use a sample sort instead, which distributes the elements into buckets in one pass and sorts the 
+    // buckets independently.
+    if (_Size >= _SAMPLE_SORT_MIN_SIZE)
     {
-        return _M_buffer;
+        _Parallel_sample_sort_impl(_Begin, _Size, stdext::make_unchecked_array_iterator(_Holder._Get_buffer()), 
+            _Func, _Core_num, _Chunk_size);
+        return;
     }
 
-private:
-    size_t _M_size;
-    _Allocator _M_alloc;
-    typename _Allocator::pointer _M_buffer;
-};
+    _Parallel_buffered_sort_impl(_Begin, _Size, stdext::make_unchecked_array_iterator(_Holder._Get_buffer()), 
+        _Func, _Align_core_num_to_power_of_four(_Core_num), _Chunk_size);
+}
 
-#pragma warning (pop)
+/// <summary>
+///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
+///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for sort.
+/// </param>
+/// <remarks>
+///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
+///     to be sorted, and <c>T</c> is the element type.
+///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
+///     the buffer for this function.</para>
+///     <para>For the second function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. To allocate the buffer for this algorithm, users should provide an allocator 
+///     template argument. For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>For the third function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer in this function.</para>
+///     <para>For the fourth function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. To allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
+///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
+///     Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     </para>
+///     <para>For inputs of a million elements or more, the elements are first distributed into buckets around splitters drawn from 
+///     a sample of the input and the buckets are then sorted independently, which takes two passes over the data instead of one pass 
+///     per merge level. The additional space required is <c>n * (sizeof(T) + 1)</c> in that case.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator>
+inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
+{
+    parallel_buffered_sort<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End, 
+        std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
+}
 
 /// <summary>
-///     This template function is semantically similar with <c>std::sort</c> that it is a compare-based unstable in-place sort.
+///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
+///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
 /// </summary>
+/// <typeparam name="_Allocator">
+///     The STL compatible memory allocator type.
+/// </typeparam>
 /// <typeparam name="_Random_iterator">
 ///     The iterator type of the input range, it requires the iterator category to be random_iterator.
 /// </typeparam>
@@ -2261,28 +5648,40 @@ private:
 ///     The position of the first element not to be included for sort.
 /// </param>
 /// <remarks>
-///     There are two overloads.
-///     <para>For the first function overload, it is using an in-place sorting algorithm. A default <c>std::less</c> binary 
-///     compare functor will be applied, so the compare operator <c>operator </c> is required for the element type, and the 
-///     sorting result will be in increasing order. </para>
-///     <para>For the second function overload, it is using an in-place sorting algorithm. A binary compare predicate functor 
-///     <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is the element type.</para>
+///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
+///     to be sorted, and <c>T</c> is the element type.
+///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
+///     the buffer for this function.</para>
+///     <para>For the second function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. To allocate the buffer for this algorithm, users should provide an allocator 
+///     template argument. For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>For the third function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer in this function.</para>
+///     <para>For the fourth function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. To allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
 ///     <para>
-///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial 
-///     sort as soon as  the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before 
-///     that point. Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
+///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
+///     Move semantics are supported in this function, for more information about move semantics, please refer to 
 ///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
 ///     </para>
+///     <para>For inputs of a million elements or more, the elements are first distributed into buckets around splitters drawn from 
+///     a sample of the input and the buckets are then sorted independently, which takes two passes over the data instead of one pass 
+///     per merge level. The additional space required is <c>n * (sizeof(T) + 1)</c> in that case.</para>
 /// </remarks>
 /**/
-template<typename _Random_iterator>
-inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
+template<typename _Allocator, typename _Random_iterator>
+inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
 {
-    parallel_sort(_Begin, _End, std::less<std::iterator_traits<_Random_iterator>::value_type>());
+    parallel_buffered_sort<_Allocator>(_Begin, _End, 
+        std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
 }
 
 /// <summary>
-///     This template function is semantically similar with <c>std::sort</c> that it is a compare-based unstable in-place sort.
+///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
+///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
 /// </summary>
 /// <typeparam name="_Random_iterator">
 ///     The iterator type of the input range, it requires the iterator category to be random_iterator.
@@ -2297,28 +5696,94 @@ inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator
 ///     The position of the first element not to be included for sort.
 /// </param>
 /// <param name="_Func">
-///     The binary comparison prediction functor.
+///     The binary comparison predicate functor.
 /// </param>
 /// <param name="_Chunk_size">
 ///     The minimal divisible chunk size that can be split for parallel execution.
 /// </param>
 /// <remarks>
-///     There are two overloads.
-///     <para>For the first function overload, it is using an in-place sorting algorithm. A default <c>std::less</c> binary 
-///     compare functor will be applied, so the compare operator <c>operator </c> is required for the element type, and the 
-///     sorting result will be in increasing order. </para>
-///     <para>For the second function overload, it is using an in-place sorting algorithm. A binary compare predicate functor 
-///     <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is the element type.</para>
+///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
+///     to be sorted, and <c>T</c> is the element type.
+///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
+///     the buffer for this function.</para>
+///     <para>For the second function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. To allocate the buffer for this algorithm, users should provide an allocator 
+///     template argument. For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>For the third function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer in this function.</para>
+///     <para>For the fourth function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. To allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
 ///     <para>
-///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial 
-///     sort as soon as  the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before 
-///     that point. Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
+///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
+///     Move semantics are supported in this function, for more information about move semantics, please refer to 
 ///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
 ///     </para>
+///     <para>For inputs of a million elements or more, the elements are first distributed into buckets around splitters drawn from 
+///     a sample of the input and the buckets are then sorted independently, which takes two passes over the data instead of one pass 
+///     per merge level. The additional space required is <c>n * (sizeof(T) + 1)</c> in that case.</para>
 /// </remarks>
 /**/
 template<typename _Random_iterator, typename _Function>
-inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
+inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
+{
+    parallel_buffered_sort<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End, _Func, _Chunk_size);
+}
+
+/// <summary>
+///     This template function is semantically similar to <c>std::stable_sort</c> in that it is a compare-based stable sort: elements that
+///     are equivalent keep their relative order. It needs O(n) additional space, and requires a default constructor for the type of 
+///     sorting element.
+/// </summary>
+/// <typeparam name="_Allocator">
+///     The STL compatible memory allocator type.
+/// </typeparam>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The binary comparison predicate functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for sort.
+/// </param>
+/// <param name="_Func">
+///     The binary comparison predicate functor.
+/// </param>
+/// <param name="_Chunk_size">
+///     The minimal divisible chunk size that can be split for parallel execution.
+/// </param>
+/// <remarks>
+///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
+///     to be sorted, and <c>T</c> is the element type. The chunks are sorted with <c>std::stable_sort</c>, which may allocate a temporary
+///     buffer of its own, and then merged in parallel like in <see cref="parallel_buffered_sort Function"/>; the merges take equal elements 
+///     from the left chunk first.
+///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
+///     the buffer for this function.</para>
+///     <para>For the second function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
+///     operator <c>operator <()</c> is required for the element type. To allocate the buffer for this algorithm, users should provide an allocator 
+///     template argument. For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>For the third function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer in this function.</para>
+///     <para>For the fourth function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
+///     the element type. To allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>
+///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
+///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
+///     Move semantics are supported in this function, for more information about move semantics, please refer to 
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     </para>
+/// </remarks>
+/**/
+template<typename _Allocator, typename _Random_iterator, typename _Function>
+inline void parallel_stable_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
 {
     // We make the guarantee that if the sort is part of a tree that has been canceled before starting, it will
     // not begin at all.
@@ -2332,15 +5797,23 @@ inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator
 
     if (_Size <= _Chunk_size || _Core_num < 2)
     {
-        return std::sort(_Begin, _End, _Func);
+        return std::stable_sort(_Begin, _End, _Func);
     }
 
-    _Parallel_quicksort_impl(_Begin, _Size, _Func, _Core_num * _MAX_NUM_TASKS_PER_CORE, _Chunk_size, 0);
+    _Allocator _Alloc;
+    _AllocatedBufferHolder<_Allocator> _Holder(_Size, _Alloc);
+
+    // The number of chunks is aligned to a power of 4 so that the final merge puts the result back in the input array; see 
+    // parallel_buffered_sort for the details. Unlike parallel_buffered_sort, there's no sample sort for very large inputs here
+    // since distributing the elements into buckets doesn't keep equal elements in order.
+    _Parallel_buffered_sort_impl(_Begin, _Size, stdext::make_unchecked_array_iterator(_Holder._Get_buffer()), 
+        _Func, _Align_core_num_to_power_of_four(_Core_num), _Chunk_size, true);
 }
 
 /// <summary>
-///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
-///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
+///     This template function is semantically similar to <c>std::stable_sort</c> in that it is a compare-based stable sort: elements that
+///     are equivalent keep their relative order. It needs O(n) additional space, and requires a default constructor for the type of 
+///     sorting element.
 /// </summary>
 /// <typeparam name="_Random_iterator">
 ///     The iterator type of the input range, it requires the iterator category to be random_iterator.
@@ -2353,7 +5826,9 @@ inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator
 /// </param>
 /// <remarks>
 ///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
-///     to be sorted, and <c>T</c> is the element type.
+///     to be sorted, and <c>T</c> is the element type. The chunks are sorted with <c>std::stable_sort</c>, which may allocate a temporary
+///     buffer of its own, and then merged in parallel like in <see cref="parallel_buffered_sort Function"/>; the merges take equal elements 
+///     from the left chunk first.
 ///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
 ///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
 ///     the buffer for this function.</para>
@@ -2369,20 +5844,21 @@ inline void parallel_sort(const _Random_iterator &_Begin, const _Random_iterator
 ///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
 ///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
 ///     Move semantics are supported in this function, for more information about move semantics, please refer to 
-///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
 ///     </para>
 /// </remarks>
 /**/
 template<typename _Random_iterator>
-inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
+inline void parallel_stable_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
 {
-    parallel_buffered_sort<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End, 
-        std::less<std::iterator_traits<_Random_iterator>::value_type>());
+    parallel_stable_sort<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End, 
+        std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
 }
 
 /// <summary>
-///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
-///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
+///     This template function is semantically similar to <c>std::stable_sort</c> in that it is a compare-based stable sort: elements that
+///     are equivalent keep their relative order. It needs O(n) additional space, and requires a default constructor for the type of 
+///     sorting element.
 /// </summary>
 /// <typeparam name="_Allocator">
 ///     The STL compatible memory allocator type.
@@ -2398,7 +5874,9 @@ inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random
 /// </param>
 /// <remarks>
 ///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
-///     to be sorted, and <c>T</c> is the element type.
+///     to be sorted, and <c>T</c> is the element type. The chunks are sorted with <c>std::stable_sort</c>, which may allocate a temporary
+///     buffer of its own, and then merged in parallel like in <see cref="parallel_buffered_sort Function"/>; the merges take equal elements 
+///     from the left chunk first.
 ///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
 ///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
 ///     the buffer for this function.</para>
@@ -2414,20 +5892,21 @@ inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random
 ///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
 ///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
 ///     Move semantics are supported in this function, for more information about move semantics, please refer to 
-///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
 ///     </para>
 /// </remarks>
 /**/
 template<typename _Allocator, typename _Random_iterator>
-inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
+inline void parallel_stable_sort(const _Random_iterator &_Begin, const _Random_iterator &_End)
 {
-    parallel_buffered_sort<_Allocator>(_Begin, _End, 
-        std::less<std::iterator_traits<_Random_iterator>::value_type>());
+    parallel_stable_sort<_Allocator>(_Begin, _End, 
+        std::less<typename std::iterator_traits<_Random_iterator>::value_type>());
 }
 
 /// <summary>
-///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
-///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
+///     This template function is semantically similar to <c>std::stable_sort</c> in that it is a compare-based stable sort: elements that
+///     are equivalent keep their relative order. It needs O(n) additional space, and requires a default constructor for the type of 
+///     sorting element.
 /// </summary>
 /// <typeparam name="_Random_iterator">
 ///     The iterator type of the input range, it requires the iterator category to be random_iterator.
@@ -2449,7 +5928,9 @@ inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random
 /// </param>
 /// <remarks>
 ///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
-///     to be sorted, and <c>T</c> is the element type.
+///     to be sorted, and <c>T</c> is the element type. The chunks are sorted with <c>std::stable_sort</c>, which may allocate a temporary
+///     buffer of its own, and then merged in parallel like in <see cref="parallel_buffered_sort Function"/>; the merges take equal elements 
+///     from the left chunk first.
 ///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
 ///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
 ///     the buffer for this function.</para>
@@ -2465,54 +5946,183 @@ inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random
 ///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
 ///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
 ///     Move semantics are supported in this function, for more information about move semantics, please refer to 
-///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
+///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
 ///     </para>
 /// </remarks>
 /**/
 template<typename _Random_iterator, typename _Function>
-inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
+inline void parallel_stable_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
 {
-    parallel_buffered_sort<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End, _Func, _Chunk_size);
+    parallel_stable_sort<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End, _Func, _Chunk_size);
 }
 
+#if defined(_MSC_VER)
+#pragma warning(push)
+#pragma warning (disable: 4127)
+#endif
+//
+// The unsigned integral type of each size, which the default radix functions map values to. Keys are kept as narrow as the
+// value so that the radix sort doesn't visit more bytes than the value has.
+//
+template <size_t _Size>
+struct _Radix_unsigned_type
+{
+    static_assert(_Size == 1 || _Size == 2 || _Size == 4 || _Size == 8, "Type should be at most 8 bytes to use default radix function.");
+};
+
+template <>
+struct _Radix_unsigned_type<1>
+{
+    typedef unsigned char _Type;
+};
+
+template <>
+struct _Radix_unsigned_type<2>
+{
+    typedef unsigned short _Type;
+};
+
+template <>
+struct _Radix_unsigned_type<4>
+{
+    typedef unsigned int _Type;
+};
+
+template <>
+struct _Radix_unsigned_type<8>
+{
+    typedef unsigned long long _Type;
+};
+
+//
+// Maps a value of an integral type to an unsigned key of the same size whose order is the order of the values.
+//
+template <typename _DataType, bool _Is_floating = std::is_floating_point<_DataType>::value>
+struct _Radix_order_key
+{
+    typedef typename _Radix_unsigned_type<sizeof(_DataType)>::_Type _Key_type;
+
+    static _Key_type _Get(const _DataType& val)
+    {
+        // Flipping the sign bit maps the [signed_min, signed_max] range in order onto the [0, unsigned_max] range.
+        // Unsigned values are returned unchanged.
+        const _Key_type _Sign_bit = std::is_signed<_DataType>::value ? static_cast<_Key_type>(_Key_type(1) << (8 * sizeof(_Key_type) - 1)) : 0;
+
+        return static_cast<_Key_type>(static_cast<_Key_type>(val) ^ _Sign_bit);
+    }
+};
+
+//
+// Maps a float or a double to an unsigned key of the same size whose order is the order of the values.
+//
+template <typename _DataType>
+struct _Radix_order_key<_DataType, true>
+{
+    typedef typename _Radix_unsigned_type<sizeof(_DataType)>::_Type _Key_type;
+
+    static _Key_type _Get(const _DataType& val)
+    {
+        const _Key_type _Sign_bit = static_cast<_Key_type>(_Key_type(1) << (8 * sizeof(_Key_type) - 1));
+
+        // NaNs don't have a place in the order of the values; whatever their sign they are sorted after +infinity. 
+        if (val != val)
+        {
+            return static_cast<_Key_type>(~_Key_type(0));
+        }
+
+        // -0.0 compares equal to +0.0, so it gets the same key and the two keep their relative order
+        _DataType _Value = (val == 0) ? _DataType(0) : val;
+        _Key_type _Bits;
+        memcpy(&_Bits, &_Value, sizeof(_Bits));
+
+        // IEEE 754 values are sign and magnitude: a negative value orders before another one when its magnitude is larger,
+        // so all its bits are flipped; a positive value only needs the sign bit set to order after all negative values.
+        return (_Bits & _Sign_bit) ? static_cast<_Key_type>(~_Bits) : static_cast<_Key_type>(_Bits | _Sign_bit);
+    }
+};
+
+//
+// This is a default function used for parallel_radixsort which maps the value to an order preserving unsigned key.
+// It also performs compile-time checks to ensure that the data type is integral or floating point.
+//
+template <typename _DataType>
+struct _Radix_sort_default_function
+{
+    typename _Radix_order_key<_DataType>::_Key_type operator()(const _DataType& val) const
+    {
+        // An instance of the type predicate returns the key if the type _DataType is one of the integral or floating point types, 
+        // otherwise it statically asserts.
+        // An integral type is one of: bool, char, unsigned char, signed char, wchar_t, short, unsigned short, int, unsigned int, long, 
+        // and unsigned long. 
+        // In addition, with compilers that provide them, an integral type can be one of long long, unsigned long long, __int64, and 
+        // unsigned __int64
+        // The floating point types are float and double; long double is accepted where it is no wider than double.
+        static_assert(std::is_integral<_DataType>::value || std::is_floating_point<_DataType>::value, 
+            "Type should be integral or floating point to use default radix function. For more information on integral types, please refer to http://msdn.microsoft.com/en-us/library/bb983099.aspx.");
+
+        return _Radix_order_key<_DataType>::_Get(val);
+    }
+};
+
+//
+// The default function used for descending radix sorts: the complement of the ascending key reverses the order.
+//
+template <typename _DataType>
+struct _Radix_sort_descending_function
+{
+    typename _Radix_order_key<_DataType>::_Key_type operator()(const _DataType& val) const
+    {
+        _Radix_sort_default_function<_DataType> _Ascending;
+
+        return static_cast<typename _Radix_order_key<_DataType>::_Key_type>(~_Ascending(val));
+    }
+};
+#if defined(_MSC_VER)
+#pragma warning (pop)
+#endif
+
 /// <summary>
-///     This template function is semantically similar to <c>std::sort</c> in that it is a compare-based unstable sort, except that 
-///     it needs O(n) additional space, and requires a default constructor for the type of sorting element.
+///     This template function will sort elements with a radix sorting algorithm. This is a stable sort function which requires a 
+///     projection function that can project sorting elements into unsigned integer-like keys. The algorithm will sort elements in 
+///     key increasing order.
 /// </summary>
 /// <typeparam name="_Allocator">
 ///     The STL compatible memory allocator type.
 /// </typeparam>
 /// <typeparam name="_Random_iterator">
-///     The iterator type of the input range, it requires the iterator category to be random_iterator.
+///     The iterator type of the input range, it requires iterator category to be random_iterator.
 /// </typeparam>
 /// <typeparam name="_Function">
-///     The binary comparison predicate functor type.
+///     The unary projection functor type.
 /// </typeparam>
 /// <param name="_Begin">
-///     The position of the first element to be included for sort.
+///     The position of the first element to be included for radix sort.
 /// </param>
 /// <param name="_End">
-///     The position of the first element not to be included for sort.
+///     The position of the first element not to be included for radix sort.
 /// </param>
 /// <param name="_Func">
-///     The binary comparison predicate functor.
+///     The unary projection functor which returns an unsigned integer-like key from the element type.
 /// </param>
 /// <param name="_Chunk_size">
 ///     The minimal divisible chunk size that can be split for parallel execution.
 /// </param>
 /// <remarks>
-///     There are four overloaded functions, they all require <c>n * sizeof(T)</c> additional space, where <c>n</c> is the number of elements 
-///     to be sorted, and <c>T</c> is the element type.
-///     <para>For the first function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
-///     operator <c>operator <()</c> is required for the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate 
-///     the buffer for this function.</para>
-///     <para>For the second function overload, a default <c>std::less</c> binary comparison functor will be applied to sort, so the comparison 
-///     operator <c>operator <()</c> is required for the element type. To allocate the buffer for this algorithm, users should provide an allocator 
-///     template argument. For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
-///     <para>For the third function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
-///     the element type. The STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer in this function.</para>
-///     <para>For the fourth function overload, a binary compare predicate functor <c>_Func: bool (T, T) </c> is required, in which <c>T</c> is 
-///     the element type. To allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     There are three overloads, they all require <c>n * sizeof(T)</c> bytes of additional space, where <c>n</c> is the number of elements
+///     to be sorted, and <c>T</c> is the element type. An unary projection functor <c>_Proj_func: I (T)</c> is required to return a key 
+///     from a sorting element, in which <c>T</c> is the element type and <c>I</c> is an unsigned integer-like type. A default constructor 
+///     is required for the elements to be sorted.
+///     <para>For the first function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
+///     this function. In addition, a default projection function which maps the value to an order preserving key is used.  This function 
+///     generates a compiler error if the type is not an integral or floating point type. For floating point types, NaNs are sorted 
+///     after all other values and -0.0 and +0.0 are equal.</para>
+///     <para>For the second function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>. In addition, a default projection function which 
+///     maps the value to an order preserving key is used.  This function generates a compiler error if the type is not an integral or 
+///     floating point type. For floating point types, NaNs are sorted after all other values and -0.0 and +0.0 are equal.</para>
+///     <para>For the third function overload, the STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer 
+///     for this function.</para>
+///     <para>For the fourth function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
 ///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
 ///     <para>
 ///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
@@ -2523,7 +6133,7 @@ inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random
 /// </remarks>
 /**/
 template<typename _Allocator, typename _Random_iterator, typename _Function>
-inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Func, const size_t _Chunk_size = 2048)
+inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Proj_func, const size_t _Chunk_size = 256 * 256)
 {
     // We make the guarantee that if the sort is part of a tree that has been canceled before starting, it will
     // not begin at all.
@@ -2533,91 +6143,19 @@ inline void parallel_buffered_sort(const _Random_iterator &_Begin, const _Random
     }
 
     size_t _Size = _End - _Begin;
-    size_t _Core_num = Concurrency::CurrentScheduler::Get()->GetNumberOfVirtualProcessors();
 
-    if (_Size <= _Chunk_size || _Core_num < 2)
+    // If _Size <= 1, no more sorting needs to be done.
+    if (_Size <= 1)
     {
-        return std::sort(_Begin, _End, _Func);
+        return;
     }
-    const static size_t CORE_NUM_MASK = 0x55555555;
 
     _Allocator _Alloc;
     _AllocatedBufferHolder<_Allocator> _Holder(_Size, _Alloc);
 
-    // This buffered sort algorithm will divide chunks and apply parallel quicksort on each chunk. In the end, it will 
-    // apply parallel merge to these sorted chunks.
-    // 
-    // We need to decide the number of chunks to divide the input buffer into. If we divide it into n chunks, log(n) 
-    // merges will be needed to get the final sorted result.  In this algorithm, we have two buffers for each merge 
-    // operation, let's say buffer A and B. Buffer A is the original input array, buffer B is the additional allocated 
-    // buffer.  Each turn's merge will put the merge result into the other buffer; for example, if we decided to split 
-    // into 8 chunks in buffer A at very beginning, after one pass of merging, there will be 4 chunks in buffer B.
-    // If we apply one more pass of merging, there will be 2 chunks in buffer A again.
-    // 
-    // The problem is we want to the final merge pass to put the result back in buffer A, so that we don't need 
-    // one extra copy to put the sorted data back to buffer A.
-    // To make sure the final result is in buffer A (original input array), we need an even number of merge passes,
-    // which means log(n) must be an even number. Thus n must be a number power(2, even number). For example, when the
-    // even number is 2, n is power(2, 2) = 4, when even number is 4, n is power(2, 4) = 16. When we divide chunks 
-    // into these numbers, the final merge result will be in the original input array. Now we need to decide the chunk(split) 
-    // number based on this property and the number of cores.
-    // 
-    // We want to get a chunk (split) number close the the core number (or a little more than the number of cores), 
-    // and it also needs to satisfy above property. For a 8 core machine, the best chunk number should be 16, because it's 
-    // the smallest number that satisfies the above property and is bigger than the core number (so that we can utilize all 
-    // cores, a little more than core number is OK, we need to split more tasks anyway). 
-    // 
-    // In this algorithm, we will make this alignment by bit operations (it's easy and clear). For a binary representation, 
-    // all the numbers that satisfy power(2, even number) will be 1, 100, 10000, 1000000, 100000000 ...
-    // After OR-ing these numbers together, we will get a mask (... 0101 0101 0101) which is all possible combinations of 
-    // power(2, even number). We use _Core_num & CORE_NUM_MASK | _Core_num << 1 & CORE_NUM_MASK, a bit-wise operation to align 
-    // _Core_num's highest bit into a power(2, even number).
-    // 
-    // It means if _Core_num = 8, the highest bit in binary is bin(1000) which is not power(2, even number). After this 
-    // bit-wise operation, it will align to bin(10000) = 16 which is power(2, even number). If the _Core_num = 16, after 
-    // alignment it still returns 16. The trick is to make sure the highest bit of _Core_num will align to the "1" bit of the 
-    // mask bin(... 0101 0101 0101) We don't care about the other bits on the aligned result except the highest bit, since they 
-    // will be ignored in the function.
-    _Parallel_buffered_sort_impl(_Begin, _Size, stdext::make_unchecked_array_iterator(_Holder._Get_buffer()), 
-        _Func, _Core_num & CORE_NUM_MASK | _Core_num << 1 & CORE_NUM_MASK, _Chunk_size);
+    _Parallel_integer_sort_asc(_Begin, _Size, stdext::make_unchecked_array_iterator(_Holder._Get_buffer()), _Proj_func, _Chunk_size);
 }
 
-#pragma warning(push)
-#pragma warning (disable: 4127)
-//
-// This is a default function used for parallel_radixsort which will return just the value.
-// It also performs compile-time checks to ensure that the data type is integral.
-//
-template <typename _DataType>
-struct _Radix_sort_default_function
-{
-    size_t operator()(const _DataType& val) const
-    {
-        // An instance of the type predicate returns the value if the type _DataType is one of the integral types, otherwise it
-        // statically asserts.
-        // An integral type is one of: bool, char, unsigned char, signed char, wchar_t, short, unsigned short, int, unsigned int, long, 
-        // and unsigned long. 
-        // In addition, with compilers that provide them, an integral type can be one of long long, unsigned long long, __int64, and 
-        // unsigned __int64
-        static_assert(std::is_integral<_DataType>::value, 
-            "Type should be integral to use default radix function. For more information on integral types, please refer to http://msdn.microsoft.com/en-us/library/bb983099.aspx.");
-        static_assert((sizeof(_DataType) <= sizeof(size_t)), "Passed Type is bigger than size_t.");
-
-        if (std::is_unsigned<_DataType>::value)
-        {
-            return val;
-        }
-        else
-        {
-            // The default function needs to take the signed integer-like representation and map it to an unsigned one.  The
-            // following code will take the midpoint of the unsigned representable range (SIZE_MAX/2)+1 and does an unsigned
-            // add of the value.  Thus, it maps a [-signed_min,+signed_max] range into a [0, unsigned_max] range.
-            return (((SIZE_MAX/2) + 1) + static_cast<size_t>(val));
-        }
-    }
-};
-#pragma warning (pop)
-
 /// <summary>
 ///     This template function will sort elements with a radix sorting algorithm. This is a stable sort function which requires a 
 ///     projection function that can project sorting elements into unsigned integer-like keys. The algorithm will sort elements in 
@@ -2638,11 +6176,13 @@ struct _Radix_sort_default_function
 ///     from a sorting element, in which <c>T</c> is the element type and <c>I</c> is an unsigned integer-like type. A default constructor 
 ///     is required for the elements to be sorted.
 ///     <para>For the first function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
-///     this function. In addition, a default projection function which simply returns the value is used.  This function generates a 
-///     compiler error if the type is not an integral type.</para>
+///     this function. In addition, a default projection function which maps the value to an order preserving key is used.  This function 
+///     generates a compiler error if the type is not an integral or floating point type. For floating point types, NaNs are sorted 
+///     after all other values and -0.0 and +0.0 are equal.</para>
 ///     <para>For the second function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
 ///     For more information about allocators, please refer to <see cref="allocator Class"/>. In addition, a default projection function which 
-///     simply returns the value is used.  This function generates a compiler error if the type is not an integral type.</para>
+///     maps the value to an order preserving key is used.  This function generates a compiler error if the type is not an integral or 
+///     floating point type. For floating point types, NaNs are sorted after all other values and -0.0 and +0.0 are equal.</para>
 ///     <para>For the third function overload, the STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer 
 ///     for this function.</para>
 ///     <para>For the fourth function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
@@ -2658,7 +6198,7 @@ struct _Radix_sort_default_function
 template<typename _Random_iterator>
 inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_iterator &_End)
 {
-    typedef std::iterator_traits<_Random_iterator>::value_type _DataType;
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _DataType;
 
     _Radix_sort_default_function<_DataType> _Proj_func;
 
@@ -2688,11 +6228,13 @@ inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_ite
 ///     from a sorting element, in which <c>T</c> is the element type and <c>I</c> is an unsigned integer-like type. A default constructor 
 ///     is required for the elements to be sorted.
 ///     <para>For the first function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
-///     this function. In addition, a default projection function which simply returns the value is used.  This function generates a 
-///     compiler error if the type is not an integral type.</para>
+///     this function. In addition, a default projection function which maps the value to an order preserving key is used.  This function 
+///     generates a compiler error if the type is not an integral or floating point type. For floating point types, NaNs are sorted 
+///     after all other values and -0.0 and +0.0 are equal.</para>
 ///     <para>For the second function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
 ///     For more information about allocators, please refer to <see cref="allocator Class"/>. In addition, a default projection function which 
-///     simply returns the value is used.  This function generates a compiler error if the type is not an integral type.</para>
+///     maps the value to an order preserving key is used.  This function generates a compiler error if the type is not an integral or 
+///     floating point type. For floating point types, NaNs are sorted after all other values and -0.0 and +0.0 are equal.</para>
 ///     <para>For the third function overload, the STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer 
 ///     for this function.</para>
 ///     <para>For the fourth function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
@@ -2708,7 +6250,7 @@ inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_ite
 template<typename _Allocator, typename _Random_iterator>
 inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_iterator &_End)
 {
-    typedef std::iterator_traits<_Random_iterator>::value_type _DataType;
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _DataType;
 
     _Radix_sort_default_function<_DataType> _Proj_func;
 
@@ -2744,11 +6286,13 @@ inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_ite
 ///     from a sorting element, in which <c>T</c> is the element type and <c>I</c> is an unsigned integer-like type. A default constructor 
 ///     is required for the elements to be sorted.
 ///     <para>For the first function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
-///     this function. In addition, a default projection function which simply returns the value is used.  This function generates a 
-///     compiler error if the type is not an integral type.</para>
+///     this function. In addition, a default projection function which maps the value to an order preserving key is used.  This function 
+///     generates a compiler error if the type is not an integral or floating point type. For floating point types, NaNs are sorted 
+///     after all other values and -0.0 and +0.0 are equal.</para>
 ///     <para>For the second function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
 ///     For more information about allocators, please refer to <see cref="allocator Class"/>. In addition, a default projection function which 
-///     simply returns the value is used.  This function generates a compiler error if the type is not an integral type.</para>
+///     maps the value to an order preserving key is used.  This function generates a compiler error if the type is not an integral or 
+///     floating point type. For floating point types, NaNs are sorted after all other values and -0.0 and +0.0 are equal.</para>
 ///     <para>For the third function overload, the STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer 
 ///     for this function.</para>
 ///     <para>For the fourth function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
@@ -2769,9 +6313,8 @@ inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_ite
 }
 
 /// <summary>
-///     This template function will sort elements with a radix sorting algorithm. This is a stable sort function which requires a 
-///     projection function that can project sorting elements into unsigned integer-like keys. The algorithm will sort elements in 
-///     key increasing order.
+///     This template function will sort integral or floating point elements in decreasing order with a radix sorting algorithm. This 
+///     is a stable sort function.
 /// </summary>
 /// <typeparam name="_Allocator">
 ///     The STL compatible memory allocator type.
@@ -2779,47 +6322,165 @@ inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_ite
 /// <typeparam name="_Random_iterator">
 ///     The iterator type of the input range, it requires iterator category to be random_iterator.
 /// </typeparam>
-/// <typeparam name="_Function">
-///     The unary projection functor type.
-/// </typeparam>
 /// <param name="_Begin">
 ///     The position of the first element to be included for radix sort.
 /// </param>
 /// <param name="_End">
 ///     The position of the first element not to be included for radix sort.
 /// </param>
-/// <param name="_Func">
-///     The unary projection functor which returns an unsigned integer-like key from the element type.
+/// <remarks>
+///     There are two overloads, they both require <c>n * sizeof(T)</c> bytes of additional space, where <c>n</c> is the number of elements
+///     to be sorted, and <c>T</c> is the element type. The elements are sorted by the complement of the key that 
+///     <see cref="parallel_radixsort Function"/> uses by default, so the order is exactly the reverse: for floating point types, 
+///     NaNs come first, and -0.0 and +0.0 are equal. This function generates a compiler error if the type is not an integral or 
+///     floating point type.
+///     <para>For the first function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
+///     <para>For the second function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
+///     this function.</para>
+/// </remarks>
+/**/
+template<typename _Allocator, typename _Random_iterator>
+inline void parallel_radixsort_descending(const _Random_iterator &_Begin, const _Random_iterator &_End)
+{
+    typedef typename std::iterator_traits<_Random_iterator>::value_type _DataType;
+
+    _Radix_sort_descending_function<_DataType> _Proj_func;
+
+    parallel_radixsort<_Allocator>(_Begin, _End, _Proj_func, 256 * 256);
+}
+
+/// <summary>
+///     This template function will sort integral or floating point elements in decreasing order with a radix sorting algorithm. This 
+///     is a stable sort function.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for radix sort.
 /// </param>
-/// <param name="_Chunk_size">
-///     The minimal divisible chunk size that can be split for parallel execution.
+/// <param name="_End">
+///     The position of the first element not to be included for radix sort.
 /// </param>
 /// <remarks>
-///     There are three overloads, they all require <c>n * sizeof(T)</c> bytes of additional space, where <c>n</c> is the number of elements
-///     to be sorted, and <c>T</c> is the element type. An unary projection functor <c>_Proj_func: I (T)</c> is required to return a key 
-///     from a sorting element, in which <c>T</c> is the element type and <c>I</c> is an unsigned integer-like type. A default constructor 
-///     is required for the elements to be sorted.
-///     <para>For the first function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
-///     this function. In addition, a default projection function which simply returns the value is used.  This function generates a 
-///     compiler error if the type is not an integral type.</para>
-///     <para>For the second function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
-///     For more information about allocators, please refer to <see cref="allocator Class"/>. In addition, a default projection function which 
-///     simply returns the value is used.  This function generates a compiler error if the type is not an integral type.</para>
-///     <para>For the third function overload, the STL memory allocator <c>std::allocator<T> </c> will be used to allocate the buffer 
-///     for this function.</para>
-///     <para>For the fourth function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
+///     There are two overloads, they both require <c>n * sizeof(T)</c> bytes of additional space, where <c>n</c> is the number of elements
+///     to be sorted, and <c>T</c> is the element type. The elements are sorted by the complement of the key that 
+///     <see cref="parallel_radixsort Function"/> uses by default, so the order is exactly the reverse: for floating point types, 
+///     NaNs come first, and -0.0 and +0.0 are equal. This function generates a compiler error if the type is not an integral or 
+///     floating point type.
+///     <para>For the first function overload, to allocate the buffer for this algorithm, users should provide an allocator template argument. 
 ///     For more information about allocators, please refer to <see cref="allocator Class"/>.</para>
-///     <para>
-///     For the optional argument <c>_Chunk_size</c>, the partitioner will guarantee that it will stop splitting and turn to serial sort as soon as 
-///     the size of the chunks is less than <c>_Chunk_size</c>, but it is still possible to stop splitting before that point. 
-///     Move semantics are supported in this function, for more information about move semantics, please refer to 
-///     <see cref=Rvalue Reference Declarator: &amp;&amp;/>.
-///     </para>
+///     <para>For the second function overload, the STL memory allocator <c>std::allocator<T></c> will be used to allocate the buffer for 
+///     this function.</para>
 /// </remarks>
 /**/
-template<typename _Allocator, typename _Random_iterator, typename _Function>
-inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Function &_Proj_func, const size_t _Chunk_size = 256 * 256)
+template<typename _Random_iterator>
+inline void parallel_radixsort_descending(const _Random_iterator &_Begin, const _Random_iterator &_End)
+{
+    parallel_radixsort_descending<std::allocator<typename std::iterator_traits<_Random_iterator>::value_type>>(_Begin, _End);
+}
+
+// The record sorted by parallel_argsort and parallel_radixsort_by_key: the projected key and the position of the element it 
+// was taken from. It is packed so that an 8 byte key with a 4 byte index takes 12 bytes rather than 16.
+#pragma pack(push, 4)
+template<typename _Key_type, typename _Index_type>
+struct _Radix_key_index
+{
+    _Key_type _M_key;
+    _Index_type _M_index;
+};
+#pragma pack(pop)
+
+template<typename _Key_type, typename _Index_type>
+struct _Radix_key_index_projection
 {
+    _Key_type operator()(const _Radix_key_index<_Key_type, _Index_type> &_Rec) const
+    {
+        return _Rec._M_key;
+    }
+};
+
+// Radix sort the (key, index) records of the input, then call _Gather_func(_Pos, _Index) for every position of the sorted order,
+// where _Index is the position in the input of the element that belongs at _Pos.
+template<typename _Index_type, typename _Random_iterator, typename _Function, typename _Gather_function>
+void _Parallel_radix_index_sort_impl(const _Random_iterator &_Begin, size_t _Size, const _Function &_Proj_func, const _Gather_function &_Gather_func)
+{
+    typedef typename std::remove_const<typename std::remove_reference<decltype(_Proj_func(*_Begin))>::type>::type _Integer_type;
+    typedef _Radix_key_index<_Integer_type, _Index_type> _Record_type;
+
+    std::allocator<_Record_type> _Alloc;
+    _AllocatedBufferHolder<std::allocator<_Record_type>> _Holder(_Size, _Alloc);
+    _Record_type * _Records = _Holder._Get_buffer();
+
+    parallel_for_fixed(static_cast<size_t>(0), _Size, [&](size_t _I)
+    {
+        _Records[_I]._M_key = _Proj_func(_Begin[_I]);
+        _Records[_I]._M_index = static_cast<_Index_type>(_I);
+    });
+
+    // The radix sort is stable, so elements with equal keys keep their input order
+    parallel_radixsort(_Records, _Records + _Size, _Radix_key_index_projection<_Integer_type, _Index_type>());
+
+    parallel_for_fixed(static_cast<size_t>(0), _Size, [&](size_t _I)
+    {
+        _Gather_func(_I, static_cast<size_t>(_Records[_I]._M_index));
+    });
+}
+
+// Dispatch to 32 bit indices whenever the input is small enough, which keeps the records as small as possible
+template<typename _Random_iterator, typename _Function, typename _Gather_function>
+inline void _Parallel_radix_index_sort(const _Random_iterator &_Begin, size_t _Size, const _Function &_Proj_func, const _Gather_function &_Gather_func)
+{
+    if (_Size <= static_cast<size_t>(0xFFFFFFFF))
+    {
+        _Parallel_radix_index_sort_impl<unsigned int>(_Begin, _Size, _Proj_func, _Gather_func);
+    }
+    else
+    {
+        _Parallel_radix_index_sort_impl<size_t>(_Begin, _Size, _Proj_func, _Gather_func);
+    }
+}
+
+/// <summary>
+///     This template function computes the permutation that radix sorts the given range, without moving the elements. It writes 
+///     the position of the element with the smallest key first, and so on, so that <c>_Begin[_Result[i]]</c> is the i-th element
+///     in key increasing order. Elements with equal keys keep their relative order.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Random_output_iterator">
+///     The iterator type of the permutation, it requires iterator category to be random_iterator and an integral value type.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The unary projection functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for the sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for the sort.
+/// </param>
+/// <param name="_Result">
+///     The position of the first element of the permutation, which has room for <c>_End - _Begin</c> indices.
+/// </param>
+/// <param name="_Proj_func">
+///     The unary projection functor which returns an unsigned integer-like key from the element type.
+/// </param>
+/// <remarks>
+///     Only the keys and their positions are sorted: for large elements that is much less memory traffic than sorting the elements 
+///     themselves. Positions are kept in 32 bits when there are fewer than 2^32 elements. <c>2 * n * (sizeof(I) + sizeof(index))</c> 
+///     bytes of additional space are required, where <c>n</c> is the number of elements and <c>I</c> is the key type.
+///     <para>For the second function overload, a default projection function which maps the value to an order preserving key is used.  
+///     This function generates a compiler error if the type is not an integral or floating point type.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Random_output_iterator, typename _Function>
+inline void parallel_argsort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Random_output_iterator &_Result, const _Function &_Proj_func)
+{
+    typedef typename std::iterator_traits<_Random_output_iterator>::value_type _Result_type;
+
     // We make the guarantee that if the sort is part of a tree that has been canceled before starting, it will
     // not begin at all.
     if (is_current_task_group_canceling())
@@ -2828,20 +6489,183 @@ inline void parallel_radixsort(const _Random_iterator &_Begin, const _Random_ite
     }
 
     size_t _Size = _End - _Begin;
+    if (_Size == 0)
+    {
+        return;
+    }
 
-    // If _Size <= 1, no more sorting needs to be done.
+    _Parallel_radix_index_sort(_Begin, _Size, _Proj_func, [&](size_t _Pos, size_t _Index)
+    {
+        _Result[_Pos] = static_cast<_Result_type>(_Index);
+    });
+}
+
+/// <summary>
+///     This template function computes the permutation that radix sorts the given range, without moving the elements. It writes 
+///     the position of the element with the smallest key first, and so on, so that <c>_Begin[_Result[i]]</c> is the i-th element
+///     in key increasing order. Elements with equal keys keep their relative order.
+/// </summary>
+/// <typeparam name="_Random_iterator">
+///     The iterator type of the input range, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Random_output_iterator">
+///     The iterator type of the permutation, it requires iterator category to be random_iterator and an integral value type.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The unary projection functor type.
+/// </typeparam>
+/// <param name="_Begin">
+///     The position of the first element to be included for the sort.
+/// </param>
+/// <param name="_End">
+///     The position of the first element not to be included for the sort.
+/// </param>
+/// <param name="_Result">
+///     The position of the first element of the permutation, which has room for <c>_End - _Begin</c> indices.
+/// </param>
+/// <param name="_Proj_func">
+///     The unary projection functor which returns an unsigned integer-like key from the element type.
+/// </param>
+/// <remarks>
+///     Only the keys and their positions are sorted: for large elements that is much less memory traffic than sorting the elements 
+///     themselves. Positions are kept in 32 bits when there are fewer than 2^32 elements. <c>2 * n * (sizeof(I) + sizeof(index))</c> 
+///     bytes of additional space are required, where <c>n</c> is the number of elements and <c>I</c> is the key type.
+///     <para>For the second function overload, a default projection function which maps the value to an order preserving key is used.  
+///     This function generates a compiler error if the type is not an integral or floating point type.</para>
+/// </remarks>
+/**/
+template<typename _Random_iterator, typename _Random_output_iterator>
+inline void parallel_argsort(const _Random_iterator &_Begin, const _Random_iterator &_End, const _Random_output_iterator &_Result)
+{
+    _Radix_sort_default_function<typename std::iterator_traits<_Random_iterator>::value_type> _Proj_func;
+
+    parallel_argsort(_Begin, _End, _Result, _Proj_func);
+}
+
+/// <summary>
+///     This template function radix sorts a range of keys and applies the same reordering to a range of values, so that each value 
+///     stays with its key. This is a stable sort: elements with equal keys keep their relative order.
+/// </summary>
+/// <typeparam name="_Key_iterator">
+///     The iterator type of the keys, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Value_iterator">
+///     The iterator type of the values, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The unary projection functor type.
+/// </typeparam>
+/// <param name="_Key_begin">
+///     The position of the first key to be included for the sort.
+/// </param>
+/// <param name="_Key_end">
+///     The position of the first key not to be included for the sort.
+/// </param>
+/// <param name="_Value_begin">
+///     The position of the value that belongs to the first key; there must be <c>_Key_end - _Key_begin</c> values.
+/// </param>
+/// <param name="_Proj_func">
+///     The unary projection functor which returns an unsigned integer-like radix key from the key type.
+/// </param>
+/// <remarks>
+///     The keys are sorted together with their positions, and keys and values are then each moved into place once. Sorting 
+///     records of key and position and moving each value only once is much less memory traffic than moving large values on every 
+///     radix pass. Besides the space used by <see cref="parallel_argsort Function"/>, <c>n * (sizeof(K) + sizeof(V))</c> bytes of 
+///     additional space are required, where <c>n</c> is the number of elements and <c>K</c> and <c>V</c> are the key and value 
+///     types. A default constructor is required for keys and values.
+///     <para>For the second function overload, a default projection function which maps the key to an order preserving radix key is used.  
+///     This function generates a compiler error if the key type is not an integral or floating point type.</para>
+/// </remarks>
+/**/
+template<typename _Key_iterator, typename _Value_iterator, typename _Function>
+inline void parallel_radixsort_by_key(const _Key_iterator &_Key_begin, const _Key_iterator &_Key_end, const _Value_iterator &_Value_begin, 
+    const _Function &_Proj_func)
+{
+    typedef typename std::iterator_traits<_Key_iterator>::value_type _Key_type;
+    typedef typename std::iterator_traits<_Value_iterator>::value_type _Value_type;
+
+    // We make the guarantee that if the sort is part of a tree that has been canceled before starting, it will
+    // not begin at all.
+    if (is_current_task_group_canceling())
+    {
+        return;
+    }
+
+    size_t _Size = _Key_end - _Key_begin;
     if (_Size <= 1)
     {
         return;
     }
 
-    _Allocator _Alloc;
-    _AllocatedBufferHolder<_Allocator> _Holder(_Size, _Alloc);
+    std::allocator<_Key_type> _Key_alloc;
+    _AllocatedBufferHolder<std::allocator<_Key_type>> _Key_holder(_Size, _Key_alloc);
+    std::allocator<_Value_type> _Value_alloc;
+    _AllocatedBufferHolder<std::allocator<_Value_type>> _Value_holder(_Size, _Value_alloc);
 
-    _Parallel_integer_sort_asc(_Begin, _Size, stdext::make_unchecked_array_iterator(_Holder._Get_buffer()), _Proj_func, _Chunk_size);
+    _Key_type * _Keys = _Key_holder._Get_buffer();
+    _Value_type * _Values = _Value_holder._Get_buffer();
+
+    _Parallel_radix_index_sort(_Key_begin, _Size, _Proj_func, [&](size_t _Pos, size_t _Index)
+    {
+        _Keys[_Pos] = std::move(_Key_begin[_Index]);
+        _Values[_Pos] = std::move(_Value_begin[_Index]);
+    });
+
+    parallel_for_fixed(static_cast<size_t>(0), _Size, [&](size_t _I)
+    {
+        _Key_begin[_I] = std::move(_Keys[_I]);
+        _Value_begin[_I] = std::move(_Values[_I]);
+    });
+}
+
+/// <summary>
+///     This template function radix sorts a range of keys and applies the same reordering to a range of values, so that each value 
+///     stays with its key. This is a stable sort: elements with equal keys keep their relative order.
+/// </summary>
+/// <typeparam name="_Key_iterator">
+///     The iterator type of the keys, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Value_iterator">
+///     The iterator type of the values, it requires iterator category to be random_iterator.
+/// </typeparam>
+/// <typeparam name="_Function">
+///     The unary projection functor type.
+/// </typeparam>
+/// <param name="_Key_begin">
+///     The position of the first key to be included for the sort.
+/// </param>
+/// <param name="_Key_end">
+///     The position of the first key not to be included for the sort.
+/// </param>
+/// <param name="_Value_begin">
+///     The position of the value that belongs to the first key; there must be <c>_Key_end - _Key_begin</c> values.
+/// </param>
+/// <param name="_Proj_func">
+///     The unary projection functor which returns an unsigned integer-like radix key from the key type.
+/// </param>
+/// <remarks>
+///     The keys are sorted together with their positions, and keys and values are then each moved into place once. Sorting 
+///     records of key and position and moving each value only once is much less memory traffic than moving large values on every 
+///     radix pass. Besides the space used by <see cref="parallel_argsort Function"/>, <c>n * (sizeof(K) + sizeof(V))</c> bytes of 
+///     additional space are required, where <c>n</c> is the number of elements and <c>K</c> and <c>V</c> are the key and value 
+///     types. A default constructor is required for keys and values.
+///     <para>For the second function overload, a default projection function which maps the key to an order preserving radix key is used.  
+///     This function generates a compiler error if the key type is not an integral or floating point type.</para>
+/// </remarks>
+/**/
+template<typename _Key_iterator, typename _Value_iterator>
+inline void parallel_radixsort_by_key(const _Key_iterator &_Key_begin, const _Key_iterator &_Key_end, const _Value_iterator &_Value_begin)
+{
+    _Radix_sort_default_function<typename std::iterator_traits<_Key_iterator>::value_type> _Proj_func;
+
+    parallel_radixsort_by_key(_Key_begin, _Key_end, _Value_begin, _Proj_func);
 }
 
+#pragma pop_macro("_SAMPLE_SORT_OVERSAMPLING")
+#pragma pop_macro("_SAMPLE_SORT_MIN_SIZE")
 #pragma pop_macro("_SORT_MAX_RECURSION_DEPTH")
+#pragma pop_macro("_RADIX_WC_MIN_SIZE")
+#pragma pop_macro("_RADIX_WC_LINE_SIZE")
 #pragma pop_macro("_MAX_NUM_TASKS_PER_CORE")
 #pragma pop_macro("_FINE_GRAIN_CHUNK_SIZE")
 } // namespace samples
@@ -11,6 +11,7 @@
 #pragma once
 
 #include <concrt.h>
+#include <climits>
 
 namespace Concurrency
 {
@@ -252,6 +253,167 @@ namespace samples
         WaitQueue m_waitQueue;
     };
 
+    // Semaphore with a lock-free fast path. The count is kept in an
+    // interlocked counter and the underlying cooperative semaphore is only
+    // touched when a caller has to block (count would drop below zero) or
+    // when a release has to wake blocked callers. A negative count is the
+    // number of blocked waiters.
+    class lightweight_semaphore
+    {
+    public:
+        lightweight_semaphore(int initialCount, int spinCount = 1024)
+            : m_count(initialCount),
+              m_spinCount(spinCount),
+              m_semaphore(0, INT_MAX)
+        {
+            _ASSERTE(initialCount >= 0);
+        }
+
+        // Attempt to decrement the count without blocking. Returns "false"
+        // if the count is 0.
+        bool try_wait()
+        {
+            long oldCount = m_count;
+            while (oldCount > 0)
+            {
+                long prevCount = _InterlockedCompareExchange(&m_count, oldCount - 1, oldCount);
+                if (prevCount == oldCount)
+                {
+                    return true;
+                }
+
+                oldCount = prevCount;
+            }
+
+            return false;
+        }
+
+        // Attempt to decrement the count by up to maxCount without blocking.
+        // Returns the amount actually taken, 0 if the count is 0.
+        int try_wait_many(int maxCount)
+        {
+            _ASSERTE(maxCount > 0);
+
+            long oldCount = m_count;
+            while (oldCount > 0)
+            {
+                long take = (oldCount < maxCount) ? oldCount : maxCount;
+                long prevCount = _InterlockedCompareExchange(&m_count, oldCount - take, oldCount);
+                if (prevCount == oldCount)
+                {
+                    return (int)take;
+                }
+
+                oldCount = prevCount;
+            }
+
+            return 0;
+        }
+
+        // Decrement the count by at least 1 and at most maxCount, blocking 
+        // only while the count is 0. Returns the amount taken, 0 if the wait
+        // timed out.
+        int wait_many(int maxCount, unsigned int timeout = COOPERATIVE_TIMEOUT_INFINITE)
+        {
+            int taken = try_wait_many(maxCount);
+            if (taken > 0)
+            {
+                return taken;
+            }
+
+            if (!wait(timeout))
+            {
+                return 0;
+            }
+
+            // Pick up whatever else became available while waiting
+            return (maxCount > 1) ? 1 + try_wait_many(maxCount - 1) : 1;
+        }
+
+        // P(). Decrement the count, spinning briefly and then cooperatively
+        // blocking if it is 0. If the wait times out the return value is "false".
+        bool wait(unsigned int timeout = COOPERATIVE_TIMEOUT_INFINITE)
+        {
+            if (try_wait())
+            {
+                return true;
+            }
+
+            if (timeout == 0)
+            {
+                return false;
+            }
+
+            // Spin for a little while; a short stall on the other side
+            // should not cost a trip through the wait queue
+            for (int spin = 0; spin < m_spinCount; ++spin)
+            {
+                _YieldProcessor();
+
+                if ((m_count > 0) && try_wait())
+                {
+                    return true;
+                }
+            }
+
+            if (_InterlockedDecrement(&m_count) >= 0)
+            {
+                return true;
+            }
+
+            if (m_semaphore.wait(timeout))
+            {
+                return true;
+            }
+
+            // Timeout. Withdraw from the waiter count unless a release has
+            // already accounted for this waiter, in which case its signal is
+            // on the way and has to be consumed.
+            long oldCount = m_count;
+            while (oldCount < 0)
+            {
+                long prevCount = _InterlockedCompareExchange(&m_count, oldCount + 1, oldCount);
+                if (prevCount == oldCount)
+                {
+                    return false;
+                }
+
+                oldCount = prevCount;
+            }
+
+            m_semaphore.wait();
+            return true;
+        }
+
+        // V(). Increment the count by the specified amount and wake
+        // up to that many blocked waiters. The routine returns the count 
+        // prior to this increment (negative if there were waiters).
+        int release(int count = 1)
+        {
+            _ASSERTE(count > 0);
+
+            long oldCount = _InterlockedExchangeAdd(&m_count, count);
+            long toWake = (-oldCount < count) ? -oldCount : count;
+
+            if (toWake > 0)
+            {
+                m_semaphore.release(toWake);
+            }
+
+            return oldCount;
+        }
+
+    private:
+
+        // Not copyable
+        lightweight_semaphore(const lightweight_semaphore&);
+        lightweight_semaphore& operator=(const lightweight_semaphore&);
+
+        volatile long m_count;
+        int m_spinCount;
+        semaphore m_semaphore;
+    };
+
 
 } // namespace samples
 } // namespace Concurrency
\ No newline at end of file
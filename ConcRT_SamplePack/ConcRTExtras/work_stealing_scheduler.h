@@ -0,0 +1,1244 @@
+//--------------------------------------------------------------------------
+//
+//  Copyright (c) Microsoft Corporation.  All rights reserved.
+//
+//  File: work_stealing_scheduler.h
+//
+//  A portable, header-only work-stealing scheduler built on std::thread and
+//  the PPL subset that ppl_extras.h is written against. It is selected by
+//  defining CONCRTEXTRAS_STD_THREAD_BACKEND before including ppl_extras.h,
+//  and allows the algorithms to be compiled with GCC or Clang on platforms
+//  where the Concurrency Runtime is not available.
+//
+//--------------------------------------------------------------------------
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#ifndef _ASSERTE
+#define _ASSERTE(_Expr) assert(_Expr)
+#endif
+
+// The algorithms allocate task_handle arrays through _malloca; heap allocation is used here since the
+// arrays are sized by the number of virtual processors and never large.
+#ifndef _malloca
+#define _malloca(_Size) ::Concurrency::Alloc(_Size)
+#define _freea(_Ptr) ::Concurrency::Free(_Ptr)
+#endif
+
+namespace Concurrency
+{
+/// <summary>
+///     Allocates a block of memory of the size specified.
+/// </summary>
+/// <param name="_NumBytes">
+///     The number of bytes of memory to allocate.
+/// </param>
+/// <returns>
+///     A pointer to newly allocated memory.
+/// </returns>
+/**/
+inline void * Alloc(size_t _NumBytes)
+{
+    void * _Ptr = ::malloc(_NumBytes != 0 ? _NumBytes : 1);
+    if (_Ptr == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return _Ptr;
+}
+
+/// <summary>
+///     Releases a block of memory previously allocated by the <c>Alloc</c> method.
+/// </summary>
+/// <param name="_PAllocation">
+///     A pointer to memory previously allocated by the <c>Alloc</c> method which is to be freed.
+/// </param>
+/**/
+inline void Free(void * _PAllocation)
+{
+    ::free(_PAllocation);
+}
+
+/// <summary>
+///     Describes the execution status of a <c>task_group</c> or <c>structured_task_group</c> object.
+/// </summary>
+/**/
+enum task_group_status
+{
+    not_complete,
+    completed,
+    canceled
+};
+
+namespace samples
+{
+namespace details
+{
+    class _Ws_task_collection;
+
+    //
+    // A unit of work queued on the scheduler. Tasks are owned by the scheduler once queued and delete themselves
+    // after running.
+    //
+    class _Ws_task
+    {
+    public:
+        explicit _Ws_task(_Ws_task_collection * _PCollection) : _M_pCollection(_PCollection)
+        {
+        }
+
+        virtual ~_Ws_task()
+        {
+        }
+
+        // Runs the task in the context of its collection and releases it
+        inline void _Invoke();
+
+    protected:
+        virtual void _Execute() = 0;
+
+    private:
+        _Ws_task_collection * _M_pCollection;
+    };
+
+    //
+    // Chase-Lev work-stealing deque. The owning worker pushes and pops at the bottom, thieves steal from the top.
+    // The circular array grows on demand; retired arrays are kept until the deque is destroyed because a thief
+    // may still be reading from them.
+    //
+    class _Ws_deque
+    {
+    private:
+        struct _Array
+        {
+            explicit _Array(long long _Log_size) :
+                _M_size(1LL << _Log_size), _M_mask((1LL << _Log_size) - 1), _M_slots(new std::atomic<_Ws_task *>[static_cast<size_t>(1LL << _Log_size)])
+            {
+            }
+
+            ~_Array()
+            {
+                delete [] _M_slots;
+            }
+
+            _Ws_task * _Get(long long _Index) const
+            {
+                return _M_slots[_Index & _M_mask].load(std::memory_order_acquire);
+            }
+
+            void _Put(long long _Index, _Ws_task * _PTask)
+            {
+                _M_slots[_Index & _M_mask].store(_PTask, std::memory_order_release);
+            }
+
+            const long long _M_size;
+            const long long _M_mask;
+            std::atomic<_Ws_task *> * _M_slots;
+        };
+
+    public:
+        _Ws_deque() : _M_top(0), _M_bottom(0), _M_array(new _Array(_Initial_log_size))
+        {
+        }
+
+        ~_Ws_deque()
+        {
+            delete _M_array.load(std::memory_order_relaxed);
+            for (size_t _I = 0; _I < _M_retired.size(); ++_I)
+            {
+                delete _M_retired[_I];
+            }
+        }
+
+        // Called only by the owner
+        void _Push(_Ws_task * _PTask)
+        {
+            long long _Bottom = _M_bottom.load(std::memory_order_relaxed);
+            long long _Top = _M_top.load(std::memory_order_acquire);
+            _Array * _PArray = _M_array.load(std::memory_order_relaxed);
+
+            if (_Bottom - _Top > _PArray->_M_size - 1)
+            {
+                _PArray = _Grow(_PArray, _Top, _Bottom);
+            }
+
+            _PArray->_Put(_Bottom, _PTask);
+            std::atomic_thread_fence(std::memory_order_release);
+            _M_bottom.store(_Bottom + 1, std::memory_order_relaxed);
+        }
+
+        // Called only by the owner; returns the most recently pushed task
+        _Ws_task * _Pop()
+        {
+            long long _Bottom = _M_bottom.load(std::memory_order_relaxed) - 1;
+            _Array * _PArray = _M_array.load(std::memory_order_relaxed);
+            _M_bottom.store(_Bottom, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long long _Top = _M_top.load(std::memory_order_relaxed);
+
+            _Ws_task * _PTask = NULL;
+            if (_Top <= _Bottom)
+            {
+                _PTask = _PArray->_Get(_Bottom);
+                if (_Top == _Bottom)
+                {
+                    // Last element, race against the thieves for it
+                    if (!_M_top.compare_exchange_strong(_Top, _Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                    {
+                        _PTask = NULL;
+                    }
+                    _M_bottom.store(_Bottom + 1, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                _M_bottom.store(_Bottom + 1, std::memory_order_relaxed);
+            }
+
+            return _PTask;
+        }
+
+        // Called by any thread; returns the oldest task or NULL if the deque is empty or the steal lost a race
+        _Ws_task * _Steal()
+        {
+            long long _Top = _M_top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            long long _Bottom = _M_bottom.load(std::memory_order_acquire);
+
+            if (_Top < _Bottom)
+            {
+                _Array * _PArray = _M_array.load(std::memory_order_acquire);
+                _Ws_task * _PTask = _PArray->_Get(_Top);
+                if (!_M_top.compare_exchange_strong(_Top, _Top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                {
+                    return NULL;
+                }
+                return _PTask;
+            }
+
+            return NULL;
+        }
+
+    private:
+        static const long long _Initial_log_size = 8;
+
+        _Array * _Grow(_Array * _POld, long long _Top, long long _Bottom)
+        {
+            long long _Log_size = 0;
+            while ((1LL << _Log_size) < _POld->_M_size * 2)
+            {
+                ++_Log_size;
+            }
+
+            _Array * _PNew = new _Array(_Log_size);
+            for (long long _I = _Top; _I < _Bottom; ++_I)
+            {
+                _PNew->_Put(_I, _POld->_Get(_I));
+            }
+
+            _M_retired.push_back(_POld);
+            _M_array.store(_PNew, std::memory_order_release);
+            return _PNew;
+        }
+
+        std::atomic<long long> _M_top;
+        char _M_pad[64];
+        std::atomic<long long> _M_bottom;
+        std::atomic<_Array *> _M_array;
+        std::vector<_Array *> _M_retired;
+
+        _Ws_deque(const _Ws_deque &);
+        _Ws_deque & operator=(const _Ws_deque &);
+    };
+
+    //
+    // The work-stealing scheduler. One worker thread is created per hardware thread; each worker owns a deque and
+    // steals from randomly chosen victims when its own deque runs dry. Work queued from threads that are not
+    // workers goes through a shared injection queue. Idle workers spin briefly and then sleep on a condition
+    // variable until new work is queued.
+    //
+    class _Ws_scheduler
+    {
+    private:
+        struct _Worker
+        {
+            _Worker(_Ws_scheduler * _PScheduler, unsigned int _Index) :
+                _M_pScheduler(_PScheduler), _M_index(_Index), _M_seed(_Index * 2654435761u + 1)
+            {
+            }
+
+            _Ws_deque _M_deque;
+            _Ws_scheduler * _M_pScheduler;
+            unsigned int _M_index;
+            unsigned int _M_seed;
+            std::thread _M_thread;
+        };
+
+    public:
+        static _Ws_scheduler & _Instance()
+        {
+            static _Ws_scheduler _S_scheduler;
+            return _S_scheduler;
+        }
+
+        unsigned int _Number_of_workers() const
+        {
+            return static_cast<unsigned int>(_M_workers.size());
+        }
+
+        // Returns the index of the calling worker, or -1 if the caller is not a worker of this scheduler
+        int _Current_worker_index() const
+        {
+            _Worker * _PWorker = _Current_worker();
+            return (_PWorker != NULL) ? static_cast<int>(_PWorker->_M_index) : -1;
+        }
+
+        void _Schedule(_Ws_task * _PTask)
+        {
+            _Worker * _PWorker = _Current_worker();
+            if (_PWorker != NULL)
+            {
+                _PWorker->_M_deque._Push(_PTask);
+            }
+            else
+            {
+                std::lock_guard<std::mutex> _Lock(_M_inject_lock);
+                _M_inject.push_back(_PTask);
+            }
+
+            _M_queued.fetch_add(1, std::memory_order_seq_cst);
+            if (_M_sleepers.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> _Lock(_M_sleep_lock);
+                _M_wake.notify_one();
+            }
+        }
+
+        // Wakes the threads blocked in _Help_until so that they re-check their predicates
+        void _Notify_waiters()
+        {
+            if (_M_sleepers.load(std::memory_order_seq_cst) > 0)
+            {
+                std::lock_guard<std::mutex> _Lock(_M_sleep_lock);
+                _M_wake.notify_all();
+            }
+        }
+
+        // Executes queued work on the calling thread until the predicate is satisfied. The predicate must become
+        // true only by a change that is followed by a call to _Notify_waiters, or the caller may sleep through it.
+        template<typename _Predicate>
+        void _Help_until(const _Predicate & _Done)
+        {
+            _Worker * _PWorker = _Current_worker();
+            unsigned int _Seed = (_PWorker != NULL) ? _PWorker->_M_seed : _External_seed();
+            unsigned int _Idle = 0;
+
+            while (!_Done())
+            {
+                _Ws_task * _PTask = _Find_work(_PWorker, _Seed);
+                if (_PTask != NULL)
+                {
+                    _PTask->_Invoke();
+                    _Idle = 0;
+                }
+                else if (++_Idle < _Spin_count)
+                {
+                    std::this_thread::yield();
+                }
+                else
+                {
+                    // The outstanding tasks are running elsewhere; sleep like an idle worker until new work is queued
+                    // or _Notify_waiters reports a change. The sleeper is announced before the predicate is re-checked,
+                    // the same handshake as in _Worker_proc.
+                    std::unique_lock<std::mutex> _Lock(_M_sleep_lock);
+                    _M_sleepers.fetch_add(1, std::memory_order_seq_cst);
+                    while (!_Done() && _M_queued.load(std::memory_order_seq_cst) <= 0 && !_M_shutdown.load())
+                    {
+                        _M_wake.wait(_Lock);
+                    }
+                    _M_sleepers.fetch_sub(1, std::memory_order_seq_cst);
+                    _Idle = 0;
+                }
+            }
+
+            if (_PWorker != NULL)
+            {
+                _PWorker->_M_seed = _Seed;
+            }
+        }
+
+    private:
+        static const unsigned int _Spin_count = 64;
+
+        _Ws_scheduler() : _M_queued(0), _M_sleepers(0), _M_shutdown(false)
+        {
+            // CONCRTEXTRAS_STD_THREAD_WORKERS overrides the number of workers, which is otherwise the number of hardware threads
+#if defined(CONCRTEXTRAS_STD_THREAD_WORKERS)
+            unsigned int _Count = CONCRTEXTRAS_STD_THREAD_WORKERS;
+#else
+            unsigned int _Count = std::thread::hardware_concurrency();
+#endif
+            if (_Count == 0)
+            {
+                _Count = 1;
+            }
+
+            _M_workers.reserve(_Count);
+            for (unsigned int _I = 0; _I < _Count; ++_I)
+            {
+                _M_workers.push_back(new _Worker(this, _I));
+            }
+
+            // Threads are started after all deques exist, since they immediately begin stealing from each other
+            for (unsigned int _I = 0; _I < _Count; ++_I)
+            {
+                _M_workers[_I]->_M_thread = std::thread(&_Ws_scheduler::_Worker_proc, this, _M_workers[_I]);
+            }
+        }
+
+        ~_Ws_scheduler()
+        {
+            {
+                std::lock_guard<std::mutex> _Lock(_M_sleep_lock);
+                _M_shutdown.store(true);
+                _M_wake.notify_all();
+            }
+
+            for (size_t _I = 0; _I < _M_workers.size(); ++_I)
+            {
+                _M_workers[_I]->_M_thread.join();
+                delete _M_workers[_I];
+            }
+        }
+
+        static _Worker *& _Current_worker()
+        {
+            static thread_local _Worker * _S_pWorker = NULL;
+            return _S_pWorker;
+        }
+
+        static unsigned int & _External_seed()
+        {
+            static thread_local unsigned int _S_seed =
+                static_cast<unsigned int>(std::hash<std::thread::id>()(std::this_thread::get_id())) | 1;
+            return _S_seed;
+        }
+
+        static unsigned int _Next_random(unsigned int & _Seed)
+        {
+            // xorshift32
+            _Seed ^= _Seed << 13;
+            _Seed ^= _Seed >> 17;
+            _Seed ^= _Seed << 5;
+            return _Seed;
+        }
+
+        _Ws_task * _Find_work(_Worker * _PWorker, unsigned int & _Seed)
+        {
+            _Ws_task * _PTask = NULL;
+
+            if (_PWorker != NULL)
+            {
+                _PTask = _PWorker->_M_deque._Pop();
+            }
+
+            if (_PTask == NULL)
+            {
+                // Randomized stealing: start from a random victim and visit every other worker once
+                size_t _Count = _M_workers.size();
+                size_t _Start = _Next_random(_Seed) % _Count;
+                for (size_t _I = 0; _I < _Count && _PTask == NULL; ++_I)
+                {
+                    _Worker * _PVictim = _M_workers[(_Start + _I) % _Count];
+                    if (_PVictim != _PWorker)
+                    {
+                        _PTask = _PVictim->_M_deque._Steal();
+                    }
+                }
+            }
+
+            if (_PTask == NULL)
+            {
+                std::lock_guard<std::mutex> _Lock(_M_inject_lock);
+                if (!_M_inject.empty())
+                {
+                    _PTask = _M_inject.front();
+                    _M_inject.pop_front();
+                }
+            }
+
+            if (_PTask != NULL)
+            {
+                _M_queued.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            return _PTask;
+        }
+
+        void _Worker_proc(_Worker * _PWorker)
+        {
+            _Current_worker() = _PWorker;
+            unsigned int _Idle = 0;
+
+            while (!_M_shutdown.load(std::memory_order_relaxed))
+            {
+                _Ws_task * _PTask = _Find_work(_PWorker, _PWorker->_M_seed);
+                if (_PTask != NULL)
+                {
+                    _PTask->_Invoke();
+                    _Idle = 0;
+                    continue;
+                }
+
+                if (++_Idle < _Spin_count)
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                // Announce the sleeper before re-checking the queued count; _Schedule increments the count before
+                // reading the number of sleepers, so one of the two sides always observes the other.
+                std::unique_lock<std::mutex> _Lock(_M_sleep_lock);
+                _M_sleepers.fetch_add(1, std::memory_order_seq_cst);
+                while (_M_queued.load(std::memory_order_seq_cst) <= 0 && !_M_shutdown.load())
+                {
+                    _M_wake.wait(_Lock);
+                }
+                _M_sleepers.fetch_sub(1, std::memory_order_seq_cst);
+                _Idle = 0;
+            }
+
+            _Current_worker() = NULL;
+        }
+
+        std::vector<_Worker *> _M_workers;
+        std::mutex _M_inject_lock;
+        std::deque<_Ws_task *> _M_inject;
+        std::atomic<long> _M_queued;
+        std::atomic<int> _M_sleepers;
+        std::atomic<bool> _M_shutdown;
+        std::mutex _M_sleep_lock;
+        std::condition_variable _M_wake;
+
+        _Ws_scheduler(const _Ws_scheduler &);
+        _Ws_scheduler & operator=(const _Ws_scheduler &);
+    };
+
+    //
+    // The state shared by task_group and structured_task_group: the count of outstanding tasks, the cancellation
+    // flag and the first exception thrown by a task. Collections created while a task runs are nested inside the
+    // collection of that task, so canceling a parent is observed by its children.
+    //
+    class _Ws_task_collection
+    {
+    public:
+        _Ws_task_collection() : _M_pParent(_Current()), _M_pending(0), _M_canceled(false)
+        {
+        }
+
+        ~_Ws_task_collection()
+        {
+            _ASSERTE(_M_pending.load() == 0);
+        }
+
+        static _Ws_task_collection *& _Current()
+        {
+            static thread_local _Ws_task_collection * _S_pCurrent = NULL;
+            return _S_pCurrent;
+        }
+
+        void _Schedule(_Ws_task * _PTask)
+        {
+            _M_pending.fetch_add(1, std::memory_order_relaxed);
+            _Ws_scheduler::_Instance()._Schedule(_PTask);
+        }
+
+        // Runs a functor inline on the calling thread as a member of this collection
+        template<typename _Function>
+        void _Run_inline(const _Function & _Func)
+        {
+            if (_Is_canceling())
+            {
+                return;
+            }
+
+            _Ws_task_collection * _PPrevious = _Current();
+            _Current() = this;
+            try
+            {
+                _Func();
+            }
+            catch (...)
+            {
+                _Capture_exception();
+            }
+            _Current() = _PPrevious;
+        }
+
+        task_group_status _Wait()
+        {
+            _Ws_scheduler::_Instance()._Help_until([this]() -> bool {
+                return _M_pending.load(std::memory_order_seq_cst) == 0;
+            });
+
+            if (_M_exception)
+            {
+                std::exception_ptr _Exception = _M_exception;
+                _M_exception = std::exception_ptr();
+                _M_canceled.store(false);
+                std::rethrow_exception(_Exception);
+            }
+
+            if (_M_canceled.load())
+            {
+                _M_canceled.store(false);
+                return canceled;
+            }
+
+            return completed;
+        }
+
+        void _Cancel()
+        {
+            _M_canceled.store(true);
+        }
+
+        bool _Is_canceling() const
+        {
+            for (const _Ws_task_collection * _PCollection = this; _PCollection != NULL; _PCollection = _PCollection->_M_pParent)
+            {
+                if (_PCollection->_M_canceled.load(std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        void _Capture_exception()
+        {
+            {
+                std::lock_guard<std::mutex> _Lock(_M_exception_lock);
+                if (!_M_exception)
+                {
+                    _M_exception = std::current_exception();
+                }
+            }
+            _Cancel();
+        }
+
+        void _Task_done()
+        {
+            // The collection may be destroyed as soon as the count drops to zero, so only the scheduler is touched
+            // after the decrement
+            if (_M_pending.fetch_sub(1, std::memory_order_seq_cst) == 1)
+            {
+                _Ws_scheduler::_Instance()._Notify_waiters();
+            }
+        }
+
+    private:
+        _Ws_task_collection * const _M_pParent;
+        std::atomic<long> _M_pending;
+        std::atomic<bool> _M_canceled;
+        std::mutex _M_exception_lock;
+        std::exception_ptr _M_exception;
+
+        _Ws_task_collection(const _Ws_task_collection &);
+        _Ws_task_collection & operator=(const _Ws_task_collection &);
+    };
+
+    inline void _Ws_task::_Invoke()
+    {
+        _Ws_task_collection * _PCollection = _M_pCollection;
+        if (!_PCollection->_Is_canceling())
+        {
+            _Ws_task_collection * _PPrevious = _Ws_task_collection::_Current();
+            _Ws_task_collection::_Current() = _PCollection;
+            try
+            {
+                _Execute();
+            }
+            catch (...)
+            {
+                _PCollection->_Capture_exception();
+            }
+            _Ws_task_collection::_Current() = _PPrevious;
+        }
+
+        // The collection may be destroyed as soon as the count drops, so the task is released first
+        delete this;
+        _PCollection->_Task_done();
+    }
+
+    // A task owning a copy of the functor, used by task_group::run
+    template<typename _Function>
+    class _Ws_function_task : public _Ws_task
+    {
+    public:
+        _Ws_function_task(_Ws_task_collection * _PCollection, const _Function & _Func) : _Ws_task(_PCollection), _M_function(_Func)
+        {
+        }
+
+    protected:
+        virtual void _Execute()
+        {
+            _M_function();
+        }
+
+    private:
+        _Function _M_function;
+    };
+
+    // A task referring to a functor owned by the caller, used for task_handle objects
+    template<typename _Function>
+    class _Ws_reference_task : public _Ws_task
+    {
+    public:
+        _Ws_reference_task(_Ws_task_collection * _PCollection, const _Function & _Func) : _Ws_task(_PCollection), _M_function(_Func)
+        {
+        }
+
+    protected:
+        virtual void _Execute()
+        {
+            _M_function();
+        }
+
+    private:
+        const _Function & _M_function;
+    };
+} // namespace details
+} // namespace samples
+
+/// <summary>
+///     Returns an indication of whether the task group which is currently executing inline on the current context
+///     is in the midst of an active cancellation (or will be shortly).
+/// </summary>
+/// <returns>
+///     <c>true</c> if the task group which is currently executing is canceling, <c>false</c> otherwise.
+/// </returns>
+/**/
+inline bool is_current_task_group_canceling()
+{
+    samples::details::_Ws_task_collection * _PCurrent = samples::details::_Ws_task_collection::_Current();
+    return (_PCurrent != NULL) && _PCurrent->_Is_canceling();
+}
+
+/// <summary>
+///     The <c>task_handle</c> class represents an individual parallel work item. It encapsulates the instructions
+///     and the data required to execute a piece of work.
+/// </summary>
+/// <typeparam name="_Function">
+///     The type of the function object that will be invoked to execute the work represented by the <c>task_handle</c> object.
+/// </typeparam>
+/**/
+template<typename _Function>
+class task_handle
+{
+public:
+    task_handle(const _Function & _Func) : _M_function(_Func)
+    {
+    }
+
+    void operator()() const
+    {
+        _M_function();
+    }
+
+private:
+    _Function _M_function;
+};
+
+/// <summary>
+///     A factory method for creating a <c>task_handle</c> object.
+/// </summary>
+/**/
+template<class _Function>
+task_handle<_Function> make_task(const _Function & _Func)
+{
+    return task_handle<_Function>(_Func);
+}
+
+/// <summary>
+///     The <c>task_group</c> class represents a collection of parallel work which can be waited on or canceled.
+/// </summary>
+/**/
+class task_group
+{
+public:
+    task_group()
+    {
+    }
+
+    ~task_group()
+    {
+        // Work must not outlive the group; exceptions are dropped as they cannot be thrown from a destructor
+        try
+        {
+            _M_collection._Wait();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    template<typename _Function>
+    void run(const _Function & _Func)
+    {
+        _M_collection._Schedule(new samples::details::_Ws_function_task<_Function>(&_M_collection, _Func));
+    }
+
+    template<typename _Function>
+    void run(task_handle<_Function> & _Task_handle)
+    {
+        _M_collection._Schedule(new samples::details::_Ws_reference_task<task_handle<_Function>>(&_M_collection, _Task_handle));
+    }
+
+    task_group_status wait()
+    {
+        return _M_collection._Wait();
+    }
+
+    template<typename _Function>
+    task_group_status run_and_wait(const _Function & _Func)
+    {
+        _M_collection._Run_inline(_Func);
+        return _M_collection._Wait();
+    }
+
+    void cancel()
+    {
+        _M_collection._Cancel();
+    }
+
+    bool is_canceling()
+    {
+        return _M_collection._Is_canceling();
+    }
+
+private:
+    samples::details::_Ws_task_collection _M_collection;
+
+    task_group(const task_group &);
+    task_group & operator=(const task_group &);
+};
+
+/// <summary>
+///     The <c>structured_task_group</c> class represents a highly structured collection of parallel work. The
+///     <c>task_handle</c> objects passed to it must remain alive until the group has been waited on.
+/// </summary>
+/**/
+class structured_task_group
+{
+public:
+    structured_task_group()
+    {
+    }
+
+    ~structured_task_group()
+    {
+        try
+        {
+            _M_collection._Wait();
+        }
+        catch (...)
+        {
+        }
+    }
+
+    template<typename _Function>
+    void run(task_handle<_Function> & _Task_handle)
+    {
+        _M_collection._Schedule(new samples::details::_Ws_reference_task<task_handle<_Function>>(&_M_collection, _Task_handle));
+    }
+
+    task_group_status wait()
+    {
+        return _M_collection._Wait();
+    }
+
+    template<typename _Function>
+    task_group_status run_and_wait(task_handle<_Function> & _Task_handle)
+    {
+        _M_collection._Run_inline(_Task_handle);
+        return _M_collection._Wait();
+    }
+
+    template<typename _Function>
+    task_group_status run_and_wait(const _Function & _Func)
+    {
+        _M_collection._Run_inline(_Func);
+        return _M_collection._Wait();
+    }
+
+    void cancel()
+    {
+        _M_collection._Cancel();
+    }
+
+    bool is_canceling()
+    {
+        return _M_collection._Is_canceling();
+    }
+
+private:
+    samples::details::_Ws_task_collection _M_collection;
+
+    structured_task_group(const structured_task_group &);
+    structured_task_group & operator=(const structured_task_group &);
+};
+
+/// <summary>
+///     Represents the scheduler the calling context runs on; only the queries used by the sample algorithms are provided.
+/// </summary>
+/**/
+class Scheduler
+{
+public:
+    unsigned int GetNumberOfVirtualProcessors() const
+    {
+        return samples::details::_Ws_scheduler::_Instance()._Number_of_workers();
+    }
+};
+
+/// <summary>
+///     Represents an abstraction for the current scheduler associated with the calling context.
+/// </summary>
+/**/
+class CurrentScheduler
+{
+public:
+    static Scheduler * Get()
+    {
+        static Scheduler _S_scheduler;
+        return &_S_scheduler;
+    }
+};
+
+/// <summary>
+///     The <c>combinable</c> object provides thread-private copies of data, to perform lock-free thread-local
+///     sub-computations during parallel algorithms.
+/// </summary>
+/// <typeparam name="_Ty">
+///     The data type of the final merged result.
+/// </typeparam>
+/**/
+template<typename _Ty>
+class combinable
+{
+public:
+    combinable() : _M_init(&combinable::_Default_init)
+    {
+        _Initialize();
+    }
+
+    template<typename _Function>
+    explicit combinable(_Function _FnInitialize) : _M_init(_FnInitialize)
+    {
+        _Initialize();
+    }
+
+    ~combinable()
+    {
+        clear();
+    }
+
+    _Ty & local()
+    {
+        bool _Exists;
+        return local(_Exists);
+    }
+
+    _Ty & local(bool & _Exists)
+    {
+        int _Index = samples::details::_Ws_scheduler::_Instance()._Current_worker_index();
+        if (_Index >= 0)
+        {
+            // Only the owning worker ever touches its slot
+            _Ty *& _PSlot = _M_worker_slots[_Index];
+            _Exists = (_PSlot != NULL);
+            if (!_Exists)
+            {
+                _PSlot = new _Ty(_M_init());
+            }
+            return *_PSlot;
+        }
+
+        std::lock_guard<std::mutex> _Lock(_M_external_lock);
+        _Ty *& _PSlot = _M_external_slots[std::this_thread::get_id()];
+        _Exists = (_PSlot != NULL);
+        if (!_Exists)
+        {
+            _PSlot = new _Ty(_M_init());
+        }
+        return *_PSlot;
+    }
+
+    void clear()
+    {
+        for (size_t _I = 0; _I < _M_worker_slots.size(); ++_I)
+        {
+            delete _M_worker_slots[_I];
+            _M_worker_slots[_I] = NULL;
+        }
+
+        for (typename std::map<std::thread::id, _Ty *>::iterator _It = _M_external_slots.begin(); _It != _M_external_slots.end(); ++_It)
+        {
+            delete _It->second;
+        }
+        _M_external_slots.clear();
+    }
+
+    template<typename _Function>
+    _Ty combine(_Function _FnCombine) const
+    {
+        bool _Has_value = false;
+        _Ty _Result = _Ty();
+        combine_each([&](const _Ty & _Value) {
+            _Result = _Has_value ? _FnCombine(_Result, _Value) : _Value;
+            _Has_value = true;
+        });
+        return _Has_value ? _Result : _M_init();
+    }
+
+    template<typename _Function>
+    void combine_each(_Function _FnCombine) const
+    {
+        for (size_t _I = 0; _I < _M_worker_slots.size(); ++_I)
+        {
+            if (_M_worker_slots[_I] != NULL)
+            {
+                _FnCombine(*_M_worker_slots[_I]);
+            }
+        }
+
+        for (typename std::map<std::thread::id, _Ty *>::const_iterator _It = _M_external_slots.begin(); _It != _M_external_slots.end(); ++_It)
+        {
+            _FnCombine(*_It->second);
+        }
+    }
+
+private:
+    static _Ty _Default_init()
+    {
+        return _Ty();
+    }
+
+    void _Initialize()
+    {
+        _M_worker_slots.assign(samples::details::_Ws_scheduler::_Instance()._Number_of_workers(), static_cast<_Ty *>(NULL));
+    }
+
+    std::function<_Ty ()> _M_init;
+    std::vector<_Ty *> _M_worker_slots;
+    std::mutex _M_external_lock;
+    std::map<std::thread::id, _Ty *> _M_external_slots;
+
+    combinable(const combinable &);
+    combinable & operator=(const combinable &);
+};
+
+namespace samples
+{
+namespace details
+{
+    // Recursively halves [_First, _Last) until ranges reach the grain size, queuing the upper halves for stealing
+    template<typename _Index_type, typename _Function>
+    void _Ws_parallel_for_recursive(_Index_type _First, _Index_type _Last, _Index_type _Grain, const _Function & _Func)
+    {
+        if (_Last - _First <= _Grain)
+        {
+            if (!is_current_task_group_canceling())
+            {
+                for (_Index_type _I = _First; _I < _Last; ++_I)
+                {
+                    _Func(_I);
+                }
+            }
+            return;
+        }
+
+        _Index_type _Mid = _First + (_Last - _First) / 2;
+
+        structured_task_group _Tg;
+        auto _Upper = make_task([_Mid, _Last, _Grain, &_Func]() {
+            _Ws_parallel_for_recursive(_Mid, _Last, _Grain, _Func);
+        });
+        _Tg.run(_Upper);
+
+        _Tg.run_and_wait([_First, _Mid, _Grain, &_Func]() {
+            _Ws_parallel_for_recursive(_First, _Mid, _Grain, _Func);
+        });
+    }
+
+    // Executes _Func for every iteration number in [0, _Iterations), balancing through recursive splitting
+    template<typename _Index_type, typename _Function>
+    void _Ws_parallel_for(_Index_type _Iterations, const _Function & _Func)
+    {
+        if (_Iterations <= 0)
+        {
+            return;
+        }
+
+        _Index_type _Grain = static_cast<_Index_type>(_Iterations / (_Ws_scheduler::_Instance()._Number_of_workers() * 8));
+        if (_Grain < 1)
+        {
+            _Grain = 1;
+        }
+
+        _Ws_parallel_for_recursive(_Index_type(0), _Iterations, _Grain, _Func);
+    }
+
+    // Executes _Func for every iteration number in [0, _Iterations) as one fixed chunk per virtual processor
+    template<typename _Index_type, typename _Function>
+    void _Ws_parallel_for_static(_Index_type _Iterations, const _Function & _Func)
+    {
+        if (_Iterations <= 0)
+        {
+            return;
+        }
+
+        _Index_type _Num_chunks = static_cast<_Index_type>(_Ws_scheduler::_Instance()._Number_of_workers());
+        if (_Num_chunks > _Iterations)
+        {
+            _Num_chunks = _Iterations;
+        }
+
+        _Index_type _Step = _Iterations / _Num_chunks;
+        _Index_type _Remain = _Iterations % _Num_chunks;
+
+        task_group _Tg;
+        _Index_type _Begin = 0;
+        for (_Index_type _Chunk = 0; _Chunk < _Num_chunks; ++_Chunk)
+        {
+            _Index_type _End = _Begin + _Step + ((_Chunk < _Remain) ? 1 : 0);
+            _Tg.run([_Begin, _End, &_Func]() {
+                for (_Index_type _I = _Begin; _I < _End; ++_I)
+                {
+                    _Func(_I);
+                }
+            });
+            _Begin = _End;
+        }
+        _Tg.wait();
+    }
+
+    template<typename _Iterator, typename _Function>
+    void _Ws_parallel_for_each(_Iterator _First, _Iterator _Last, const _Function & _Func, std::random_access_iterator_tag)
+    {
+        typedef typename std::iterator_traits<_Iterator>::difference_type _Diff_type;
+        _Ws_parallel_for(static_cast<_Diff_type>(_Last - _First), [&_First, &_Func](_Diff_type _I) {
+            _Func(_First[_I]);
+        });
+    }
+
+    template<typename _Iterator, typename _Function>
+    void _Ws_parallel_for_each(_Iterator _First, _Iterator _Last, const _Function & _Func, std::forward_iterator_tag)
+    {
+        // Forward iterators are walked serially and handed out in batches
+        const size_t _Batch_size = 1024;
+        task_group _Tg;
+        while (_First != _Last)
+        {
+            _Iterator _Head = _First;
+            size_t _Count = 0;
+            while (_Count < _Batch_size && _First != _Last)
+            {
+                ++_First;
+                ++_Count;
+            }
+
+            _Tg.run([_Head, _Count, &_Func]() {
+                _Iterator _It = _Head;
+                for (size_t _I = 0; _I < _Count; ++_I, ++_It)
+                {
+                    _Func(*_It);
+                }
+            });
+        }
+        _Tg.wait();
+    }
+} // namespace details
+} // namespace samples
+
+/// <summary>
+///     <c>parallel_for</c> iterates over a range of indices and executes a user-supplied function at each iteration, in parallel.
+/// </summary>
+/**/
+template <typename _Index_type, typename _Function>
+void parallel_for(_Index_type _First, _Index_type _Last, _Index_type _Step, const _Function & _Func)
+{
+    if (_Step < 1)
+    {
+        throw std::invalid_argument("_Step");
+    }
+
+    if (_First >= _Last)
+    {
+        return;
+    }
+
+    _Index_type _Iterations = (_Step == 1) ? (_Last - _First) : ((_Last - _First - 1) / _Step + 1);
+    samples::details::_Ws_parallel_for(_Iterations, [_First, _Step, &_Func](_Index_type _I) {
+        _Func(static_cast<_Index_type>(_First + _I * _Step));
+    });
+}
+
+/// <summary>
+///     <c>parallel_for</c> iterates over a range of indices and executes a user-supplied function at each iteration, in parallel.
+/// </summary>
+/**/
+template <typename _Index_type, typename _Function>
+void parallel_for(_Index_type _First, _Index_type _Last, const _Function & _Func)
+{
+    parallel_for(_First, _Last, _Index_type(1), _Func);
+}
+
+/// <summary>
+///     <c>parallel_for_each</c> applies a specified function to each element within a range, in parallel.
+/// </summary>
+/**/
+template <typename _Iterator, typename _Function>
+void parallel_for_each(_Iterator _First, _Iterator _Last, const _Function & _Func)
+{
+    samples::details::_Ws_parallel_for_each(_First, _Last, _Func, typename std::iterator_traits<_Iterator>::iterator_category());
+}
+
+// The sample algorithms call the runtime's internal loop helper directly
+template <typename _Index_type, typename _Function>
+void _Parallel_for_impl(_Index_type _First, _Index_type _Last, _Index_type _Step, const _Function & _Func)
+{
+    parallel_for(_First, _Last, _Step, _Func);
+}
+} // namespace Concurrency
+
+namespace stdext
+{
+    // Unchecked iterators are an MSVC debugging aid; raw pointers are used as they are
+    template<class _Iterator>
+    inline _Iterator make_unchecked_array_iterator(_Iterator _Ptr)
+    {
+        return _Ptr;
+    }
+} // namespace stdext